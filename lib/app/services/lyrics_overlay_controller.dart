@@ -6,16 +6,83 @@ import 'package:tono_music/app/services/player_service.dart';
 class LyricsOverlayController extends GetxService {
   final RxBool visible = false.obs;
 
+  /// Re-anchor the native timeline when the reported position drifts this
+  /// far from the extrapolated one.
+  static const int _resyncThresholdMs = 150;
+
+  /// True while the native overlay has the current song's sheet and picks
+  /// lines itself from the playback anchor.
+  bool _nativeTimeline = false;
+
+  /// Texts of the sheet the native timeline has; any other line is a
+  /// status message ("loading", "no lyrics") and goes through setText.
+  Set<String> _sheetTexts = const {};
+
+  /// True while a status message is up, which the timeline does not
+  /// replace until its next line.
+  bool _showingStatus = false;
+  int _anchorMs = 0;
+  bool _anchorPlaying = false;
+  final Stopwatch _anchorClock = Stopwatch();
+
   Future<LyricsOverlayController> init() async {
     try {
       final player = Get.find<PlayerService>();
+      ever(player.lyrics, (List<LyricPoint> lines) async {
+        final ok = await LyricsOverlayService.instance.setSheet(
+          player.lyricsLrc,
+        );
+        _nativeTimeline = ok && lines.isNotEmpty;
+        _sheetTexts = _nativeTimeline
+            ? lines.map((l) => l.text).toSet()
+            : const <String>{};
+        _syncPlayback(
+          player.position.value,
+          player.playing.value,
+          force: true,
+        );
+      });
       ever(player.currentLyricLine, (String line) {
+        // Lyric lines are shown by the native timeline; status messages
+        // (and platforms without one) still go through setText, as does
+        // the first lyric line after a status message.
+        final lyric = _nativeTimeline && _sheetTexts.contains(line);
+        if (lyric && !_showingStatus) return;
+        _showingStatus = _nativeTimeline && !lyric;
         LyricsOverlayService.instance.setText(line);
       });
+      ever(player.position, (Duration d) {
+        _syncPlayback(d, player.playing.value);
+      });
+      ever(player.playing, (bool playing) {
+        _syncPlayback(player.position.value, playing, force: true);
+      });
     } catch (_) {}
     return this;
   }
 
+  void _syncPlayback(Duration position, bool playing, {bool force = false}) {
+    if (!_nativeTimeline) return;
+    final ms = position.inMilliseconds;
+    final predicted = _anchorPlaying
+        ? _anchorMs + _anchorClock.elapsedMilliseconds
+        : _anchorMs;
+    if (!force &&
+        playing == _anchorPlaying &&
+        (ms - predicted).abs() < _resyncThresholdMs) {
+      return;
+    }
+    _anchorMs = ms;
+    _anchorPlaying = playing;
+    _anchorClock
+      ..reset()
+      ..start();
+    LyricsOverlayService.instance.setPlayback(
+      positionMs: ms,
+      playing: playing,
+    );
+  }
+
   Future<void> updateStyle({
     String? fontFamily,
     int? fontSize,
@@ -0,0 +1,260 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:io';
+
+import 'package:ffi/ffi.dart';
+
+/// Mirrors `TonoOverlayStyle` in native/overlay_core/tono_overlay_api.h.
+final class TonoOverlayStyle extends Struct {
+  @Uint32()
+  external int structSize;
+  @Uint32()
+  external int fields;
+  external Pointer<Utf8> fontFamily;
+  @Int32()
+  external int fontSize;
+  @Int32()
+  external int fontWeight;
+  @Int32()
+  external int bold;
+  @Uint32()
+  external int textColor;
+  @Int32()
+  external int textOpacity;
+  @Int32()
+  external int strokeWidth;
+  @Uint32()
+  external int strokeColor;
+  @Uint32()
+  external int highlightColor;
+  @Int32()
+  external int textAlign;
+  @Int32()
+  external int width;
+  @Int32()
+  external int lines;
+  @Int32()
+  external int padding;
+  @Int32()
+  external int x;
+  @Int32()
+  external int y;
+  @Int32()
+  external int backgroundAlpha;
+}
+
+typedef _SetTextNative = Int32 Function(Pointer<Uint8>, Size);
+typedef _SetText = int Function(Pointer<Uint8>, int);
+typedef _ApplyStyleNative = Int32 Function(Pointer<TonoOverlayStyle>);
+typedef _ApplyStyle = int Function(Pointer<TonoOverlayStyle>);
+typedef _SetPlaybackNative = Int32 Function(Int64, Int32, Double);
+typedef _SetPlayback = int Function(int, int, double);
+typedef _VersionNative = Int32 Function();
+typedef _Version = int Function();
+
+/// Synchronous calls into the overlay C API the Windows and Linux runners
+/// export, for the updates sent while a song plays. They skip the
+/// MethodChannel codec and its hop to the platform thread; the channel
+/// stays for everything else and for runners without the API.
+class LyricsOverlayFfi {
+  LyricsOverlayFfi._(DynamicLibrary lib)
+    : _setText = lib.lookupFunction<_SetTextNative, _SetText>(
+        'tono_overlay_set_text',
+      ),
+      _applyStyle = lib.lookupFunction<_ApplyStyleNative, _ApplyStyle>(
+        'tono_overlay_apply_style',
+      ),
+      _setPlayback = lib.lookupFunction<_SetPlaybackNative, _SetPlayback>(
+        'tono_overlay_set_playback',
+      ),
+      _setSheetLrc = lib.providesSymbol('tono_overlay_set_sheet_lrc')
+          ? lib.lookupFunction<_SetTextNative, _SetText>(
+              'tono_overlay_set_sheet_lrc',
+            )
+          : null;
+
+  /// Null when the runner does not export a compatible API.
+  static final LyricsOverlayFfi? instance = _open();
+
+  static const int _apiVersion = 1;
+  static const int _ok = 0;
+
+  // Bits of TonoOverlayStyle.fields.
+  static const int _fontFamily = 1 << 0;
+  static const int _fontSize = 1 << 1;
+  static const int _fontWeight = 1 << 2;
+  static const int _bold = 1 << 3;
+  static const int _textColor = 1 << 4;
+  static const int _textOpacity = 1 << 5;
+  static const int _strokeWidth = 1 << 6;
+  static const int _strokeColor = 1 << 7;
+  static const int _highlightColor = 1 << 8;
+  static const int _textAlign = 1 << 9;
+  static const int _width = 1 << 10;
+  static const int _lines = 1 << 11;
+  static const int _padding = 1 << 12;
+  static const int _x = 1 << 13;
+  static const int _y = 1 << 14;
+  static const int _backgroundAlpha = 1 << 15;
+
+  static const Map<String, int> _alignNames = {
+    'left': 0,
+    'center': 1,
+    'centre': 1,
+    'right': 2,
+  };
+
+  final _SetText _setText;
+  final _ApplyStyle _applyStyle;
+  final _SetPlayback _setPlayback;
+  // Null for runners built before it was added.
+  final _SetText? _setSheetLrc;
+
+  // Reused across calls; the native side copies what it keeps.
+  final Pointer<TonoOverlayStyle> _style = calloc<TonoOverlayStyle>();
+  Pointer<Uint8> _text = nullptr;
+  int _textCapacity = 0;
+
+  static LyricsOverlayFfi? _open() {
+    if (!Platform.isWindows && !Platform.isLinux) return null;
+    try {
+      final lib = DynamicLibrary.executable();
+      final version = lib.lookupFunction<_VersionNative, _Version>(
+        'tono_overlay_api_version',
+      );
+      if (version() != _apiVersion) return null;
+      return LyricsOverlayFfi._(lib);
+    } on ArgumentError {
+      return null;
+    }
+  }
+
+  /// Each call returns true when the runner took it, and false for any
+  /// negative status, after which the caller can use the channel instead.
+  bool setText(String text) {
+    final length = _encode(text);
+    return _setText(_text, length) == _ok;
+  }
+
+  /// Sends the song's LRC text, which the runner parses itself. False if
+  /// the runner lacks the call.
+  bool setSheet(String lrc) {
+    final setSheetLrc = _setSheetLrc;
+    if (setSheetLrc == null) return false;
+    final length = _encode(lrc);
+    return setSheetLrc(_text, length) == _ok;
+  }
+
+  // Copies [text] as UTF-8 into the reused buffer; returns its length.
+  int _encode(String text) {
+    final bytes = utf8.encode(text);
+    if (bytes.length > _textCapacity) {
+      if (_text != nullptr) calloc.free(_text);
+      _textCapacity = bytes.length < 256 ? 256 : bytes.length * 2;
+      _text = calloc<Uint8>(_textCapacity);
+    }
+    _text.asTypedList(_textCapacity).setAll(0, bytes);
+    return bytes.length;
+  }
+
+  /// Applies the applyOverlayStyle fields in [style]. Returns null when a
+  /// value has no C form (names, color strings), so the caller can send
+  /// the map over the channel instead.
+  bool? applyStyle(Map<String, Object> style) {
+    final s = _style.ref;
+    s.structSize = sizeOf<TonoOverlayStyle>();
+    s.fields = 0;
+    Pointer<Utf8> family = nullptr;
+    for (final entry in style.entries) {
+      final value = entry.value;
+      final int? number = value is num ? value.round() : null;
+      switch (entry.key) {
+        case 'fontFamily':
+          if (value is! String) return _reject(family);
+          if (family != nullptr) calloc.free(family);
+          family = value.toNativeUtf8(allocator: calloc);
+          s.fontFamily = family;
+          s.fields |= _fontFamily;
+        case 'bold':
+          if (value is! bool) return _reject(family);
+          s.bold = value ? 1 : 0;
+          s.fields |= _bold;
+        case 'textAlign':
+          final align = value is String
+              ? _alignNames[value.toLowerCase()]
+              : number;
+          if (align == null) return _reject(family);
+          s.textAlign = align;
+          s.fields |= _textAlign;
+        default:
+          final bit = _setNumber(s, entry.key, number);
+          if (bit == 0) return _reject(family);
+          s.fields |= bit;
+      }
+    }
+    final ok = _applyStyle(_style) == _ok;
+    if (family != nullptr) calloc.free(family);
+    return ok;
+  }
+
+  bool setPlayback({
+    required int positionMs,
+    required bool playing,
+    double rate = 1.0,
+  }) {
+    return _setPlayback(positionMs, playing ? 1 : 0, rate) == _ok;
+  }
+
+  static bool? _reject(Pointer<Utf8> family) {
+    if (family != nullptr) calloc.free(family);
+    return null;
+  }
+
+  // Stores a numeric field and returns its bit, or 0 if [key] is not one or
+  // [value] is missing.
+  static int _setNumber(TonoOverlayStyle s, String key, int? value) {
+    if (value == null) return 0;
+    switch (key) {
+      case 'fontSize':
+        s.fontSize = value;
+        return _fontSize;
+      case 'fontWeight':
+        s.fontWeight = value;
+        return _fontWeight;
+      case 'textColor':
+        s.textColor = value;
+        return _textColor;
+      case 'textOpacity':
+        s.textOpacity = value;
+        return _textOpacity;
+      case 'strokeWidth':
+        s.strokeWidth = value;
+        return _strokeWidth;
+      case 'strokeColor':
+        s.strokeColor = value;
+        return _strokeColor;
+      case 'highlightColor':
+        s.highlightColor = value;
+        return _highlightColor;
+      case 'width':
+        s.width = value;
+        return _width;
+      case 'lines':
+        s.lines = value;
+        return _lines;
+      case 'padding':
+        s.padding = value;
+        return _padding;
+      case 'x':
+        s.x = value;
+        return _x;
+      case 'y':
+        s.y = value;
+        return _y;
+      case 'backgroundAlpha':
+        s.backgroundAlpha = value;
+        return _backgroundAlpha;
+    }
+    return 0;
+  }
+}
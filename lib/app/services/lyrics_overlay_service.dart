@@ -1,193 +1,447 @@
 import 'package:flutter/services.dart';
+import 'package:tono_music/app/services/lyrics_overlay_ffi.dart';
 
 class LyricsOverlayService {
   LyricsOverlayService._();
 
   static final LyricsOverlayService instance = LyricsOverlayService._();
 
+  /// Arguments go as native values: bools as bools, numbers and 0xRRGGBB
+  /// colors as ints. The runners still accept the string forms older
+  /// builds sent.
   static const MethodChannel _channel = MethodChannel(
     'com.enten0103.tono_music/window',
   );
 
+  /// Direct native calls for the per-line updates, when the runner has them.
+  /// A call the native side refuses (any negative status) goes over the
+  /// channel instead, which reports why. They only reach the default
+  /// overlay, so calls for any other id go over the channel too.
+  static final LyricsOverlayFfi? _ffi = LyricsOverlayFfi.instance;
+
+  /// The overlay methods address the one with their `id` argument,
+  /// creating it on first use; settings sent before its window exists
+  /// apply once it does. The app drives this one.
+  static const int defaultId = 0;
+
   bool isLock = false;
 
-  Future<bool> lock(bool enable) async {
+  /// [args] plus the overlay [id], left out for the default overlay so
+  /// those calls stay as older runners expect them.
+  static Map<String, Object?>? _withId(int id, [Map<String, Object?>? args]) {
+    if (id == defaultId) return args;
+    return {...?args, 'id': id};
+  }
+
+  Future<bool> lock(bool enable, {int id = defaultId}) async {
     try {
       final dynamic res = await _channel.invokeMethod(
         'setOverlayClickThrough',
-        {'enabled': enable},
+        _withId(id, {'enabled': enable}),
       );
-      if (res is bool) {
-        isLock = res;
-      } else if (res != null) {
-        isLock = res.toString().toLowerCase() == 'true';
-      }
-    } catch (_) {}
+      final locked = res is bool
+          ? res
+          : res != null && res.toString().toLowerCase() == 'true';
+      if (id != defaultId) return locked;
+      if (res != null) isLock = locked;
+    } catch (_) {
+      if (id != defaultId) return false;
+    }
     return isLock;
   }
 
-  Future<bool> create() async {
+  Future<bool> create({int id = defaultId}) async {
     try {
-      final res = await _channel.invokeMethod('createLyricsWindow');
+      final res = await _channel.invokeMethod(
+        'createLyricsWindow',
+        _withId(id),
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> show() async {
+  Future<bool> show({int id = defaultId}) async {
     try {
-      final res = await _channel.invokeMethod('showLyricsWindow');
+      final res = await _channel.invokeMethod('showLyricsWindow', _withId(id));
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> hide() async {
+  Future<bool> hide({int id = defaultId}) async {
     try {
-      final res = await _channel.invokeMethod('hideLyricsWindow');
+      final res = await _channel.invokeMethod('hideLyricsWindow', _withId(id));
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> destroy() async {
+  Future<bool> destroy({int id = defaultId}) async {
     try {
-      final res = await _channel.invokeMethod('destroyLyricsWindow');
+      final res = await _channel.invokeMethod(
+        'destroyLyricsWindow',
+        _withId(id),
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> setText(String text) async {
+  Future<bool> setText(String text, {int id = defaultId}) async {
+    final ffi = _ffi;
+    if (ffi != null && id == defaultId && ffi.setText(text)) return true;
     try {
-      final res = await _channel.invokeMethod('setLyricsText', {'text': text});
+      final res = await _channel.invokeMethod(
+        'setLyricsText',
+        _withId(id, {'text': text}),
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> setTextColor(int color) async {
+  /// Sends the whole song as LRC text, which the native side parses
+  /// itself (<mm:ss.xx> word tags drive the karaoke sweep). It then
+  /// pre-renders upcoming lines in the background and advances them from
+  /// [setPlayback].
+  Future<bool> setSheet(
+    String lrc, {
+    int? lookahead,
+    int id = defaultId,
+  }) async {
+    final ffi = _ffi;
+    if (ffi != null &&
+        id == defaultId &&
+        lookahead == null &&
+        ffi.setSheet(lrc)) {
+      return true;
+    }
     try {
-      final res = await _channel.invokeMethod('setLyricsTextColor', {
-        'textColor': '0x${color.toRadixString(16)}',
-      });
+      final res = await _channel.invokeMethod(
+        'setLyricsSheet',
+        _withId(id, {
+          'lrc': lrc,
+          if (lookahead != null) 'lookahead': lookahead,
+        }),
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> setBold(bool bold) async {
+  /// Anchors the native lyric timeline: playback was at [positionMs] just
+  /// now. Only needed when playback jumps, pauses, resumes or drifts; the
+  /// overlay advances lines on its own in between.
+  Future<bool> setPlayback({
+    required int positionMs,
+    required bool playing,
+    double rate = 1.0,
+    int id = defaultId,
+  }) async {
+    final ffi = _ffi;
+    if (ffi != null &&
+        id == defaultId &&
+        ffi.setPlayback(positionMs: positionMs, playing: playing, rate: rate)) {
+      return true;
+    }
     try {
-      final res = await _channel.invokeMethod('setLyricsBold', {
-        'bold': bold.toString(),
-      });
+      final res = await _channel.invokeMethod(
+        'setLyricsPlayback',
+        _withId(id, {
+          'positionMs': positionMs,
+          'playing': playing,
+          'rate': rate,
+        }),
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> setFontFamily(String family) async {
+  /// Applies any subset of the overlay style in one native transaction:
+  /// every field is validated first, then the font is rebuilt at most once
+  /// and the overlay rendered once. Keys: fontFamily, fontSize, fontWeight,
+  /// bold, textColor, textOpacity, strokeWidth, strokeColor, highlightColor,
+  /// textAlign, width, lines, padding, x, y, backgroundAlpha,
+  /// backgroundColor, cornerRadius, transition, transitionMs, marquee,
+  /// marqueeSpeed, marqueePauseMs. Colors are 0xRRGGBB ints. With marquee
+  /// on, a single line too long for the window scrolls back and forth at
+  /// marqueeSpeed pixels per second, resting marqueePauseMs at each end.
+  Future<bool> applyStyle(
+    Map<String, Object> style, {
+    int id = defaultId,
+  }) async {
+    if (id == defaultId && _ffi?.applyStyle(style) == true) return true;
     try {
-      final res = await _channel.invokeMethod('setLyricsFontFamily', family);
+      final res = await _channel.invokeMethod(
+        'applyOverlayStyle',
+        _withId(id, style),
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> setFontSize(num size) async {
+  Future<bool> setTextColor(int color, {int id = defaultId}) async {
     try {
-      final String s = size is double
-          ? size.round().toString()
-          : size.toInt().toString();
-      final res = await _channel.invokeMethod('setLyricsFontSize', {
-        'fontSize': s,
-      });
+      final res = await _channel.invokeMethod(
+        'setLyricsTextColor',
+        _withId(id, {'textColor': color}),
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> setFontWeight(int weight) async {
+  /// Color the karaoke sweep fills sung words with.
+  Future<bool> setHighlightColor(int color, {int id = defaultId}) async {
     try {
-      final res = await _channel.invokeMethod('setLyricsFontWeight', {
-        'weight': weight.toString(),
-      });
+      final res = await _channel.invokeMethod(
+        'setLyricsHighlightColor',
+        _withId(id, {'color': color}),
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> setOpacity(int alpha) async {
+  Future<bool> setBold(bool bold, {int id = defaultId}) async {
     try {
-      final res = await _channel.invokeMethod('setOverlayOpacity', {
-        'alpha': alpha.toString(),
-      });
+      final res = await _channel.invokeMethod(
+        'setLyricsBold',
+        _withId(id, {'bold': bold}),
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> setTextOpacity(int alpha) async {
+  Future<bool> setFontFamily(String family, {int id = defaultId}) async {
     try {
-      final res = await _channel.invokeMethod('setLyricsTextOpacity', {
-        'alpha': alpha.toString(),
-      });
+      final res = await _channel.invokeMethod(
+        'setLyricsFontFamily',
+        id == defaultId ? family : {'family': family, 'id': id},
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> setWidth(int width) async {
+  Future<bool> setFontSize(num size, {int id = defaultId}) async {
     try {
-      final res = await _channel.invokeMethod('setOverlayWidth', {
-        'width': width.toString(),
-      });
+      final res = await _channel.invokeMethod(
+        'setLyricsFontSize',
+        _withId(id, {'fontSize': size.round()}),
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> setLines(int lines) async {
+  Future<bool> setFontWeight(int weight, {int id = defaultId}) async {
     try {
-      final res = await _channel.invokeMethod('setOverlayLines', {
-        'lines': lines.toString(),
-      });
+      final res = await _channel.invokeMethod(
+        'setLyricsFontWeight',
+        _withId(id, {'weight': weight}),
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> setStroke({required int width, required int color}) async {
+  Future<bool> setOpacity(int alpha, {int id = defaultId}) async {
     try {
-      final res = await _channel.invokeMethod('setLyricsStroke', {
-        'width': width.toString(),
-        'color': '0x${color.toRadixString(16)}',
-      });
+      final res = await _channel.invokeMethod(
+        'setOverlayOpacity',
+        _withId(id, {'alpha': alpha}),
+      );
+      return res == true;
+    } catch (_) {
+      return false;
+    }
+  }
+
+  Future<bool> setTextOpacity(int alpha, {int id = defaultId}) async {
+    try {
+      final res = await _channel.invokeMethod(
+        'setLyricsTextOpacity',
+        _withId(id, {'alpha': alpha}),
+      );
+      return res == true;
+    } catch (_) {
+      return false;
+    }
+  }
+
+  Future<bool> setWidth(int width, {int id = defaultId}) async {
+    try {
+      final res = await _channel.invokeMethod(
+        'setOverlayWidth',
+        _withId(id, {'width': width}),
+      );
+      return res == true;
+    } catch (_) {
+      return false;
+    }
+  }
+
+  Future<bool> setLines(int lines, {int id = defaultId}) async {
+    try {
+      final res = await _channel.invokeMethod(
+        'setOverlayLines',
+        _withId(id, {'lines': lines}),
+      );
       return res == true;
     } catch (_) {
       return false;
     }
   }
 
-  Future<bool> setTextAlign(String align) async {
+  Future<bool> setStroke({
+    required int width,
+    required int color,
+    int id = defaultId,
+  }) async {
+    try {
+      final res = await _channel.invokeMethod(
+        'setLyricsStroke',
+        _withId(id, {
+          'width': width,
+          'color': color,
+        }),
+      );
+      return res == true;
+    } catch (_) {
+      return false;
+    }
+  }
+
+  Future<bool> setTextAlign(String align, {int id = defaultId}) async {
     try {
       final v = align.toLowerCase();
-      final res = await _channel.invokeMethod('setLyricsTextAlign', {
-        'align': v,
+      final res = await _channel.invokeMethod(
+        'setLyricsTextAlign',
+        _withId(id, {'align': v}),
+      );
+      return res == true;
+    } catch (_) {
+      return false;
+    }
+  }
+
+  /// How a new line replaces the shown one: `none`, `crossfade`, `slideUp`
+  /// or `scale`, animated over [durationMs] (0 switches at once).
+  Future<bool> setTransition(
+    String kind, {
+    int durationMs = 200,
+    int id = defaultId,
+  }) async {
+    try {
+      final res = await _channel.invokeMethod(
+        'setLyricsTransition',
+        _withId(id, {
+          'kind': kind,
+          'durationMs': durationMs,
+        }),
+      );
+      return res == true;
+    } catch (_) {
+      return false;
+    }
+  }
+
+  /// Scrolls a single line too long for the window back and forth instead
+  /// of cutting it, at [speed] pixels per second with [pauseMs] of rest at
+  /// each end.
+  Future<bool> setMarquee(
+    bool enabled, {
+    int speed = 40,
+    int pauseMs = 1500,
+    int id = defaultId,
+  }) async {
+    try {
+      final res = await _channel.invokeMethod(
+        'setLyricsMarquee',
+        _withId(id, {
+          'enabled': enabled,
+          'speed': speed,
+          'pauseMs': pauseMs,
+        }),
+      );
+      return res == true;
+    } catch (_) {
+      return false;
+    }
+  }
+
+  /// The overlays the runner holds, whether or not their windows are
+  /// created. Empty when the platform does not report them.
+  Future<List<({int id, bool created})>> listWindows() async {
+    try {
+      final res = await _channel.invokeMethod('listLyricsWindows');
+      if (res is List) {
+        return [
+          for (final w in res.whereType<Map>())
+            (id: (w['id'] as num).toInt(), created: w['created'] == true),
+        ];
+      }
+    } catch (_) {}
+    return const [];
+  }
+
+  /// Native line cache counters (hits, misses, evictions, entries, bytes,
+  /// budgetBytes). Empty when the platform does not report them.
+  Future<Map<String, int>> getCacheStats() async {
+    try {
+      final res = await _channel.invokeMethod('getOverlayCacheStats');
+      if (res is Map) {
+        return res.map((k, v) => MapEntry(k.toString(), (v as num).toInt()));
+      }
+    } catch (_) {}
+    return const {};
+  }
+
+  /// Native per-stage latency summaries, keyed by stage (font, layout,
+  /// rasterize, stroke, composite, render, blend, scroll, present, update),
+  /// each with count, meanUs, p50Us, p95Us, p99Us and maxUs. [reset] clears
+  /// the histograms after reading them. Empty when the platform does not
+  /// report them.
+  Future<Map<String, Map<String, num>>> getStats({bool reset = false}) async {
+    try {
+      final res = await _channel.invokeMethod('getOverlayStats', {
+        'reset': reset,
+      });
+      if (res is Map) {
+        return res.map(
+          (stage, values) => MapEntry(
+            stage.toString(),
+            (values as Map).map((k, v) => MapEntry(k.toString(), v as num)),
+          ),
+        );
+      }
+    } catch (_) {}
+    return const {};
+  }
+
+  Future<bool> setCacheBudget(int bytes) async {
+    try {
+      final res = await _channel.invokeMethod('setOverlayCacheBudget', {
+        'bytes': bytes,
       });
       return res == true;
     } catch (_) {
@@ -39,6 +39,10 @@ class PlayerService extends GetxService {
   Timer? _lyricTimer;
 
   final RxList<LyricPoint> lyrics = <LyricPoint>[].obs;
+
+  /// LRC text [lyrics] was parsed from, set before [lyrics] changes; the
+  /// desktop overlay parses it natively, word timings included.
+  String lyricsLrc = '';
   int _lastLyricIndex = -1;
 
   final Rx<PlayerState> state = Rx<PlayerState>(PlayerState.ready);
@@ -124,8 +128,9 @@ class PlayerService extends GetxService {
 
   Future<void> seek(Duration d) => _player.seek(d);
 
-  void setLyrics(List<LyricPoint> list) {
+  void setLyrics(List<LyricPoint> list, {String lrc = ''}) {
     list.sort((a, b) => a.ms.compareTo(b.ms));
+    lyricsLrc = lrc;
     lyrics.assignAll(list);
     _lastLyricIndex = -1;
     currentLyricIndex.value = -1;
@@ -133,6 +138,7 @@ class PlayerService extends GetxService {
   }
 
   void clearLyrics() {
+    lyricsLrc = '';
     lyrics.clear();
     _lastLyricIndex = -1;
     currentLyricLine.value = '';
@@ -306,6 +312,7 @@ class PlayerService extends GetxService {
       final parsed = _parseLyric(raw);
       setLyrics(
         parsed.map((e) => LyricPoint(e.time.inMilliseconds, e.text)).toList(),
+        lrc: raw,
       );
     } catch (_) {
       clearLyrics();
@@ -329,11 +336,16 @@ class PlayerService extends GetxService {
     final List<_TimedLine> out = [];
     final lines = raw.split(RegExp(r'\r?\n'));
     final timeTag = RegExp(r'\[(\d{1,2}):(\d{1,2})(?:\.(\d{1,3}))?\]');
+    // Enhanced LRC word timings, e.g. <00:12.34>; not shown as text.
+    final wordTag = RegExp(r'<\d+:\d{1,2}(?:[.:]\d+)?>');
     for (final line in lines) {
       if (line.trim().isEmpty) continue;
       final matches = timeTag.allMatches(line);
       if (matches.isEmpty) continue;
-      String text = line.replaceAll(timeTag, '').trim();
+      String text = line
+          .replaceAll(timeTag, '')
+          .replaceAll(wordTag, '')
+          .trim();
       if (text.isEmpty) text = ' ';
       for (final m in matches) {
         final mm = int.tryParse(m.group(1) ?? '0') ?? 0;
@@ -171,36 +171,10 @@ class SettingsController extends GetxController {
     // If overlay is enabled, ensure native window exists and apply style
     if (overlayEnabled.value) {
       try {
+        // Style first, so the window is created and drawn once with it.
+        await LyricsOverlayService.instance.applyStyle(_overlayStyle());
         await LyricsOverlayService.instance.create();
         await LyricsOverlayService.instance.show();
-        // Apply persisted settings via dedicated native methods.
-        try {
-          await LyricsOverlayService.instance.setFontSize(
-            overlayFontSize.value,
-          );
-          // 背景不透明度锁定，不在 UI 调整；可保留默认或用历史值，仅一次性设置
-          await LyricsOverlayService.instance.setFontFamily(
-            overlayFontFamily.value,
-          );
-          await LyricsOverlayService.instance.setFontWeight(
-            overlayFontWeight.value,
-          );
-          await LyricsOverlayService.instance.setTextColor(
-            overlayTextColor.value,
-          );
-          await LyricsOverlayService.instance.setTextOpacity(
-            overlayTextOpacity.value,
-          );
-          await LyricsOverlayService.instance.setWidth(overlayWidth.value);
-          await LyricsOverlayService.instance.setLines(overlayLines.value);
-          await LyricsOverlayService.instance.setStroke(
-            width: overlayStrokeWidth.value,
-            color: overlayStrokeColor.value,
-          );
-          await LyricsOverlayService.instance.setTextAlign(
-            overlayTextAlign.value,
-          );
-        } catch (_) {}
         await LyricsOverlayService.instance.lock(overlayClickThrough.value);
       } catch (_) {}
     }
@@ -223,6 +197,20 @@ class SettingsController extends GetxController {
     updateImageCacheUsage();
   }
 
+  /// The persisted overlay style, for LyricsOverlayService.applyStyle.
+  Map<String, Object> _overlayStyle() => {
+    'fontFamily': overlayFontFamily.value,
+    'fontSize': overlayFontSize.value,
+    'fontWeight': overlayFontWeight.value,
+    'textColor': overlayTextColor.value,
+    'textOpacity': overlayTextOpacity.value,
+    'width': overlayWidth.value,
+    'lines': overlayLines.value,
+    'strokeWidth': overlayStrokeWidth.value,
+    'strokeColor': overlayStrokeColor.value,
+    'textAlign': overlayTextAlign.value.toLowerCase(),
+  };
+
   // Overlay settings API
   Future<void> setOverlayEnabled(bool enable) async {
     overlayEnabled.value = enable;
@@ -230,35 +218,9 @@ class SettingsController extends GetxController {
     await prefs.setBool('overlayEnabled', enable);
     try {
       if (enable) {
+        await LyricsOverlayService.instance.applyStyle(_overlayStyle());
         await LyricsOverlayService.instance.create();
         await LyricsOverlayService.instance.show();
-        // Reapply individual settings
-        try {
-          await LyricsOverlayService.instance.setFontSize(
-            overlayFontSize.value,
-          );
-          await LyricsOverlayService.instance.setFontFamily(
-            overlayFontFamily.value,
-          );
-          await LyricsOverlayService.instance.setFontWeight(
-            overlayFontWeight.value,
-          );
-          await LyricsOverlayService.instance.setTextColor(
-            overlayTextColor.value,
-          );
-          await LyricsOverlayService.instance.setTextOpacity(
-            overlayTextOpacity.value,
-          );
-          await LyricsOverlayService.instance.setWidth(overlayWidth.value);
-          await LyricsOverlayService.instance.setLines(overlayLines.value);
-          await LyricsOverlayService.instance.setStroke(
-            width: overlayStrokeWidth.value,
-            color: overlayStrokeColor.value,
-          );
-          await LyricsOverlayService.instance.setTextAlign(
-            overlayTextAlign.value,
-          );
-        } catch (_) {}
         await LyricsOverlayService.instance.lock(overlayClickThrough.value);
       } else {
         await LyricsOverlayService.instance.hide();
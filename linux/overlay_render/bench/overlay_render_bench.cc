@@ -0,0 +1,662 @@
+// overlay_render_bench.cc
+//
+// Times the whole text pipeline with the FreeType backend, rendering into
+// an offscreen frame, across a sweep of overlay widths, line counts,
+// stroke widths, text opacities and scripts. Each case reports the mean
+// time of every stage (rasterize, stroke, composite) from the OverlayStats
+// histograms, the end-to-end render time per frame, and its text's layout
+// from scratch ("layout"), which frames of the same text skip. A second
+// section times layout alone on a long mixed-script line: for new text
+// ("cold"), after a width change ("rewrap") and for an unchanged call
+// ("same").
+//
+//   tono_overlay_render_bench [options] [font file]
+//     --json=<path>      also write the results as JSON ("-" for stdout)
+//     --baseline=<path>  compare with an earlier --json file; exits with 1
+//                        when a stage got slower by more than --threshold
+//     --threshold=<pct>  allowed slowdown before a regression (default 10)
+//     --full             every combination instead of one parameter at a
+//                        time around the base case
+//     --filter=<text>    only cases whose name contains <text>
+//     --min-ms=<ms>      time per case (default 200)
+//     --cjk-font=<path>  font for the CJK cases (default: fontconfig's
+//                        "Noto Sans CJK SC")
+//
+// Typical use: record a baseline on the release branch with --json, then
+// run with --baseline on the candidate on the same machine.
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "overlay_core/line_cache.h"
+#include "overlay_core/offscreen_target.h"
+#include "overlay_core/overlay_stats.h"
+#include "overlay_render/font_lookup.h"
+#include "overlay_render/freetype_rasterizer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using tono_overlay::OverlayStats;
+using tono_overlay::TimingStage;
+
+// Runs |fn| until at least |min_ms| elapsed and returns microseconds per run.
+template <typename Fn>
+double TimeUs(Fn&& fn, double min_ms = 200.0) {
+  fn();  // warm up caches and scratch buffers
+  int runs = 0;
+  const auto start = Clock::now();
+  double elapsed_ms = 0.0;
+  do {
+    fn();
+    ++runs;
+    elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() -
+                                                           start).count();
+  } while (elapsed_ms < min_ms);
+  return elapsed_ms * 1000.0 / runs;
+}
+
+// Stages reported per case, in output order; "render" is the end-to-end
+// time per frame measured by the loop itself, and "layout" a cold layout
+// of the case's text timed on its own.
+const TimingStage kStages[] = {TimingStage::kRasterize, TimingStage::kStroke,
+                               TimingStage::kComposite};
+constexpr const char* kRenderKey = "render";
+constexpr const char* kLayoutKey = "layout";
+
+constexpr int kFontSize = 28;
+constexpr int kPadding = 8;
+
+const char kLatinText[] =
+    "Somewhere over the rainbow way up high, there's a land that I heard "
+    "of once in a lullaby. ";
+// 40 ideographs and kana, with the punctuation lyrics files use.
+const char kCjkText[] =
+    "\xe5\xa4\x9c\xe7\xa9\xba\xe3\x81\xae\xe5\x90\x91\xe3\x81\x93\xe3\x81"
+    "\x86\xe3\x81\xab\xe3\x80\x81\xe6\x9c\x88\xe6\x98\x8e\xe3\x81\x8b\xe3"
+    "\x82\x8a\xe3\x81\x8c\xe9\x9d\x99\xe3\x81\x8b\xe3\x81\xab\xe6\xb5\x81"
+    "\xe3\x82\x8c\xe3\x82\x8b\xe3\x80\x82\xe6\x88\x91\xe4\xbb\xac\xe5\x9c"
+    "\xa8\xe9\xa3\x8e\xe4\xb8\xad\xe5\x94\xb1\xe7\x9d\x80\xe9\x82\xa3\xe9"
+    "\xa6\x96\xe6\x97\xa7\xe6\xad\x8c\xef\xbc\x8c\xe7\x9b\xb4\xe5\x88\xb0"
+    "\xe5\xa4\xa9\xe4\xba\xae\xe3\x80\x82";
+
+enum class Script { kLatin, kCjk, kMixed };
+
+const char* ScriptName(Script script) {
+  switch (script) {
+    case Script::kLatin:
+      return "latin";
+    case Script::kCjk:
+      return "cjk";
+    default:
+      return "mixed";
+  }
+}
+
+struct Case {
+  std::string name;
+  int width = 1280;
+  int lines = 1;
+  int stroke_width = 3;
+  int text_opacity = 255;
+  Script script = Script::kLatin;
+};
+
+struct Result {
+  Case params;
+  int height = 0;
+  int runs = 0;
+  std::map<std::string, double> us;  // stage name -> mean microseconds
+  uint64_t digest = 0;
+};
+
+// Sweep values; the first of each is the base case.
+const int kWidths[] = {1280, 600, 1920, 2560, 3840};
+const int kLineCounts[] = {1, 2, 3, 4};
+const int kStrokeWidths[] = {3, 0, 1, 8, 20};
+const int kOpacities[] = {255, 128};
+const Script kScripts[] = {Script::kLatin, Script::kCjk};
+
+std::string CaseName(const Case& c) {
+  char name[96];
+  std::snprintf(name, sizeof(name), "w%d-l%d-s%d-o%d-%s", c.width, c.lines,
+                c.stroke_width, c.text_opacity, ScriptName(c.script));
+  return name;
+}
+
+std::vector<Case> SweepCases(bool full) {
+  std::vector<Case> cases;
+  auto add = [&cases](Case c) {
+    c.name = CaseName(c);
+    for (const Case& existing : cases) {
+      if (existing.name == c.name) return;
+    }
+    cases.push_back(c);
+  };
+  if (full) {
+    for (int width : kWidths) {
+      for (int lines : kLineCounts) {
+        for (int stroke : kStrokeWidths) {
+          for (int opacity : kOpacities) {
+            for (Script script : kScripts) {
+              add({"", width, lines, stroke, opacity, script});
+            }
+          }
+        }
+      }
+    }
+    return cases;
+  }
+  const Case base;
+  add(base);
+  for (int width : kWidths) {
+    Case c = base;
+    c.width = width;
+    add(c);
+  }
+  for (int lines : kLineCounts) {
+    Case c = base;
+    c.lines = lines;
+    add(c);
+  }
+  for (int stroke : kStrokeWidths) {
+    Case c = base;
+    c.stroke_width = stroke;
+    add(c);
+  }
+  for (int opacity : kOpacities) {
+    Case c = base;
+    c.text_opacity = opacity;
+    add(c);
+  }
+  for (Script script : kScripts) {
+    Case c = base;
+    c.script = script;
+    add(c);
+    // CJK at the widest size too: the most glyphs per frame.
+    c.width = kWidths[4];
+    c.lines = 2;
+    add(c);
+  }
+  return cases;
+}
+
+// Enough text to fill every line of the case, so wider and taller
+// overlays really draw more glyphs.
+std::string TextFor(const Case& c) {
+  const bool latin = c.script == Script::kLatin;
+  const std::string unit = latin ? kLatinText : kCjkText;
+  // Rough advances: half an em for Latin, a full em for CJK.
+  const int glyph_px = latin ? kFontSize * 2 / 3 : kFontSize * 4 / 3;
+  const size_t glyphs = (size_t)c.width * c.lines / glyph_px + 1;
+  const size_t unit_glyphs = latin ? unit.size() : 40;
+  std::string text;
+  for (size_t n = 0; n < glyphs; n += unit_glyphs) text += unit;
+  return text;
+}
+
+// A long line mixing Latin with combining accents, CJK with kinsoku
+// punctuation, Hangul, emoji with skin tones and a flag: every class of
+// break rule, at about 1500 code points.
+std::string MixedText() {
+  const std::string unit =
+      std::string(kLatinText) +
+      "Cafe\xcc\x81 nai\xcc\x88ve (\xe2\x80\x9cquoted\xe2\x80\x9d) "
+      "\xf0\x9f\x91\x8d\xf0\x9f\x8f\xbd \xf0\x9f\x87\xaf"
+      "\xf0\x9f\x87\xb5 " +
+      kCjkText +
+      "\xec\x95\x88\xeb\x85\x95\xed\x95\x98\xec\x84\xb8\xec\x9a"
+      "\x94 \xe3\x80\x8c\xe6\xad\x8c\xe3\x80\x8d 12.5% ";
+  std::string text;
+  while (text.size() < 4000) text += unit;
+  return text;
+}
+
+// Times |rasterizer|'s layout of a long mixed-script line in a few
+// incremental situations and appends one result per situation.
+void RunLayoutCases(tono_overlay::FreeTypeRasterizer* rasterizer,
+                    const std::string& filter, double min_ms, FILE* table,
+                    std::vector<Result>* results) {
+  const std::string text = MixedText();
+  // A second text of the same length, so "cold" reshapes every call.
+  std::string other = text;
+  other.back() = '.';
+  tono_overlay::OverlayStyle style;
+  style.font_size = kFontSize;
+  style.lines = 4;
+  const int width = kWidths[0];
+
+  // "cold" alternates two texts, "rewrap" two widths.
+  const char* const kSituations[] = {"cold", "rewrap", "same"};
+
+  std::fprintf(table, "\n== layout: TextLayout on a %zu-byte mixed line ==\n",
+               text.size());
+  std::fprintf(table, "%-28s %10s %10s\n", "case", "glyphs", "layout us");
+  for (const char* situation : kSituations) {
+    Result result;
+    result.params.name = std::string("layout-") + situation;
+    if (!filter.empty() &&
+        result.params.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    result.params.width = width;
+    result.params.lines = style.lines;
+    result.params.stroke_width = 0;
+    result.params.script = Script::kMixed;
+    const bool cold = std::strcmp(situation, "cold") == 0;
+    const bool rewrap = std::strcmp(situation, "rewrap") == 0;
+    uint64_t calls = 0;
+    result.us["layout"] = TimeUs(
+        [&] {
+          const bool odd = calls++ % 2 != 0;
+          rasterizer->Layout(cold && odd ? other : text, style,
+                             rewrap && odd ? width - 1 : width);
+        },
+        min_ms);
+    result.runs = (int)calls;
+    // Lay the reference text out once more so the digest is comparable.
+    rasterizer->Layout(text, style, width);
+    const tono_overlay::TextLayout& layout = rasterizer->layout();
+    tono_overlay::HashBuilder digest;
+    for (const tono_overlay::LayoutLine& line : layout.lines()) {
+      digest.Add((int64_t)line.begin).Add((int64_t)line.end);
+    }
+    for (const tono_overlay::LayoutGlyph& glyph : layout.glyphs()) {
+      digest.Add((int64_t)glyph.glyph).Add((int64_t)glyph.x);
+    }
+    result.digest = digest.hash();
+    std::fprintf(table, "%-28s %10zu %10.2f\n", result.params.name.c_str(),
+                 layout.glyphs().size(), result.us["layout"]);
+    results->push_back(std::move(result));
+  }
+}
+
+// --- Minimal JSON reader, enough for files this tool writes. ---
+
+struct JsonValue {
+  enum Type { kNull, kBool, kNumber, kString, kArray, kObject } type = kNull;
+  double number = 0;
+  std::string string;
+  std::vector<JsonValue> array;
+  std::vector<std::pair<std::string, JsonValue>> object;
+
+  const JsonValue* Find(const std::string& key) const {
+    for (const auto& entry : object) {
+      if (entry.first == key) return &entry.second;
+    }
+    return nullptr;
+  }
+};
+
+class JsonReader {
+ public:
+  explicit JsonReader(const std::string& text) : text_(text) {}
+
+  bool Parse(JsonValue* value) {
+    if (!ParseValue(value, 0)) return false;
+    SkipSpace();
+    return pos_ == text_.size();
+  }
+
+ private:
+  static constexpr int kMaxDepth = 32;
+
+  void SkipSpace() {
+    while (pos_ < text_.size() &&
+           std::strchr(" \t\r\n", text_[pos_]) != nullptr) {
+      ++pos_;
+    }
+  }
+
+  bool Consume(const char* literal) {
+    const size_t n = std::strlen(literal);
+    if (text_.compare(pos_, n, literal) != 0) return false;
+    pos_ += n;
+    return true;
+  }
+
+  bool ParseString(std::string* out) {
+    if (pos_ >= text_.size() || text_[pos_] != '"') return false;
+    ++pos_;
+    while (pos_ < text_.size() && text_[pos_] != '"') {
+      char c = text_[pos_++];
+      if (c == '\\') {
+        if (pos_ >= text_.size()) return false;
+        c = text_[pos_++];
+        // The names and digests this tool writes are plain ASCII; other
+        // escapes are kept as the escaped letter.
+        if (c == 'n') c = '\n';
+        if (c == 't') c = '\t';
+        if (c == 'u') {
+          if (pos_ + 4 > text_.size()) return false;
+          c = (char)std::strtol(text_.substr(pos_, 4).c_str(), nullptr, 16);
+          pos_ += 4;
+        }
+      }
+      out->push_back(c);
+    }
+    if (pos_ >= text_.size()) return false;
+    ++pos_;
+    return true;
+  }
+
+  bool ParseValue(JsonValue* value, int depth) {
+    if (depth > kMaxDepth) return false;
+    SkipSpace();
+    if (pos_ >= text_.size()) return false;
+    const char c = text_[pos_];
+    if (c == '{') {
+      ++pos_;
+      value->type = JsonValue::kObject;
+      SkipSpace();
+      if (pos_ < text_.size() && text_[pos_] == '}') {
+        ++pos_;
+        return true;
+      }
+      for (;;) {
+        SkipSpace();
+        std::pair<std::string, JsonValue> entry;
+        if (!ParseString(&entry.first)) return false;
+        SkipSpace();
+        if (!Consume(":")) return false;
+        if (!ParseValue(&entry.second, depth + 1)) return false;
+        value->object.push_back(std::move(entry));
+        SkipSpace();
+        if (Consume("}")) return true;
+        if (!Consume(",")) return false;
+      }
+    }
+    if (c == '[') {
+      ++pos_;
+      value->type = JsonValue::kArray;
+      SkipSpace();
+      if (pos_ < text_.size() && text_[pos_] == ']') {
+        ++pos_;
+        return true;
+      }
+      for (;;) {
+        JsonValue item;
+        if (!ParseValue(&item, depth + 1)) return false;
+        value->array.push_back(std::move(item));
+        SkipSpace();
+        if (Consume("]")) return true;
+        if (!Consume(",")) return false;
+      }
+    }
+    if (c == '"') {
+      value->type = JsonValue::kString;
+      return ParseString(&value->string);
+    }
+    if (Consume("true") || Consume("false")) {
+      value->type = JsonValue::kBool;
+      value->number = text_[pos_ - 2] == 'u';
+      return true;
+    }
+    if (Consume("null")) return true;
+    const char* begin = text_.c_str() + pos_;
+    char* end = nullptr;
+    value->type = JsonValue::kNumber;
+    value->number = std::strtod(begin, &end);
+    if (end == begin) return false;
+    pos_ += (size_t)(end - begin);
+    return true;
+  }
+
+  const std::string text_;
+  size_t pos_ = 0;
+};
+
+// --- Output ---
+
+std::string JsonEscape(const std::string& text) {
+  std::string out;
+  for (char c : text) {
+    if (c == '"' || c == '\\') out.push_back('\\');
+    out.push_back(c);
+  }
+  return out;
+}
+
+void WriteJson(std::ostream& out, const std::string& font,
+               const std::string& cjk_font, double min_ms,
+               const std::vector<Result>& results) {
+  out << "{\n  \"benchmark\": \"tono_overlay_render_bench\",\n"
+      << "  \"version\": 1,\n"
+      << "  \"font\": \"" << JsonEscape(font) << "\",\n"
+      << "  \"cjk_font\": \"" << JsonEscape(cjk_font) << "\",\n"
+      << "  \"font_size\": " << kFontSize << ",\n"
+      << "  \"min_ms\": " << min_ms << ",\n"
+      << "  \"cases\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    char digest[17];
+    std::snprintf(digest, sizeof(digest), "%016" PRIx64, r.digest);
+    out << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.params.name
+        << "\", \"width\": " << r.params.width << ", \"height\": " << r.height
+        << ", \"lines\": " << r.params.lines
+        << ", \"stroke_width\": " << r.params.stroke_width
+        << ", \"text_opacity\": " << r.params.text_opacity
+        << ", \"script\": \"" << ScriptName(r.params.script)
+        << "\", \"runs\": " << r.runs << ", \"digest\": \"" << digest
+        << "\",\n     \"us\": {";
+    bool first = true;
+    for (const auto& stage : r.us) {
+      char value[32];
+      std::snprintf(value, sizeof(value), "%.3f", stage.second);
+      out << (first ? "" : ", ") << '"' << stage.first << "\": " << value;
+      first = false;
+    }
+    out << "}}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+// Prints every stage of every case present in both runs and returns the
+// number that got slower than |threshold_pct| allows. Stages under
+// |floor_us| in the baseline are shown but never fail: they are mostly
+// timer noise.
+int CompareWithBaseline(const JsonValue& baseline,
+                        const std::vector<Result>& results,
+                        double threshold_pct, FILE* out) {
+  constexpr double kFloorUs = 2.0;
+  const JsonValue* cases = baseline.Find("cases");
+  if (!cases || cases->type != JsonValue::kArray) {
+    std::fprintf(stderr, "baseline has no \"cases\" array\n");
+    return -1;
+  }
+  std::map<std::string, const JsonValue*> by_name;
+  for (const JsonValue& c : cases->array) {
+    const JsonValue* name = c.Find("name");
+    if (name && name->type == JsonValue::kString) by_name[name->string] = &c;
+  }
+  std::fprintf(out, "\n== comparison with baseline (threshold %.1f%%) ==\n",
+               threshold_pct);
+  std::fprintf(out, "%-28s %-10s %11s %11s %8s\n", "case", "stage",
+               "base us", "now us", "change");
+  int regressions = 0;
+  int compared = 0;
+  for (const Result& r : results) {
+    auto it = by_name.find(r.params.name);
+    if (it == by_name.end()) continue;
+    const JsonValue* us = it->second->Find("us");
+    if (!us || us->type != JsonValue::kObject) continue;
+    for (const auto& stage : r.us) {
+      const JsonValue* base = us->Find(stage.first);
+      if (!base || base->type != JsonValue::kNumber) continue;
+      ++compared;
+      const double change =
+          base->number > 0 ? (stage.second / base->number - 1.0) * 100.0 : 0;
+      const bool regressed =
+          base->number >= kFloorUs && change > threshold_pct;
+      if (regressed) ++regressions;
+      std::fprintf(out, "%-28s %-10s %11.1f %11.1f %+7.1f%%%s\n",
+                   r.params.name.c_str(), stage.first.c_str(), base->number,
+                   stage.second, change, regressed ? "  REGRESSION" : "");
+    }
+  }
+  std::fprintf(out, "%d stage(s) compared, %d regression(s)\n", compared,
+               regressions);
+  return regressions;
+}
+
+bool StartsWith(const char* arg, const char* prefix, const char** value) {
+  const size_t n = std::strlen(prefix);
+  if (std::strncmp(arg, prefix, n) != 0) return false;
+  *value = arg + n;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string font = TONO_OVERLAY_TEST_FONT;
+  std::string cjk_font;
+  std::string json_path;
+  std::string baseline_path;
+  std::string filter;
+  double threshold_pct = 10.0;
+  double min_ms = 200.0;
+  bool full = false;
+  for (int i = 1; i < argc; ++i) {
+    const char* value = nullptr;
+    if (StartsWith(argv[i], "--json=", &value)) {
+      json_path = value;
+    } else if (StartsWith(argv[i], "--baseline=", &value)) {
+      baseline_path = value;
+    } else if (StartsWith(argv[i], "--threshold=", &value)) {
+      threshold_pct = std::atof(value);
+    } else if (StartsWith(argv[i], "--filter=", &value)) {
+      filter = value;
+    } else if (StartsWith(argv[i], "--min-ms=", &value)) {
+      min_ms = std::max(1.0, std::atof(value));
+    } else if (StartsWith(argv[i], "--cjk-font=", &value)) {
+      cjk_font = value;
+    } else if (std::strcmp(argv[i], "--full") == 0) {
+      full = true;
+    } else if (argv[i][0] == '-') {
+      std::fprintf(stderr, "unknown option: %s\n", argv[i]);
+      return 2;
+    } else {
+      font = argv[i];
+    }
+  }
+
+  // Read the baseline first so a bad path fails before minutes of timing.
+  JsonValue baseline;
+  if (!baseline_path.empty()) {
+    std::ifstream in(baseline_path, std::ios::binary);
+    std::stringstream text;
+    text << in.rdbuf();
+    if (!in || !JsonReader(text.str()).Parse(&baseline)) {
+      std::fprintf(stderr, "cannot read baseline: %s\n",
+                   baseline_path.c_str());
+      return 2;
+    }
+  }
+
+  tono_overlay::FreeTypeRasterizer latin(font);
+  if (!latin.ok()) {
+    std::fprintf(stderr, "cannot load font: %s\n", latin.error().c_str());
+    return 1;
+  }
+  if (cjk_font.empty()) {
+    cjk_font = tono_overlay::FindFontFile("Noto Sans CJK SC", 400);
+  }
+  std::unique_ptr<tono_overlay::FreeTypeRasterizer> cjk;
+  if (!cjk_font.empty()) {
+    cjk = std::make_unique<tono_overlay::FreeTypeRasterizer>(cjk_font);
+  }
+  if (!cjk || !cjk->ok()) {
+    // Still timed, as missing-glyph boxes; the JSON names the font used.
+    std::fprintf(stderr, "no CJK font; CJK cases use %s\n", font.c_str());
+    cjk_font = font;
+    cjk.reset();
+  }
+  tono_overlay::OffscreenTarget latin_target(&latin);
+  tono_overlay::OffscreenTarget cjk_target(cjk ? cjk.get() : &latin);
+
+  // The table goes to stderr when stdout carries the JSON.
+  FILE* table = json_path == "-" ? stderr : stdout;
+  std::fprintf(table,
+               "== render: FreeType text layer into an offscreen frame ==\n");
+  std::fprintf(table, "%-28s %-10s %9s %9s %9s %9s %10s\n", "case", "size",
+               "layout", "raster", "stroke", "composite", "render us");
+  std::vector<Result> results;
+  for (const Case& c : SweepCases(full)) {
+    if (!filter.empty() && c.name.find(filter) == std::string::npos) continue;
+    tono_overlay::OffscreenTarget* target =
+        c.script == Script::kLatin ? &latin_target : &cjk_target;
+    tono_overlay::FreeTypeRasterizer* rasterizer =
+        c.script == Script::kLatin ? &latin : (cjk ? cjk.get() : &latin);
+
+    tono_overlay::OverlayStyle style;
+    style.font_size = kFontSize;
+    style.stroke_width = c.stroke_width;
+    style.text_opacity = c.text_opacity;
+    style.lines = c.lines;
+    style.padding = kPadding;
+    style.width = c.width;
+    Result result;
+    result.params = c;
+    result.height = rasterizer->LineHeight(style) * c.lines + 2 * kPadding;
+    const std::string text = TextFor(c);
+
+    OverlayStats& stats = OverlayStats::Global();
+    stats.Reset();
+    result.us[kRenderKey] = TimeUs(
+        [&] { target->Render(text, style, c.width, result.height); },
+        min_ms);
+    result.runs = (int)stats.Summary(TimingStage::kRasterize).count;
+    for (TimingStage stage : kStages) {
+      result.us[tono_overlay::TimingStageName(stage)] =
+          stats.Summary(stage).mean_us;
+    }
+    result.digest = target->Digest();
+    // Frames of the same text reuse the layout, so "render" hides its
+    // cost; time it cold, in the text box of the frame.
+    result.us[kLayoutKey] = TimeUs(
+        [&] {
+          rasterizer->InvalidateLayout();
+          rasterizer->Layout(text, style, c.width - 2 * kPadding);
+        },
+        min_ms);
+
+    char size[32];
+    std::snprintf(size, sizeof(size), "%dx%d", c.width, result.height);
+    std::fprintf(table, "%-28s %-10s %9.1f %9.1f %9.1f %9.1f %10.1f\n",
+                 c.name.c_str(), size, result.us[kLayoutKey],
+                 result.us["rasterize"], result.us["stroke"],
+                 result.us["composite"], result.us[kRenderKey]);
+    results.push_back(std::move(result));
+  }
+  RunLayoutCases(cjk ? cjk.get() : &latin, filter, min_ms, table, &results);
+
+  if (json_path == "-") {
+    WriteJson(std::cout, font, cjk_font, min_ms, results);
+  } else if (!json_path.empty()) {
+    std::ofstream out(json_path, std::ios::binary | std::ios::trunc);
+    WriteJson(out, font, cjk_font, min_ms, results);
+    if (!out) {
+      std::fprintf(stderr, "cannot write %s\n", json_path.c_str());
+      return 2;
+    }
+  }
+
+  if (!baseline_path.empty()) {
+    const int regressions =
+        CompareWithBaseline(baseline, results, threshold_pct, table);
+    if (regressions != 0) return 1;
+  }
+  return 0;
+}
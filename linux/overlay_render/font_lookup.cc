@@ -0,0 +1,124 @@
+// font_lookup.cc
+#include "overlay_render/font_lookup.h"
+
+#include <fontconfig/fontconfig.h>
+
+#include "overlay_core/overlay_log.h"
+
+namespace tono_overlay {
+
+std::string FindFontFile(const std::string& family, int weight) {
+  FcPattern* pattern = FcPatternCreate();
+  if (!pattern) return std::string();
+  const char* name = family.empty() ? "sans-serif" : family.c_str();
+  FcPatternAddString(pattern, FC_FAMILY,
+                     reinterpret_cast<const FcChar8*>(name));
+  FcPatternAddInteger(pattern, FC_WEIGHT, FcWeightFromOpenType(weight));
+  FcPatternAddBool(pattern, FC_SCALABLE, FcTrue);
+  // A null config is the current one, initialized on first use.
+  FcConfigSubstitute(nullptr, pattern, FcMatchPattern);
+  FcDefaultSubstitute(pattern);
+  FcResult result = FcResultNoMatch;
+  FcPattern* match = FcFontMatch(nullptr, pattern, &result);
+  std::string path;
+  FcChar8* file = nullptr;
+  if (match && FcPatternGetString(match, FC_FILE, 0, &file) == FcResultMatch) {
+    path = reinterpret_cast<const char*>(file);
+  }
+  if (match) FcPatternDestroy(match);
+  FcPatternDestroy(pattern);
+  return path;
+}
+
+FontKey FreeTypeFontKey(const OverlayStyle& style) {
+  FontKey key;
+  key.family = style.font_family;
+  key.size_pt = style.font_size;
+  key.weight =
+      style.font_bold && style.font_weight < 700 ? 700 : style.font_weight;
+  key.dpi = FreeTypeRasterizer::kDefaultDpi;
+  return key;
+}
+
+FreeTypeFont::FreeTypeFont(std::string path,
+                           std::unique_ptr<FreeTypeRasterizer> rasterizer,
+                           const FontMetrics& metrics)
+    : path_(std::move(path)), rasterizer_(std::move(rasterizer)) {
+  metrics_ = metrics;
+}
+
+std::unique_ptr<FontInstance> FreeTypeFontFactory::Open(const FontKey& key) {
+  std::string path;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = paths_.find({key.family, key.weight});
+    if (it == paths_.end()) {
+      it = paths_.emplace(std::make_pair(key.family, key.weight),
+                          FindFontFile(key.family, key.weight))
+               .first;
+    }
+    path = it->second;
+  }
+  if (path.empty()) {
+    TONO_LOG(kError, "FreeTypeFontFactory: no font for family="
+                         << key.family << " weight=" << key.weight);
+    return nullptr;
+  }
+  auto rasterizer = std::make_unique<FreeTypeRasterizer>(path, key.dpi);
+  if (!rasterizer->ok()) {
+    TONO_LOG(kError, "FreeTypeFontFactory: " << rasterizer->error());
+    return nullptr;
+  }
+  OverlayStyle style;
+  style.font_family = key.family;
+  style.font_size = key.size_pt;
+  style.font_weight = key.weight;
+  FontMetrics metrics;
+  if (!rasterizer->Metrics(style, &metrics)) {
+    TONO_LOG(kError, "FreeTypeFontFactory: cannot set " << path << " to "
+                                                        << key.size_pt
+                                                        << "pt");
+    return nullptr;
+  }
+  TONO_VLOG("FreeTypeFontFactory: family=" << key.family << " size="
+                                           << key.size_pt << " weight="
+                                           << key.weight << " file="
+                                           << path);
+  return std::make_unique<FreeTypeFont>(path, std::move(rasterizer),
+                                        metrics);
+}
+
+FontTextRenderer::FontTextRenderer(size_t font_capacity)
+    : cache_(std::make_unique<FreeTypeFontFactory>(), font_capacity) {}
+
+bool FontTextRenderer::Ensure(const OverlayStyle& style) {
+  const FontKey key = FreeTypeFontKey(style);
+  if (has_key_ && key == key_) return font_ != nullptr;
+  has_key_ = true;
+  key_ = key;
+  font_ = cache_.Get(key);
+  if (!font_) return false;
+  FreeTypeRasterizer* rasterizer = this->rasterizer();
+  if (pipeline_) {
+    pipeline_->set_rasterizer(rasterizer);
+  } else {
+    pipeline_ = std::make_unique<TextLayerPipeline>(rasterizer);
+  }
+  return true;
+}
+
+FreeTypeRasterizer* FontTextRenderer::rasterizer() const {
+  return font_ ? static_cast<FreeTypeFont*>(font_.get())->rasterizer()
+               : nullptr;
+}
+
+std::string FontTextRenderer::font_path() const {
+  return font_ ? static_cast<FreeTypeFont*>(font_.get())->path()
+               : std::string();
+}
+
+FontMetrics FontTextRenderer::metrics() const {
+  return font_ ? font_->metrics() : FontMetrics();
+}
+
+}  // namespace tono_overlay
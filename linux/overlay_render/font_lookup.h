@@ -0,0 +1,94 @@
+// font_lookup.h
+#ifndef OVERLAY_RENDER_FONT_LOOKUP_H_
+#define OVERLAY_RENDER_FONT_LOOKUP_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "overlay_core/font_cache.h"
+#include "overlay_core/overlay_state.h"
+#include "overlay_core/text_layer.h"
+#include "overlay_render/freetype_rasterizer.h"
+
+namespace tono_overlay {
+
+// Path of the scalable font file fontconfig picks for |family| at |weight|
+// (100..900, as in OverlayStyle), or "" if none is installed. Unknown
+// families fall back the way fontconfig substitutes them; an empty family
+// means sans-serif. Thread safe.
+std::string FindFontFile(const std::string& family, int weight);
+
+// FontCache key for |style| at FreeTypeRasterizer's default dpi. Bold
+// asks for at least weight 700.
+FontKey FreeTypeFontKey(const OverlayStyle& style);
+
+// A font from FreeTypeFontFactory: its own FreeTypeRasterizer, already set
+// to the key's size. Like the rasterizer, it belongs to one thread.
+class FreeTypeFont : public FontInstance {
+ public:
+  FreeTypeFont(std::string path,
+               std::unique_ptr<FreeTypeRasterizer> rasterizer,
+               const FontMetrics& metrics);
+
+  FreeTypeRasterizer* rasterizer() const { return rasterizer_.get(); }
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string path_;
+  std::unique_ptr<FreeTypeRasterizer> rasterizer_;
+};
+
+// Opens FreeTypeFonts for the file fontconfig picks, remembering the file
+// of each family and weight.
+class FreeTypeFontFactory : public FontFactory {
+ public:
+  std::unique_ptr<FontInstance> Open(const FontKey& key) override;
+
+ private:
+  std::mutex mutex_;  // guards paths_
+  std::map<std::pair<std::string, int>, std::string> paths_;
+};
+
+// A FreeType text pipeline for the font of the styles it is given. Fonts
+// come from a FontCache keyed by family, size, weight and dpi, so
+// switching between a few styles opens each font once; the pipeline and
+// its stroke scratch are kept across switches. Like the rasterizer, one
+// instance belongs to one thread.
+class FontTextRenderer {
+ public:
+  explicit FontTextRenderer(
+      size_t font_capacity = FontCache::kDefaultCapacity);
+
+  FontTextRenderer(const FontTextRenderer&) = delete;
+  FontTextRenderer& operator=(const FontTextRenderer&) = delete;
+
+  // Switches to the font for |style|. Returns false if no font could be
+  // loaded; a failed key is not retried while it stays cached.
+  bool Ensure(const OverlayStyle& style);
+
+  // Null until Ensure() succeeded.
+  FreeTypeRasterizer* rasterizer() const;
+  TextLayerPipeline* pipeline() const {
+    return font_ ? pipeline_.get() : nullptr;
+  }
+  // Empty until Ensure() succeeded.
+  std::string font_path() const;
+  // Metrics of the current font; zeros until Ensure() succeeded.
+  FontMetrics metrics() const;
+
+  FontCacheStats cache_stats() const { return cache_.stats(); }
+
+ private:
+  FontCache cache_;
+  bool has_key_ = false;
+  FontKey key_;
+  std::shared_ptr<FontInstance> font_;
+  std::unique_ptr<TextLayerPipeline> pipeline_;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_RENDER_FONT_LOOKUP_H_
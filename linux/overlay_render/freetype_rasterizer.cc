@@ -0,0 +1,209 @@
+// freetype_rasterizer.cc
+#include "overlay_render/freetype_rasterizer.h"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_SYNTHESIS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "overlay_core/line_cache.h"
+#include "overlay_core/marquee.h"
+#include "overlay_core/overlay_stats.h"
+
+namespace tono_overlay {
+
+namespace {
+
+// 26.6 fixed point to the nearest whole pixel.
+int RoundPx(int32_t v) { return (int)std::floor((v + 32) / 64.0); }
+
+}  // namespace
+
+FreeTypeRasterizer::FreeTypeRasterizer(const std::string& font_path, int dpi)
+    : dpi_(dpi > 0 ? dpi : kDefaultDpi) {
+  FT_Library library = nullptr;
+  FT_Error err = FT_Init_FreeType(&library);
+  if (err) {
+    error_ = "FT_Init_FreeType failed (error " + std::to_string(err) + ")";
+    return;
+  }
+  library_ = library;
+  FT_Face face = nullptr;
+  err = FT_New_Face(library, font_path.c_str(), 0, &face);
+  if (err) {
+    error_ = "FT_New_Face failed (error " + std::to_string(err) + ") for " +
+             font_path;
+    return;
+  }
+  if (!FT_IS_SCALABLE(face)) {
+    FT_Done_Face(face);
+    error_ = font_path + " is not a scalable font";
+    return;
+  }
+  face_ = face;
+  face_key_ = HashBuilder().Add(font_path).Add((int64_t)dpi_).hash();
+}
+
+FreeTypeRasterizer::~FreeTypeRasterizer() {
+  if (face_) FT_Done_Face(face_);
+  if (library_) FT_Done_FreeType(library_);
+}
+
+std::unique_ptr<SurfaceAllocator>
+FreeTypeRasterizer::CreateSurfaceAllocator() {
+  return std::make_unique<MemorySurfaceAllocator>();
+}
+
+bool FreeTypeRasterizer::SetStyle(const OverlayStyle& style) {
+  const int size_pt = std::max(style.font_size, 1);
+  const bool embolden =
+      (style.font_bold || style.font_weight >= 600) &&
+      !(face_->style_flags & FT_STYLE_FLAG_BOLD);
+  if (size_pt == size_pt_ && embolden == embolden_) return true;
+  ScopedStageTimer timer(TimingStage::kFont);
+  if (FT_Set_Char_Size(face_, 0, (FT_F26Dot6)size_pt * 64, (FT_UInt)dpi_,
+                       (FT_UInt)dpi_)) {
+    size_pt_ = -1;
+    return false;
+  }
+  size_pt_ = size_pt;
+  embolden_ = embolden;
+  load_flags_ = FT_LOAD_DEFAULT | FT_LOAD_NO_BITMAP | FT_LOAD_TARGET_LIGHT;
+  font_key_ = HashBuilder()
+                  .Add((int64_t)face_key_)
+                  .Add((int64_t)size_pt)
+                  .Add((int64_t)embolden)
+                  .hash();
+  return true;
+}
+
+uint32_t FreeTypeRasterizer::GlyphIndex(uint32_t codepoint) {
+  return FT_Get_Char_Index(face_, codepoint);
+}
+
+int32_t FreeTypeRasterizer::GlyphAdvance(uint32_t glyph) {
+  if (FT_Load_Glyph(face_, glyph, load_flags_)) return 0;
+  if (embolden_) FT_GlyphSlot_Embolden(face_->glyph);
+  return (int32_t)face_->glyph->advance.x;
+}
+
+int32_t FreeTypeRasterizer::Kerning(uint32_t left, uint32_t right) {
+  if (!FT_HAS_KERNING(face_)) return 0;
+  FT_Vector delta;
+  if (FT_Get_Kerning(face_, left, right, FT_KERNING_DEFAULT, &delta)) {
+    return 0;
+  }
+  return (int32_t)delta.x;
+}
+
+void FreeTypeRasterizer::DrawGlyph(uint32_t index, int pen_x, int baseline,
+                                   Surface* fill, int clip_left, int clip_top,
+                                   int clip_right, int clip_bottom) {
+  if (FT_Load_Glyph(face_, index, load_flags_)) return;
+  FT_GlyphSlot slot = face_->glyph;
+  if (embolden_) FT_GlyphSlot_Embolden(slot);
+  if (FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL)) return;
+  const FT_Bitmap& bitmap = slot->bitmap;
+  if (bitmap.pixel_mode != FT_PIXEL_MODE_GRAY) return;
+  const int x0 = pen_x + slot->bitmap_left;
+  const int y0 = baseline - slot->bitmap_top;
+  const int rows = (int)bitmap.rows;
+  const int cols = (int)bitmap.width;
+  const size_t stride = fill->stride();
+  for (int r = std::max(0, clip_top - y0);
+       r < rows && y0 + r < clip_bottom; ++r) {
+    const unsigned char* src =
+        bitmap.pitch >= 0 ? bitmap.buffer + (size_t)r * bitmap.pitch
+                          : bitmap.buffer +
+                                (size_t)(rows - 1 - r) * (size_t)-bitmap.pitch;
+    uint8_t* dst = fill->data() + (size_t)(y0 + r) * stride;
+    for (int c = std::max(0, clip_left - x0);
+         c < cols && x0 + c < clip_right; ++c) {
+      // Overlapping glyphs keep the larger coverage, like GDI text.
+      dst[x0 + c] = std::max(dst[x0 + c], (uint8_t)src[c]);
+    }
+  }
+}
+
+int FreeTypeRasterizer::LineHeight(const OverlayStyle& style) {
+  FontMetrics metrics;
+  return Metrics(style, &metrics) ? metrics.line_height : 0;
+}
+
+bool FreeTypeRasterizer::Metrics(const OverlayStyle& style,
+                                 FontMetrics* metrics) {
+  if (!face_ || !SetStyle(style)) return false;
+  const FT_Size_Metrics& size = face_->size->metrics;
+  metrics->ascent = RoundPx((int32_t)size.ascender);
+  metrics->descent = -RoundPx((int32_t)size.descender);
+  metrics->height = metrics->ascent + metrics->descent;
+  metrics->line_height = RoundPx((int32_t)size.height);
+  return true;
+}
+
+bool FreeTypeRasterizer::Layout(const std::string& text,
+                                const OverlayStyle& style, int width) {
+  if (!face_ || !SetStyle(style)) return false;
+  LayoutParams params;
+  params.max_width = std::max(width, 0) * 64;
+  params.max_lines = std::max(style.lines, 1);
+  params.align = style.text_align;
+  params.font_key = font_key_;
+  layout_.Layout(text, params, this);
+  return true;
+}
+
+int FreeTypeRasterizer::MeasureLine(const std::string& text,
+                                    const OverlayStyle& style) {
+  OverlayStyle line = style;
+  line.lines = 1;
+  line.text_align = 0;
+  // Wide enough that no sensible line is cut; the marquee caps the strip.
+  if (!Layout(text, line, kMaxMarqueeStripWidth * 4)) return 0;
+  if (layout_.lines().empty()) return 0;
+  return (layout_.lines()[0].width + 63) / 64;
+}
+
+bool FreeTypeRasterizer::Rasterize(const std::string& text,
+                                   const OverlayStyle& style, Surface* fill) {
+  if (!face_ || fill->bytes_per_pixel() != 1) return false;
+  if (!SetStyle(style)) return false;
+  const int pad = std::max(style.padding, 0);
+  const int clip_left = pad;
+  const int clip_top = pad;
+  const int clip_right = fill->width() - pad;
+  const int clip_bottom = fill->height() - pad;
+  if (clip_right <= clip_left || clip_bottom <= clip_top) return true;
+
+  Layout(text, style, clip_right - clip_left);
+
+  const FT_Size_Metrics& metrics = face_->size->metrics;
+  const int32_t ascender = (int32_t)metrics.ascender;
+  int32_t baseline;
+  if (style.lines <= 1) {
+    // Centered like DT_VCENTER: the ascent + descent box in the middle.
+    const int32_t text_height = ascender - (int32_t)metrics.descender;
+    baseline = clip_top * 64 +
+               ((clip_bottom - clip_top) * 64 - text_height) / 2 + ascender;
+  } else {
+    baseline = clip_top * 64 + ascender;
+  }
+
+  const std::vector<LayoutGlyph>& glyphs = layout_.glyphs();
+  for (const LayoutLine& line : layout_.lines()) {
+    const int baseline_px = RoundPx(baseline);
+    for (size_t i = line.begin; i < line.end; ++i) {
+      const LayoutGlyph& glyph = glyphs[i];
+      if (glyph.codepoint == ' ') continue;
+      DrawGlyph(glyph.glyph, RoundPx(clip_left * 64 + glyph.x), baseline_px,
+                fill, clip_left, clip_top, clip_right, clip_bottom);
+    }
+    baseline += (int32_t)metrics.height;
+  }
+  return true;
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,93 @@
+// freetype_rasterizer.h
+#ifndef OVERLAY_RENDER_FREETYPE_RASTERIZER_H_
+#define OVERLAY_RENDER_FREETYPE_RASTERIZER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "overlay_core/font_cache.h"
+#include "overlay_core/text_layer.h"
+#include "overlay_core/text_layout.h"
+
+struct FT_LibraryRec_;
+struct FT_FaceRec_;
+
+namespace tono_overlay {
+
+// TextRasterizer on FreeType, drawing A8 coverage into plain memory
+// surfaces. Uses one font file; weights of 600 and up are emboldened
+// synthetically unless the face is already bold.
+//
+// Output depends only on the inputs, the font file and the FreeType
+// version: glyphs are placed on whole pixels with light hinting and no
+// embedded bitmaps, so golden images are stable on a given build.
+class FreeTypeRasterizer : public TextRasterizer, private GlyphSource {
+ public:
+  static constexpr int kDefaultDpi = 96;
+
+  // Loads the first face of |font_path|. Check ok() before rendering.
+  explicit FreeTypeRasterizer(const std::string& font_path,
+                              int dpi = kDefaultDpi);
+  ~FreeTypeRasterizer() override;
+
+  FreeTypeRasterizer(const FreeTypeRasterizer&) = delete;
+  FreeTypeRasterizer& operator=(const FreeTypeRasterizer&) = delete;
+
+  bool ok() const { return face_ != nullptr; }
+  // Why loading failed; empty when ok().
+  const std::string& error() const { return error_; }
+
+  std::unique_ptr<SurfaceAllocator> CreateSurfaceAllocator() override;
+  bool Rasterize(const std::string& text, const OverlayStyle& style,
+                 Surface* fill) override;
+  int MeasureLine(const std::string& text, const OverlayStyle& style) override;
+
+  // Distance between baselines of wrapped lines at the size of |style|, in
+  // pixels; 0 if the face cannot be set to that size. Windows are sized
+  // from it.
+  int LineHeight(const OverlayStyle& style);
+  // Ascent, descent and line height at the size of |style|, in pixels.
+  // Returns false if the face cannot be set to that size.
+  bool Metrics(const OverlayStyle& style, FontMetrics* metrics);
+
+  // Lays |text| out as Rasterize() would in a text box |width| pixels
+  // wide, without drawing; the lines are then in layout(). Returns false if
+  // the face cannot be set to the size of |style|.
+  bool Layout(const std::string& text, const OverlayStyle& style, int width);
+  // Lines of the last Layout() or Rasterize() call.
+  const TextLayout& layout() const { return layout_; }
+  // Forgets the laid-out text, so the next call shapes it from scratch;
+  // for benchmarks of cold layout.
+  void InvalidateLayout() { layout_.Invalidate(); }
+
+ private:
+  // Sets the pixel size and bold synthesis for |style|.
+  bool SetStyle(const OverlayStyle& style);
+
+  // GlyphSource, at the size SetStyle() chose.
+  uint32_t GlyphIndex(uint32_t codepoint) override;
+  int32_t GlyphAdvance(uint32_t glyph) override;
+  int32_t Kerning(uint32_t left, uint32_t right) override;
+
+  void DrawGlyph(uint32_t index, int pen_x, int baseline, Surface* fill,
+                 int clip_left, int clip_top, int clip_right,
+                 int clip_bottom);
+
+  FT_LibraryRec_* library_ = nullptr;
+  FT_FaceRec_* face_ = nullptr;
+  std::string error_;
+  int dpi_;
+  int size_pt_ = -1;
+  bool embolden_ = false;
+  int load_flags_ = 0;
+  // Hash of the font file and dpi; |font_key_| adds the size and bold
+  // synthesis, naming the font for TextLayout's caches.
+  uint64_t face_key_ = 0;
+  uint64_t font_key_ = 0;
+  TextLayout layout_;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_RENDER_FREETYPE_RASTERIZER_H_
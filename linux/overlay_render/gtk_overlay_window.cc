@@ -0,0 +1,527 @@
+// gtk_overlay_window.cc
+#include "overlay_render/gtk_overlay_window.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "overlay_core/compositor.h"
+#include "overlay_core/lrc_parser.h"
+#include "overlay_core/overlay_log.h"
+#include "overlay_core/overlay_stats.h"
+#include "overlay_core/overlay_trace.h"
+#include "overlay_core/text_layer.h"
+
+namespace tono_overlay {
+
+namespace {
+
+// Line height used until a font could be loaded.
+constexpr int kFallbackLineHeight = 16;
+
+}  // namespace
+
+GtkOverlayWindow::GtkOverlayWindow(
+    std::shared_ptr<OverlayRenderContext> context)
+    : context_(context ? std::move(context)
+                       : std::make_shared<OverlayRenderContext>()) {}
+
+GtkOverlayWindow::~GtkOverlayWindow() { Destroy(); }
+
+bool GtkOverlayWindow::Create() {
+  if (window_) return true;
+  TONO_LOG(kInfo, "GtkOverlayWindow::Create: compositor isa="
+                      << CompositorIsaName(ActiveCompositorIsa()));
+  window_ = gtk_window_new(GTK_WINDOW_POPUP);
+  GtkWindow* window = GTK_WINDOW(window_);
+  gtk_window_set_title(window, "TonoLyrics");
+  gtk_window_set_keep_above(window, TRUE);
+  gtk_window_set_skip_taskbar_hint(window, TRUE);
+  gtk_window_set_skip_pager_hint(window, TRUE);
+  gtk_window_set_accept_focus(window, FALSE);
+  // Per-pixel alpha needs an ARGB visual, which only a compositing screen
+  // offers; without one the background is opaque black.
+  GdkVisual* visual =
+      gdk_screen_get_rgba_visual(gtk_widget_get_screen(window_));
+  if (visual) {
+    gtk_widget_set_visual(window_, visual);
+  } else {
+    TONO_LOG(kWarning, "GtkOverlayWindow::Create: no ARGB visual");
+  }
+  gtk_widget_set_app_paintable(window_, TRUE);
+  gtk_widget_add_events(window_, GDK_BUTTON_PRESS_MASK |
+                                     GDK_BUTTON_RELEASE_MASK |
+                                     GDK_POINTER_MOTION_MASK);
+  g_signal_connect(window_, "draw", G_CALLBACK(OnDraw), this);
+  g_signal_connect(window_, "button-press-event", G_CALLBACK(OnButtonPress),
+                   this);
+  g_signal_connect(window_, "button-release-event",
+                   G_CALLBACK(OnButtonRelease), this);
+  g_signal_connect(window_, "motion-notify-event", G_CALLBACK(OnMotion),
+                   this);
+
+  // Presenting happens on the main loop; Destroy() removes a pending call
+  // after taking the queue off the worker.
+  renderer_ = context_->CreateRenderer([this] {
+    g_idle_add_full(G_PRIORITY_HIGH_IDLE, OnFrameReady, this, nullptr);
+  });
+
+  const OverlayStyle& style = state_.style();
+  MoveWindow(style.x, style.y);
+  // Sizes the window and posts the first frame.
+  UpdateSizeAndRedraw();
+  ApplyInputShape();
+  gtk_widget_show(window_);
+  // A sheet and anchor may have arrived while the overlay was closed.
+  timeline_index_ = -1;
+  TimelineTick();
+  return true;
+}
+
+void GtkOverlayWindow::Destroy() {
+  // Waits for a render in flight, then drops its pending present along
+  // with the timeline timer.
+  renderer_.reset();
+  while (g_source_remove_by_user_data(this)) {
+  }
+  timeline_source_ = 0;
+  // The tick callback goes with the widget.
+  animation_tick_ = 0;
+  transition_.Cancel();
+  marquee_.Stop();
+  shown_ = false;
+  shown_text_.clear();
+  // Keep the sheet for the next window, but stop rendering for this one.
+  if (prerenderer_) prerenderer_->SetStyle(0, nullptr);
+  prerender_style_hash_ = 0;
+  dragging_ = false;
+  if (window_) {
+    gtk_widget_destroy(window_);
+    window_ = nullptr;
+  }
+}
+
+bool GtkOverlayWindow::Show() {
+  if (!Create()) return false;
+  gtk_widget_show(window_);
+  return true;
+}
+
+void GtkOverlayWindow::Hide() {
+  if (window_) gtk_widget_hide(window_);
+}
+
+void GtkOverlayWindow::SetText(const std::string& text) {
+  if (text == text_) return;
+  text_ = text;
+  UpdateTextLayer();
+}
+
+void GtkOverlayWindow::ApplyStyle(const OverlayStyleUpdate& update) {
+  if (update.ApplyTo(&state_)) ApplyChanges();
+}
+
+bool GtkOverlayWindow::SetClickThrough(bool enable) {
+  click_through_ = enable;
+  dragging_ = false;
+  if (window_) {
+    ApplyInputShape();
+    // The background plate is hidden while locked.
+    UpdateTextLayer();
+  }
+  return click_through_;
+}
+
+void GtkOverlayWindow::SetSheet(const std::vector<LrcLine>& lines,
+                                int lookahead) {
+  std::vector<LyricLine> sheet;
+  std::vector<std::string> sheet_texts;
+  std::vector<int64_t> sheet_times;
+  const size_t count = lines.size();
+  sheet.reserve(count);
+  sheet_texts.reserve(count);
+  sheet_times.reserve(count);
+  std::string plain;
+  std::vector<LrcWord> words;
+  for (const LrcLine& lrc : lines) {
+    // Word tags are dropped: word-timed lines show as plain lines.
+    StripWordTimings(lrc.text, &plain, &words);
+    LyricLine line;
+    line.time_ms = lrc.time_ms;
+    line.text = plain;
+    sheet.push_back(std::move(line));
+    sheet_texts.push_back(plain);
+    sheet_times.push_back(lrc.time_ms);
+  }
+  if (!prerenderer_) {
+    prerenderer_ =
+        std::make_unique<LinePrerenderer>(context_->line_cache());
+  }
+  if (lookahead >= 0) prerenderer_->SetLookahead(lookahead);
+  prerenderer_->SetSheet(std::move(sheet));
+  // Hand the worker the current style right away instead of waiting for
+  // the next line change.
+  UpdateTextLayer();
+  sheet_texts_ = std::move(sheet_texts);
+  timeline_.SetTimes(std::move(sheet_times));
+  timeline_index_ = -1;
+  TimelineTick();
+  TONO_LOG(kInfo, "GtkOverlayWindow::SetSheet: " << count << " lines");
+}
+
+void GtkOverlayWindow::SetPlayback(int64_t position_ms, bool playing,
+                                   double rate) {
+  timeline_.SetAnchor(position_ms, rate, !playing);
+  TimelineTick();
+}
+
+RenderThreadStats GtkOverlayWindow::render_stats() const {
+  return renderer_ ? renderer_->stats() : RenderThreadStats();
+}
+
+gboolean GtkOverlayWindow::OnDraw(GtkWidget*, cairo_t* cr, gpointer data) {
+  static_cast<GtkOverlayWindow*>(data)->Paint(cr);
+  return FALSE;
+}
+
+gboolean GtkOverlayWindow::OnButtonPress(GtkWidget*, GdkEventButton* event,
+                                         gpointer data) {
+  auto* self = static_cast<GtkOverlayWindow*>(data);
+  if (event->button != 1 || self->click_through_) return FALSE;
+  // Popups are not managed by the window manager, so the drag is ours.
+  self->dragging_ = true;
+  self->drag_dx_ = (int)event->x;
+  self->drag_dy_ = (int)event->y;
+  return TRUE;
+}
+
+gboolean GtkOverlayWindow::OnButtonRelease(GtkWidget*, GdkEventButton* event,
+                                           gpointer data) {
+  auto* self = static_cast<GtkOverlayWindow*>(data);
+  if (event->button != 1 || !self->dragging_) return FALSE;
+  self->dragging_ = false;
+  return TRUE;
+}
+
+gboolean GtkOverlayWindow::OnMotion(GtkWidget*, GdkEventMotion* event,
+                                    gpointer data) {
+  auto* self = static_cast<GtkOverlayWindow*>(data);
+  if (!self->dragging_) return FALSE;
+  const int x = (int)event->x_root - self->drag_dx_;
+  const int y = (int)event->y_root - self->drag_dy_;
+  // The window moves here, so the new position is not dirty.
+  if (self->state_.SetPosition(x, y)) {
+    self->state_.MarkClean(kFieldPosition);
+    self->MoveWindow(x, y);
+  }
+  return TRUE;
+}
+
+gboolean GtkOverlayWindow::OnFrameReady(gpointer data) {
+  static_cast<GtkOverlayWindow*>(data)->PresentRenderedFrame();
+  return G_SOURCE_REMOVE;
+}
+
+gboolean GtkOverlayWindow::OnAnimationTick(GtkWidget* widget,
+                                           GdkFrameClock* clock,
+                                           gpointer data) {
+  auto* self = static_cast<GtkOverlayWindow*>(data);
+  // The last paint found the transition over and showed the line itself,
+  // and no line scrolls.
+  if (!self->transition_.active() && !self->marquee_.active()) {
+    self->animation_tick_ = 0;
+    return G_SOURCE_REMOVE;
+  }
+  const int64_t now_ms = gdk_frame_clock_get_frame_time(clock) / 1000;
+  self->marquee_.SetMotion(MarqueeMotionOf(self->state_.style()), now_ms);
+  // A marquee at rest paints nothing.
+  if (self->transition_.active() || self->marquee_.NeedsFrame(now_ms)) {
+    gtk_widget_queue_draw(widget);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+gboolean GtkOverlayWindow::OnTimelineTimer(gpointer data) {
+  auto* self = static_cast<GtkOverlayWindow*>(data);
+  self->timeline_source_ = 0;
+  self->TimelineTick();
+  return G_SOURCE_REMOVE;
+}
+
+void GtkOverlayWindow::Paint(cairo_t* cr) {
+  ScopedStageTimer timer(TimingStage::kPresent);
+  // The frame already holds the background plate under the text, so it
+  // replaces the window's pixels in one paint.
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  RenderBuffer* frame = renderer_ ? renderer_->front() : nullptr;
+  Surface* output = frame && frame->surfaces
+                        ? frame->surfaces->surface(kTextLayerOutput)
+                        : nullptr;
+  if (!output) {
+    cairo_set_source_rgba(cr, 0, 0, 0, 0);
+    cairo_paint(cr);
+    return;
+  }
+  const int64_t now_ms = FrameTimeMs();
+  Surface* shown = output;
+  if (marquee_.active()) {
+    // Only copies the window out of the strip, and only if it moved.
+    marquee_.SetMotion(MarqueeMotionOf(state_.style()), now_ms);
+    if (marquee_.Frame(output->data(), marquee_surface_->data(), now_ms)) {
+      ++marquee_frames_;
+    }
+    shown = marquee_surface_.get();
+  }
+  if (transition_.active() &&
+      (!transition_surface_ ||
+       transition_surface_->width() != shown->width() ||
+       transition_surface_->height() != shown->height())) {
+    // No surface of this size to blend into; the new line shows at once.
+    transition_.Cancel();
+  }
+  if (transition_.active() &&
+      transition_.Frame(shown->data(), transition_surface_->data(),
+                        shown->width(), shown->height(), shown->stride(),
+                        now_ms)) {
+    shown = transition_surface_.get();
+    ++transition_frames_;
+  }
+  // The core writes premultiplied B, G, R, A bytes: CAIRO_FORMAT_ARGB32 on
+  // a little-endian machine, with a stride cairo accepts for any width.
+  // The front buffer is ours until the next AcquireFrame(), so cairo reads
+  // it in place.
+  cairo_surface_t* image = cairo_image_surface_create_for_data(
+      shown->data(), CAIRO_FORMAT_ARGB32, shown->width(), shown->height(),
+      (int)shown->stride());
+  cairo_set_source_surface(cr, image, 0, 0);
+  cairo_paint(cr);
+  cairo_surface_destroy(image);
+  ++frames_painted_;
+}
+
+void GtkOverlayWindow::MoveWindow(int x, int y) {
+  OverlayTracer::Global().Instant("window", "move", StatsNowNs(), "x", x,
+                                  "y", y);
+  gtk_window_move(GTK_WINDOW(window_), x, y);
+}
+
+void GtkOverlayWindow::ApplyChanges() {
+  const uint32_t stages = state_.TakeDirtyStages();
+  if (stages == 0) return;
+  const OverlayStyle& style = state_.style();
+  if ((stages & kStageWindow) && window_) {
+    MoveWindow(style.x, style.y);
+  }
+  if (stages & kStageFont) UpdateFont();
+  if (stages & kStageLayout) {
+    UpdateSizeAndRedraw();
+  } else if (stages & (kStageRaster | kStageComposite)) {
+    // The render thread recolors its masks when only colors changed.
+    UpdateTextLayer();
+  }
+}
+
+void GtkOverlayWindow::UpdateFont() {
+  const OverlayStyle& style = state_.style();
+  context_->measure()->Ensure(style);
+  TONO_VLOG("GtkOverlayWindow::UpdateFont: size=" << style.font_size
+                                                  << " weight="
+                                                  << style.font_weight
+                                                  << " family="
+                                                  << style.font_family);
+}
+
+void GtkOverlayWindow::UpdateSizeAndRedraw() {
+  const OverlayStyle& style = state_.style();
+  int line_h = kFallbackLineHeight;
+  FontTextRenderer* measure = context_->measure();
+  if (measure->Ensure(style)) {
+    const int measured = measure->metrics().line_height;
+    if (measured > 0) line_h = measured;
+  }
+  height_ = style.padding * 2 + line_h * std::max(style.lines, 1);
+  if (window_) {
+    gtk_window_resize(GTK_WINDOW(window_), style.width, height_);
+    UpdateTextLayer();
+  }
+}
+
+void GtkOverlayWindow::ApplyInputShape() {
+  if (!window_) return;
+  if (click_through_) {
+    cairo_region_t* empty = cairo_region_create();
+    gtk_widget_input_shape_combine_region(window_, empty);
+    cairo_region_destroy(empty);
+  } else {
+    gtk_widget_input_shape_combine_region(window_, nullptr);
+  }
+}
+
+void GtkOverlayWindow::UpdateTextLayer() {
+  if (!window_ || !renderer_) return;
+  const OverlayStyle& style = state_.style();
+  if (style.width <= 0 || height_ <= 0) return;
+  RenderSnapshot snapshot;
+  snapshot.text = text_;
+  snapshot.style = style;
+  snapshot.style.background_alpha = BackgroundAlpha();
+  snapshot.width = style.width;
+  snapshot.height = height_;
+  posted_text_ = text_;
+  renderer_->Post(std::move(snapshot));
+}
+
+void GtkOverlayWindow::PresentRenderedFrame() {
+  if (!renderer_ || !window_) return;
+  const OverlayStyle& style = state_.style();
+  // The frame waiting is for a different line than the one shown.
+  const bool new_line = posted_text_ != shown_text_;
+  const bool animate =
+      style.transition != TransitionKind::kNone && style.transition_ms > 0;
+  // Started only once a frame is taken: with none ready (the worker took
+  // it back to draw a newer one), the old line simply stays up.
+  RenderBuffer* frame = renderer_->AcquireFrame([&](RenderBuffer* previous) {
+    if (animate && new_line) StartTransition(previous);
+  });
+  if (!frame) return;
+  ++frames_acquired_;
+  const RenderSnapshot& snapshot = *frame->snapshot;
+  // Drawn before a resize; the frame for the new size is already queued.
+  if (snapshot.width != style.width || snapshot.height != height_) {
+    transition_.Cancel();
+    marquee_.Stop();
+    shown_ = false;
+    return;
+  }
+  const bool same_line = shown_ && snapshot.text == shown_text_;
+  // An older frame of the line on screen: nothing to animate. A running
+  // transition simply continues into a restyled line.
+  if (new_line && shown_ && snapshot.text == shown_text_) transition_.Cancel();
+  shown_text_ = snapshot.text;
+  shown_ = true;
+  // Painted on this frame clock cycle, which is close enough for a
+  // latency that is mostly render time.
+  RecordStage(TimingStage::kUpdate, snapshot.posted_ns, StatsNowNs());
+  NotePrerenderStyle(snapshot, frame->style_hash);
+  UpdateMarquee(snapshot, *frame->surfaces->surface(kTextLayerOutput),
+                same_line);
+  if (transition_.active()) {
+    if (!transition_surface_ ||
+        transition_surface_->width() != snapshot.width ||
+        transition_surface_->height() != snapshot.height) {
+      transition_surface_ = std::make_unique<MemorySurface>(
+          snapshot.width, snapshot.height, 4);
+    }
+  }
+  StartAnimationTick();
+  // Paints at most once per frame clock cycle however often it is queued.
+  gtk_widget_queue_draw(window_);
+}
+
+void GtkOverlayWindow::StartTransition(RenderBuffer* previous) {
+  const OverlayStyle& style = state_.style();
+  const Surface* on_screen = nullptr;
+  if (transition_.active()) {
+    on_screen = transition_surface_.get();
+  } else if (marquee_.active()) {
+    on_screen = marquee_surface_.get();
+  } else if (shown_ && previous && previous->surfaces) {
+    on_screen = previous->surfaces->surface(kTextLayerOutput);
+  }
+  if (!on_screen) {
+    transition_.Cancel();
+    return;
+  }
+  // The plate the lines are drawn over, which stays still.
+  BackgroundPlate plate = TextLayerCompositeParams(style, PixelFormat())
+                              .background;
+  plate.alpha = BackgroundAlpha();
+  // Not FrameTimeMs(): between paints the frame clock still reports the
+  // last frame. A first frame time slightly before this counts as 0.
+  transition_.Start(style.transition, style.transition_ms,
+                    g_get_monotonic_time() / 1000, on_screen->data(),
+                    on_screen->width(), on_screen->height(),
+                    on_screen->stride(), plate, PixelFormat());
+}
+
+void GtkOverlayWindow::UpdateMarquee(const RenderSnapshot& snapshot,
+                                     const Surface& output, bool same_line) {
+  if (output.width() <= snapshot.width) {
+    marquee_.Stop();
+    return;
+  }
+  if (!same_line || !marquee_.active() ||
+      marquee_.strip_width() != output.width()) {
+    marquee_.Start(output.width(), snapshot.width, snapshot.height,
+                   g_get_monotonic_time() / 1000);
+  }
+  // The snapshot carries the plate's alpha as drawn.
+  marquee_.SetPlate(
+      TextLayerCompositeParams(snapshot.style, PixelFormat()).background,
+      PixelFormat());
+  // The strip is a new buffer, possibly recolored.
+  marquee_.Invalidate();
+  if (!marquee_surface_ || marquee_surface_->width() != snapshot.width ||
+      marquee_surface_->height() != snapshot.height) {
+    marquee_surface_ = std::make_unique<MemorySurface>(snapshot.width,
+                                                       snapshot.height, 4);
+  }
+}
+
+void GtkOverlayWindow::StartAnimationTick() {
+  if (animation_tick_ || (!transition_.active() && !marquee_.active())) {
+    return;
+  }
+  animation_tick_ =
+      gtk_widget_add_tick_callback(window_, OnAnimationTick, this, nullptr);
+}
+
+int64_t GtkOverlayWindow::FrameTimeMs() const {
+  // Frame times are on g_get_monotonic_time()'s clock.
+  GdkFrameClock* clock = gtk_widget_get_frame_clock(window_);
+  if (!clock) return g_get_monotonic_time() / 1000;
+  return gdk_frame_clock_get_frame_time(clock) / 1000;
+}
+
+void GtkOverlayWindow::NotePrerenderStyle(const RenderSnapshot& snapshot,
+                                          uint64_t style_hash) {
+  if (!prerenderer_) return;
+  if (style_hash != prerender_style_hash_) {
+    prerenderer_->SetStyle(style_hash,
+                           MakePrerenderFn(snapshot.style, snapshot.width,
+                                           snapshot.height));
+    prerender_style_hash_ = style_hash;
+  }
+  prerenderer_->NoteText(snapshot.text);
+}
+
+void GtkOverlayWindow::TimelineTick() {
+  if (!window_) return;
+  if (timeline_source_) {
+    g_source_remove(timeline_source_);
+    timeline_source_ = 0;
+  }
+  if (timeline_.empty()) return;
+  const int index = timeline_.CurrentIndex();
+  if (index != timeline_index_) {
+    timeline_index_ = index;
+    if (index >= 0 && index < (int)sheet_texts_.size()) {
+      // Blank lines keep the previous text on screen.
+      const std::string& text = sheet_texts_[index];
+      if (text.find_first_not_of(" \t\r\n") != std::string::npos) {
+        SetText(text);
+      }
+      if (prerenderer_) prerenderer_->SetCurrentIndex(index);
+    }
+  }
+  int64_t delay = timeline_.MsUntilNextChange();
+  if (delay < 0) return;
+  delay = std::min<int64_t>(delay, G_MAXINT);
+  timeline_source_ = g_timeout_add((guint)delay, OnTimelineTimer, this);
+}
+
+int GtkOverlayWindow::BackgroundAlpha() const {
+  // A locked (click-through) overlay hides its background.
+  return click_through_ ? 0 : state_.style().background_alpha;
+}
+
+}  // namespace tono_overlay
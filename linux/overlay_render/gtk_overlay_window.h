@@ -0,0 +1,194 @@
+// gtk_overlay_window.h
+#ifndef OVERLAY_RENDER_GTK_OVERLAY_WINDOW_H_
+#define OVERLAY_RENDER_GTK_OVERLAY_WINDOW_H_
+
+#include <gtk/gtk.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "overlay_core/clock.h"
+#include "overlay_core/line_cache.h"
+#include "overlay_core/line_prerenderer.h"
+#include "overlay_core/line_transition.h"
+#include "overlay_core/lrc_parser.h"
+#include "overlay_core/lyric_timeline.h"
+#include "overlay_core/marquee.h"
+#include "overlay_core/overlay_state.h"
+#include "overlay_core/overlay_style_decoder.h"
+#include "overlay_core/render_thread.h"
+#include "overlay_core/surface.h"
+#include "overlay_render/render_context.h"
+
+namespace tono_overlay {
+
+// The lyrics overlay on GTK: an always-on-top ARGB popup that shows one
+// line of text over a translucent background, can be dragged, and can be
+// made click-through with an empty input shape.
+//
+// Text is drawn with FreeType through the core text pipeline on a
+// RenderThread, which composites it over the background plate in the same
+// pass; the window thread paints the front buffer's premultiplied pixels
+// through a cairo image surface that wraps them, without copying.
+// Paints follow the GdkFrameClock: new frames only queue a draw, so any
+// number of updates within one frame are painted once, and a line change
+// animates on a tick callback by blending the old and new line bitmaps. A
+// line too long for the window, with the marquee on, is drawn once into a
+// wider strip that the same tick callback scrolls through the window.
+// Every method runs on the GTK main thread. The lyrics channel of the
+// Linux runner forwards its calls here, one window per overlay id.
+//
+// Windows created with the same OverlayRenderContext share its render
+// worker, fonts and line cache; each keeps its own text, style, sheet,
+// timeline and frame buffers.
+class GtkOverlayWindow {
+ public:
+  // Null |context|: one of its own.
+  explicit GtkOverlayWindow(
+      std::shared_ptr<OverlayRenderContext> context = nullptr);
+  ~GtkOverlayWindow();
+
+  GtkOverlayWindow(const GtkOverlayWindow&) = delete;
+  GtkOverlayWindow& operator=(const GtkOverlayWindow&) = delete;
+
+  // Creates and shows the window; true if it exists afterwards.
+  bool Create();
+  void Destroy();
+  bool created() const { return window_ != nullptr; }
+  // Creates the window if needed and shows it.
+  bool Show();
+  void Hide();
+
+  // Shows |text| (UTF-8). Identical text is not redrawn.
+  void SetText(const std::string& text);
+  const std::string& text() const { return text_; }
+
+  // Applies a decoded style batch, running only the stages it needs.
+  void ApplyStyle(const OverlayStyleUpdate& update);
+  const OverlayStyle& style() const { return state_.style(); }
+
+  // Lets pointer events through to the windows below and hides the
+  // background. Returns the new setting.
+  bool SetClickThrough(bool enable);
+  bool click_through() const { return click_through_; }
+
+  // The whole song, sorted by start time, with optional <mm:ss.xx> word
+  // tags in the texts (shown as plain text). Upcoming lines are
+  // pre-rendered |lookahead| ahead (< 0 keeps the current setting), and the
+  // overlay advances lines itself from the anchor set by SetPlayback().
+  void SetSheet(const std::vector<LrcLine>& lines, int lookahead);
+  void SetPlayback(int64_t position_ms, bool playing, double rate);
+
+  // Of the line cache, which is the context's.
+  LineCacheStats cache_stats() const {
+    return context_->line_cache()->stats();
+  }
+  void SetCacheBudget(size_t bytes) {
+    context_->line_cache()->SetByteBudget(bytes);
+  }
+  OverlayRenderContext* context() const { return context_.get(); }
+
+  // Frames taken from the render thread, and frames painted; for tests and
+  // latency measurements.
+  uint64_t frames_acquired() const { return frames_acquired_; }
+  uint64_t frames_painted() const { return frames_painted_; }
+  // Paints that showed a line transition, and whether one is running.
+  uint64_t transition_frames() const { return transition_frames_; }
+  bool transition_active() const { return transition_.active(); }
+  // Paints that moved the marquee, and whether the line on screen scrolls.
+  uint64_t marquee_frames() const { return marquee_frames_; }
+  bool marquee_active() const { return marquee_.active(); }
+  RenderThreadStats render_stats() const;
+  GtkWidget* widget() const { return window_; }
+
+ private:
+  static gboolean OnDraw(GtkWidget* widget, cairo_t* cr, gpointer data);
+  static gboolean OnButtonPress(GtkWidget* widget, GdkEventButton* event,
+                                gpointer data);
+  static gboolean OnButtonRelease(GtkWidget* widget, GdkEventButton* event,
+                                  gpointer data);
+  static gboolean OnMotion(GtkWidget* widget, GdkEventMotion* event,
+                           gpointer data);
+  static gboolean OnFrameReady(gpointer data);
+  static gboolean OnTimelineTimer(gpointer data);
+  static gboolean OnAnimationTick(GtkWidget* widget, GdkFrameClock* clock,
+                                  gpointer data);
+
+  void Paint(cairo_t* cr);
+  // gtk_window_move, traced as a window move.
+  void MoveWindow(int x, int y);
+  void ApplyChanges();
+  void UpdateFont();
+  void UpdateSizeAndRedraw();
+  void ApplyInputShape();
+  // Posts the text with the current style to the render thread.
+  void UpdateTextLayer();
+  void PresentRenderedFrame();
+  // Starts the configured transition from the pixels on screen, before
+  // |previous| (the front buffer, or null) goes back to the render thread.
+  void StartTransition(RenderBuffer* previous);
+  // Scrolls |output| through the window if it is a strip wider than
+  // |snapshot|'s; a restyle of the same line keeps its place.
+  void UpdateMarquee(const RenderSnapshot& snapshot, const Surface& output,
+                     bool same_line);
+  // Runs OnAnimationTick() while a transition or the marquee is active.
+  void StartAnimationTick();
+  // Time of the frame being painted, in milliseconds.
+  int64_t FrameTimeMs() const;
+  void NotePrerenderStyle(const RenderSnapshot& snapshot,
+                          uint64_t style_hash);
+  void TimelineTick();
+  // The plate's alpha as drawn: 0 while click-through.
+  int BackgroundAlpha() const;
+
+  // Outlives the prerenderer and render queue below, which use its line
+  // cache and worker.
+  std::shared_ptr<OverlayRenderContext> context_;
+  GtkWidget* window_ = nullptr;
+  OverlayState state_;
+  std::string text_;
+  int height_ = 64;
+  bool click_through_ = false;
+  // Pointer offset inside the window while dragging it.
+  bool dragging_ = false;
+  int drag_dx_ = 0;
+  int drag_dy_ = 0;
+
+  // Renders the upcoming lines of the sheet into the context's line cache.
+  std::unique_ptr<LinePrerenderer> prerenderer_;
+  // Style hash the prerenderer was last given; 0 = none.
+  uint64_t prerender_style_hash_ = 0;
+  // Created with the window, on the context's worker.
+  std::unique_ptr<RenderThread> renderer_;
+
+  SteadyClock clock_;
+  LyricTimeline timeline_{&clock_};
+  std::vector<std::string> sheet_texts_;
+  // Sheet index last shown by the timeline (-1 = none yet).
+  int timeline_index_ = -1;
+  guint timeline_source_ = 0;
+
+  // Text of the last snapshot posted and of the frame on screen; only a
+  // new line animates, not a restyle of the same one.
+  std::string posted_text_;
+  std::string shown_text_;
+  bool shown_ = false;
+  LineTransition transition_;
+  // The transition frame painted last; reused across transitions.
+  std::unique_ptr<MemorySurface> transition_surface_;
+  Marquee marquee_;
+  // The window onto the marquee strip painted last.
+  std::unique_ptr<MemorySurface> marquee_surface_;
+  guint animation_tick_ = 0;
+
+  uint64_t frames_acquired_ = 0;
+  uint64_t frames_painted_ = 0;
+  uint64_t transition_frames_ = 0;
+  uint64_t marquee_frames_ = 0;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_RENDER_GTK_OVERLAY_WINDOW_H_
@@ -0,0 +1,116 @@
+// render_context.cc
+#include "overlay_render/render_context.h"
+
+#include <utility>
+
+#include "overlay_core/marquee.h"
+#include "overlay_core/overlay_log.h"
+#include "overlay_core/text_layer.h"
+
+namespace tono_overlay {
+
+namespace {
+
+// Style and width |text| is drawn with for a |w| pixel window: the window
+// itself, or a wider strip without the plate when the line scrolls.
+OverlayStyle LayerStyle(FreeTypeRasterizer* rasterizer,
+                        const std::string& text, const OverlayStyle& style,
+                        int w, int* layer_w) {
+  *layer_w = MarqueeStripWidth(rasterizer, text, style, w);
+  return *layer_w > w ? MarqueeStripStyle(style) : style;
+}
+
+// Draws |snapshot| into |buffer| on the render worker: from the line
+// cache, by recoloring the buffer's masks when only colors changed, or by
+// rasterizing. A line that scrolls is drawn into a strip wider than the
+// window, cached under the window's key like any other line.
+bool RenderFrame(FontTextRenderer* fonts, LineCache* cache,
+                 const RenderSnapshot& snapshot, RenderBuffer* buffer) {
+  const int w = snapshot.width;
+  const int h = snapshot.height;
+  if (!fonts->Ensure(snapshot.style)) return false;
+  int layer_w = w;
+  const OverlayStyle style = LayerStyle(
+      fonts->rasterizer(), snapshot.text, snapshot.style, w, &layer_w);
+  TextLayerPipeline* pipeline = fonts->pipeline();
+  if (!buffer->surfaces) buffer->surfaces = pipeline->CreateSurfaces();
+  SurfacePool* surfaces = buffer->surfaces.get();
+  if (!surfaces->EnsureSize(layer_w, h)) {
+    buffer->raster_hash = 0;
+    TONO_LOG(kError, "RenderFrame: surface allocation failed for "
+                         << layer_w << "x" << h);
+    return false;
+  }
+
+  const uint64_t raster_hash =
+      TextLayerRasterHash(snapshot.text, style, layer_w, h);
+  LineCacheKey key;
+  key.text = snapshot.text;
+  key.style_hash =
+      TextLayerStyleHash(snapshot.style, w, h, surfaces->pixel_format());
+  buffer->style_hash = key.style_hash;
+  Surface* output = surfaces->surface(kTextLayerOutput);
+
+  // Only colors or text opacity changed since the masks were drawn.
+  if (buffer->raster_hash == raster_hash) {
+    pipeline->Recomposite(style, surfaces);
+    cache->Insert(key, layer_w, h, output->data());
+    return true;
+  }
+  // The masks no longer match the output after a cache hit.
+  if (cache->Lookup(key, output->data(), output->size_bytes())) {
+    buffer->raster_hash = 0;
+    return true;
+  }
+  if (!pipeline->Render(snapshot.text, style, layer_w, h, surfaces)) {
+    buffer->raster_hash = 0;
+    return false;
+  }
+  buffer->raster_hash = raster_hash;
+  cache->Insert(key, layer_w, h, output->data());
+  return true;
+}
+
+}  // namespace
+
+OverlayRenderContext::OverlayRenderContext(size_t font_capacity)
+    : render_fonts_(std::make_shared<FontTextRenderer>(font_capacity)),
+      worker_(std::make_shared<RenderWorker>()) {}
+
+std::unique_ptr<RenderThread> OverlayRenderContext::CreateRenderer(
+    RenderThread::FrameReadyFn frame_ready) {
+  std::shared_ptr<FontTextRenderer> fonts = render_fonts_;
+  LineCache* cache = &line_cache_;
+  return std::make_unique<RenderThread>(
+      worker_,
+      [fonts, cache](const RenderSnapshot& snapshot, RenderBuffer* buffer) {
+        return RenderFrame(fonts.get(), cache, snapshot, buffer);
+      },
+      std::move(frame_ready));
+}
+
+LinePrerenderer::RenderFn MakePrerenderFn(const OverlayStyle& style, int w,
+                                          int h) {
+  struct Target {
+    FontTextRenderer fonts;
+    std::unique_ptr<SurfacePool> surfaces;
+  };
+  auto target = std::make_shared<Target>();
+  return [style, w, h, target](const std::string& text, LineBitmap* out) {
+    if (!target->fonts.Ensure(style)) return false;
+    int layer_w = w;
+    const OverlayStyle layer_style =
+        LayerStyle(target->fonts.rasterizer(), text, style, w, &layer_w);
+    TextLayerPipeline* pipeline = target->fonts.pipeline();
+    if (!target->surfaces) target->surfaces = pipeline->CreateSurfaces();
+    Surface* output = pipeline->Render(text, layer_style, layer_w, h,
+                                       target->surfaces.get());
+    if (!output) return false;
+    out->width = output->width();
+    out->height = output->height();
+    out->pixels.assign(output->data(), output->data() + output->size_bytes());
+    return true;
+  };
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,63 @@
+// render_context.h
+#ifndef OVERLAY_RENDER_RENDER_CONTEXT_H_
+#define OVERLAY_RENDER_RENDER_CONTEXT_H_
+
+#include <cstddef>
+#include <memory>
+
+#include "overlay_core/font_cache.h"
+#include "overlay_core/line_cache.h"
+#include "overlay_core/line_prerenderer.h"
+#include "overlay_core/overlay_state.h"
+#include "overlay_core/render_thread.h"
+#include "overlay_render/font_lookup.h"
+
+namespace tono_overlay {
+
+// What the overlay windows of a process share: one render worker thread,
+// the FreeType fonts (with their glyph and advance caches) it draws with,
+// the cache of finished lines, and the fonts the main thread sizes windows
+// with. Another overlay then costs its state and frame buffers, not a
+// thread or a font. Created and used on the main thread; the overlays
+// keep it alive.
+class OverlayRenderContext {
+ public:
+  explicit OverlayRenderContext(
+      size_t font_capacity = FontCache::kDefaultCapacity);
+
+  OverlayRenderContext(const OverlayRenderContext&) = delete;
+  OverlayRenderContext& operator=(const OverlayRenderContext&) = delete;
+
+  // A render queue for one overlay on the shared worker. Frames come from
+  // the line cache, from recoloring the buffer's masks when only colors
+  // changed, or from rasterizing with the shared fonts.
+  std::unique_ptr<RenderThread> CreateRenderer(
+      RenderThread::FrameReadyFn frame_ready);
+
+  // Fonts for measuring on the main thread.
+  FontTextRenderer* measure() { return &measure_; }
+  LineCache* line_cache() { return &line_cache_; }
+  // Fonts opened by the render worker so far.
+  FontCacheStats render_font_stats() const {
+    return render_fonts_->cache_stats();
+  }
+
+ private:
+  FontTextRenderer measure_;
+  // Written by the render worker and by prerenderers, which the overlays
+  // destroy before this.
+  LineCache line_cache_;
+  // Only used on |worker_|.
+  std::shared_ptr<FontTextRenderer> render_fonts_;
+  std::shared_ptr<RenderWorker> worker_;
+};
+
+// Returns the function a LinePrerenderer uses to draw sheet lines with
+// |style| into w x h layers (wider strips for lines that scroll). Its
+// worker gets fonts and surfaces of its own.
+LinePrerenderer::RenderFn MakePrerenderFn(const OverlayStyle& style, int w,
+                                          int h);
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_RENDER_RENDER_CONTEXT_H_
@@ -0,0 +1,553 @@
+// gtk_overlay_test.cc
+//
+// Drives GtkOverlayWindow the way the lyrics channel of the Linux runner
+// does and reports, per call, how long the call took and how long until
+// its frame reached the screen (taken from the render thread, then
+// painted). Built inside the Flutter build, it also sends every channel
+// method, with good and bad arguments, through the runner's handler.
+// Needs a display; run it under xvfb-run on headless machines. Exits with
+// 77 when no display can be opened.
+#include <gtk/gtk.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "overlay_core/lrc_parser.h"
+#include "overlay_core/overlay_instance.h"
+#include "overlay_core/overlay_style_decoder.h"
+#include "overlay_render/gtk_overlay_window.h"
+#include "overlay_render/render_context.h"
+
+#ifdef TONO_OVERLAY_TEST_CHANNEL
+#include <flutter_linux/flutter_linux.h>
+
+#include <initializer_list>
+
+#include "lyrics_overlay.h"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using tono_overlay::GtkOverlayWindow;
+using tono_overlay::OverlayStyleUpdate;
+using tono_overlay::StyleValue;
+
+int g_failures = 0;
+
+#define EXPECT_TRUE(cond)                                                 \
+  do {                                                                    \
+    if (!(cond)) {                                                        \
+      std::fprintf(stderr, "%s:%d: EXPECT_TRUE(%s) failed\n", __FILE__,   \
+                   __LINE__, #cond);                                      \
+      ++g_failures;                                                       \
+    }                                                                     \
+  } while (0)
+
+double MsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// Runs the main loop until |done| holds or |timeout_ms| passed. Returns
+// whether |done| held.
+bool PumpUntil(const std::function<bool()>& done, int timeout_ms = 2000) {
+  const auto start = Clock::now();
+  while (!done()) {
+    if (MsSince(start) > timeout_ms) return false;
+    // Does not block, so a frame posted from the render thread is seen as
+    // soon as its idle callback is queued.
+    if (!g_main_context_iteration(nullptr, FALSE)) g_usleep(200);
+  }
+  return true;
+}
+
+// Runs |call| and waits for the frame it produced to be painted. With
+// |expect_frame| false, the call must not produce one.
+void Measure(GtkOverlayWindow* overlay, const char* name,
+             const std::function<void()>& call, bool expect_frame = true) {
+  const uint64_t acquired = overlay->frames_acquired();
+  const uint64_t painted = overlay->frames_painted();
+  const auto start = Clock::now();
+  call();
+  const double call_ms = MsSince(start);
+  if (!expect_frame) {
+    PumpUntil([] { return false; }, 50);
+    EXPECT_TRUE(overlay->frames_acquired() == acquired);
+    std::printf("%-24s %9.3f %11s %11s\n", name, call_ms, "-", "-");
+    return;
+  }
+  const bool got_frame =
+      PumpUntil([&] { return overlay->frames_acquired() > acquired; });
+  const double frame_ms = MsSince(start);
+  const bool got_paint =
+      got_frame &&
+      PumpUntil([&] { return overlay->frames_painted() > painted; });
+  const double paint_ms = MsSince(start);
+  if (!got_frame || !got_paint) {
+    std::fprintf(stderr, "%s: no %s\n", name, got_frame ? "paint" : "frame");
+    ++g_failures;
+    return;
+  }
+  std::printf("%-24s %9.3f %11.3f %11.3f\n", name, call_ms, frame_ms,
+              paint_ms);
+}
+
+OverlayStyleUpdate Decode(
+    const std::vector<std::pair<std::string, StyleValue>>& fields) {
+  OverlayStyleUpdate update;
+  std::string error;
+  for (const auto& field : fields) {
+    if (!update.Decode(field.first, field.second, &error)) {
+      std::fprintf(stderr, "decode %s: %s\n", field.first.c_str(),
+                   error.c_str());
+      ++g_failures;
+    }
+  }
+  return update;
+}
+
+#ifdef TONO_OVERLAY_TEST_CHANNEL
+// A map argument; takes the values.
+FlValue* Args(
+    std::initializer_list<std::pair<const char*, FlValue*>> entries) {
+  FlValue* map = fl_value_new_map();
+  for (const auto& entry : entries) {
+    fl_value_set_string_take(map, entry.first, entry.second);
+  }
+  return map;
+}
+
+FlValue* Str(const char* text) { return fl_value_new_string(text); }
+FlValue* Int(int64_t value) { return fl_value_new_int(value); }
+FlValue* Flag(bool value) { return fl_value_new_bool(value); }
+
+FlValue* Strings(std::initializer_list<const char*> texts) {
+  FlValue* list = fl_value_new_list();
+  for (const char* text : texts) fl_value_append_take(list, Str(text));
+  return list;
+}
+
+FlValue* Ints(std::initializer_list<int64_t> values) {
+  FlValue* list = fl_value_new_list();
+  for (int64_t value : values) fl_value_append_take(list, Int(value));
+  return list;
+}
+
+// Sends |method| with |args| (taken; may be null) through the channel
+// handler and returns a reference to the success result, or null after
+// counting a failure.
+FlValue* CallOk(const char* method, FlValue* args) {
+  g_autoptr(FlValue) owned = args;
+  g_autoptr(FlMethodResponse) response =
+      lyrics_overlay_handle_method(method, owned);
+  if (!FL_IS_METHOD_SUCCESS_RESPONSE(response)) {
+    std::fprintf(stderr, "%s: expected a success reply\n", method);
+    ++g_failures;
+    return nullptr;
+  }
+  return fl_value_ref(fl_method_success_response_get_result(
+      FL_METHOD_SUCCESS_RESPONSE(response)));
+}
+
+// Expects a success reply of |expected|.
+void ExpectBoolReply(const char* method, FlValue* args, bool expected) {
+  g_autoptr(FlValue) result = CallOk(method, args);
+  if (result && (fl_value_get_type(result) != FL_VALUE_TYPE_BOOL ||
+                 fl_value_get_bool(result) != expected)) {
+    std::fprintf(stderr, "%s: expected %s\n", method,
+                 expected ? "true" : "false");
+    ++g_failures;
+  }
+}
+
+// Expects an error reply |code| whose message starts with |message|.
+void ExpectError(const char* method, FlValue* args, const char* code,
+                 const std::string& message) {
+  g_autoptr(FlValue) owned = args;
+  g_autoptr(FlMethodResponse) response =
+      lyrics_overlay_handle_method(method, owned);
+  std::string got_code = "success";
+  std::string got_message;
+  if (FL_IS_METHOD_ERROR_RESPONSE(response)) {
+    FlMethodErrorResponse* error = FL_METHOD_ERROR_RESPONSE(response);
+    got_code = fl_method_error_response_get_code(error);
+    if (const gchar* text = fl_method_error_response_get_message(error)) {
+      got_message = text;
+    }
+  } else if (FL_IS_METHOD_NOT_IMPLEMENTED_RESPONSE(response)) {
+    got_code = "not_implemented";
+  }
+  if (got_code != code || got_message.rfind(message, 0) != 0) {
+    std::fprintf(stderr, "%s: expected %s \"%s\", got %s \"%s\"\n", method,
+                 code, message.c_str(), got_code.c_str(),
+                 got_message.c_str());
+    ++g_failures;
+  }
+}
+
+void ExpectBadArgs(const char* method, FlValue* args,
+                   const std::string& usage) {
+  ExpectError(method, args, "bad_args", usage);
+}
+
+// The overlays listLyricsWindows reports, as id -> created.
+std::vector<std::pair<int64_t, bool>> ListWindows() {
+  std::vector<std::pair<int64_t, bool>> windows;
+  g_autoptr(FlValue) list = CallOk("listLyricsWindows", nullptr);
+  if (!list || fl_value_get_type(list) != FL_VALUE_TYPE_LIST) return windows;
+  for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+    FlValue* entry = fl_value_get_list_value(list, i);
+    windows.emplace_back(
+        fl_value_get_int(fl_value_lookup_string(entry, "id")),
+        fl_value_get_bool(fl_value_lookup_string(entry, "created")));
+  }
+  return windows;
+}
+
+// One single-purpose style setter with arguments it takes and arguments it
+// rejects with its usage.
+struct SetterCase {
+  const char* method;
+  FlValue* (*good)();
+  FlValue* (*bad)();
+};
+
+const SetterCase kSetterCases[] = {
+    {"setOverlayWidth", [] { return Args({{"width", Int(600)}}); },
+     [] { return Args({{"width", Int(0)}}); }},
+    {"setOverlayLines", [] { return Args({{"lines", Int(2)}}); },
+     [] { return Args({{"lines", Str("two")}}); }},
+    // A single field also comes bare.
+    {"setLyricsFontFamily", [] { return Str("Sans"); },
+     [] { return Args({{"family", Str("")}}); }},
+    {"setLyricsFontSize", [] { return Args({{"fontSize", Int(24)}}); },
+     [] { return Args({{"fontSize", Int(-1)}}); }},
+    {"setLyricsFontWeight", [] { return Args({{"weight", Str("bold")}}); },
+     [] { return Args({{"weight", fl_value_new_list()}}); }},
+    {"setLyricsTextColor",
+     [] { return Args({{"textColor", Int(0xFFFFFF)}}); },
+     [] { return Args({{"textColor", Str("#GG0000")}}); }},
+    {"setLyricsHighlightColor",
+     [] { return Args({{"color", Str("#30A0FF")}}); },
+     [] { return Args({}); }},
+    {"setLyricsBold", [] { return Flag(true); },
+     [] { return Args({{"bold", Str("maybe")}}); }},
+    {"setLyricsPosition",
+     [] { return Args({{"x", Int(40)}, {"y", Int(60)}}); },
+     [] { return Args({{"x", Int(40)}}); }},
+    {"setOverlayOpacity", [] { return Args({{"alpha", Int(120)}}); },
+     [] { return Args({{"alpha", fl_value_new_list()}}); }},
+    // Several fields need the map.
+    {"setLyricsStroke",
+     [] { return Args({{"width", Int(2)}, {"color", Int(0)}}); },
+     [] { return Int(2); }},
+    {"setLyricsTextAlign", [] { return Args({{"align", Str("center")}}); },
+     [] { return Args({{"align", Str("middle")}}); }},
+    {"setLyricsTextOpacity", [] { return Args({{"alpha", Int(200)}}); },
+     [] { return Args({{"alpha", Int(-5)}}); }},
+    {"setLyricsTransition",
+     [] {
+       return Args({{"kind", Str("crossfade")}, {"durationMs", Int(80)}});
+     },
+     [] { return Args({{"kind", Str("spin")}, {"durationMs", Int(80)}}); }},
+    {"setLyricsMarquee",
+     [] {
+       return Args({{"enabled", Flag(false)},
+                    {"speed", Int(60)},
+                    {"pauseMs", Int(500)}});
+     },
+     [] {
+       return Args({{"enabled", Flag(false)},
+                    {"speed", Int(0)},
+                    {"pauseMs", Int(500)}});
+     }},
+};
+
+// Every method of the lyrics channel through the runner's handler, as the
+// method channel calls it, and every bad_args reply.
+void TestChannel(GtkWindow* main_window) {
+  lyrics_overlay_init(main_window);
+
+  ExpectBoolReply("setClickThrough", Args({{"enabled", Flag(true)}}), true);
+  ExpectBoolReply("setClickThrough", Flag(false), false);
+
+  ExpectBadArgs("createLyricsWindow", Args({{"id", Str("one")}}),
+                "Expected {id: int}");
+  ExpectBoolReply("createLyricsWindow", nullptr, true);
+  ExpectBoolReply("showLyricsWindow", nullptr, true);
+  ExpectBoolReply("hideLyricsWindow", nullptr, true);
+  ExpectBoolReply("showLyricsWindow", Args({{"id", Int(0)}}), true);
+
+  ExpectBoolReply("setLyricsText", Args({{"text", Str("hello")}}), true);
+  ExpectBadArgs("setLyricsText", Args({{"text", Int(1)}}),
+                "Expected {text: string}");
+  ExpectBadArgs("setLyricsText", nullptr, "Expected {text: string}");
+
+  // Style: the map form, then every setter.
+  ExpectBoolReply("applyOverlayStyle",
+                  Args({{"id", Int(0)},
+                        {"fontSize", Int(28)},
+                        {"textAlign", Str("left")}}),
+                  true);
+  ExpectBadArgs("applyOverlayStyle", nullptr,
+                "Expected a map of style fields");
+  {
+    FlValue* args = fl_value_new_map();
+    fl_value_set_take(args, Int(1), Int(1));
+    ExpectBadArgs("applyOverlayStyle", args,
+                  "Style field names must be strings");
+  }
+  ExpectBadArgs("applyOverlayStyle", Args({{"lines", fl_value_new_list()}}),
+                "lines: unsupported value type");
+  ExpectBadArgs("applyOverlayStyle", Args({{"lines", Int(0)}}),
+                "lines: expected");
+  ExpectBadArgs("applyOverlayStyle", Args({{"nope", Int(1)}}),
+                "unknown style field 'nope'");
+  for (const SetterCase& setter : kSetterCases) {
+    const tono_overlay::StyleSetter* spec =
+        tono_overlay::FindStyleSetter(setter.method);
+    EXPECT_TRUE(spec != nullptr);
+    if (!spec) continue;
+    ExpectBoolReply(setter.method, setter.good(), true);
+    ExpectBadArgs(setter.method, setter.bad(), spec->usage);
+  }
+  ExpectBoolReply("setLyricsFontSize", Int(26), true);
+
+  ExpectBoolReply("setOverlayClickThrough", Args({{"enabled", Flag(true)}}),
+                  true);
+  ExpectBoolReply("setOverlayClickThrough", Args({{"enabled", Flag(false)}}),
+                  false);
+
+  // A sheet as raw LRC, or as parsed lines in a list or a typed list.
+  const std::string sheet_usage = "Expected {lrc: String} or {times: ";
+  ExpectBoolReply("setLyricsSheet",
+                  Args({{"lrc", Str("[00:00.00]one\n[00:01.00]two\n")},
+                        {"lookahead", Int(2)}}),
+                  true);
+  ExpectBoolReply("setLyricsSheet",
+                  Args({{"times", Ints({0, 1000})},
+                        {"texts", Strings({"one", "two"})}}),
+                  true);
+  {
+    const int32_t times[] = {0, 1000};
+    ExpectBoolReply("setLyricsSheet",
+                    Args({{"times", fl_value_new_int32_list(times, 2)},
+                          {"texts", Strings({"one", "two"})}}),
+                    true);
+  }
+  ExpectBadArgs("setLyricsSheet", nullptr, sheet_usage);
+  ExpectBadArgs("setLyricsSheet", Args({{"lrc", Int(1)}}), sheet_usage);
+  ExpectBadArgs("setLyricsSheet",
+                Args({{"times", Ints({0})}, {"texts", Strings({"a", "b"})}}),
+                sheet_usage);
+  ExpectBadArgs("setLyricsSheet",
+                Args({{"times", Ints({0})}, {"texts", Ints({1})}}),
+                sheet_usage);
+  ExpectBadArgs("setLyricsSheet",
+                Args({{"times", Str("0")}, {"texts", Strings({"a"})}}),
+                sheet_usage);
+
+  const std::string playback_usage = "Expected {positionMs: int>=0, ";
+  ExpectBoolReply("setLyricsPlayback",
+                  Args({{"positionMs", Int(0)},
+                        {"playing", Flag(true)},
+                        {"rate", fl_value_new_float(1.0)}}),
+                  true);
+  ExpectBadArgs("setLyricsPlayback",
+                Args({{"positionMs", Int(-1)}, {"playing", Flag(true)}}),
+                playback_usage);
+  ExpectBadArgs("setLyricsPlayback", Args({{"positionMs", Int(0)}}),
+                playback_usage);
+  ExpectBadArgs("setLyricsPlayback",
+                Args({{"positionMs", Int(0)},
+                      {"playing", Flag(true)},
+                      {"rate", fl_value_new_float(0.0)}}),
+                playback_usage);
+
+  // Process-wide calls.
+  {
+    g_autoptr(FlValue) stats = CallOk("getOverlayCacheStats", nullptr);
+    EXPECT_TRUE(stats && fl_value_lookup_string(stats, "entries") &&
+                fl_value_lookup_string(stats, "budgetBytes"));
+  }
+  {
+    g_autoptr(FlValue) stats =
+        CallOk("getOverlayStats", Args({{"reset", Flag(true)}}));
+    EXPECT_TRUE(stats && fl_value_get_type(stats) == FL_VALUE_TYPE_MAP &&
+                fl_value_get_length(stats) > 0);
+  }
+  ExpectBoolReply("setOverlayCacheBudget", Args({{"bytes", Int(1 << 20)}}),
+                  true);
+  ExpectBadArgs("setOverlayCacheBudget", Args({{"bytes", Int(-1)}}),
+                "Expected {bytes: int>=0}");
+  ExpectBadArgs("setOverlayCacheBudget", nullptr, "Expected {bytes: int>=0}");
+
+  // Other overlays by id; the default one outlives its window.
+  ExpectBoolReply("createLyricsWindow", Args({{"id", Int(3)}}), true);
+  EXPECT_TRUE((ListWindows() ==
+               std::vector<std::pair<int64_t, bool>>{{0, true}, {3, true}}));
+  ExpectBoolReply("destroyLyricsWindow", Args({{"id", Int(3)}}), true);
+  ExpectBoolReply("destroyLyricsWindow", nullptr, true);
+  EXPECT_TRUE(
+      (ListWindows() == std::vector<std::pair<int64_t, bool>>{{0, false}}));
+
+  ExpectError("setLyricsBogus", nullptr, "not_implemented", "");
+}
+#endif
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (!gtk_init_check(&argc, &argv)) {
+    std::printf("skipped: cannot open a display\n");
+    return 77;
+  }
+
+  GtkOverlayWindow overlay;
+  std::printf("%-24s %9s %11s %11s\n", "call", "return ms", "frame ms",
+              "painted ms");
+  Measure(&overlay, "createLyricsWindow", [&] {
+    EXPECT_TRUE(overlay.Create());
+  });
+  EXPECT_TRUE(overlay.created());
+  Measure(&overlay, "setLyricsText", [&] { overlay.SetText("Hello, world"); });
+  // Identical text is not redrawn.
+  Measure(&overlay, "setLyricsText (same)",
+          [&] { overlay.SetText("Hello, world"); }, false);
+  Measure(&overlay, "setLyricsTextColor", [&] {
+    overlay.ApplyStyle(Decode({{"textColor", StyleValue::Number(0xFF2020)}}));
+  });
+  Measure(&overlay, "setLyricsFontSize", [&] {
+    overlay.ApplyStyle(Decode({{"fontSize", StyleValue::Number(32)}}));
+  });
+  Measure(&overlay, "setLyricsStroke", [&] {
+    overlay.ApplyStyle(Decode({{"strokeWidth", StyleValue::Number(2)},
+                               {"strokeColor", StyleValue::Number(0)}}));
+  });
+  Measure(&overlay, "setOverlayWidth", [&] {
+    overlay.ApplyStyle(Decode({{"width", StyleValue::Number(640)}}));
+  });
+  Measure(&overlay, "applyOverlayStyle", [&] {
+    overlay.ApplyStyle(Decode({{"lines", StyleValue::Number(2)},
+                               {"fontWeight", StyleValue::Number(700)},
+                               {"textAlign", StyleValue::String("center")}}));
+  });
+  EXPECT_TRUE(overlay.style().width == 640 && overlay.style().lines == 2);
+  // Moving only moves the window.
+  Measure(&overlay, "setLyricsPosition", [&] {
+    overlay.ApplyStyle(Decode({{"x", StyleValue::Number(40)},
+                               {"y", StyleValue::Number(60)}}));
+  }, false);
+  // The background plate is composited under the text: a new frame from
+  // the masks already drawn.
+  Measure(&overlay, "setOverlayOpacity", [&] {
+    overlay.ApplyStyle(Decode({{"backgroundAlpha", StyleValue::Number(40)},
+                               {"cornerRadius", StyleValue::Number(8)}}));
+  });
+  EXPECT_TRUE(overlay.SetClickThrough(true));
+  EXPECT_TRUE(!overlay.SetClickThrough(false));
+
+  // A sheet advances on its own from the playback anchor: the second line
+  // starts 20 ms into the song.
+  Measure(&overlay, "setLyricsSheet", [&] {
+    tono_overlay::LrcParser parser;
+    overlay.SetSheet(parser.Parse("[00:00.00]first line\n"
+                                  "[00:00.02]second line\n"
+                                  "[00:05.00]third\n"),
+                     2);
+    overlay.SetPlayback(0, true, 1.0);
+  });
+  EXPECT_TRUE(PumpUntil([&] { return overlay.text() == "second line"; }));
+  // Lines the prerenderer drew ahead come from the cache.
+  EXPECT_TRUE(PumpUntil([&] { return overlay.cache_stats().entries >= 2; }));
+
+  // A new line slides in over a few frame clock ticks, blended from the
+  // two line bitmaps, and then shows on its own.
+  overlay.ApplyStyle(Decode({{"transition", StyleValue::String("slideUp")},
+                             {"transitionMs", StyleValue::Number(120)}}));
+  const uint64_t blended = overlay.transition_frames();
+  overlay.SetText("a new line");
+  EXPECT_TRUE(
+      PumpUntil([&] { return overlay.transition_frames() > blended; }));
+  EXPECT_TRUE(PumpUntil([&] { return !overlay.transition_active(); }));
+
+  // A single line too long for the window scrolls: the strip is drawn
+  // once, and the tick callback moves the window through it.
+  Measure(&overlay, "applyOverlayStyle (marquee)", [&] {
+    overlay.ApplyStyle(Decode({{"lines", StyleValue::Number(1)},
+                               {"marquee", StyleValue::Bool(true)},
+                               {"marqueeSpeed", StyleValue::Number(2000)},
+                               {"marqueePauseMs", StyleValue::Number(0)}}));
+  });
+  overlay.SetText("a line far too long to fit into a window of this width, "
+                  "so it has to scroll from one end to the other");
+  EXPECT_TRUE(PumpUntil([&] { return overlay.marquee_active(); }));
+  const uint64_t scrolled = overlay.marquee_frames();
+  const uint64_t acquired = overlay.frames_acquired();
+  EXPECT_TRUE(
+      PumpUntil([&] { return overlay.marquee_frames() > scrolled + 2; }));
+  EXPECT_TRUE(overlay.frames_acquired() == acquired);
+  overlay.SetText("short");
+  EXPECT_TRUE(PumpUntil([&] { return !overlay.marquee_active(); }));
+
+  overlay.Hide();
+  Measure(&overlay, "showLyricsWindow",
+          [&] { EXPECT_TRUE(overlay.Show()); }, false);
+  overlay.Destroy();
+  EXPECT_TRUE(!overlay.created());
+  // Recreating keeps the text and the style.
+  Measure(&overlay, "createLyricsWindow (again)", [&] {
+    EXPECT_TRUE(overlay.Create());
+  });
+  overlay.Destroy();
+
+  // Many windows on one context, as the runner keeps them by id: each
+  // shows its own line and style, and destroying some leaves the rest
+  // drawing.
+  {
+    auto context = std::make_shared<tono_overlay::OverlayRenderContext>();
+    tono_overlay::OverlayRegistry<GtkOverlayWindow> windows(
+        [&](tono_overlay::OverlayId) {
+          return std::make_unique<GtkOverlayWindow>(context);
+        });
+    constexpr int kWindows = 8;
+    for (int id = 0; id < kWindows; ++id) {
+      GtkOverlayWindow* window = windows.Get(id);
+      EXPECT_TRUE(window != nullptr && window->Create());
+      window->ApplyStyle(Decode({{"y", StyleValue::Number(80 * id)},
+                                 {"fontSize", StyleValue::Number(16 + id)}}));
+      Measure(window, "setLyricsText (window)",
+              [&] { window->SetText("window " + std::to_string(id)); });
+    }
+    EXPECT_TRUE(windows.size() == (size_t)kWindows);
+    for (int id = 0; id < kWindows; id += 2) EXPECT_TRUE(windows.Remove(id));
+    for (int id = 1; id < kWindows; id += 2) {
+      GtkOverlayWindow* window = windows.Find(id);
+      EXPECT_TRUE(window->text() == "window " + std::to_string(id));
+      Measure(window, "setLyricsText (kept)",
+              [&] { window->SetText("still here"); });
+    }
+  }
+
+#ifdef TONO_OVERLAY_TEST_CHANNEL
+  GtkWidget* main_window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+  TestChannel(GTK_WINDOW(main_window));
+#endif
+
+  const tono_overlay::LineCacheStats cache = overlay.cache_stats();
+  std::printf("cache: hits=%llu misses=%llu entries=%zu\n",
+              (unsigned long long)cache.hits,
+              (unsigned long long)cache.misses, cache.entries);
+  if (g_failures) {
+    std::fprintf(stderr, "%d failure(s)\n", g_failures);
+    return 1;
+  }
+  std::printf("all tests passed\n");
+  return 0;
+}
@@ -0,0 +1,456 @@
+// overlay_render_test.cc
+//
+// Headless tests of the text pipeline with the FreeType backend: layout,
+// stroke and determinism, rendered into OffscreenTarget frames.
+//
+//   overlay_render_test <font file>
+//
+// With TONO_OVERLAY_GOLDEN_DIR set, every case is also compared with
+// <dir>/<case>.pam; missing goldens are written, and
+// TONO_OVERLAY_UPDATE_GOLDENS=1 rewrites all of them. Goldens are only
+// meaningful for the font file and FreeType version that produced them.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "overlay_core/marquee.h"
+#include "overlay_core/offscreen_target.h"
+#include "overlay_core/overlay_instance.h"
+#include "overlay_core/render_thread.h"
+#include "overlay_render/font_lookup.h"
+#include "overlay_render/freetype_rasterizer.h"
+#include "overlay_render/render_context.h"
+
+namespace {
+
+int g_failures = 0;
+std::string g_font;
+
+#define EXPECT_TRUE(cond)                                                 \
+  do {                                                                    \
+    if (!(cond)) {                                                        \
+      std::fprintf(stderr, "%s:%d: EXPECT_TRUE(%s) failed\n", __FILE__,   \
+                   __LINE__, #cond);                                      \
+      ++g_failures;                                                       \
+    }                                                                     \
+  } while (0)
+
+#define EXPECT_EQ(a, b)                                                   \
+  do {                                                                    \
+    if (!((a) == (b))) {                                                  \
+      std::fprintf(stderr, "%s:%d: EXPECT_EQ(%s, %s) failed\n", __FILE__, \
+                   __LINE__, #a, #b);                                     \
+      ++g_failures;                                                       \
+    }                                                                     \
+  } while (0)
+
+// Box around the pixels with any alpha; empty (right < left) if none.
+struct Bounds {
+  int left = 1 << 30;
+  int top = 1 << 30;
+  int right = -1;
+  int bottom = -1;
+  int pixels = 0;
+};
+
+Bounds InkBounds(const tono_overlay::Surface& frame) {
+  Bounds b;
+  for (int y = 0; y < frame.height(); ++y) {
+    const uint8_t* row = frame.data() + (size_t)y * frame.stride();
+    for (int x = 0; x < frame.width(); ++x) {
+      if (row[x * 4 + 3] == 0) continue;
+      b.left = std::min(b.left, x);
+      b.right = std::max(b.right, x);
+      b.top = std::min(b.top, y);
+      b.bottom = std::max(b.bottom, y);
+      ++b.pixels;
+    }
+  }
+  return b;
+}
+
+tono_overlay::OverlayStyle BaseStyle() {
+  tono_overlay::OverlayStyle style;
+  style.font_size = 20;
+  style.padding = 8;
+  style.text_color = 0xFFFFFF;
+  // Ink only: no background plate under it.
+  style.background_alpha = 0;
+  return style;
+}
+
+// Compares |target|'s frame with the golden image of |name|, if enabled.
+void CheckGolden(const char* name,
+                 const tono_overlay::OffscreenTarget& target) {
+  const char* dir = std::getenv("TONO_OVERLAY_GOLDEN_DIR");
+  if (!dir || !*dir || !target.frame()) return;
+  const std::string path = std::string(dir) + "/" + name + ".pam";
+  const char* update = std::getenv("TONO_OVERLAY_UPDATE_GOLDENS");
+  int w = 0, h = 0;
+  std::vector<uint8_t> golden;
+  if ((update && std::string(update) == "1") ||
+      !tono_overlay::ReadPam(path, &w, &h, &golden)) {
+    EXPECT_TRUE(tono_overlay::WritePam(*target.frame(), target.pixel_format(),
+                                       path));
+    std::printf("wrote golden %s\n", path.c_str());
+    return;
+  }
+  const bool same =
+      w == target.frame()->width() && h == target.frame()->height() &&
+      golden == tono_overlay::SurfaceToRgba(*target.frame(),
+                                            target.pixel_format());
+  if (!same) std::fprintf(stderr, "golden mismatch: %s\n", path.c_str());
+  EXPECT_TRUE(same);
+}
+
+void TestLayoutFollowsStyle() {
+  tono_overlay::FreeTypeRasterizer rasterizer(g_font);
+  tono_overlay::OffscreenTarget target(&rasterizer);
+  tono_overlay::OverlayStyle style = BaseStyle();
+  const int w = 400, h = 48;
+
+  const tono_overlay::Surface* frame = target.Render("Hello", style, w, h);
+  EXPECT_TRUE(frame != nullptr);
+  if (!frame) return;
+  const Bounds left = InkBounds(*frame);
+  EXPECT_TRUE(left.pixels > 0);
+  // Left-aligned ink starts right after the padding (plus side bearing).
+  EXPECT_TRUE(left.left >= 8 && left.left <= 12);
+  // Centered vertically.
+  EXPECT_TRUE(std::abs((left.top + left.bottom) - h) <= 8);
+  CheckGolden("hello_left", target);
+
+  style.text_align = 2;
+  const Bounds right = InkBounds(*target.Render("Hello", style, w, h));
+  EXPECT_TRUE(right.right <= w - 8 - 1 && right.right >= w - 8 - 5);
+  EXPECT_EQ(right.pixels, left.pixels);
+
+  style.text_align = 1;
+  const Bounds center = InkBounds(*target.Render("Hello", style, w, h));
+  EXPECT_TRUE(std::abs((center.left + center.right) - w) <= 4);
+
+  // Too long for one line: cut to the padded box with an ellipsis.
+  style.text_align = 0;
+  const std::string long_text(200, 'W');
+  const Bounds cut = InkBounds(*target.Render(long_text, style, w, h));
+  EXPECT_TRUE(cut.left >= 8 && cut.right < w - 8);
+  CheckGolden("ellipsis", target);
+
+  // Two lines wrap at the space and use two bands.
+  style.lines = 2;
+  const Bounds one_line =
+      InkBounds(*target.Render("Lyrics", style, w, 2 * h));
+  const Bounds two_lines = InkBounds(
+      *target.Render("Lyrics " + std::string(60, 'm'), style, w, 2 * h));
+  EXPECT_TRUE(two_lines.bottom - two_lines.top >
+              (one_line.bottom - one_line.top) * 3 / 2);
+  EXPECT_TRUE(two_lines.top >= 8 && two_lines.bottom < 2 * h - 8);
+  CheckGolden("wrapped", target);
+}
+
+void TestStrokeAndWeightAddInk() {
+  tono_overlay::FreeTypeRasterizer rasterizer(g_font);
+  tono_overlay::OffscreenTarget target(&rasterizer);
+  tono_overlay::OverlayStyle style = BaseStyle();
+  auto ink = [&] {
+    return InkBounds(*target.Render("Stroke", style, 300, 48)).pixels;
+  };
+  const int plain = ink();
+
+  style.font_weight = 700;
+  EXPECT_TRUE(ink() > plain);
+
+  style.font_weight = 400;
+  style.stroke_width = 3;
+  style.stroke_color = 0x000000;
+  EXPECT_TRUE(ink() > plain * 2);
+  CheckGolden("stroke3", target);
+}
+
+void TestOutputIsDeterministic() {
+  tono_overlay::OverlayStyle style = BaseStyle();
+  style.stroke_width = 2;
+  style.text_color = 0x40C0FF;
+  style.text_align = 1;
+  const std::string text = "Deterministic \xE2\x80\x94 AV To Wa";
+
+  tono_overlay::FreeTypeRasterizer a(g_font);
+  tono_overlay::OffscreenTarget first(&a);
+  first.Render(text, style, 360, 48);
+  const uint64_t digest = first.Digest();
+  EXPECT_TRUE(digest != 0);
+
+  // Same target after rendering something else.
+  first.Render("other", style, 200, 30);
+  first.Render(text, style, 360, 48);
+  EXPECT_EQ(first.Digest(), digest);
+
+  // A fresh rasterizer on another thread.
+  uint64_t other_digest = 0;
+  std::thread([&] {
+    tono_overlay::FreeTypeRasterizer b(g_font);
+    tono_overlay::OffscreenTarget second(&b);
+    second.Render(text, style, 360, 48);
+    other_digest = second.Digest();
+  }).join();
+  EXPECT_EQ(other_digest, digest);
+
+  // A color change only recomposites but gives the same pixels as a full
+  // render with that color.
+  tono_overlay::FreeTypeRasterizer c(g_font);
+  tono_overlay::TextLayerPipeline pipeline(&c);
+  auto surfaces = pipeline.CreateSurfaces();
+  pipeline.Render(text, style, 360, 48, surfaces.get());
+  style.text_color = 0xFF2020;
+  tono_overlay::Surface* recolored =
+      pipeline.Recomposite(style, surfaces.get());
+  first.Render(text, style, 360, 48);
+  EXPECT_TRUE(recolored != nullptr &&
+              std::equal(recolored->data(),
+                         recolored->data() + recolored->size_bytes(),
+                         first.frame()->data()));
+}
+
+void TestFontLookupFollowsStyle() {
+  // Machines without fontconfig data have nothing to find.
+  const std::string regular = tono_overlay::FindFontFile("", 400);
+  if (regular.empty()) {
+    std::printf("font lookup: no fonts configured, skipped\n");
+    return;
+  }
+  EXPECT_TRUE(tono_overlay::FreeTypeRasterizer(regular).ok());
+
+  tono_overlay::FontTextRenderer fonts;
+  tono_overlay::OverlayStyle style;
+  style.font_family = "";
+  EXPECT_TRUE(fonts.Ensure(style));
+  EXPECT_EQ(fonts.font_path(), regular);
+  tono_overlay::TextLayerPipeline* pipeline = fonts.pipeline();
+  EXPECT_TRUE(pipeline != nullptr);
+  // Another size is another font instance; the pipeline is kept.
+  tono_overlay::FreeTypeRasterizer* small = fonts.rasterizer();
+  style.font_size = 30;
+  EXPECT_TRUE(fonts.Ensure(style));
+  EXPECT_TRUE(fonts.pipeline() == pipeline);
+  EXPECT_TRUE(fonts.rasterizer() != small);
+  EXPECT_TRUE(fonts.metrics().line_height >= 30);
+  EXPECT_EQ(fonts.metrics().line_height,
+            fonts.rasterizer()->LineHeight(style));
+
+  // Bold asks for at least 700; the renderer follows it.
+  style.font_bold = true;
+  EXPECT_TRUE(fonts.Ensure(style));
+  EXPECT_EQ(fonts.font_path(), tono_overlay::FindFontFile("", 700));
+  auto surfaces = fonts.pipeline()->CreateSurfaces();
+  tono_overlay::Surface* output =
+      fonts.pipeline()->Render("Bold", style, 200, 48, surfaces.get());
+  EXPECT_TRUE(output != nullptr && InkBounds(*output).pixels > 0);
+}
+
+void TestFontCacheSwitchesPresets() {
+  if (tono_overlay::FindFontFile("", 400).empty()) {
+    std::printf("font cache: no fonts configured, skipped\n");
+    return;
+  }
+  tono_overlay::FontTextRenderer fonts(/*font_capacity=*/2);
+  tono_overlay::OverlayStyle karaoke;
+  karaoke.font_size = 36;
+  karaoke.font_bold = true;
+  tono_overlay::OverlayStyle minimal;
+  minimal.font_size = 18;
+
+  // Alternating presets opens each font once.
+  EXPECT_TRUE(fonts.Ensure(karaoke));
+  tono_overlay::FreeTypeRasterizer* karaoke_font = fonts.rasterizer();
+  const int karaoke_height = fonts.metrics().line_height;
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_TRUE(fonts.Ensure(minimal));
+    EXPECT_TRUE(fonts.metrics().line_height < karaoke_height);
+    EXPECT_TRUE(fonts.Ensure(karaoke));
+    EXPECT_TRUE(fonts.rasterizer() == karaoke_font);
+  }
+  tono_overlay::FontCacheStats stats = fonts.cache_stats();
+  EXPECT_EQ(stats.misses, (uint64_t)2);
+  EXPECT_EQ(stats.hits, (uint64_t)9);
+  EXPECT_EQ(stats.evictions, (uint64_t)0);
+
+  // A third preset evicts the least recently used one, which is then
+  // opened again.
+  tono_overlay::OverlayStyle large = minimal;
+  large.font_size = 48;
+  EXPECT_TRUE(fonts.Ensure(large));
+  EXPECT_TRUE(fonts.Ensure(karaoke));
+  EXPECT_TRUE(fonts.rasterizer() == karaoke_font);
+  EXPECT_TRUE(fonts.Ensure(minimal));
+  stats = fonts.cache_stats();
+  EXPECT_EQ(stats.misses, (uint64_t)4);
+  EXPECT_EQ(stats.evictions, (uint64_t)2);
+  EXPECT_EQ(stats.entries, (size_t)2);
+
+  // A reopened font draws like the first one.
+  auto surfaces = fonts.pipeline()->CreateSurfaces();
+  tono_overlay::Surface* output =
+      fonts.pipeline()->Render("Preset", minimal, 200, 48, surfaces.get());
+  EXPECT_TRUE(output != nullptr && InkBounds(*output).pixels > 0);
+}
+
+void TestMarqueeStripHoldsWholeLine() {
+  tono_overlay::FreeTypeRasterizer rasterizer(g_font);
+  tono_overlay::OffscreenTarget target(&rasterizer);
+  tono_overlay::OverlayStyle style = BaseStyle();
+  style.marquee = true;
+  const int w = 240, h = 48;
+  const std::string short_text = "Hello";
+  const std::string long_text(60, 'W');
+
+  const int hello = rasterizer.MeasureLine(short_text, style);
+  EXPECT_TRUE(hello > 0 && hello < w);
+  EXPECT_EQ(tono_overlay::MarqueeStripWidth(&rasterizer, short_text, style, w),
+            w);
+  const int strip_w =
+      tono_overlay::MarqueeStripWidth(&rasterizer, long_text, style, w);
+  EXPECT_EQ(strip_w, rasterizer.MeasureLine(long_text, style) + 16);
+
+  // The whole line, uncut: ink runs to the strip's far padding.
+  const tono_overlay::Surface* strip = target.Render(
+      long_text, tono_overlay::MarqueeStripStyle(style), strip_w, h);
+  EXPECT_TRUE(strip != nullptr);
+  if (!strip) return;
+  const Bounds ink = InkBounds(*strip);
+  EXPECT_TRUE(ink.left >= 8 && ink.left <= 12);
+  EXPECT_TRUE(ink.right < strip_w - 8 && ink.right >= strip_w - 8 - 5);
+}
+
+// One overlay instance as the runners keep it, minus the window: its
+// render queue on the shared context.
+struct HeadlessOverlay {
+  std::unique_ptr<tono_overlay::RenderThread> renderer;
+  tono_overlay::OverlayStyle style;
+
+  void Post(const std::string& text) {
+    tono_overlay::RenderSnapshot snapshot;
+    snapshot.text = text;
+    snapshot.style = style;
+    snapshot.width = 240;
+    snapshot.height = 40;
+    renderer->Post(std::move(snapshot));
+  }
+  // The newest finished frame after the worker went idle, or null.
+  const tono_overlay::Surface* Frame(const std::string& text) {
+    renderer->WaitIdle();
+    tono_overlay::RenderBuffer* frame = renderer->AcquireFrame();
+    if (!frame || frame->snapshot->text != text) return nullptr;
+    return frame->surfaces->surface(tono_overlay::kTextLayerOutput);
+  }
+};
+
+void TestManyOverlaysShareContext() {
+  using tono_overlay::OverlayId;
+  if (tono_overlay::FindFontFile("", 400).empty()) {
+    std::printf("overlay instances: no fonts configured, skipped\n");
+    return;
+  }
+  auto context = std::make_shared<tono_overlay::OverlayRenderContext>();
+  // Original lyrics in even windows, translations in odd ones.
+  tono_overlay::OverlayStyle original = BaseStyle();
+  original.font_size = 22;
+  tono_overlay::OverlayStyle translated = BaseStyle();
+  translated.font_size = 16;
+  translated.text_color = 0xC0C0C0;
+  tono_overlay::OverlayRegistry<HeadlessOverlay> overlays(
+      [&](OverlayId id) {
+        auto overlay = std::make_unique<HeadlessOverlay>();
+        overlay->renderer = context->CreateRenderer(nullptr);
+        overlay->style = id % 2 ? translated : original;
+        return overlay;
+      },
+      /*max_instances=*/32);
+
+  // Creating: each draws its own line, all on the one worker with the
+  // fonts opened once per style.
+  constexpr int kOverlays = 24;
+  for (OverlayId id = 0; id < kOverlays; ++id) {
+    HeadlessOverlay* overlay = overlays.Get(id);
+    EXPECT_TRUE(overlay != nullptr);
+    if (overlay) overlay->Post("line " + std::to_string(id));
+  }
+  EXPECT_EQ(overlays.size(), (size_t)kOverlays);
+  for (OverlayId id = 0; id < kOverlays; ++id) {
+    const tono_overlay::Surface* frame =
+        overlays.Find(id)->Frame("line " + std::to_string(id));
+    EXPECT_TRUE(frame != nullptr && InkBounds(*frame).pixels > 0);
+  }
+  EXPECT_EQ(context->render_font_stats().misses, (uint64_t)2);
+
+  // Updating: the same line in every window is rasterized once per style;
+  // the rest copy it from the shared line cache.
+  const uint64_t hits = context->line_cache()->stats().hits;
+  for (OverlayId id = 0; id < kOverlays; ++id) {
+    overlays.Find(id)->Post("chorus");
+  }
+  const tono_overlay::Surface* first = overlays.Find(0)->Frame("chorus");
+  EXPECT_TRUE(first != nullptr);
+  for (OverlayId id = 1; id < kOverlays; ++id) {
+    const tono_overlay::Surface* frame = overlays.Find(id)->Frame("chorus");
+    EXPECT_TRUE(frame != nullptr);
+    if (!frame || !first || id % 2) continue;
+    EXPECT_TRUE(std::equal(frame->data(), frame->data() + frame->size_bytes(),
+                           first->data()));
+  }
+  EXPECT_EQ(context->line_cache()->stats().hits - hits,
+            (uint64_t)(kOverlays - 2));
+
+  // Destroying: half go away with renders still queued; the others keep
+  // drawing, and new instances reuse the fonts.
+  for (OverlayId id = 0; id < kOverlays; ++id) {
+    overlays.Find(id)->Post("outro " + std::to_string(id));
+  }
+  for (OverlayId id = 0; id < kOverlays; id += 2) {
+    EXPECT_TRUE(overlays.Remove(id));
+  }
+  EXPECT_EQ(overlays.size(), (size_t)(kOverlays / 2));
+  for (OverlayId id = 1; id < kOverlays; id += 2) {
+    const tono_overlay::Surface* frame =
+        overlays.Find(id)->Frame("outro " + std::to_string(id));
+    EXPECT_TRUE(frame != nullptr && InkBounds(*frame).pixels > 0);
+  }
+  for (OverlayId id = 100; id < 100 + kOverlays / 2; ++id) {
+    HeadlessOverlay* overlay = overlays.Get(id);
+    EXPECT_TRUE(overlay != nullptr);
+    if (!overlay) continue;
+    overlay->Post("again");
+    EXPECT_TRUE(overlay->Frame("again") != nullptr);
+  }
+  EXPECT_EQ(overlays.size(), (size_t)kOverlays);
+  EXPECT_EQ(context->render_font_stats().misses, (uint64_t)2);
+  while (!overlays.ids().empty()) overlays.Remove(overlays.ids().front());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  g_font = argc > 1 ? argv[1] : "";
+  tono_overlay::FreeTypeRasterizer probe(g_font);
+  if (!probe.ok()) {
+    std::printf("skipped: no usable font (%s)\n", probe.error().c_str());
+    return 77;
+  }
+  TestLayoutFollowsStyle();
+  TestStrokeAndWeightAddInk();
+  TestOutputIsDeterministic();
+  TestFontLookupFollowsStyle();
+  TestFontCacheSwitchesPresets();
+  TestMarqueeStripHoldsWholeLine();
+  TestManyOverlaysShareContext();
+  if (g_failures) {
+    std::fprintf(stderr, "%d failure(s)\n", g_failures);
+    return 1;
+  }
+  std::printf("all tests passed\n");
+  return 0;
+}
@@ -0,0 +1,517 @@
+#include "lyrics_overlay.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "overlay_core/lrc_parser.h"
+#include "overlay_core/overlay_api.h"
+#include "overlay_core/overlay_instance.h"
+#include "overlay_core/overlay_log.h"
+#include "overlay_core/overlay_stats.h"
+#include "overlay_core/overlay_style_decoder.h"
+#include "overlay_core/overlay_trace.h"
+#include "overlay_render/gtk_overlay_window.h"
+#include "overlay_render/render_context.h"
+
+namespace {
+
+using tono_overlay::GtkOverlayWindow;
+using tono_overlay::OverlayId;
+
+// The overlays by id and the main window, all owned by the GTK main
+// thread. Every overlay shares lyrics_context, which the registry's
+// factory keeps alive.
+tono_overlay::OverlayRenderContext* lyrics_context = nullptr;
+tono_overlay::OverlayRegistry<GtkOverlayWindow>* lyrics_overlays = nullptr;
+GtkWindow* lyrics_main_window = nullptr;
+FlMethodChannel* lyrics_channel = nullptr;
+
+gboolean drain_overlay_api_cb(gpointer) {
+  tono_overlay::DrainOverlayApi();
+  return G_SOURCE_REMOVE;
+}
+
+// Target of the dart:ffi calls in tono_overlay_api.h, which address the
+// default overlay; the channel handlers below call the same methods.
+class LyricsOverlayApiHost : public tono_overlay::OverlayApiHost {
+ public:
+  bool OnHostThread() const override {
+    return g_main_context_is_owner(g_main_context_default());
+  }
+  void Wake() override {
+    g_idle_add_full(G_PRIORITY_HIGH_IDLE, drain_overlay_api_cb, nullptr,
+                    nullptr);
+  }
+  void SetText(const std::string& utf8) override {
+    if (GtkOverlayWindow* overlay = default_overlay()) overlay->SetText(utf8);
+  }
+  void ApplyStyle(const tono_overlay::OverlayStyleUpdate& update) override {
+    if (GtkOverlayWindow* overlay = default_overlay()) {
+      overlay->ApplyStyle(update);
+    }
+  }
+  void SetSheet(const std::vector<tono_overlay::LrcLine>& lines) override {
+    if (GtkOverlayWindow* overlay = default_overlay()) {
+      overlay->SetSheet(lines, -1);
+    }
+  }
+  void SetPlayback(int64_t position_ms, bool playing, double rate) override {
+    if (GtkOverlayWindow* overlay = default_overlay()) {
+      overlay->SetPlayback(position_ms, playing, rate);
+    }
+  }
+
+ private:
+  static GtkOverlayWindow* default_overlay() {
+    return lyrics_overlays->Get(tono_overlay::kDefaultOverlayId);
+  }
+};
+
+LyricsOverlayApiHost* lyrics_api_host = nullptr;
+// Parses setLyricsSheet's {lrc}; its storage is reused from song to song.
+tono_overlay::LrcParser* lyrics_lrc_parser = nullptr;
+
+// Looks up |key| in a map argument; null if |args| is not a map or lacks it.
+FlValue* lookup_arg(FlValue* args, const char* key) {
+  if (!args || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) return nullptr;
+  return fl_value_lookup_string(args, key);
+}
+
+// Dart sends native numbers and flags; the string forms older builds sent
+// are accepted too.
+bool parse_int(FlValue* v, int64_t* out) {
+  if (!v) return false;
+  switch (fl_value_get_type(v)) {
+    case FL_VALUE_TYPE_INT:
+      *out = fl_value_get_int(v);
+      return true;
+    case FL_VALUE_TYPE_FLOAT:
+      *out = (int64_t)std::llround(fl_value_get_float(v));
+      return true;
+    case FL_VALUE_TYPE_STRING: {
+      const char* s = fl_value_get_string(v);
+      char* end = nullptr;
+      const long long parsed = std::strtoll(s, &end, 10);
+      if (end == s || *end != '\0') return false;
+      *out = parsed;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool parse_double(FlValue* v, double* out) {
+  if (!v) return false;
+  if (fl_value_get_type(v) == FL_VALUE_TYPE_FLOAT) {
+    *out = fl_value_get_float(v);
+    return true;
+  }
+  if (fl_value_get_type(v) == FL_VALUE_TYPE_STRING) {
+    const char* s = fl_value_get_string(v);
+    char* end = nullptr;
+    const double parsed = std::strtod(s, &end);
+    if (end == s || *end != '\0') return false;
+    *out = parsed;
+    return true;
+  }
+  int64_t n = 0;
+  if (!parse_int(v, &n)) return false;
+  *out = (double)n;
+  return true;
+}
+
+bool parse_bool(FlValue* v, bool* out) {
+  if (!v) return false;
+  if (fl_value_get_type(v) == FL_VALUE_TYPE_BOOL) {
+    *out = fl_value_get_bool(v);
+    return true;
+  }
+  if (fl_value_get_type(v) == FL_VALUE_TYPE_STRING) {
+    const std::string s = fl_value_get_string(v);
+    if (g_ascii_strcasecmp(s.c_str(), "true") == 0 || s == "1") {
+      *out = true;
+      return true;
+    }
+    if (g_ascii_strcasecmp(s.c_str(), "false") == 0 || s == "0") {
+      *out = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Converts a channel scalar for OverlayStyleUpdate::Decode.
+bool style_value_from_fl(FlValue* v, tono_overlay::StyleValue* out) {
+  switch (fl_value_get_type(v)) {
+    case FL_VALUE_TYPE_STRING:
+      *out = tono_overlay::StyleValue::String(fl_value_get_string(v));
+      return true;
+    case FL_VALUE_TYPE_BOOL:
+      *out = tono_overlay::StyleValue::Bool(fl_value_get_bool(v));
+      return true;
+    case FL_VALUE_TYPE_INT:
+      *out = tono_overlay::StyleValue::Number((double)fl_value_get_int(v));
+      return true;
+    case FL_VALUE_TYPE_FLOAT:
+      *out = tono_overlay::StyleValue::Number(fl_value_get_float(v));
+      return true;
+    default:
+      return false;
+  }
+}
+
+FlMethodResponse* success(FlValue* value) {
+  g_autoptr(FlValue) owned = value;
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(owned));
+}
+
+FlMethodResponse* bad_args(const std::string& message) {
+  return FL_METHOD_RESPONSE(
+      fl_method_error_response_new("bad_args", message.c_str(), nullptr));
+}
+
+FlMethodResponse* too_many_overlays() {
+  return FL_METHOD_RESPONSE(fl_method_error_response_new(
+      "too_many_overlays", "No more overlay windows can be opened",
+      nullptr));
+}
+
+// The overlay a call addresses: {id: int} in a map argument, else the
+// default one. False if the id is not an integer.
+bool parse_overlay_id(FlValue* args, OverlayId* id) {
+  *id = tono_overlay::kDefaultOverlayId;
+  FlValue* value = lookup_arg(args, "id");
+  if (!value) return true;
+  if (fl_value_get_type(value) != FL_VALUE_TYPE_INT) return false;
+  *id = fl_value_get_int(value);
+  return true;
+}
+
+// Channel arguments for the style decoding in overlay_core.
+class FlStyleArgs : public tono_overlay::StyleArgs {
+ public:
+  explicit FlStyleArgs(FlValue* args) : args_(args) {}
+
+  bool IsMap() const override {
+    return args_ && fl_value_get_type(args_) == FL_VALUE_TYPE_MAP;
+  }
+  Lookup Find(const char* key,
+              tono_overlay::StyleValue* value) const override {
+    return convert(lookup_arg(args_, key), value);
+  }
+  Lookup Self(tono_overlay::StyleValue* value) const override {
+    return IsMap() ? Lookup::kMissing : convert(args_, value);
+  }
+  void ForEach(const EntryVisitor& visit) const override {
+    if (!IsMap()) return;
+    for (size_t i = 0; i < fl_value_get_length(args_); ++i) {
+      FlValue* key = fl_value_get_map_key(args_, i);
+      tono_overlay::StyleValue value;
+      const Lookup lookup = convert(fl_value_get_map_value(args_, i), &value);
+      const char* name = fl_value_get_type(key) == FL_VALUE_TYPE_STRING
+                             ? fl_value_get_string(key)
+                             : nullptr;
+      if (!visit(name, lookup, value)) return;
+    }
+  }
+
+ private:
+  static Lookup convert(FlValue* v, tono_overlay::StyleValue* out) {
+    if (!v) return Lookup::kMissing;
+    return style_value_from_fl(v, out) ? Lookup::kFound : Lookup::kUnsupported;
+  }
+
+  FlValue* args_;
+};
+
+// applyOverlayStyle, or a single-purpose setter when |setter| is set.
+// Nothing is applied unless every field is valid; then the overlay is
+// rendered once.
+FlMethodResponse* apply_overlay_style(GtkOverlayWindow* overlay,
+                                      const tono_overlay::StyleSetter* setter,
+                                      FlValue* args) {
+  const FlStyleArgs style_args(args);
+  tono_overlay::OverlayStyleUpdate update;
+  std::string error;
+  const bool ok =
+      setter ? tono_overlay::DecodeStyleSetter(*setter, style_args, &update,
+                                               &error)
+             : tono_overlay::DecodeStyleMap(style_args, &update, &error);
+  if (!ok) return bad_args(error);
+  overlay->ApplyStyle(update);
+  return success(fl_value_new_bool(TRUE));
+}
+
+// Lets pointer events through the main window with an empty input shape.
+void set_main_window_click_through(bool enable) {
+  GtkWidget* widget = GTK_WIDGET(lyrics_main_window);
+  if (enable) {
+    cairo_region_t* empty = cairo_region_create();
+    gtk_widget_input_shape_combine_region(widget, empty);
+    cairo_region_destroy(empty);
+  } else {
+    gtk_widget_input_shape_combine_region(widget, nullptr);
+  }
+}
+
+// {lrc: String, lookahead?: int}, parsed here, or the parsed lines as
+// {times: List<int> (ms), texts: List<String>, lookahead?: int}.
+FlMethodResponse* set_lyrics_sheet(GtkOverlayWindow* overlay,
+                                   FlValue* args) {
+  const char* usage =
+      "Expected {lrc: String} or {times: List<int>, texts: List<String>} of "
+      "equal length";
+  int64_t lookahead = -1;
+  if (!parse_int(lookup_arg(args, "lookahead"), &lookahead)) lookahead = -1;
+  FlValue* lrc = lookup_arg(args, "lrc");
+  if (lrc) {
+    if (fl_value_get_type(lrc) != FL_VALUE_TYPE_STRING) return bad_args(usage);
+    if (!lyrics_lrc_parser) lyrics_lrc_parser = new tono_overlay::LrcParser();
+    overlay->SetSheet(lyrics_lrc_parser->Parse(fl_value_get_string(lrc)),
+                      (int)lookahead);
+    return success(fl_value_new_bool(TRUE));
+  }
+  FlValue* times = lookup_arg(args, "times");
+  FlValue* texts = lookup_arg(args, "texts");
+  if (!times || !texts || fl_value_get_type(texts) != FL_VALUE_TYPE_LIST) {
+    return bad_args(usage);
+  }
+  // Integer lists may arrive as typed Int32List / Int64List.
+  std::vector<int64_t> times_ms;
+  switch (fl_value_get_type(times)) {
+    case FL_VALUE_TYPE_INT32_LIST: {
+      const int32_t* data = fl_value_get_int32_list(times);
+      times_ms.assign(data, data + fl_value_get_length(times));
+      break;
+    }
+    case FL_VALUE_TYPE_INT64_LIST: {
+      const int64_t* data = fl_value_get_int64_list(times);
+      times_ms.assign(data, data + fl_value_get_length(times));
+      break;
+    }
+    case FL_VALUE_TYPE_LIST:
+      for (size_t i = 0; i < fl_value_get_length(times); ++i) {
+        int64_t t = 0;
+        if (!parse_int(fl_value_get_list_value(times, i), &t)) {
+          return bad_args(usage);
+        }
+        times_ms.push_back(t);
+      }
+      break;
+    default:
+      return bad_args(usage);
+  }
+  if (times_ms.size() != fl_value_get_length(texts)) return bad_args(usage);
+  // The texts stay in |args| for the call.
+  std::vector<tono_overlay::LrcLine> lines(times_ms.size());
+  for (size_t i = 0; i < times_ms.size(); ++i) {
+    FlValue* text = fl_value_get_list_value(texts, i);
+    if (fl_value_get_type(text) != FL_VALUE_TYPE_STRING) {
+      return bad_args(usage);
+    }
+    lines[i].time_ms = times_ms[i];
+    lines[i].text = fl_value_get_string(text);
+  }
+  overlay->SetSheet(lines, (int)lookahead);
+  return success(fl_value_new_bool(TRUE));
+}
+
+// {positionMs: int, playing: bool, rate?: double}
+FlMethodResponse* set_lyrics_playback(GtkOverlayWindow* overlay,
+                                      FlValue* args) {
+  int64_t position_ms = -1;
+  bool playing = false;
+  double rate = 1.0;
+  bool ok = parse_int(lookup_arg(args, "positionMs"), &position_ms) &&
+            position_ms >= 0 &&
+            parse_bool(lookup_arg(args, "playing"), &playing);
+  FlValue* rate_arg = lookup_arg(args, "rate");
+  if (ok && rate_arg) ok = parse_double(rate_arg, &rate) && rate > 0.0;
+  if (!ok) {
+    return bad_args(
+        "Expected {positionMs: int>=0, playing: bool, rate?: double>0}");
+  }
+  overlay->SetPlayback(position_ms, playing, rate);
+  return success(fl_value_new_bool(TRUE));
+}
+
+FlMethodResponse* get_overlay_cache_stats() {
+  // The line cache is shared by every overlay.
+  const tono_overlay::LineCacheStats st =
+      lyrics_context->line_cache()->stats();
+  FlValue* m = fl_value_new_map();
+  fl_value_set_string_take(m, "hits", fl_value_new_int((int64_t)st.hits));
+  fl_value_set_string_take(m, "misses", fl_value_new_int((int64_t)st.misses));
+  fl_value_set_string_take(m, "insertions",
+                           fl_value_new_int((int64_t)st.insertions));
+  fl_value_set_string_take(m, "evictions",
+                           fl_value_new_int((int64_t)st.evictions));
+  fl_value_set_string_take(m, "entries",
+                           fl_value_new_int((int64_t)st.entries));
+  fl_value_set_string_take(m, "bytes", fl_value_new_int((int64_t)st.bytes));
+  fl_value_set_string_take(m, "budgetBytes",
+                           fl_value_new_int((int64_t)st.byte_budget));
+  return success(m);
+}
+
+// Per-stage latency summaries: {stage: {count, meanUs, p50Us, p95Us, p99Us,
+// maxUs}}. {reset: true} clears the histograms after reading them.
+FlMethodResponse* get_overlay_stats(FlValue* args) {
+  bool reset = false;
+  if (!parse_bool(lookup_arg(args, "reset"), &reset)) reset = false;
+  tono_overlay::OverlayStats& stats = tono_overlay::OverlayStats::Global();
+  FlValue* stages = fl_value_new_map();
+  for (int i = 0; i < (int)tono_overlay::TimingStage::kCount; ++i) {
+    const auto stage = (tono_overlay::TimingStage)i;
+    const tono_overlay::LatencySummary s = stats.Summary(stage);
+    FlValue* m = fl_value_new_map();
+    fl_value_set_string_take(m, "count", fl_value_new_int((int64_t)s.count));
+    fl_value_set_string_take(m, "meanUs", fl_value_new_float(s.mean_us));
+    fl_value_set_string_take(m, "p50Us", fl_value_new_float(s.p50_us));
+    fl_value_set_string_take(m, "p95Us", fl_value_new_float(s.p95_us));
+    fl_value_set_string_take(m, "p99Us", fl_value_new_float(s.p99_us));
+    fl_value_set_string_take(m, "maxUs", fl_value_new_float(s.max_us));
+    fl_value_set_string_take(stages, tono_overlay::TimingStageName(stage), m);
+  }
+  if (reset) stats.Reset();
+  return success(stages);
+}
+
+// Ids of the overlays that exist, with or without a window.
+FlMethodResponse* list_lyrics_windows() {
+  FlValue* list = fl_value_new_list();
+  for (OverlayId id : lyrics_overlays->ids()) {
+    GtkOverlayWindow* overlay = lyrics_overlays->Find(id);
+    FlValue* m = fl_value_new_map();
+    fl_value_set_string_take(m, "id", fl_value_new_int(id));
+    fl_value_set_string_take(m, "created",
+                             fl_value_new_bool(overlay->created()));
+    fl_value_append_take(list, m);
+  }
+  return success(list);
+}
+
+void method_call_cb(FlMethodChannel*, FlMethodCall* method_call, gpointer) {
+  g_autoptr(FlMethodResponse) response =
+      lyrics_overlay_handle_method(fl_method_call_get_name(method_call),
+                                   fl_method_call_get_args(method_call));
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    TONO_LOG(kWarning, "lyrics channel: failed to respond: "
+                           << error->message);
+  }
+}
+
+}  // namespace
+
+void lyrics_overlay_init(GtkWindow* main_window) {
+  if (!lyrics_overlays) {
+    auto context = std::make_shared<tono_overlay::OverlayRenderContext>();
+    lyrics_context = context.get();
+    lyrics_overlays = new tono_overlay::OverlayRegistry<GtkOverlayWindow>(
+        [context](OverlayId) {
+          return std::make_unique<GtkOverlayWindow>(context);
+        });
+    lyrics_api_host = new LyricsOverlayApiHost();
+    tono_overlay::SetOverlayApiHost(lyrics_api_host);
+  }
+  lyrics_main_window = main_window;
+}
+
+void lyrics_overlay_register(FlBinaryMessenger* messenger,
+                             GtkWindow* main_window) {
+  lyrics_overlay_init(main_window);
+  g_clear_object(&lyrics_channel);
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  lyrics_channel = fl_method_channel_new(messenger,
+                                         "com.enten0103.tono_music/window",
+                                         FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(lyrics_channel, method_call_cb,
+                                            nullptr, nullptr);
+}
+
+// Every method but setClickThrough and the process-wide ones addresses
+// one overlay by the optional "id" argument (default 0), creating it on
+// first use; settings sent before its window exists apply once it does.
+FlMethodResponse* lyrics_overlay_handle_method(const gchar* method,
+                                               FlValue* args) {
+  const std::string name = method;
+  tono_overlay::ScopedTraceEvent trace("channel", name);
+  if (name == "setClickThrough") {
+    bool enable = false;
+    FlValue* enabled = lookup_arg(args, "enabled");
+    if (!parse_bool(enabled ? enabled : args, &enable)) enable = false;
+    set_main_window_click_through(enable);
+    return success(fl_value_new_bool(enable));
+  }
+  // Process-wide: the line cache and stats are shared by every overlay.
+  if (name == "getOverlayCacheStats") return get_overlay_cache_stats();
+  if (name == "getOverlayStats") return get_overlay_stats(args);
+  if (name == "setOverlayCacheBudget") {
+    int64_t bytes = -1;
+    if (!parse_int(lookup_arg(args, "bytes"), &bytes) || bytes < 0) {
+      return bad_args("Expected {bytes: int>=0}");
+    }
+    lyrics_context->line_cache()->SetByteBudget((size_t)bytes);
+    return success(fl_value_new_bool(TRUE));
+  }
+  if (name == "listLyricsWindows") return list_lyrics_windows();
+
+  OverlayId id = tono_overlay::kDefaultOverlayId;
+  if (!parse_overlay_id(args, &id)) return bad_args("Expected {id: int}");
+  if (name == "destroyLyricsWindow") {
+    // The default overlay keeps its text and style for the next window;
+    // any other is gone with its window.
+    if (id == tono_overlay::kDefaultOverlayId) {
+      if (GtkOverlayWindow* overlay = lyrics_overlays->Find(id)) {
+        overlay->Destroy();
+      }
+    } else {
+      lyrics_overlays->Remove(id);
+    }
+    return success(fl_value_new_bool(TRUE));
+  }
+  if (name == "hideLyricsWindow") {
+    if (GtkOverlayWindow* overlay = lyrics_overlays->Find(id)) overlay->Hide();
+    return success(fl_value_new_bool(TRUE));
+  }
+  GtkOverlayWindow* overlay = lyrics_overlays->Get(id);
+  if (!overlay) return too_many_overlays();
+  if (name == "createLyricsWindow") {
+    return success(fl_value_new_bool(overlay->Create()));
+  }
+  if (name == "showLyricsWindow") {
+    if (!overlay->Show()) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "create_failed", "Failed to create overlay", nullptr));
+    }
+    return success(fl_value_new_bool(TRUE));
+  }
+  if (name == "setLyricsText") {
+    FlValue* text = lookup_arg(args, "text");
+    if (!text || fl_value_get_type(text) != FL_VALUE_TYPE_STRING) {
+      return bad_args("Expected {text: string}");
+    }
+    overlay->SetText(fl_value_get_string(text));
+    return success(fl_value_new_bool(TRUE));
+  }
+  if (name == "applyOverlayStyle") {
+    return apply_overlay_style(overlay, nullptr, args);
+  }
+  if (const tono_overlay::StyleSetter* setter =
+          tono_overlay::FindStyleSetter(name)) {
+    return apply_overlay_style(overlay, setter, args);
+  }
+  if (name == "setOverlayClickThrough") {
+    bool enable = false;
+    if (!parse_bool(lookup_arg(args, "enabled"), &enable)) enable = false;
+    return success(fl_value_new_bool(overlay->SetClickThrough(enable)));
+  }
+  if (name == "setLyricsSheet") return set_lyrics_sheet(overlay, args);
+  if (name == "setLyricsPlayback") return set_lyrics_playback(overlay, args);
+  return FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+}
@@ -0,0 +1,26 @@
+#ifndef FLUTTER_LYRICS_OVERLAY_H_
+#define FLUTTER_LYRICS_OVERLAY_H_
+
+#include <flutter_linux/flutter_linux.h>
+#include <gtk/gtk.h>
+
+// Registers the "com.enten0103.tono_music/window" method channel on
+// |messenger|: the desktop lyrics overlay plus click-through for
+// |main_window|, with the same methods and arguments as the Windows runner.
+// Overlays are addressed by an optional "id" argument and share one render
+// worker, font cache and line cache; the default overlay (id 0) lives
+// until the process exits.
+void lyrics_overlay_register(FlBinaryMessenger* messenger,
+                             GtkWindow* main_window);
+
+// Sets up the overlays and the dart:ffi host for |main_window| without a
+// channel; lyrics_overlay_register calls it first. Tests use it to drive
+// lyrics_overlay_handle_method on a display of their own.
+void lyrics_overlay_init(GtkWindow* main_window);
+
+// Handles one call on the channel: |method| with its decoded |args|, which
+// may be null. Returns a new reference to the reply.
+FlMethodResponse* lyrics_overlay_handle_method(const gchar* method,
+                                               FlValue* args);
+
+#endif  // FLUTTER_LYRICS_OVERLAY_H_
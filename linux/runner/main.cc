@@ -1,6 +1,37 @@
+#include <cstdlib>
+#include <string>
+
 #include "my_application.h"
+#include "overlay_core/overlay_trace.h"
 
 int main(int argc, char** argv) {
-  g_autoptr(MyApplication) app = my_application_new();
-  return g_application_run(G_APPLICATION(app), argc, argv);
+  // --overlay-trace=<path> (or $TONO_OVERLAY_TRACE=<path>) records a Chrome
+  // trace of the overlay and the window channel, written at exit. The flag
+  // is removed so Dart never sees it.
+  std::string trace_path;
+  const char* trace_env = getenv(tono_overlay::kTraceEnvVar);
+  if (trace_env && *trace_env) trace_path = trace_env;
+  int kept = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (!tono_overlay::ParseTraceFlag(argv[i], &trace_path)) {
+      argv[kept++] = argv[i];
+    }
+  }
+  argv[kept] = nullptr;
+  argc = kept;
+  tono_overlay::OverlayTracer& tracer = tono_overlay::OverlayTracer::Global();
+  if (!trace_path.empty()) {
+    tracer.Start(trace_path);
+    tracer.SetThreadName("platform");
+  }
+
+  int status = 0;
+  {
+    g_autoptr(MyApplication) app = my_application_new();
+    status = g_application_run(G_APPLICATION(app), argc, argv);
+  }
+  if (tracer.enabled() && !tracer.Stop()) {
+    g_warning("Failed to write overlay trace to %s", trace_path.c_str());
+  }
+  return status;
 }
@@ -6,10 +6,15 @@
 #endif
 
 #include "flutter/generated_plugin_registrant.h"
+#include "lyrics_overlay.h"
+#include "overlay_core/overlay_log.h"
 
 struct _MyApplication {
   GtkApplication parent_instance;
   char** dart_entrypoint_arguments;
+  // Overlay logger, writing to $TMPDIR/tono_lyrics_overlay.log between
+  // startup and shutdown.
+  tono_overlay::ScopedOverlayLogger* logger;
 };
 
 G_DEFINE_TYPE(MyApplication, my_application, GTK_TYPE_APPLICATION)
@@ -72,6 +77,8 @@ static void my_application_activate(GApplication* application) {
   gtk_widget_realize(GTK_WIDGET(view));
 
   fl_register_plugins(FL_PLUGIN_REGISTRY(view));
+  lyrics_overlay_register(
+      fl_engine_get_binary_messenger(fl_view_get_engine(view)), window);
 
   gtk_widget_grab_focus(GTK_WIDGET(view));
 }
@@ -97,18 +104,27 @@ static gboolean my_application_local_command_line(GApplication* application, gch
 
 // Implements GApplication::startup.
 static void my_application_startup(GApplication* application) {
-  //MyApplication* self = MY_APPLICATION(object);
+  MyApplication* self = MY_APPLICATION(application);
 
   // Perform any actions required at application startup.
+  g_autofree gchar* log_path =
+      g_build_filename(g_get_tmp_dir(), "tono_lyrics_overlay.log", nullptr);
+  self->logger = new tono_overlay::ScopedOverlayLogger(
+      std::make_unique<tono_overlay::AsyncLogger>(
+          std::make_unique<tono_overlay::FileLogSink>(log_path)));
+  TONO_LOG(kInfo, "startup: " << APPLICATION_ID);
 
   G_APPLICATION_CLASS(my_application_parent_class)->startup(application);
 }
 
 // Implements GApplication::shutdown.
 static void my_application_shutdown(GApplication* application) {
-  //MyApplication* self = MY_APPLICATION(object);
+  MyApplication* self = MY_APPLICATION(application);
 
   // Perform any actions required at application shutdown.
+  // Writes what is still queued and stops the flusher thread.
+  delete self->logger;
+  self->logger = nullptr;
 
   G_APPLICATION_CLASS(my_application_parent_class)->shutdown(application);
 }
@@ -0,0 +1,402 @@
+// overlay_bench.cc
+//
+// Micro benchmarks for the overlay core. Run without arguments for every
+// suite, or pass suite names (e.g. "stroke") to run a subset.
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "overlay_core/compositor.h"
+#include "overlay_core/karaoke.h"
+#include "overlay_core/lrc_parser.h"
+#include "overlay_core/marquee.h"
+#include "overlay_core/overlay_log.h"
+#include "overlay_core/stroke_engine.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Runs |fn| until at least |min_ms| elapsed and returns microseconds per run.
+template <typename Fn>
+double TimeUs(Fn&& fn, double min_ms = 200.0) {
+  fn();  // warm up caches and scratch buffers
+  int runs = 0;
+  const auto start = Clock::now();
+  double elapsed_ms = 0.0;
+  do {
+    fn();
+    ++runs;
+    elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() -
+                                                           start).count();
+  } while (elapsed_ms < min_ms);
+  return elapsed_ms * 1000.0 / runs;
+}
+
+// Text-like coverage mask: rows of glyph-sized blobs made of antialiased
+// bars and rings, vertically centered like a single DrawTextW line.
+std::vector<uint8_t> SyntheticTextMask(int w, int h, int font_px,
+                                       uint32_t seed) {
+  std::vector<uint8_t> m((size_t)w * h, 0);
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> shape(0, 2);
+  const int pad = 8;
+  const int advance = font_px * 3 / 4 + 2;
+  const int top = (h - font_px) / 2;
+  const float thick = std::max(1.5f, font_px / 10.0f);
+  auto plot = [&](int x, int y, float cov) {
+    if (x < 0 || y < 0 || x >= w || y >= h || cov <= 0.0f) return;
+    uint8_t v = (uint8_t)(std::min(cov, 1.0f) * 255.0f + 0.5f);
+    uint8_t& dst = m[(size_t)y * w + x];
+    if (v > dst) dst = v;
+  };
+  for (int gx = pad; gx + advance < w - pad; gx += advance) {
+    const int kind = shape(rng);
+    const float cx = gx + advance * 0.5f;
+    const float cy = top + font_px * 0.5f;
+    const float r = font_px * 0.38f;
+    for (int y = top; y < top + font_px; ++y) {
+      for (int x = gx; x < gx + advance; ++x) {
+        const float px = x + 0.5f - cx, py = y + 0.5f - cy;
+        float dist;
+        if (kind == 0) {
+          dist = std::fabs(std::sqrt(px * px + py * py) - r);
+        } else if (kind == 1) {
+          dist = std::min(std::fabs(px), std::fabs(py));
+        } else {
+          dist = std::fabs(px - py * 0.5f);
+        }
+        plot(x, y, thick * 0.5f + 0.5f - dist);
+      }
+    }
+  }
+  return m;
+}
+
+// The pre-engine stroke: stamp the fill mask at every offset inside the
+// stroke disk. Uses max instead of a full text rasterization per offset, so
+// it is a lower bound on what the DrawTextW loop cost.
+void DiskStampStroke(const uint8_t* fill, uint8_t* stroke, int w, int h,
+                     int radius) {
+  std::memset(stroke, 0, (size_t)w * h);
+  const int radsq = radius * radius;
+  for (int dy = -radius; dy <= radius; ++dy) {
+    for (int dx = -radius; dx <= radius; ++dx) {
+      if (dx * dx + dy * dy > radsq) continue;
+      const int y_begin = std::max(0, dy), y_end = std::min(h, h + dy);
+      const int x_begin = std::max(0, dx), x_end = std::min(w, w + dx);
+      for (int y = y_begin; y < y_end; ++y) {
+        const uint8_t* src = fill + (size_t)(y - dy) * w - dx;
+        uint8_t* dst = stroke + (size_t)y * w;
+        for (int x = x_begin; x < x_end; ++x) {
+          if (src[x] > dst[x]) dst[x] = src[x];
+        }
+      }
+    }
+  }
+}
+
+void BenchStroke() {
+  std::printf("== stroke: distance-transform engine vs disk stamping ==\n");
+  std::printf("%-10s %6s %8s %14s %14s %8s\n", "size", "radius", "stamps",
+              "engine_us", "disk_us", "speedup");
+  const int sizes[][3] = {{600, 64, 28}, {3840, 200, 80}};
+  tono_overlay::StrokeEngine engine;
+  for (const auto& s : sizes) {
+    const int w = s[0], h = s[1];
+    std::vector<uint8_t> fill = SyntheticTextMask(w, h, s[2], 7);
+    std::vector<uint8_t> out((size_t)w * h);
+    for (int radius : {1, 2, 4, 8, 12, 20}) {
+      int stamps = 0;
+      for (int dy = -radius; dy <= radius; ++dy)
+        for (int dx = -radius; dx <= radius; ++dx)
+          if (dx * dx + dy * dy <= radius * radius) ++stamps;
+      const double engine_us = TimeUs(
+          [&] { engine.BuildA8(fill.data(), out.data(), w, h, radius); });
+      const double disk_us = TimeUs(
+          [&] { DiskStampStroke(fill.data(), out.data(), w, h, radius); });
+      char size[32];
+      std::snprintf(size, sizeof(size), "%dx%d", w, h);
+      std::printf("%-10s %6d %8d %14.1f %14.1f %7.1fx\n", size, radius,
+                  stamps, engine_us, disk_us, disk_us / engine_us);
+    }
+  }
+}
+
+// A song-sized LRC: header tags, |lines| timed lines of mixed ASCII and
+// CJK text, every eighth line carrying a second (chorus) timestamp.
+std::string SyntheticLrc(int lines, uint32_t seed, bool translation) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> words(2, 9);
+  static const char* const kWords[] = {"love", "night", "\xE5\xA4\x9C",
+                                       "\xE6\x98\x9F\xE7\xA9\xBA", "again",
+                                       "\xE4\xBD\xA0"};
+  std::string out = translation ? "[by:translator]\n"
+                                : "[ti:Song]\n[ar:Artist]\n[offset:+100]\n";
+  char stamp[32];
+  for (int i = 0; i < lines; ++i) {
+    const int ms = 1000 + i * 3170;
+    std::snprintf(stamp, sizeof(stamp), "[%02d:%02d.%02d]", ms / 60000,
+                  ms / 1000 % 60, ms / 10 % 100);
+    out += stamp;
+    if (!translation && i % 8 == 0) {
+      const int chorus = ms + lines * 3170;
+      std::snprintf(stamp, sizeof(stamp), "[%02d:%02d.%03d]", chorus / 60000,
+                    chorus / 1000 % 60, chorus % 1000);
+      out += stamp;
+    }
+    for (int w = words(rng); w > 0; --w) {
+      out += kWords[rng() % 6];
+      out += ' ';
+    }
+    out += "\n";
+  }
+  return out;
+}
+
+void BenchLrc() {
+  std::printf("== lrc: LrcParser throughput ==\n");
+  std::printf("%-8s %12s %10s %12s %10s\n", "lines", "bytes", "us", "MB/s",
+              "ns/line");
+  tono_overlay::LrcParser parser;
+  for (int lines : {60, 400, 5000}) {
+    const std::string lyric = SyntheticLrc(lines, 11, false);
+    const std::string tlyric = SyntheticLrc(lines, 12, true);
+    size_t parsed = 0;
+    const double us =
+        TimeUs([&] { parsed = parser.Parse(lyric, tlyric).size(); });
+    const double bytes = (double)(lyric.size() + tlyric.size());
+    std::printf("%-8d %12.0f %10.1f %12.1f %10.1f\n", lines, bytes, us,
+                bytes / us, us * 1000.0 / (double)parsed);
+  }
+}
+
+void BenchKaraoke() {
+  std::printf("== karaoke: per-frame sweep vs full recomposite ==\n");
+  std::printf("%-10s %8s %14s %14s %8s\n", "size", "cols/fr", "sweep_us",
+              "full_us", "speedup");
+  const int sizes[][3] = {{600, 64, 28}, {1920, 120, 56}};
+  for (const auto& s : sizes) {
+    const int w = s[0], h = s[1];
+    const size_t n = (size_t)w * h;
+    const std::vector<uint8_t> fill = SyntheticTextMask(w, h, s[2], 3);
+    const std::vector<uint8_t>& stroke = fill;
+    std::vector<uint8_t> out(n * 4);
+    tono_overlay::CompositeParams params;
+    params.fill = {255, 255, 255};
+    params.stroke = {0, 0, 0};
+    tono_overlay::KaraokeCompositor karaoke;
+    // A line swept over ~3 s at 60 fps.
+    const int step = std::max(1, w / 180);
+    int x = 0;
+    const double sweep_us = TimeUs([&] {
+      int b, e;
+      x += step;
+      if (x > w) {
+        karaoke.Reset(fill.data(), stroke.data(), out.data(), w, h, params,
+                      {255, 200, 64});
+        x = step;
+      }
+      karaoke.SetSweep(x, &b, &e);
+    });
+    const double full_us = TimeUs([&] {
+      tono_overlay::CompositeStrokeFill(fill.data(), stroke.data(),
+                                        out.data(), n, params);
+    });
+    char size[32];
+    std::snprintf(size, sizeof(size), "%dx%d", w, h);
+    std::printf("%-10s %8d %14.2f %14.2f %7.1fx\n", size, step, sweep_us,
+                full_us, full_us / sweep_us);
+  }
+}
+
+// The text path before masks went A8: the rasterizer's 32-bit masks are
+// reduced for the stroke engine and the stroke expanded back to 32 bits.
+void Legacy32BitStroke(tono_overlay::StrokeEngine& engine,
+                       const uint8_t* fill32, uint8_t* stroke32, int w, int h,
+                       int radius, std::vector<uint8_t>& fill8,
+                       std::vector<uint8_t>& stroke8) {
+  const size_t n = (size_t)w * h;
+  tono_overlay::MaskToA8(fill32, fill8.data(), n);
+  engine.BuildA8(fill8.data(), stroke8.data(), w, h, radius);
+  for (size_t i = 0; i < n; ++i) {
+    std::memset(stroke32 + i * 4, stroke8[i], 3);
+    stroke32[i * 4 + 3] = 0;
+  }
+}
+
+void BenchMasks() {
+  std::printf("== masks: A8 text masks vs 32-bit masks ==\n");
+  std::printf("%-10s %10s %10s %12s %12s %12s %12s\n", "size", "a8_KiB",
+              "32bit_KiB", "reduce_us", "stroke_us", "stroke32_us",
+              "compose_us");
+  const int sizes[][3] = {{600, 64, 28}, {1920, 120, 56}, {3840, 200, 80}};
+  tono_overlay::StrokeEngine engine;
+  for (const auto& s : sizes) {
+    const int w = s[0], h = s[1];
+    const size_t n = (size_t)w * h;
+    const std::vector<uint8_t> fill = SyntheticTextMask(w, h, s[2], 5);
+    std::vector<uint8_t> fill32(n * 4), stroke32(n * 4), stroke(n), out(n * 4);
+    for (size_t i = 0; i < n; ++i) std::memset(&fill32[i * 4], fill[i], 3);
+    std::vector<uint8_t> fill8(n), stroke8(n);
+    const int radius = std::max(1, s[2] / 14);
+    const double reduce_us = TimeUs(
+        [&] { tono_overlay::MaskToA8(fill32.data(), fill8.data(), n); });
+    const double stroke_us = TimeUs(
+        [&] { engine.BuildA8(fill.data(), stroke.data(), w, h, radius); });
+    const double stroke32_us = TimeUs([&] {
+      Legacy32BitStroke(engine, fill32.data(), stroke32.data(), w, h, radius,
+                        fill8, stroke8);
+    });
+    tono_overlay::CompositeParams params;
+    const double compose_us = TimeUs([&] {
+      tono_overlay::CompositeStrokeFill(fill.data(), stroke.data(),
+                                        out.data(), n, params);
+    });
+    // KiB columns: fill plus stroke mask per layer in each representation.
+    char size[32];
+    std::snprintf(size, sizeof(size), "%dx%d", w, h);
+    std::printf("%-10s %10.1f %10.1f %12.1f %12.1f %12.1f %12.1f\n", size,
+                2.0 * n / 1024.0, 8.0 * n / 1024.0, reduce_us, stroke_us,
+                stroke32_us, compose_us);
+  }
+}
+
+// One marquee frame, a window copied out of a strip three times as wide,
+// against stroking and compositing the strip again, which is what every
+// frame would cost if the scroll re-rendered the line.
+void BenchMarquee() {
+  std::printf("== marquee: window blit vs re-render per frame ==\n");
+  std::printf("%-10s %12s %12s %12s %12s\n", "window", "blit_us",
+              "subpx_us", "plate_us", "rerender_us");
+  const int sizes[][3] = {{600, 64, 28}, {1920, 120, 56}};
+  tono_overlay::StrokeEngine engine;
+  for (const auto& s : sizes) {
+    const int w = s[0], h = s[1], strip_w = 3 * w;
+    const size_t n = (size_t)strip_w * h;
+    const std::vector<uint8_t> fill = SyntheticTextMask(strip_w, h, s[2], 9);
+    std::vector<uint8_t> stroke(n), strip(n * 4);
+    const int radius = std::max(1, s[2] / 14);
+    tono_overlay::CompositeParams params;
+    const double rerender_us = TimeUs([&] {
+      engine.BuildA8(fill.data(), stroke.data(), strip_w, h, radius);
+      tono_overlay::CompositeStrokeFill(fill.data(), stroke.data(),
+                                        strip.data(), n, params);
+    });
+    const size_t stride = (size_t)w * 4;
+    std::vector<uint8_t> out(stride * h), plate(stride * h);
+    tono_overlay::BackgroundPlate background = {{0, 0, 0}, 160, 8};
+    tono_overlay::RenderBackgroundPlate(background, params.format, w, h,
+                                        plate.data(), stride);
+    int32_t offset = 0;
+    auto step = [&](int32_t by) {
+      offset = (offset + by) % ((strip_w - w) * 256);
+      return offset;
+    };
+    const double blit_us = TimeUs([&] {
+      tono_overlay::BlitMarquee(strip.data(), (size_t)strip_w * 4, out.data(),
+                                w, h, stride, step(256));
+    });
+    const double subpx_us = TimeUs([&] {
+      tono_overlay::BlitMarquee(strip.data(), (size_t)strip_w * 4, out.data(),
+                                w, h, stride, step(170));
+    });
+    const double plate_us = TimeUs([&] {
+      tono_overlay::BlitMarquee(strip.data(), (size_t)strip_w * 4, out.data(),
+                                w, h, stride, step(170), plate.data());
+    });
+    char size[32];
+    std::snprintf(size, sizeof(size), "%dx%d", w, h);
+    std::printf("%-10s %12.1f %12.1f %12.1f %12.1f\n", size, blit_us,
+                subpx_us, plate_us, rerender_us);
+  }
+}
+
+// Discards batches; measures the logger, not the disk.
+class NullLogSink : public tono_overlay::LogSink {
+ public:
+  void Write(const char*, size_t) override {}
+};
+
+// Cost per log call on the calling thread: the async ring with 1 and 4
+// producers, against the old open/append/close per line.
+void BenchLog() {
+  std::printf("\n[log] ns per call (message ~60 bytes)\n");
+  std::printf("%-24s %10s %10s\n", "mode", "ns/call", "dropped");
+  const std::string message =
+      "update_text_layer: allocated 600x64 surfaces, R=2 G=1 B=0";
+  const int kCalls = 200000;
+  for (int threads : {1, 4}) {
+    tono_overlay::AsyncLogger logger(std::make_unique<NullLogSink>(), 1 << 16,
+                                     1);
+    const auto start = Clock::now();
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; ++t) {
+      producers.emplace_back([&] {
+        for (int i = 0; i < kCalls; ++i) {
+          logger.Log(tono_overlay::LogLevel::kInfo, message);
+        }
+      });
+    }
+    for (auto& producer : producers) producer.join();
+    const double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start)
+            .count() /
+        kCalls;
+    logger.Flush();
+    char mode[32];
+    std::snprintf(mode, sizeof(mode), "async x%d thread(s)", threads);
+    std::printf("%-24s %10.1f %10llu\n", mode, ns,
+                (unsigned long long)logger.dropped());
+  }
+  {
+    // What AppendOverlayLog did per line.
+    const std::string path = "tono_overlay_bench.log";
+    const int calls = 5000;
+    const auto start = Clock::now();
+    for (int i = 0; i < calls; ++i) {
+      std::ofstream f(path, std::ios::app);
+      if (f) f << message << std::endl;
+    }
+    const double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start)
+            .count() /
+        calls;
+    std::remove(path.c_str());
+    std::printf("%-24s %10.1f %10s\n", "open/append/close", ns, "-");
+  }
+}
+
+struct Suite {
+  const char* name;
+  void (*run)();
+};
+
+const Suite kSuites[] = {
+    {"stroke", BenchStroke},
+    {"lrc", BenchLrc},
+    {"karaoke", BenchKaraoke},
+    {"masks", BenchMasks},
+    {"marquee", BenchMarquee},
+    {"log", BenchLog},
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  for (const Suite& suite : kSuites) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; ++i) {
+      if (std::strcmp(argv[i], suite.name) == 0) selected = true;
+    }
+    if (selected) suite.run();
+  }
+  return 0;
+}
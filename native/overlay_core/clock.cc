@@ -0,0 +1,14 @@
+// clock.cc
+#include "overlay_core/clock.h"
+
+#include <chrono>
+
+namespace tono_overlay {
+
+int64_t SteadyClock::NowMs() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace tono_overlay
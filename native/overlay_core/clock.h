@@ -0,0 +1,38 @@
+// clock.h
+#ifndef OVERLAY_CORE_CLOCK_H_
+#define OVERLAY_CORE_CLOCK_H_
+
+#include <cstdint>
+
+namespace tono_overlay {
+
+// Monotonic millisecond time source. Injected wherever the overlay depends
+// on wall time so tests can drive it deterministically.
+class Clock {
+ public:
+  virtual ~Clock() = default;
+  virtual int64_t NowMs() const = 0;
+};
+
+// std::chrono::steady_clock.
+class SteadyClock : public Clock {
+ public:
+  int64_t NowMs() const override;
+};
+
+// A clock that only moves when told to. Used by tests and benchmarks.
+class ManualClock : public Clock {
+ public:
+  explicit ManualClock(int64_t now_ms = 0) : now_ms_(now_ms) {}
+
+  int64_t NowMs() const override { return now_ms_; }
+  void Advance(int64_t ms) { now_ms_ += ms; }
+  void Set(int64_t now_ms) { now_ms_ = now_ms; }
+
+ private:
+  int64_t now_ms_;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_CLOCK_H_
@@ -0,0 +1,607 @@
+// compositor.cc
+#include "overlay_core/compositor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TONO_OVERLAY_HAVE_SSE2 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(TONO_OVERLAY_HAVE_SSE2) && \
+    (defined(_MSC_VER) || defined(__GNUC__) || defined(__clang__))
+#define TONO_OVERLAY_HAVE_AVX2 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TONO_OVERLAY_TARGET_AVX2
+#else
+#define TONO_OVERLAY_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define TONO_OVERLAY_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace tono_overlay {
+namespace {
+
+// Per-byte-position colors: lane i is the value written to byte i of an
+// output pixel. Lane 3 (alpha) is 255 so the same premultiply formula that
+// produces the color bytes also yields the composited alpha. |background|
+// is the plate premultiplied, its alpha in lane 3.
+struct Lanes {
+  uint8_t fill[4];
+  uint8_t stroke[4];
+  uint8_t background[4];
+  uint32_t opacity;
+};
+
+// round(a * b / 255) for a, b in 0..255.
+inline uint32_t MulDiv255(uint32_t a, uint32_t b) {
+  return (a * b + 127) / 255;
+}
+
+// The premultiplied plate color at |alpha|.
+void PlateLanes(const Rgb& color, int alpha, PixelFormat format,
+                uint8_t lanes[4]) {
+  alpha = std::clamp(alpha, 0, 255);
+  lanes[format.r_index] = (uint8_t)MulDiv255(color.r, alpha);
+  lanes[format.g_index] = (uint8_t)MulDiv255(color.g, alpha);
+  lanes[format.b_index] = (uint8_t)MulDiv255(color.b, alpha);
+  lanes[3] = (uint8_t)alpha;
+}
+
+Lanes MakeLanes(const CompositeParams& p) {
+  Lanes l = {};
+  l.fill[p.format.r_index] = p.fill.r;
+  l.fill[p.format.g_index] = p.fill.g;
+  l.fill[p.format.b_index] = p.fill.b;
+  l.fill[3] = 255;
+  l.stroke[p.format.r_index] = p.stroke.r;
+  l.stroke[p.format.g_index] = p.stroke.g;
+  l.stroke[p.format.b_index] = p.stroke.b;
+  l.stroke[3] = 255;
+  PlateLanes(p.background.color, p.background.alpha, p.format, l.background);
+  int op = p.text_opacity;
+  if (op < 0) op = 0;
+  if (op > 255) op = 255;
+  l.opacity = (uint32_t)op;
+  return l;
+}
+
+using KernelFn = void (*)(const uint8_t*, const uint8_t*, uint8_t*, size_t,
+                          const Lanes&);
+
+// Reference kernel. The SIMD kernels must reproduce it bit for bit:
+//   stroke_c = round(stroke * sA / 255)
+//   text_c   = floor((fill * fA + stroke_c * (255 - fA)) / 255)
+//   out_c    = text_c + round(background_c * (255 - text_A) / 255)
+// The text is premultiplied, so text_c <= text_A and the sum fits a byte.
+template <bool kStroke, bool kOpacity, bool kBackground>
+void CompositeScalar(const uint8_t* fill, const uint8_t* stroke, uint8_t* out,
+                     size_t n, const Lanes& l) {
+  for (size_t i = 0; i < n; ++i) {
+    const size_t idx = i * 4;
+    uint32_t fa = fill[i];
+    uint32_t sa = 0;
+    if (kStroke) sa = stroke[i];
+    if (kOpacity) {
+      fa = (fa * l.opacity + 127) / 255;
+      if (kStroke) sa = (sa * l.opacity + 127) / 255;
+    }
+    const uint32_t inv = 255 - fa;
+    uint32_t text[4];
+    for (int c = 0; c < 4; ++c) {
+      uint32_t acc = l.fill[c] * fa;
+      if (kStroke) acc += ((l.stroke[c] * sa + 127) / 255) * inv;
+      text[c] = acc / 255;
+    }
+    const uint32_t under = 255 - text[3];
+    for (int c = 0; c < 4; ++c) {
+      if (kBackground) text[c] += MulDiv255(l.background[c], under);
+      out[idx + c] = (uint8_t)text[c];
+    }
+  }
+}
+
+#if defined(TONO_OVERLAY_HAVE_SSE2)
+
+// Exact floor(x / 255) for any 16-bit x.
+inline __m128i Div255Sse2(__m128i x) {
+  return _mm_srli_epi16(_mm_mulhi_epu16(x, _mm_set1_epi16((short)0x8081)), 7);
+}
+
+// Coverage of four A8 mask pixels, one value per 32-bit lane.
+inline __m128i LoadMaskSse2(const uint8_t* mask) {
+  int32_t bytes;
+  std::memcpy(&bytes, mask, sizeof(bytes));
+  const __m128i zero = _mm_setzero_si128();
+  return _mm_unpacklo_epi16(
+      _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+}
+
+inline __m128i ScaleAlphaSse2(__m128i a, __m128i op) {
+  return Div255Sse2(
+      _mm_add_epi16(_mm_mullo_epi16(a, op), _mm_set1_epi32(127)));
+}
+
+inline __m128i BroadcastAlphaSse2(__m128i a) {
+  a = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+  return _mm_or_si128(a, _mm_slli_epi32(a, 16));
+}
+
+template <bool kStroke>
+inline __m128i BlendSse2(__m128i fa, __m128i sa, __m128i fill,
+                         __m128i stroke) {
+  __m128i acc = _mm_mullo_epi16(fill, fa);
+  if (kStroke) {
+    __m128i s = Div255Sse2(
+        _mm_add_epi16(_mm_mullo_epi16(stroke, sa), _mm_set1_epi16(127)));
+    __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), fa);
+    acc = _mm_add_epi16(acc, _mm_mullo_epi16(s, inv));
+  }
+  return Div255Sse2(acc);
+}
+
+// Adds the plate under four 16-bit lanes of premultiplied text (two
+// pixels), scaled by what the text leaves uncovered.
+inline __m128i UnderBackgroundSse2(__m128i text, __m128i background) {
+  const __m128i ta = _mm_shufflehi_epi16(
+      _mm_shufflelo_epi16(text, _MM_SHUFFLE(3, 3, 3, 3)),
+      _MM_SHUFFLE(3, 3, 3, 3));
+  const __m128i under = _mm_sub_epi16(_mm_set1_epi16(255), ta);
+  return _mm_add_epi16(
+      text, Div255Sse2(_mm_add_epi16(_mm_mullo_epi16(background, under),
+                                     _mm_set1_epi16(127))));
+}
+
+template <bool kStroke, bool kOpacity, bool kBackground>
+void CompositeSse2(const uint8_t* fill, const uint8_t* stroke, uint8_t* out,
+                   size_t n, const Lanes& l) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i fill16 =
+      _mm_setr_epi16(l.fill[0], l.fill[1], l.fill[2], l.fill[3], l.fill[0],
+                     l.fill[1], l.fill[2], l.fill[3]);
+  const __m128i stroke16 =
+      _mm_setr_epi16(l.stroke[0], l.stroke[1], l.stroke[2], l.stroke[3],
+                     l.stroke[0], l.stroke[1], l.stroke[2], l.stroke[3]);
+  const __m128i background16 = _mm_setr_epi16(
+      l.background[0], l.background[1], l.background[2], l.background[3],
+      l.background[0], l.background[1], l.background[2], l.background[3]);
+  const __m128i op = _mm_set1_epi32((int)l.opacity);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i fa = LoadMaskSse2(fill + i);
+    __m128i sa = zero;
+    if (kStroke) sa = LoadMaskSse2(stroke + i);
+    if (kOpacity) {
+      fa = ScaleAlphaSse2(fa, op);
+      if (kStroke) sa = ScaleAlphaSse2(sa, op);
+    }
+    fa = BroadcastAlphaSse2(fa);
+    if (kStroke) sa = BroadcastAlphaSse2(sa);
+    __m128i lo = BlendSse2<kStroke>(_mm_unpacklo_epi8(fa, zero),
+                                    _mm_unpacklo_epi8(sa, zero), fill16,
+                                    stroke16);
+    __m128i hi = BlendSse2<kStroke>(_mm_unpackhi_epi8(fa, zero),
+                                    _mm_unpackhi_epi8(sa, zero), fill16,
+                                    stroke16);
+    if (kBackground) {
+      lo = UnderBackgroundSse2(lo, background16);
+      hi = UnderBackgroundSse2(hi, background16);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4),
+                     _mm_packus_epi16(lo, hi));
+  }
+  CompositeScalar<kStroke, kOpacity, kBackground>(
+      fill + i, kStroke ? stroke + i : nullptr, out + i * 4, n - i, l);
+}
+
+#endif  // TONO_OVERLAY_HAVE_SSE2
+
+#if defined(TONO_OVERLAY_HAVE_AVX2)
+
+TONO_OVERLAY_TARGET_AVX2 inline __m256i Div255Avx2(__m256i x) {
+  return _mm256_srli_epi16(
+      _mm256_mulhi_epu16(x, _mm256_set1_epi16((short)0x8081)), 7);
+}
+
+// Coverage of eight A8 mask pixels, one value per 32-bit lane.
+TONO_OVERLAY_TARGET_AVX2 inline __m256i LoadMaskAvx2(const uint8_t* mask) {
+  return _mm256_cvtepu8_epi32(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(mask)));
+}
+
+TONO_OVERLAY_TARGET_AVX2 inline __m256i ScaleAlphaAvx2(__m256i a,
+                                                       __m256i op) {
+  return Div255Avx2(
+      _mm256_add_epi16(_mm256_mullo_epi16(a, op), _mm256_set1_epi32(127)));
+}
+
+TONO_OVERLAY_TARGET_AVX2 inline __m256i BroadcastAlphaAvx2(__m256i a) {
+  a = _mm256_or_si256(a, _mm256_slli_epi32(a, 8));
+  return _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+}
+
+template <bool kStroke>
+TONO_OVERLAY_TARGET_AVX2 inline __m256i BlendAvx2(__m256i fa, __m256i sa,
+                                                  __m256i fill,
+                                                  __m256i stroke) {
+  __m256i acc = _mm256_mullo_epi16(fill, fa);
+  if (kStroke) {
+    __m256i s = Div255Avx2(_mm256_add_epi16(_mm256_mullo_epi16(stroke, sa),
+                                            _mm256_set1_epi16(127)));
+    __m256i inv = _mm256_sub_epi16(_mm256_set1_epi16(255), fa);
+    acc = _mm256_add_epi16(acc, _mm256_mullo_epi16(s, inv));
+  }
+  return Div255Avx2(acc);
+}
+
+TONO_OVERLAY_TARGET_AVX2 inline __m256i UnderBackgroundAvx2(
+    __m256i text, __m256i background) {
+  const __m256i ta = _mm256_shufflehi_epi16(
+      _mm256_shufflelo_epi16(text, _MM_SHUFFLE(3, 3, 3, 3)),
+      _MM_SHUFFLE(3, 3, 3, 3));
+  const __m256i under = _mm256_sub_epi16(_mm256_set1_epi16(255), ta);
+  return _mm256_add_epi16(
+      text,
+      Div255Avx2(_mm256_add_epi16(_mm256_mullo_epi16(background, under),
+                                  _mm256_set1_epi16(127))));
+}
+
+// unpack/pack work within 128-bit halves, so pixel order is preserved.
+template <bool kStroke, bool kOpacity, bool kBackground>
+TONO_OVERLAY_TARGET_AVX2 void CompositeAvx2(const uint8_t* fill,
+                                            const uint8_t* stroke,
+                                            uint8_t* out, size_t n,
+                                            const Lanes& l) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i fill16 = _mm256_setr_epi16(
+      l.fill[0], l.fill[1], l.fill[2], l.fill[3], l.fill[0], l.fill[1],
+      l.fill[2], l.fill[3], l.fill[0], l.fill[1], l.fill[2], l.fill[3],
+      l.fill[0], l.fill[1], l.fill[2], l.fill[3]);
+  const __m256i stroke16 = _mm256_setr_epi16(
+      l.stroke[0], l.stroke[1], l.stroke[2], l.stroke[3], l.stroke[0],
+      l.stroke[1], l.stroke[2], l.stroke[3], l.stroke[0], l.stroke[1],
+      l.stroke[2], l.stroke[3], l.stroke[0], l.stroke[1], l.stroke[2],
+      l.stroke[3]);
+  const __m256i background16 = _mm256_setr_epi16(
+      l.background[0], l.background[1], l.background[2], l.background[3],
+      l.background[0], l.background[1], l.background[2], l.background[3],
+      l.background[0], l.background[1], l.background[2], l.background[3],
+      l.background[0], l.background[1], l.background[2], l.background[3]);
+  const __m256i op = _mm256_set1_epi32((int)l.opacity);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i fa = LoadMaskAvx2(fill + i);
+    __m256i sa = zero;
+    if (kStroke) sa = LoadMaskAvx2(stroke + i);
+    if (kOpacity) {
+      fa = ScaleAlphaAvx2(fa, op);
+      if (kStroke) sa = ScaleAlphaAvx2(sa, op);
+    }
+    fa = BroadcastAlphaAvx2(fa);
+    if (kStroke) sa = BroadcastAlphaAvx2(sa);
+    __m256i lo = BlendAvx2<kStroke>(_mm256_unpacklo_epi8(fa, zero),
+                                    _mm256_unpacklo_epi8(sa, zero), fill16,
+                                    stroke16);
+    __m256i hi = BlendAvx2<kStroke>(_mm256_unpackhi_epi8(fa, zero),
+                                    _mm256_unpackhi_epi8(sa, zero), fill16,
+                                    stroke16);
+    if (kBackground) {
+      lo = UnderBackgroundAvx2(lo, background16);
+      hi = UnderBackgroundAvx2(hi, background16);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 4),
+                        _mm256_packus_epi16(lo, hi));
+  }
+  CompositeScalar<kStroke, kOpacity, kBackground>(
+      fill + i, kStroke ? stroke + i : nullptr, out + i * 4, n - i, l);
+}
+
+bool CpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) return false;
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx) return false;
+  if ((_xgetbv(0) & 0x6) != 0x6) return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif  // TONO_OVERLAY_HAVE_AVX2
+
+#if defined(TONO_OVERLAY_HAVE_NEON)
+
+// floor(x / 255), exact for x < 65280 which covers every sum below.
+inline uint16x8_t Div255Neon(uint16x8_t x) {
+  return vshrq_n_u16(vaddq_u16(vaddq_u16(x, vshrq_n_u16(x, 8)),
+                               vdupq_n_u16(1)),
+                     8);
+}
+
+// round(a * b / 255) per byte.
+inline uint8x16_t MulDiv255RoundNeon(uint8x16_t a, uint8x16_t b) {
+  const uint16x8_t bias = vdupq_n_u16(127);
+  uint16x8_t lo = vaddq_u16(vmull_u8(vget_low_u8(a), vget_low_u8(b)), bias);
+  uint16x8_t hi =
+      vaddq_u16(vmull_u8(vget_high_u8(a), vget_high_u8(b)), bias);
+  return vcombine_u8(vmovn_u16(Div255Neon(lo)), vmovn_u16(Div255Neon(hi)));
+}
+
+template <bool kStroke>
+inline uint8x16_t BlendNeon(uint8x16_t fa, uint8x16_t sa, uint8x16_t inv,
+                            uint8_t fill, uint8_t stroke) {
+  const uint8x16_t fc = vdupq_n_u8(fill);
+  uint16x8_t lo = vmull_u8(vget_low_u8(fc), vget_low_u8(fa));
+  uint16x8_t hi = vmull_u8(vget_high_u8(fc), vget_high_u8(fa));
+  if (kStroke) {
+    uint8x16_t s = MulDiv255RoundNeon(vdupq_n_u8(stroke), sa);
+    lo = vmlal_u8(lo, vget_low_u8(s), vget_low_u8(inv));
+    hi = vmlal_u8(hi, vget_high_u8(s), vget_high_u8(inv));
+  }
+  return vcombine_u8(vmovn_u16(Div255Neon(lo)), vmovn_u16(Div255Neon(hi)));
+}
+
+template <bool kStroke, bool kOpacity, bool kBackground>
+void CompositeNeon(const uint8_t* fill, const uint8_t* stroke, uint8_t* out,
+                   size_t n, const Lanes& l) {
+  const uint8x16_t op = vdupq_n_u8((uint8_t)l.opacity);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t fa = vld1q_u8(fill + i);
+    uint8x16_t sa = vdupq_n_u8(0);
+    if (kStroke) sa = vld1q_u8(stroke + i);
+    if (kOpacity) {
+      fa = MulDiv255RoundNeon(fa, op);
+      if (kStroke) sa = MulDiv255RoundNeon(sa, op);
+    }
+    const uint8x16_t inv = vsubq_u8(vdupq_n_u8(255), fa);
+    uint8x16x4_t o;
+    for (int c = 0; c < 4; ++c) {
+      o.val[c] = BlendNeon<kStroke>(fa, sa, inv, l.fill[c], l.stroke[c]);
+    }
+    if (kBackground) {
+      const uint8x16_t under = vsubq_u8(vdupq_n_u8(255), o.val[3]);
+      for (int c = 0; c < 4; ++c) {
+        o.val[c] = vqaddq_u8(
+            o.val[c], MulDiv255RoundNeon(vdupq_n_u8(l.background[c]), under));
+      }
+    }
+    vst4q_u8(out + i * 4, o);
+  }
+  CompositeScalar<kStroke, kOpacity, kBackground>(
+      fill + i, kStroke ? stroke + i : nullptr, out + i * 4, n - i, l);
+}
+
+#endif  // TONO_OVERLAY_HAVE_NEON
+
+// The stroke/opacity/background specializations of one kernel family,
+// indexed by KernelIndex().
+struct KernelSet {
+  KernelFn fn[8];
+};
+
+constexpr int KernelIndex(bool stroke, bool opacity, bool background) {
+  return (stroke ? 4 : 0) | (opacity ? 2 : 0) | (background ? 1 : 0);
+}
+
+#define TONO_OVERLAY_KERNEL_SET(fn)                                  \
+  KernelSet {                                                        \
+    {fn<false, false, false>, fn<false, false, true>,                \
+     fn<false, true, false>, fn<false, true, true>,                  \
+     fn<true, false, false>, fn<true, false, true>,                  \
+     fn<true, true, false>, fn<true, true, true>}                    \
+  }
+
+bool KernelSetFor(CompositorIsa isa, KernelSet* out) {
+  switch (isa) {
+    case CompositorIsa::kScalar:
+      *out = TONO_OVERLAY_KERNEL_SET(CompositeScalar);
+      return true;
+#if defined(TONO_OVERLAY_HAVE_SSE2)
+    case CompositorIsa::kSse2:
+      *out = TONO_OVERLAY_KERNEL_SET(CompositeSse2);
+      return true;
+#endif
+#if defined(TONO_OVERLAY_HAVE_AVX2)
+    case CompositorIsa::kAvx2:
+      if (!CpuHasAvx2()) return false;
+      *out = TONO_OVERLAY_KERNEL_SET(CompositeAvx2);
+      return true;
+#endif
+#if defined(TONO_OVERLAY_HAVE_NEON)
+    case CompositorIsa::kNeon:
+      *out = TONO_OVERLAY_KERNEL_SET(CompositeNeon);
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+#undef TONO_OVERLAY_KERNEL_SET
+
+CompositorIsa DetectIsa() {
+  const CompositorIsa preferred[] = {CompositorIsa::kAvx2, CompositorIsa::kNeon,
+                                     CompositorIsa::kSse2};
+  KernelSet unused;
+  for (CompositorIsa isa : preferred) {
+    if (KernelSetFor(isa, &unused)) return isa;
+  }
+  return CompositorIsa::kScalar;
+}
+
+void RunKernel(const KernelSet& set, const uint8_t* fill,
+               const uint8_t* stroke, uint8_t* out, size_t pixel_count,
+               const Lanes& lanes) {
+  const KernelFn fn = set.fn[KernelIndex(
+      stroke != nullptr, lanes.opacity < 255, lanes.background[3] > 0)];
+  fn(fill, stroke, out, pixel_count, lanes);
+}
+
+const KernelSet& ActiveKernelSet() {
+  static const KernelSet active = [] {
+    KernelSet set;
+    KernelSetFor(ActiveCompositorIsa(), &set);
+    return set;
+  }();
+  return active;
+}
+
+// Radius the plate's corners are actually rounded by: none without a
+// plate, and at most half the layer.
+int PlateRadius(const BackgroundPlate& plate, int width, int height) {
+  if (plate.alpha <= 0) return 0;
+  return std::clamp(plate.corner_radius, 0, std::min(width, height) / 2);
+}
+
+// Coverage 0..255 of pixel (x, y) by a width x height rectangle with
+// corners rounded by |radius|, from the distance of the pixel center to the
+// corner's circle.
+uint32_t PlateCoverage(int x, int y, int width, int height, int radius) {
+  const double px = x + 0.5;
+  const double py = y + 0.5;
+  const double cx = std::clamp(px, (double)radius, (double)(width - radius));
+  const double cy = std::clamp(py, (double)radius, (double)(height - radius));
+  const double d = std::hypot(px - cx, py - cy);
+  return (uint32_t)std::lround(std::clamp(radius + 0.5 - d, 0.0, 1.0) * 255);
+}
+
+}  // namespace
+
+CompositorIsa ActiveCompositorIsa() {
+  static const CompositorIsa isa = DetectIsa();
+  return isa;
+}
+
+const char* CompositorIsaName(CompositorIsa isa) {
+  switch (isa) {
+    case CompositorIsa::kScalar:
+      return "scalar";
+    case CompositorIsa::kSse2:
+      return "sse2";
+    case CompositorIsa::kAvx2:
+      return "avx2";
+    case CompositorIsa::kNeon:
+      return "neon";
+  }
+  return "unknown";
+}
+
+void CompositeStrokeFill(const uint8_t* fill, const uint8_t* stroke,
+                         uint8_t* out, size_t pixel_count,
+                         const CompositeParams& params) {
+  RunKernel(ActiveKernelSet(), fill, stroke, out, pixel_count,
+            MakeLanes(params));
+}
+
+bool CompositeStrokeFillWithIsa(CompositorIsa isa, const uint8_t* fill,
+                                const uint8_t* stroke, uint8_t* out,
+                                size_t pixel_count,
+                                const CompositeParams& params) {
+  KernelSet set;
+  if (!KernelSetFor(isa, &set)) return false;
+  RunKernel(set, fill, stroke, out, pixel_count, MakeLanes(params));
+  return true;
+}
+
+void CompositeLayer(const uint8_t* fill, const uint8_t* stroke, uint8_t* out,
+                    int width, int height, int x_begin, int x_end,
+                    const CompositeParams& params) {
+  x_begin = std::max(x_begin, 0);
+  x_end = std::min(x_end, width);
+  if (x_begin >= x_end || height <= 0) return;
+  const KernelSet& set = ActiveKernelSet();
+  const Lanes lanes = MakeLanes(params);
+  const int radius = PlateRadius(params.background, width, height);
+  // |count| pixels from (x, y) on, under the plate at full alpha.
+  auto run = [&](int y, int x, size_t count) {
+    const size_t offset = (size_t)y * width + x;
+    RunKernel(set, fill + offset, stroke ? stroke + offset : nullptr,
+              out + offset * 4, count, lanes);
+  };
+  const bool whole_rows = x_begin == 0 && x_end == width;
+  // Rows between the corners, as one run when they are whole.
+  if (whole_rows) {
+    run(radius, 0, (size_t)width * (height - 2 * radius));
+  } else {
+    for (int y = radius; y < height - radius; ++y) {
+      run(y, x_begin, (size_t)(x_end - x_begin));
+    }
+  }
+  if (radius == 0) return;
+  Lanes corner = lanes;
+  for (int y = 0; y < height; ++y) {
+    if (y == radius) y = height - radius;
+    int x = x_begin;
+    while (x < x_end) {
+      if (x >= radius && x < width - radius) {
+        const int end = std::min(x_end, width - radius);
+        run(y, x, (size_t)(end - x));
+        x = end;
+        continue;
+      }
+      // A corner pixel: the plate at its coverage.
+      const uint32_t coverage = PlateCoverage(x, y, width, height, radius);
+      PlateLanes(params.background.color,
+                 (int)MulDiv255((uint32_t)lanes.background[3], coverage),
+                 params.format, corner.background);
+      const size_t offset = (size_t)y * width + x;
+      RunKernel(set, fill + offset, stroke ? stroke + offset : nullptr,
+                out + offset * 4, 1, corner);
+      ++x;
+    }
+  }
+}
+
+void MaskToA8(const uint8_t* mask, uint8_t* a8, size_t pixel_count) {
+  for (size_t i = 0; i < pixel_count; ++i) {
+    const uint8_t* px = mask + i * 4;
+    a8[i] = std::max(std::max(px[0], px[1]), px[2]);
+  }
+}
+
+void RenderBackgroundPlate(const BackgroundPlate& plate, PixelFormat format,
+                           int width, int height, uint8_t* out,
+                           size_t stride) {
+  if (width <= 0 || height <= 0) return;
+  uint8_t full[4];
+  PlateLanes(plate.color, plate.alpha, format, full);
+  const int radius = PlateRadius(plate, width, height);
+  for (int y = 0; y < height; ++y) {
+    uint8_t* row = out + (size_t)y * stride;
+    const bool corner_row = y < radius || y >= height - radius;
+    for (int x = 0; x < width; ++x) {
+      uint8_t* px = row + (size_t)x * 4;
+      if (corner_row && (x < radius || x >= width - radius)) {
+        const uint32_t coverage = PlateCoverage(x, y, width, height, radius);
+        PlateLanes(plate.color, (int)MulDiv255(full[3], coverage), format,
+                   px);
+      } else {
+        px[0] = full[0];
+        px[1] = full[1];
+        px[2] = full[2];
+        px[3] = full[3];
+      }
+    }
+  }
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,86 @@
+// compositor.h
+#ifndef OVERLAY_CORE_COMPOSITOR_H_
+#define OVERLAY_CORE_COMPOSITOR_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "overlay_core/surface.h"
+
+namespace tono_overlay {
+
+struct Rgb {
+  uint8_t r = 0;
+  uint8_t g = 0;
+  uint8_t b = 0;
+};
+
+// A solid fill under the text, composited in the same pass: |color| at
+// |alpha| (0 = none) over the whole layer, with the corners rounded by
+// |corner_radius| pixels.
+struct BackgroundPlate {
+  Rgb color;
+  int alpha = 0;
+  int corner_radius = 0;
+};
+
+// Inputs of the stroke/fill composite pass.
+struct CompositeParams {
+  Rgb fill;
+  Rgb stroke;
+  // Text opacity multiplier 0..255 applied to both masks.
+  int text_opacity = 255;
+  BackgroundPlate background;
+  PixelFormat format;
+};
+
+// Instruction set used by a compositor kernel.
+enum class CompositorIsa { kScalar, kSse2, kAvx2, kNeon };
+
+// Composites the fill mask over the stroke mask over the background plate
+// and writes premultiplied 32-bit pixels to |out|. Masks are A8: one
+// coverage byte per pixel. |stroke| may be null when no stroke is drawn.
+// All buffers hold |pixel_count| tightly packed pixels, all under the plate
+// at full alpha: corners are left to CompositeLayer(). The best kernel for
+// the running CPU is picked on first use.
+void CompositeStrokeFill(const uint8_t* fill, const uint8_t* stroke,
+                         uint8_t* out, size_t pixel_count,
+                         const CompositeParams& params);
+
+// Same as CompositeStrokeFill but forces the kernel for |isa|. Returns false
+// (and leaves |out| untouched) if that kernel is not available on this CPU
+// or was not compiled in.
+bool CompositeStrokeFillWithIsa(CompositorIsa isa, const uint8_t* fill,
+                                const uint8_t* stroke, uint8_t* out,
+                                size_t pixel_count,
+                                const CompositeParams& params);
+
+// Composites columns [x_begin, x_end) of a width x height layer of tightly
+// packed rows (width bytes per mask row, width * 4 per output row), like
+// CompositeStrokeFill, with the plate's corners rounded and anti-aliased.
+// 0 and |width| composite the whole layer.
+void CompositeLayer(const uint8_t* fill, const uint8_t* stroke, uint8_t* out,
+                    int width, int height, int x_begin, int x_end,
+                    const CompositeParams& params);
+
+// Writes the premultiplied pixels of |plate| alone for a width x height
+// layer, |stride| bytes per row: what CompositeLayer() draws where there is
+// no text.
+void RenderBackgroundPlate(const BackgroundPlate& plate, PixelFormat format,
+                           int width, int height, uint8_t* out,
+                           size_t stride);
+
+// Reduces a 32-bit white-on-black text mask, whose coverage is the max of
+// the R/G/B bytes, to |pixel_count| A8 coverage bytes. For rasterizers that
+// can only draw 32-bit pixels (GDI ClearType).
+void MaskToA8(const uint8_t* mask, uint8_t* a8, size_t pixel_count);
+
+// Returns the kernel CompositeStrokeFill dispatches to.
+CompositorIsa ActiveCompositorIsa();
+
+// Returns a short lowercase name ("scalar", "sse2", ...) for logging.
+const char* CompositorIsaName(CompositorIsa isa);
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_COMPOSITOR_H_
@@ -0,0 +1,81 @@
+// font_cache.cc
+#include "overlay_core/font_cache.h"
+
+#include <utility>
+
+#include "overlay_core/line_cache.h"
+#include "overlay_core/overlay_stats.h"
+
+namespace tono_overlay {
+
+uint64_t FontKeyHash(const FontKey& key) {
+  return HashBuilder()
+      .Add(key.family)
+      .Add((int64_t)key.size_pt)
+      .Add((int64_t)key.weight)
+      .Add((int64_t)key.dpi)
+      .hash();
+}
+
+FontCache::FontCache(std::unique_ptr<FontFactory> factory, size_t capacity)
+    : factory_(std::move(factory)), capacity_(capacity > 0 ? capacity : 1) {}
+
+std::shared_ptr<FontInstance> FontCache::Get(const FontKey& key) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      ++hits_;
+      return it->second->font;
+    }
+    ++misses_;
+  }
+  // Opened without the lock, so hits on other threads do not wait for it.
+  std::shared_ptr<FontInstance> font;
+  {
+    ScopedStageTimer timer(TimingStage::kFont);
+    font = factory_->Open(key);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    // Another thread opened it meanwhile; share that one.
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->font;
+  }
+  entries_.push_front(Entry{key, font});
+  index_[key] = entries_.begin();
+  while (entries_.size() > capacity_) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+    ++evictions_;
+  }
+  return font;
+}
+
+void FontCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  index_.clear();
+  entries_.clear();
+}
+
+FontCacheStats FontCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FontCacheStats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.evictions = evictions_;
+  stats.entries = entries_.size();
+  stats.capacity = capacity_;
+  return stats;
+}
+
+void FontCache::ResetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  hits_ = 0;
+  misses_ = 0;
+  evictions_ = 0;
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,122 @@
+// font_cache.h
+#ifndef OVERLAY_CORE_FONT_CACHE_H_
+#define OVERLAY_CORE_FONT_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace tono_overlay {
+
+// Everything that selects a platform font instance.
+struct FontKey {
+  std::string family;
+  int size_pt = 0;
+  int weight = 400;  // 100..900, with OverlayStyle::font_bold folded in
+  int dpi = 96;
+
+  bool operator==(const FontKey& other) const {
+    return size_pt == other.size_pt && weight == other.weight &&
+           dpi == other.dpi && family == other.family;
+  }
+  bool operator!=(const FontKey& other) const { return !(*this == other); }
+};
+
+uint64_t FontKeyHash(const FontKey& key);
+
+// Vertical metrics of a font instance, in pixels.
+struct FontMetrics {
+  int ascent = 0;
+  int descent = 0;   // positive, below the baseline
+  int height = 0;    // ascent + descent: one line of ink
+  // Baseline to baseline of wrapped lines, leading included.
+  int line_height = 0;
+};
+
+// One font at one size, as the platform opened it (an HFONT, a FreeType
+// face). Backends derive from it and downcast what their FontFactory
+// returned.
+class FontInstance {
+ public:
+  virtual ~FontInstance() = default;
+
+  const FontMetrics& metrics() const { return metrics_; }
+
+ protected:
+  FontMetrics metrics_;
+};
+
+class FontFactory {
+ public:
+  virtual ~FontFactory() = default;
+
+  // Opens the font for |key| and measures it; null if the platform has
+  // nothing usable.
+  virtual std::unique_ptr<FontInstance> Open(const FontKey& key) = 0;
+};
+
+struct FontCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  size_t entries = 0;
+  size_t capacity = 0;
+};
+
+// Bounded LRU of open fonts with their metrics, so switching between a few
+// styles opens each font once. Fonts are handed out as shared pointers: an
+// evicted font stays valid for whoever still draws with it. Failed opens
+// are cached too, so a missing family is not looked up on every frame.
+// Thread-safe; sharing one cache across threads also shares its fonts,
+// which the backend must allow.
+class FontCache {
+ public:
+  static constexpr size_t kDefaultCapacity = 8;
+
+  explicit FontCache(std::unique_ptr<FontFactory> factory,
+                     size_t capacity = kDefaultCapacity);
+
+  FontCache(const FontCache&) = delete;
+  FontCache& operator=(const FontCache&) = delete;
+
+  // The font for |key|, opened on a miss (timed as TimingStage::kFont).
+  // Null if the factory failed for this key.
+  std::shared_ptr<FontInstance> Get(const FontKey& key);
+
+  // Drops every font; counters are kept.
+  void Clear();
+
+  FontCacheStats stats() const;
+  void ResetStats();
+
+ private:
+  struct KeyHash {
+    size_t operator()(const FontKey& key) const {
+      return (size_t)FontKeyHash(key);
+    }
+  };
+  struct Entry {
+    FontKey key;
+    std::shared_ptr<FontInstance> font;
+  };
+  using EntryList = std::list<Entry>;
+
+  std::unique_ptr<FontFactory> factory_;
+  const size_t capacity_;
+
+  mutable std::mutex mutex_;
+  // Most recently used at the front.
+  EntryList entries_;
+  std::unordered_map<FontKey, EntryList::iterator, KeyHash> index_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  uint64_t evictions_ = 0;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_FONT_CACHE_H_
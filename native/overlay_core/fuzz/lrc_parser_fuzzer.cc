@@ -0,0 +1,41 @@
+// lrc_parser_fuzzer.cc
+//
+// libFuzzer target for LrcParser. The input is split at the first NUL into
+// the lyric and translation streams. Crashes, sanitizer reports and broken
+// invariants (unsorted output, views outside the input) are findings.
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+#include "overlay_core/lrc_parser.h"
+
+namespace {
+
+bool Within(std::string_view view, std::string_view buffer) {
+  if (view.empty()) return true;
+  return view.data() >= buffer.data() &&
+         view.data() + view.size() <= buffer.data() + buffer.size();
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  const std::string_view input(reinterpret_cast<const char*>(data), size);
+  const size_t split = input.find('\0');
+  const std::string_view lyric = input.substr(0, split);
+  const std::string_view translation =
+      split == std::string_view::npos ? std::string_view()
+                                      : input.substr(split + 1);
+
+  static tono_overlay::LrcParser parser;
+  const auto& lines = parser.Parse(lyric, translation);
+  int64_t previous = 0;
+  for (const tono_overlay::LrcLine& line : lines) {
+    if (line.time_ms < previous) std::abort();
+    previous = line.time_ms;
+    if (!Within(line.text, lyric)) std::abort();
+    if (!Within(line.translation, translation)) std::abort();
+  }
+  return 0;
+}
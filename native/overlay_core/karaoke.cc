@@ -0,0 +1,62 @@
+// karaoke.cc
+#include "overlay_core/karaoke.h"
+
+#include <algorithm>
+
+namespace tono_overlay {
+
+int KaraokeSweepX(const std::vector<KaraokeSegment>& segments,
+                  int64_t time_ms) {
+  int x = 0;
+  for (const KaraokeSegment& s : segments) {
+    if (time_ms < s.start_ms) break;
+    if (time_ms >= s.end_ms || s.end_ms <= s.start_ms) {
+      x = s.x_end;
+      continue;
+    }
+    const double t =
+        (double)(time_ms - s.start_ms) / (double)(s.end_ms - s.start_ms);
+    return s.x_begin + (int)((s.x_end - s.x_begin) * t);
+  }
+  return x;
+}
+
+void KaraokeCompositor::Reset(const uint8_t* fill, const uint8_t* stroke,
+                              uint8_t* out, int width, int height,
+                              const CompositeParams& base, Rgb highlight) {
+  fill_ = fill;
+  stroke_ = stroke;
+  out_ = out;
+  width_ = std::max(width, 0);
+  height_ = std::max(height, 0);
+  base_ = base;
+  highlight_ = base;
+  highlight_.fill = highlight;
+  sweep_ = 0;
+  CompositeLayer(fill_, stroke_, out_, width_, height_, 0, width_, base_);
+}
+
+bool KaraokeCompositor::SetSweep(int x, int* dirty_begin, int* dirty_end) {
+  x = std::clamp(x, 0, width_);
+  if (x == sweep_) return false;
+  if (x > sweep_) {
+    CompositeColumns(sweep_, x, highlight_);
+    *dirty_begin = sweep_;
+    *dirty_end = x;
+  } else {
+    // Seeking back un-highlights.
+    CompositeColumns(x, sweep_, base_);
+    *dirty_begin = x;
+    *dirty_end = sweep_;
+  }
+  sweep_ = x;
+  return true;
+}
+
+void KaraokeCompositor::CompositeColumns(int x_begin, int x_end,
+                                         const CompositeParams& params) {
+  CompositeLayer(fill_, stroke_, out_, width_, height_, x_begin, x_end,
+                 params);
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,63 @@
+// karaoke.h
+#ifndef OVERLAY_CORE_KARAOKE_H_
+#define OVERLAY_CORE_KARAOKE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "overlay_core/compositor.h"
+
+namespace tono_overlay {
+
+// One timed word of a karaoke line: the sweep moves from |x_begin| to
+// |x_end| (pixels) while playback goes from |start_ms| to |end_ms|.
+struct KaraokeSegment {
+  int64_t start_ms = 0;
+  int64_t end_ms = 0;
+  int x_begin = 0;
+  int x_end = 0;
+};
+
+// Sweep position at |time_ms| for segments sorted by time: linear inside a
+// segment, held at a segment's end until the next one starts. Returns 0
+// before the first segment.
+int KaraokeSweepX(const std::vector<KaraokeSegment>& segments,
+                  int64_t time_ms);
+
+// Composites a karaoke line whose fill and stroke masks were rasterized
+// once: columns left of the sweep use the highlight fill color, the rest
+// the base one. Moving the sweep only recomposites the columns it crossed.
+class KaraokeCompositor {
+ public:
+  // Binds the masks and output of a w x h line (the buffers of
+  // CompositeLayer; |stroke| may be null) and composites it, background
+  // plate included, with the sweep at column 0. The buffers must stay
+  // valid until the next Reset().
+  void Reset(const uint8_t* fill, const uint8_t* stroke, uint8_t* out,
+             int width, int height, const CompositeParams& base,
+             Rgb highlight);
+
+  // Moves the sweep to column |x| (clamped to the line). Returns false if
+  // nothing changed; otherwise [*dirty_begin, *dirty_end) is the column
+  // range that was rewritten.
+  bool SetSweep(int x, int* dirty_begin, int* dirty_end);
+
+  int sweep() const { return sweep_; }
+  int width() const { return width_; }
+
+ private:
+  void CompositeColumns(int x_begin, int x_end, const CompositeParams& params);
+
+  const uint8_t* fill_ = nullptr;
+  const uint8_t* stroke_ = nullptr;
+  uint8_t* out_ = nullptr;
+  int width_ = 0;
+  int height_ = 0;
+  CompositeParams base_;
+  CompositeParams highlight_;
+  int sweep_ = 0;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_KARAOKE_H_
@@ -0,0 +1,385 @@
+// line_breaker.cc
+#include "overlay_core/line_breaker.h"
+
+#include <algorithm>
+
+namespace tono_overlay {
+
+namespace {
+
+using C = LineBreakClass;
+
+constexpr uint32_t kReplacementChar = 0xFFFD;
+
+C AsciiClass(uint32_t cp) {
+  if (cp >= '0' && cp <= '9') return C::kNU;
+  if ((cp >= 'A' && cp <= 'Z') || (cp >= 'a' && cp <= 'z')) return C::kAL;
+  switch (cp) {
+    case '\t':
+      return C::kBA;
+    case '\n':
+      return C::kLF;
+    case '\v':
+    case '\f':
+      return C::kBK;
+    case '\r':
+      return C::kCR;
+    case ' ':
+      return C::kSP;
+    case '!':
+    case '?':
+      return C::kEX;
+    case '"':
+    case '\'':
+      return C::kQU;
+    case '$':
+    case '+':
+    case '\\':
+      return C::kPR;
+    case '%':
+      return C::kPO;
+    case '(':
+    case '[':
+    case '{':
+      return C::kOP;
+    case ')':
+    case ']':
+      return C::kCP;
+    case '}':
+      return C::kCL;
+    case ',':
+    case '.':
+    case ':':
+    case ';':
+      return C::kIS;
+    case '-':
+      return C::kHY;
+    case '/':
+      return C::kSY;
+    case '|':
+      return C::kBA;
+    default:
+      return cp < 0x20 || cp == 0x7F ? C::kCM : C::kAL;
+  }
+}
+
+struct ClassRange {
+  uint32_t first;
+  uint32_t last;
+  C cls;
+};
+
+// Code points above ASCII whose class is not AL, sorted. Covers the
+// punctuation, CJK and combining ranges lyrics use; rarer scripts fall
+// back to AL, which only ever removes break opportunities.
+constexpr ClassRange kRanges[] = {
+    {0x0080, 0x0084, C::kCM},   {0x0085, 0x0085, C::kNL},
+    {0x0086, 0x009F, C::kCM},   {0x00A0, 0x00A0, C::kGL},
+    {0x00A1, 0x00A1, C::kOP},   {0x00A2, 0x00A2, C::kPO},
+    {0x00A3, 0x00A5, C::kPR},   {0x00AB, 0x00AB, C::kQU},
+    {0x00AD, 0x00AD, C::kBA},   {0x00B0, 0x00B0, C::kPO},
+    {0x00B1, 0x00B1, C::kPR},   {0x00B4, 0x00B4, C::kBB},
+    {0x00BB, 0x00BB, C::kQU},   {0x00BF, 0x00BF, C::kOP},
+    {0x02C8, 0x02C8, C::kBB},   {0x02CC, 0x02CC, C::kBB},
+    {0x02DF, 0x02DF, C::kBB},   {0x0300, 0x034E, C::kCM},
+    {0x034F, 0x034F, C::kGL},   {0x0350, 0x035B, C::kCM},
+    {0x035C, 0x0362, C::kGL},   {0x0363, 0x036F, C::kCM},
+    {0x037E, 0x037E, C::kIS},   {0x0483, 0x0489, C::kCM},
+    {0x0589, 0x0589, C::kIS},   {0x058A, 0x058A, C::kBA},
+    {0x0591, 0x05BD, C::kCM},   {0x05BE, 0x05BE, C::kBA},
+    {0x05BF, 0x05BF, C::kCM},   {0x05C1, 0x05C2, C::kCM},
+    {0x05C4, 0x05C5, C::kCM},   {0x05C7, 0x05C7, C::kCM},
+    {0x060C, 0x060D, C::kIS},   {0x0610, 0x061A, C::kCM},
+    {0x061F, 0x061F, C::kEX},   {0x064B, 0x065F, C::kCM},
+    {0x0660, 0x0669, C::kNU},   {0x066A, 0x066A, C::kPO},
+    {0x066B, 0x066C, C::kNU},   {0x0670, 0x0670, C::kCM},
+    {0x06D4, 0x06D4, C::kEX},   {0x06D6, 0x06DC, C::kCM},
+    {0x06DF, 0x06E4, C::kCM},   {0x06E7, 0x06E8, C::kCM},
+    {0x06EA, 0x06ED, C::kCM},   {0x06F0, 0x06F9, C::kNU},
+    {0x0900, 0x0903, C::kCM},   {0x093A, 0x093C, C::kCM},
+    {0x093E, 0x094F, C::kCM},   {0x0951, 0x0957, C::kCM},
+    {0x0962, 0x0963, C::kCM},   {0x0964, 0x0965, C::kBA},
+    {0x0966, 0x096F, C::kNU},   {0x0E31, 0x0E31, C::kCM},
+    {0x0E34, 0x0E3A, C::kCM},   {0x0E3F, 0x0E3F, C::kPR},
+    {0x0E47, 0x0E4E, C::kCM},   {0x0E50, 0x0E59, C::kNU},
+    {0x0E5A, 0x0E5B, C::kBA},   {0x0EB1, 0x0EB1, C::kCM},
+    {0x0EB4, 0x0EBC, C::kCM},   {0x0EC8, 0x0ECE, C::kCM},
+    {0x0F0B, 0x0F0B, C::kBA},   {0x1100, 0x11FF, C::kID},
+    {0x1680, 0x1680, C::kBA},   {0x17D4, 0x17D5, C::kBA},
+    {0x1AB0, 0x1AFF, C::kCM},   {0x1DC0, 0x1DFF, C::kCM},
+    {0x2000, 0x2006, C::kBA},   {0x2007, 0x2007, C::kGL},
+    {0x2008, 0x200A, C::kBA},   {0x200B, 0x200B, C::kZW},
+    {0x200C, 0x200C, C::kCM},   {0x200D, 0x200D, C::kZWJ},
+    {0x200E, 0x200F, C::kCM},   {0x2010, 0x2010, C::kBA},
+    {0x2011, 0x2011, C::kGL},   {0x2012, 0x2013, C::kBA},
+    {0x2014, 0x2014, C::kB2},   {0x2018, 0x2019, C::kQU},
+    {0x201A, 0x201A, C::kOP},   {0x201B, 0x201D, C::kQU},
+    {0x201E, 0x201E, C::kOP},   {0x201F, 0x201F, C::kQU},
+    {0x2024, 0x2026, C::kIN},   {0x2027, 0x2027, C::kBA},
+    {0x2028, 0x2029, C::kBK},   {0x202A, 0x202E, C::kCM},
+    {0x202F, 0x202F, C::kGL},   {0x2030, 0x2037, C::kPO},
+    {0x2039, 0x203A, C::kQU},   {0x203C, 0x203D, C::kNS},
+    {0x2044, 0x2044, C::kIS},   {0x2045, 0x2045, C::kOP},
+    {0x2046, 0x2046, C::kCL},   {0x2047, 0x2049, C::kNS},
+    {0x2060, 0x2060, C::kWJ},   {0x2066, 0x206F, C::kCM},
+    {0x207D, 0x207D, C::kOP},   {0x207E, 0x207E, C::kCL},
+    {0x208D, 0x208D, C::kOP},   {0x208E, 0x208E, C::kCL},
+    {0x20A0, 0x20A6, C::kPR},   {0x20A7, 0x20A7, C::kPO},
+    {0x20A8, 0x20CF, C::kPR},   {0x20D0, 0x20FF, C::kCM},
+    {0x2103, 0x2103, C::kPO},   {0x2109, 0x2109, C::kPO},
+    {0x2116, 0x2116, C::kPR},   {0x2212, 0x2213, C::kPR},
+    {0x2308, 0x2308, C::kOP},   {0x2309, 0x2309, C::kCL},
+    {0x230A, 0x230A, C::kOP},   {0x230B, 0x230B, C::kCL},
+    {0x2329, 0x2329, C::kOP},   {0x232A, 0x232A, C::kCL},
+    {0x2E80, 0x2FFF, C::kID},   {0x3000, 0x3000, C::kBA},
+    {0x3001, 0x3002, C::kCL},   {0x3003, 0x3004, C::kID},
+    {0x3005, 0x3005, C::kNS},   {0x3006, 0x3007, C::kID},
+    {0x3008, 0x3008, C::kOP},   {0x3009, 0x3009, C::kCL},
+    {0x300A, 0x300A, C::kOP},   {0x300B, 0x300B, C::kCL},
+    {0x300C, 0x300C, C::kOP},   {0x300D, 0x300D, C::kCL},
+    {0x300E, 0x300E, C::kOP},   {0x300F, 0x300F, C::kCL},
+    {0x3010, 0x3010, C::kOP},   {0x3011, 0x3011, C::kCL},
+    {0x3012, 0x3013, C::kID},   {0x3014, 0x3014, C::kOP},
+    {0x3015, 0x3015, C::kCL},   {0x3016, 0x3016, C::kOP},
+    {0x3017, 0x3017, C::kCL},   {0x3018, 0x3018, C::kOP},
+    {0x3019, 0x3019, C::kCL},   {0x301A, 0x301A, C::kOP},
+    {0x301B, 0x301B, C::kCL},   {0x301C, 0x301C, C::kNS},
+    {0x301D, 0x301D, C::kOP},   {0x301E, 0x301F, C::kCL},
+    {0x3020, 0x3029, C::kID},   {0x302A, 0x302F, C::kCM},
+    {0x3030, 0x303A, C::kID},   {0x303B, 0x303C, C::kNS},
+    {0x303D, 0x3040, C::kID},   {0x3041, 0x3041, C::kNS},
+    {0x3042, 0x3042, C::kID},   {0x3043, 0x3043, C::kNS},
+    {0x3044, 0x3044, C::kID},   {0x3045, 0x3045, C::kNS},
+    {0x3046, 0x3046, C::kID},   {0x3047, 0x3047, C::kNS},
+    {0x3048, 0x3048, C::kID},   {0x3049, 0x3049, C::kNS},
+    {0x304A, 0x3062, C::kID},   {0x3063, 0x3063, C::kNS},
+    {0x3064, 0x3082, C::kID},   {0x3083, 0x3083, C::kNS},
+    {0x3084, 0x3084, C::kID},   {0x3085, 0x3085, C::kNS},
+    {0x3086, 0x3086, C::kID},   {0x3087, 0x3087, C::kNS},
+    {0x3088, 0x308D, C::kID},   {0x308E, 0x308E, C::kNS},
+    {0x308F, 0x3094, C::kID},   {0x3095, 0x3096, C::kNS},
+    {0x3097, 0x3098, C::kID},   {0x3099, 0x309A, C::kCM},
+    {0x309B, 0x309E, C::kNS},   {0x309F, 0x309F, C::kID},
+    {0x30A0, 0x30A1, C::kNS},   {0x30A2, 0x30A2, C::kID},
+    {0x30A3, 0x30A3, C::kNS},   {0x30A4, 0x30A4, C::kID},
+    {0x30A5, 0x30A5, C::kNS},   {0x30A6, 0x30A6, C::kID},
+    {0x30A7, 0x30A7, C::kNS},   {0x30A8, 0x30A8, C::kID},
+    {0x30A9, 0x30A9, C::kNS},   {0x30AA, 0x30C2, C::kID},
+    {0x30C3, 0x30C3, C::kNS},   {0x30C4, 0x30E2, C::kID},
+    {0x30E3, 0x30E3, C::kNS},   {0x30E4, 0x30E4, C::kID},
+    {0x30E5, 0x30E5, C::kNS},   {0x30E6, 0x30E6, C::kID},
+    {0x30E7, 0x30E7, C::kNS},   {0x30E8, 0x30ED, C::kID},
+    {0x30EE, 0x30EE, C::kNS},   {0x30EF, 0x30F4, C::kID},
+    {0x30F5, 0x30F6, C::kNS},   {0x30F7, 0x30FA, C::kID},
+    {0x30FB, 0x30FE, C::kNS},   {0x30FF, 0x31EF, C::kID},
+    {0x31F0, 0x31FF, C::kNS},   {0x3200, 0x4DBF, C::kID},
+    {0x4E00, 0x9FFF, C::kID},   {0xA000, 0xA4CF, C::kID},
+    {0xA960, 0xA97F, C::kID},   {0xAC00, 0xD7FF, C::kID},
+    {0xF900, 0xFAFF, C::kID},   {0xFE00, 0xFE0F, C::kCM},
+    {0xFE10, 0xFE10, C::kIS},   {0xFE11, 0xFE12, C::kCL},
+    {0xFE13, 0xFE14, C::kIS},   {0xFE15, 0xFE16, C::kEX},
+    {0xFE17, 0xFE17, C::kOP},   {0xFE18, 0xFE18, C::kCL},
+    {0xFE19, 0xFE19, C::kIN},   {0xFE20, 0xFE2F, C::kCM},
+    {0xFE30, 0xFE34, C::kID},   {0xFE35, 0xFE35, C::kOP},
+    {0xFE36, 0xFE36, C::kCL},   {0xFE37, 0xFE37, C::kOP},
+    {0xFE38, 0xFE38, C::kCL},   {0xFE39, 0xFE39, C::kOP},
+    {0xFE3A, 0xFE3A, C::kCL},   {0xFE3B, 0xFE3B, C::kOP},
+    {0xFE3C, 0xFE3C, C::kCL},   {0xFE3D, 0xFE3D, C::kOP},
+    {0xFE3E, 0xFE3E, C::kCL},   {0xFE3F, 0xFE3F, C::kOP},
+    {0xFE40, 0xFE40, C::kCL},   {0xFE41, 0xFE41, C::kOP},
+    {0xFE42, 0xFE42, C::kCL},   {0xFE43, 0xFE43, C::kOP},
+    {0xFE44, 0xFE44, C::kCL},   {0xFE45, 0xFE46, C::kID},
+    {0xFE47, 0xFE47, C::kOP},   {0xFE48, 0xFE48, C::kCL},
+    {0xFE49, 0xFE4F, C::kID},   {0xFE50, 0xFE50, C::kCL},
+    {0xFE51, 0xFE51, C::kID},   {0xFE52, 0xFE52, C::kCL},
+    {0xFE53, 0xFE53, C::kID},   {0xFE54, 0xFE55, C::kNS},
+    {0xFE56, 0xFE57, C::kEX},   {0xFE58, 0xFE58, C::kID},
+    {0xFE59, 0xFE59, C::kOP},   {0xFE5A, 0xFE5A, C::kCL},
+    {0xFE5B, 0xFE5B, C::kOP},   {0xFE5C, 0xFE5C, C::kCL},
+    {0xFE5D, 0xFE5D, C::kOP},   {0xFE5E, 0xFE5E, C::kCL},
+    {0xFE5F, 0xFE68, C::kID},   {0xFE69, 0xFE69, C::kPR},
+    {0xFE6A, 0xFE6A, C::kPO},   {0xFE6B, 0xFE6B, C::kID},
+    {0xFEFF, 0xFEFF, C::kWJ},   {0xFF01, 0xFF01, C::kEX},
+    {0xFF02, 0xFF03, C::kID},   {0xFF04, 0xFF04, C::kPR},
+    {0xFF05, 0xFF05, C::kPO},   {0xFF06, 0xFF07, C::kID},
+    {0xFF08, 0xFF08, C::kOP},   {0xFF09, 0xFF09, C::kCL},
+    {0xFF0A, 0xFF0B, C::kID},   {0xFF0C, 0xFF0C, C::kCL},
+    {0xFF0D, 0xFF0D, C::kID},   {0xFF0E, 0xFF0E, C::kCL},
+    {0xFF0F, 0xFF19, C::kID},   {0xFF1A, 0xFF1B, C::kNS},
+    {0xFF1C, 0xFF1E, C::kID},   {0xFF1F, 0xFF1F, C::kEX},
+    {0xFF20, 0xFF3A, C::kID},   {0xFF3B, 0xFF3B, C::kOP},
+    {0xFF3C, 0xFF3C, C::kID},   {0xFF3D, 0xFF3D, C::kCL},
+    {0xFF3E, 0xFF5A, C::kID},   {0xFF5B, 0xFF5B, C::kOP},
+    {0xFF5C, 0xFF5C, C::kID},   {0xFF5D, 0xFF5D, C::kCL},
+    {0xFF5E, 0xFF5E, C::kID},   {0xFF5F, 0xFF5F, C::kOP},
+    {0xFF60, 0xFF61, C::kCL},   {0xFF62, 0xFF62, C::kOP},
+    {0xFF63, 0xFF64, C::kCL},   {0xFF65, 0xFF65, C::kNS},
+    {0xFF66, 0xFF66, C::kID},   {0xFF67, 0xFF70, C::kNS},
+    {0xFF71, 0xFF9D, C::kID},   {0xFF9E, 0xFF9F, C::kNS},
+    {0xFFA0, 0xFFDC, C::kID},   {0xFFE0, 0xFFE0, C::kPO},
+    {0xFFE1, 0xFFE1, C::kPR},   {0xFFE2, 0xFFE4, C::kID},
+    {0xFFE5, 0xFFE6, C::kPR},   {0x1F000, 0x1F0FF, C::kID},
+    {0x1F1E6, 0x1F1FF, C::kRI}, {0x1F200, 0x1F3FA, C::kID},
+    {0x1F3FB, 0x1F3FF, C::kEM}, {0x1F400, 0x1FAFF, C::kID},
+    {0x20000, 0x3FFFD, C::kID}, {0xE0001, 0xE007F, C::kCM},
+    {0xE0100, 0xE01EF, C::kCM},
+};
+
+bool IsAny(C c, std::initializer_list<C> set) {
+  return std::find(set.begin(), set.end(), c) != set.end();
+}
+
+// Lone combining marks and joiners act as AL (LB10).
+C Base(C c) { return c == C::kCM || c == C::kZWJ ? C::kAL : c; }
+
+// State carried across the pairs of FindLineBreaks().
+struct BreakContext {
+  C prev;               // class before the position, after LB9 and LB10
+  bool prev_zwj;        // the code point before is a ZWJ (LB8a)
+  C before_spaces;      // last class before a run of spaces (LB14-LB17)
+  bool zw_before_spaces;  // LB8: ZW SP* ÷
+  int ri_run;           // regional indicators ending at the position
+};
+
+BreakAction Decide(const BreakContext& ctx, C cur) {
+  const C a = ctx.prev;
+  if (a == C::kBK) return BreakAction::kMandatory;                  // LB4
+  if (a == C::kCR && cur == C::kLF) return BreakAction::kProhibited;  // LB5
+  if (IsAny(a, {C::kCR, C::kLF, C::kNL})) return BreakAction::kMandatory;
+  if (IsAny(cur, {C::kBK, C::kCR, C::kLF, C::kNL})) {                // LB6
+    return BreakAction::kProhibited;
+  }
+  if (cur == C::kSP || cur == C::kZW) return BreakAction::kProhibited;  // LB7
+  if (ctx.zw_before_spaces) return BreakAction::kAllowed;            // LB8
+  if (ctx.prev_zwj) return BreakAction::kProhibited;                 // LB8a
+  if ((cur == C::kCM || cur == C::kZWJ) && a != C::kSP) {            // LB9
+    return BreakAction::kProhibited;
+  }
+  const C b = Base(cur);
+  if (a == C::kWJ || b == C::kWJ) return BreakAction::kProhibited;   // LB11
+  if (a == C::kGL) return BreakAction::kProhibited;                  // LB12
+  if (b == C::kGL && !IsAny(a, {C::kSP, C::kBA, C::kHY})) {          // LB12a
+    return BreakAction::kProhibited;
+  }
+  if (IsAny(b, {C::kCL, C::kCP, C::kEX, C::kIS, C::kSY})) {          // LB13
+    return BreakAction::kProhibited;
+  }
+  const C s = ctx.before_spaces;
+  if (s == C::kOP) return BreakAction::kProhibited;                  // LB14
+  if (s == C::kQU && b == C::kOP) return BreakAction::kProhibited;   // LB15
+  if ((s == C::kCL || s == C::kCP) && b == C::kNS) {                 // LB16
+    return BreakAction::kProhibited;
+  }
+  if (s == C::kB2 && b == C::kB2) return BreakAction::kProhibited;   // LB17
+  if (a == C::kSP) return BreakAction::kAllowed;                     // LB18
+  if (a == C::kQU || b == C::kQU) return BreakAction::kProhibited;   // LB19
+  if (IsAny(b, {C::kBA, C::kHY, C::kNS}) || a == C::kBB) {           // LB21
+    return BreakAction::kProhibited;
+  }
+  if (b == C::kIN) return BreakAction::kProhibited;                  // LB22
+  if ((a == C::kAL && b == C::kNU) || (a == C::kNU && b == C::kAL)) {  // LB23
+    return BreakAction::kProhibited;
+  }
+  if ((a == C::kPR && (b == C::kID || b == C::kEM)) ||               // LB23a
+      ((a == C::kID || a == C::kEM) && b == C::kPO)) {
+    return BreakAction::kProhibited;
+  }
+  if ((IsAny(a, {C::kPR, C::kPO}) && b == C::kAL) ||                 // LB24
+      (a == C::kAL && IsAny(b, {C::kPR, C::kPO}))) {
+    return BreakAction::kProhibited;
+  }
+  if ((IsAny(a, {C::kCL, C::kCP, C::kNU}) && IsAny(b, {C::kPO, C::kPR})) ||
+      (IsAny(a, {C::kPO, C::kPR}) && IsAny(b, {C::kOP, C::kNU})) ||
+      (IsAny(a, {C::kHY, C::kIS, C::kNU, C::kSY}) && b == C::kNU)) {  // LB25
+    return BreakAction::kProhibited;
+  }
+  if (a == C::kAL && b == C::kAL) return BreakAction::kProhibited;   // LB28
+  if (a == C::kIS && b == C::kAL) return BreakAction::kProhibited;   // LB29
+  // LB30, without its East Asian Width exception for OP.
+  if ((IsAny(a, {C::kAL, C::kNU}) && b == C::kOP) ||
+      (a == C::kCP && IsAny(b, {C::kAL, C::kNU}))) {
+    return BreakAction::kProhibited;
+  }
+  if (a == C::kRI && b == C::kRI && ctx.ri_run % 2 == 1) {           // LB30a
+    return BreakAction::kProhibited;
+  }
+  // LB30b, for every emoji since the table does not tell EB from ID.
+  if (a == C::kID && b == C::kEM) return BreakAction::kProhibited;
+  return BreakAction::kAllowed;                                      // LB31
+}
+
+}  // namespace
+
+LineBreakClass LineBreakClassOf(uint32_t codepoint) {
+  if (codepoint < 0x80) return AsciiClass(codepoint);
+  const ClassRange* end = kRanges + sizeof(kRanges) / sizeof(kRanges[0]);
+  const ClassRange* it = std::upper_bound(
+      kRanges, end, codepoint,
+      [](uint32_t cp, const ClassRange& range) { return cp < range.first; });
+  if (it == kRanges) return C::kAL;
+  --it;
+  return codepoint <= it->last ? it->cls : C::kAL;
+}
+
+void FindLineBreaks(const LineBreakClass* classes, size_t n,
+                    std::vector<BreakAction>* breaks) {
+  breaks->assign(n + 1, BreakAction::kProhibited);
+  if (n == 0) return;
+  (*breaks)[n] = BreakAction::kMandatory;
+  BreakContext ctx;
+  ctx.prev = Base(classes[0]);
+  ctx.prev_zwj = classes[0] == C::kZWJ;
+  ctx.before_spaces = ctx.prev;
+  ctx.zw_before_spaces = classes[0] == C::kZW;
+  ctx.ri_run = ctx.prev == C::kRI ? 1 : 0;
+  for (size_t i = 1; i < n; ++i) {
+    const C cur = classes[i];
+    (*breaks)[i] = Decide(ctx, cur);
+    // LB9: a mark or joiner takes the class of what it attaches to.
+    const bool attached =
+        (cur == C::kCM || cur == C::kZWJ) &&
+        !IsAny(ctx.prev, {C::kBK, C::kCR, C::kLF, C::kNL, C::kSP, C::kZW});
+    if (!attached) {
+      const C next = Base(cur);
+      ctx.ri_run = next == C::kRI ? ctx.ri_run + 1 : 0;
+      ctx.prev = next;
+    }
+    ctx.prev_zwj = cur == C::kZWJ;
+    if (cur == C::kZW) {
+      ctx.zw_before_spaces = true;
+    } else if (cur != C::kSP) {
+      ctx.zw_before_spaces = false;
+    }
+    if (ctx.prev != C::kSP) ctx.before_spaces = ctx.prev;
+  }
+}
+
+uint32_t NextUtf8Codepoint(const std::string& text, size_t* i) {
+  const unsigned char lead = (unsigned char)text[*i];
+  ++*i;
+  if (lead < 0x80) return lead;
+  int extra;
+  uint32_t cp;
+  if ((lead & 0xE0) == 0xC0) {
+    extra = 1;
+    cp = lead & 0x1F;
+  } else if ((lead & 0xF0) == 0xE0) {
+    extra = 2;
+    cp = lead & 0x0F;
+  } else if ((lead & 0xF8) == 0xF0) {
+    extra = 3;
+    cp = lead & 0x07;
+  } else {
+    return kReplacementChar;
+  }
+  if (*i + extra > text.size()) return kReplacementChar;
+  for (int k = 0; k < extra; ++k) {
+    const unsigned char c = (unsigned char)text[*i + k];
+    if ((c & 0xC0) != 0x80) return kReplacementChar;
+    cp = (cp << 6) | (c & 0x3F);
+  }
+  *i += extra;
+  return cp;
+}
+
+}  // namespace tono_overlay
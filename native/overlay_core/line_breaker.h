@@ -0,0 +1,70 @@
+// line_breaker.h
+#ifndef OVERLAY_CORE_LINE_BREAKER_H_
+#define OVERLAY_CORE_LINE_BREAKER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tono_overlay {
+
+// Line breaking classes of UAX #14, after its LB1 resolution: AI, SG and
+// XX are AL, SA is AL (or CM for its marks), CJ is NS, so small kana and
+// the prolonged sound mark never start a line. Hangul syllables are ID.
+enum class LineBreakClass : uint8_t {
+  kAL,   // alphabetic and everything not listed below
+  kBA,   // break after (hyphen-like spaces, |, tab)
+  kBB,   // break before
+  kB2,   // em dash: break on either side, not between two
+  kBK,   // mandatory break (VT, FF, U+2028, U+2029)
+  kCL,   // close punctuation, including 、 。 ，
+  kCM,   // combining marks and other controls
+  kCP,   // close parenthesis
+  kCR,   // carriage return
+  kEM,   // emoji modifier (emoji bases are ID)
+  kEX,   // exclamation and interrogation
+  kGL,   // non-breaking ("glue")
+  kHY,   // hyphen-minus
+  kID,   // ideographs, kana, hangul, emoji
+  kIN,   // inseparable (…)
+  kIS,   // infix numeric separator
+  kLF,   // line feed
+  kNL,   // next line
+  kNS,   // nonstarters, including small kana and ー
+  kNU,   // digits
+  kOP,   // open punctuation
+  kPO,   // numeric postfix
+  kPR,   // numeric prefix
+  kQU,   // quotation marks
+  kRI,   // regional indicators
+  kSP,   // space
+  kSY,   // solidus
+  kWJ,   // word joiner
+  kZW,   // zero width space
+  kZWJ,  // zero width joiner
+};
+
+LineBreakClass LineBreakClassOf(uint32_t codepoint);
+
+// What may happen between two code points.
+enum class BreakAction : uint8_t {
+  kProhibited,
+  kAllowed,
+  kMandatory,
+};
+
+// Runs the UAX #14 pair rules (LB4 to LB31, without dictionary breaking
+// for SA scripts) over |classes|. |breaks| gets n + 1 entries: breaks[i]
+// is the action before classes[i], breaks[0] is kProhibited and breaks[n]
+// is kMandatory (LB2, LB3).
+void FindLineBreaks(const LineBreakClass* classes, size_t n,
+                    std::vector<BreakAction>* breaks);
+
+// Next code point of |text| at |*i|, advancing |*i|. Malformed sequences
+// decode to U+FFFD one byte at a time.
+uint32_t NextUtf8Codepoint(const std::string& text, size_t* i);
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_LINE_BREAKER_H_
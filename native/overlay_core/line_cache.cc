@@ -0,0 +1,113 @@
+// line_cache.cc
+#include "overlay_core/line_cache.h"
+
+#include <cstring>
+#include <utility>
+
+namespace tono_overlay {
+
+HashBuilder& HashBuilder::Add(const void* data, size_t size) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash_ ^= p[i];
+    hash_ *= 1099511628211ull;
+  }
+  return *this;
+}
+
+size_t LineCache::KeyHash::operator()(const LineCacheKey& key) const {
+  return (size_t)HashBuilder().Add(key.text).Add((int64_t)key.style_hash).hash();
+}
+
+bool LineCache::Lookup(const LineCacheKey& key, uint8_t* dst,
+                       size_t dst_size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end() || it->second->bitmap.pixels.size() != dst_size) {
+    ++misses_;
+    return false;
+  }
+  ++hits_;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  std::memcpy(dst, it->second->bitmap.pixels.data(), dst_size);
+  return true;
+}
+
+bool LineCache::Contains(const LineCacheKey& key) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_.find(key) != index_.end();
+}
+
+void LineCache::Insert(const LineCacheKey& key, int width, int height,
+                       const uint8_t* pixels) {
+  if (width <= 0 || height <= 0) return;
+  const size_t size = (size_t)width * height * 4;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto existing = index_.find(key);
+  if (existing != index_.end()) {
+    bytes_ -= existing->second->bitmap.pixels.size();
+    spare_ = std::move(existing->second->bitmap.pixels);
+    entries_.erase(existing->second);
+    index_.erase(existing);
+  }
+  if (size > byte_budget_) return;
+  EvictUntil(byte_budget_ - size);
+
+  Entry entry;
+  entry.key = key;
+  entry.bitmap.width = width;
+  entry.bitmap.height = height;
+  entry.bitmap.pixels = std::move(spare_);
+  spare_ = std::vector<uint8_t>();
+  entry.bitmap.pixels.resize(size);
+  std::memcpy(entry.bitmap.pixels.data(), pixels, size);
+  entries_.push_front(std::move(entry));
+  index_[key] = entries_.begin();
+  bytes_ += size;
+  ++insertions_;
+}
+
+void LineCache::SetByteBudget(size_t byte_budget) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  byte_budget_ = byte_budget;
+  EvictUntil(byte_budget_);
+}
+
+void LineCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  index_.clear();
+  spare_ = std::vector<uint8_t>();
+  bytes_ = 0;
+}
+
+LineCacheStats LineCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  LineCacheStats s;
+  s.hits = hits_;
+  s.misses = misses_;
+  s.insertions = insertions_;
+  s.evictions = evictions_;
+  s.entries = entries_.size();
+  s.bytes = bytes_;
+  s.byte_budget = byte_budget_;
+  return s;
+}
+
+void LineCache::ResetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  hits_ = misses_ = insertions_ = evictions_ = 0;
+}
+
+void LineCache::EvictUntil(size_t target_bytes) {
+  while (bytes_ > target_bytes && !entries_.empty()) {
+    Entry& victim = entries_.back();
+    bytes_ -= victim.bitmap.pixels.size();
+    index_.erase(victim.key);
+    spare_ = std::move(victim.bitmap.pixels);
+    entries_.pop_back();
+    ++evictions_;
+  }
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,123 @@
+// line_cache.h
+#ifndef OVERLAY_CORE_LINE_CACHE_H_
+#define OVERLAY_CORE_LINE_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tono_overlay {
+
+// Incremental FNV-1a hash for building style keys field by field.
+class HashBuilder {
+ public:
+  HashBuilder& Add(const void* data, size_t size);
+  HashBuilder& Add(int64_t value) { return Add(&value, sizeof(value)); }
+  HashBuilder& Add(const std::string& bytes) {
+    Add((int64_t)bytes.size());
+    return Add(bytes.data(), bytes.size());
+  }
+  uint64_t hash() const { return hash_; }
+
+ private:
+  uint64_t hash_ = 14695981039346656037ull;
+};
+
+// Identifies a finished line: the text (raw bytes in whatever encoding the
+// runner uses) plus a hash of every style input that affects its pixels.
+struct LineCacheKey {
+  std::string text;
+  uint64_t style_hash = 0;
+
+  bool operator==(const LineCacheKey& other) const {
+    return style_hash == other.style_hash && text == other.text;
+  }
+};
+
+// A finished, premultiplied 32-bit line bitmap (stride = width * 4).
+struct LineBitmap {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+struct LineCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t insertions = 0;
+  uint64_t evictions = 0;
+  size_t entries = 0;
+  size_t bytes = 0;
+  size_t byte_budget = 0;
+};
+
+// Bounded LRU cache of rendered lyric lines. Total pixel bytes never exceed
+// the byte budget; a budget of 0 disables caching. Thread-safe, so a
+// background pre-renderer can fill it while the window thread reads it.
+class LineCache {
+ public:
+  static constexpr size_t kDefaultByteBudget = 32u * 1024u * 1024u;
+
+  explicit LineCache(size_t byte_budget = kDefaultByteBudget)
+      : byte_budget_(byte_budget) {}
+
+  LineCache(const LineCache&) = delete;
+  LineCache& operator=(const LineCache&) = delete;
+
+  // Copies the cached line into |dst| (|dst_size| bytes, which must match
+  // the line exactly) and marks it most recently used. Returns false if the
+  // line is not cached. Counts a hit or a miss.
+  bool Lookup(const LineCacheKey& key, uint8_t* dst, size_t dst_size);
+
+  // Returns true if the line is cached, without touching LRU order or
+  // counters.
+  bool Contains(const LineCacheKey& key) const;
+
+  // Copies |pixels| (width * height * 4 bytes) into the cache, evicting
+  // least recently used lines to stay within budget. Lines larger than the
+  // whole budget are not cached.
+  void Insert(const LineCacheKey& key, int width, int height,
+              const uint8_t* pixels);
+
+  // Changes the budget, evicting as needed.
+  void SetByteBudget(size_t byte_budget);
+
+  // Drops every line; counters are kept.
+  void Clear();
+
+  LineCacheStats stats() const;
+  void ResetStats();
+
+ private:
+  struct KeyHash {
+    size_t operator()(const LineCacheKey& key) const;
+  };
+  struct Entry {
+    LineCacheKey key;
+    LineBitmap bitmap;
+  };
+  using EntryList = std::list<Entry>;
+
+  void EvictUntil(size_t target_bytes);
+
+  mutable std::mutex mutex_;
+  size_t byte_budget_;
+  size_t bytes_ = 0;
+  // Most recently used at the front.
+  EntryList entries_;
+  std::unordered_map<LineCacheKey, EntryList::iterator, KeyHash> index_;
+  // Pixel storage of the last evicted line, reused by the next insert.
+  std::vector<uint8_t> spare_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  uint64_t insertions_ = 0;
+  uint64_t evictions_ = 0;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_LINE_CACHE_H_
@@ -0,0 +1,170 @@
+// line_prerenderer.cc
+#include "overlay_core/line_prerenderer.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "overlay_core/overlay_trace.h"
+
+namespace tono_overlay {
+
+namespace {
+
+// NUL counts as blank so UTF-16 text stored as raw bytes works too.
+bool IsBlank(const std::string& text) {
+  return std::all_of(text.begin(), text.end(), [](char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\0';
+  });
+}
+
+}  // namespace
+
+LinePrerenderer::LinePrerenderer(LineCache* cache, int lookahead)
+    : cache_(cache), lookahead_(std::max(lookahead, 0)) {
+  worker_ = std::thread(&LinePrerenderer::Run, this);
+}
+
+LinePrerenderer::~LinePrerenderer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  worker_.join();
+}
+
+void LinePrerenderer::SetSheet(std::vector<LyricLine> lines) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lines_ = std::move(lines);
+    ++generation_;
+    attempted_.clear();
+    current_ = -1;
+    if (!current_text_.empty()) current_ = FindTextLocked(current_text_);
+  }
+  wake_.notify_all();
+}
+
+void LinePrerenderer::SetStyle(uint64_t style_hash, RenderFn render) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    style_hash_ = style_hash;
+    render_ = std::move(render);
+    ++generation_;
+    attempted_.clear();
+  }
+  wake_.notify_all();
+}
+
+void LinePrerenderer::SetLookahead(int lookahead) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lookahead_ = std::max(lookahead, 0);
+  }
+  wake_.notify_all();
+}
+
+void LinePrerenderer::SetCurrentIndex(int index) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_ = index;
+    current_text_ = index >= 0 && index < (int)lines_.size()
+                        ? lines_[index].text
+                        : std::string();
+  }
+  wake_.notify_all();
+}
+
+int LinePrerenderer::NoteText(const std::string& text) {
+  int index;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_text_ = text;
+    index = FindTextLocked(text);
+    // Unknown text (status messages, a line from the previous song) keeps
+    // the lookahead where it was.
+    if (index >= 0) current_ = index;
+  }
+  wake_.notify_all();
+  return index;
+}
+
+void LinePrerenderer::WaitIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return stop_ || (!busy_ && NextJobLocked() < 0); });
+}
+
+int LinePrerenderer::current_index() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return current_;
+}
+
+uint64_t LinePrerenderer::rendered_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rendered_;
+}
+
+int LinePrerenderer::NextJobLocked() const {
+  if (!render_ || lookahead_ <= 0) return -1;
+  const int first = current_ + 1;
+  const int end = std::min(first + lookahead_, (int)lines_.size());
+  for (int i = std::max(first, 0); i < end; ++i) {
+    if (attempted_.count(i) == 0 && !IsBlank(lines_[i].text)) return i;
+  }
+  return -1;
+}
+
+int LinePrerenderer::FindTextLocked(const std::string& text) const {
+  const int count = (int)lines_.size();
+  // The current line itself first: restyling redraws the same text.
+  for (int i = std::max(current_, 0); i < count; ++i) {
+    if (lines_[i].text == text) return i;
+  }
+  // Seeking backwards.
+  for (int i = 0; i < count && i < current_; ++i) {
+    if (lines_[i].text == text) return i;
+  }
+  return -1;
+}
+
+void LinePrerenderer::Run() {
+  OverlayTracer::Global().SetThreadName("overlay prerender");
+  // Reused across jobs so steady-state rendering does not allocate.
+  LineBitmap bitmap;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    const int index = NextJobLocked();
+    if (index < 0) {
+      busy_ = false;
+      idle_.notify_all();
+      wake_.wait(lock);
+      continue;
+    }
+    busy_ = true;
+    attempted_.insert(index);
+    const uint64_t generation = generation_;
+    LineCacheKey key;
+    key.text = lines_[index].text;
+    key.style_hash = style_hash_;
+    RenderFn render = render_;
+    lock.unlock();
+
+    bool rendered = false;
+    if (!cache_->Contains(key)) {
+      ScopedTraceEvent trace("overlay", "prerender line");
+      rendered = render(key.text, &bitmap);
+    }
+
+    lock.lock();
+    // A line rendered with a style that has since been replaced would only
+    // take budget away from lines that can still be shown.
+    if (rendered && generation == generation_) {
+      cache_->Insert(key, bitmap.width, bitmap.height, bitmap.pixels.data());
+      ++rendered_;
+    }
+  }
+  busy_ = false;
+  idle_.notify_all();
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,105 @@
+// line_prerenderer.h
+#ifndef OVERLAY_CORE_LINE_PRERENDERER_H_
+#define OVERLAY_CORE_LINE_PRERENDERER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "overlay_core/line_cache.h"
+
+namespace tono_overlay {
+
+// One timed line of a lyric sheet. |text| uses the same encoding as the
+// LineCacheKey text the runner builds for the displayed line.
+struct LyricLine {
+  int64_t time_ms = 0;
+  std::string text;
+};
+
+// Renders upcoming lines of a lyric sheet on a background thread and stores
+// them in a LineCache, so switching to the next line during playback is a
+// cache copy instead of a rasterization.
+//
+// The window thread owns the sheet, the style and the playback position; the
+// worker only ever calls the RenderFn and LineCache::Insert.
+class LinePrerenderer {
+ public:
+  // Renders |text| with the style the function was created for. Runs on the
+  // worker thread. Returns false if the line could not be rendered.
+  using RenderFn =
+      std::function<bool(const std::string& text, LineBitmap* out)>;
+
+  static constexpr int kDefaultLookahead = 4;
+
+  // |cache| must outlive this object.
+  explicit LinePrerenderer(LineCache* cache,
+                           int lookahead = kDefaultLookahead);
+  // Stops the worker, waiting for an in-flight render to finish.
+  ~LinePrerenderer();
+
+  LinePrerenderer(const LinePrerenderer&) = delete;
+  LinePrerenderer& operator=(const LinePrerenderer&) = delete;
+
+  // Replaces the sheet. Lines should be sorted by time. The current line is
+  // re-resolved from the last text passed to NoteText().
+  void SetSheet(std::vector<LyricLine> lines);
+
+  // Sets the style the worker renders with. Lines are only pre-rendered once
+  // a style has been set; changing |style_hash| restarts the lookahead.
+  void SetStyle(uint64_t style_hash, RenderFn render);
+
+  // Number of lines after the current one to keep rendered (0 disables).
+  void SetLookahead(int lookahead);
+
+  // Marks |index| as the displayed line (-1 = before the first line).
+  void SetCurrentIndex(int index);
+
+  // Marks the line showing |text| as displayed. Searches forward from the
+  // current line (inclusive), so a redraw keeps the position and a repeated
+  // line resolves to its next occurrence, then from the start of the sheet.
+  // Returns the resolved index, or -1 if the text is not in the sheet.
+  int NoteText(const std::string& text);
+
+  // Blocks until the worker has nothing left to do. Used by tests.
+  void WaitIdle();
+
+  int current_index() const;
+  // Lines rendered by the worker so far.
+  uint64_t rendered_count() const;
+
+ private:
+  // Returns the next sheet index to render, or -1. Requires |mutex_|.
+  int NextJobLocked() const;
+  int FindTextLocked(const std::string& text) const;
+  void Run();
+
+  LineCache* cache_;
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::vector<LyricLine> lines_;
+  uint64_t style_hash_ = 0;
+  RenderFn render_;
+  int lookahead_;
+  int current_ = -1;
+  std::string current_text_;
+  // Bumped whenever the sheet or style changes so a render that was in
+  // flight across the change is dropped.
+  uint64_t generation_ = 0;
+  // Sheet indices already handled in this generation.
+  std::set<int> attempted_;
+  bool busy_ = false;
+  bool stop_ = false;
+  uint64_t rendered_ = 0;
+  std::thread worker_;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_LINE_PRERENDERER_H_
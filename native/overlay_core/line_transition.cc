@@ -0,0 +1,239 @@
+// line_transition.cc
+#include "overlay_core/line_transition.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "overlay_core/overlay_stats.h"
+
+namespace tono_overlay {
+
+namespace {
+
+// Size of the arriving line at the start of kScale, and of the leaving
+// line at its end.
+constexpr double kScaleIn = 0.8;
+constexpr double kScaleOut = 1.2;
+
+// Scales one row of pixels by |weight| / 256 into |out|.
+void FadeRow(const uint8_t* src, uint8_t* out, size_t bytes, int weight) {
+  if (weight >= 256) {
+    std::memcpy(out, src, bytes);
+    return;
+  }
+  if (weight <= 0) {
+    std::memset(out, 0, bytes);
+    return;
+  }
+  for (size_t i = 0; i < bytes; ++i) {
+    out[i] = (uint8_t)((src[i] * weight + 128) >> 8);
+  }
+}
+
+// Output row from |src| faded by |weight| / 256, over the plate: the text
+// in |src| (what differs from |src_plate|, the plate where |src| comes
+// from) fades over |dst_plate|, the plate where the row lands.
+void FadeRowOverPlate(const uint8_t* src, const uint8_t* src_plate,
+                      const uint8_t* dst_plate, uint8_t* out, size_t bytes,
+                      int weight) {
+  for (size_t i = 0; i < bytes; ++i) {
+    const int delta = src[i] - src_plate[i];
+    // Offset so the shift rounds a positive number.
+    const int faded = ((delta * weight + 128 + 65536) >> 8) - 256;
+    out[i] = (uint8_t)std::clamp(dst_plate[i] + faded, 0, 255);
+  }
+}
+
+void Crossfade(const uint8_t* from, const uint8_t* to, uint8_t* out,
+               int width, int height, size_t stride, int weight) {
+  const size_t bytes = (size_t)width * 4;
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* f = from + y * stride;
+    const uint8_t* t = to + y * stride;
+    uint8_t* o = out + y * stride;
+    for (size_t i = 0; i < bytes; ++i) {
+      o[i] = (uint8_t)((f[i] * (256 - weight) + t[i] * weight + 128) >> 8);
+    }
+  }
+}
+
+// The leaving line is |shift| rows higher, the arriving one |height| -
+// |shift| rows lower; every output row comes from exactly one of them.
+// With a |plate|, the text of each row moves instead of the whole row.
+void SlideUp(const uint8_t* from, const uint8_t* to, uint8_t* out, int width,
+             int height, size_t stride, int weight, int shift,
+             const uint8_t* plate) {
+  const size_t bytes = (size_t)width * 4;
+  for (int y = 0; y < height; ++y) {
+    uint8_t* o = out + y * stride;
+    const int src_y = y + shift;
+    const uint8_t* src = src_y < height ? from + src_y * stride
+                                        : to + (src_y - height) * stride;
+    const int src_weight = src_y < height ? 256 - weight : weight;
+    if (plate) {
+      const int plate_y = src_y < height ? src_y : src_y - height;
+      FadeRowOverPlate(src, plate + plate_y * stride, plate + y * stride, o,
+                       bytes, src_weight);
+    } else {
+      FadeRow(src, o, bytes, src_weight);
+    }
+  }
+}
+
+// Bilinear sample of |src| at 16.16 fixed-point (fx, fy); pixels outside
+// the bitmap are transparent.
+void Sample(const uint8_t* src, int width, int height, size_t stride,
+            int32_t fx, int32_t fy, uint32_t px[4]) {
+  static const uint8_t kClear[4] = {0, 0, 0, 0};
+  const int x0 = (int)std::floor(fx / 65536.0);
+  const int y0 = (int)std::floor(fy / 65536.0);
+  const uint32_t wx = (uint32_t)(fx >> 8) & 0xFF;
+  const uint32_t wy = (uint32_t)(fy >> 8) & 0xFF;
+  auto at = [&](int x, int y) -> const uint8_t* {
+    if (x < 0 || y < 0 || x >= width || y >= height) return kClear;
+    return src + y * stride + (size_t)x * 4;
+  };
+  const uint8_t* p00 = at(x0, y0);
+  const uint8_t* p01 = at(x0 + 1, y0);
+  const uint8_t* p10 = at(x0, y0 + 1);
+  const uint8_t* p11 = at(x0 + 1, y0 + 1);
+  for (int c = 0; c < 4; ++c) {
+    const uint32_t top = p00[c] * (256 - wx) + p01[c] * wx;
+    const uint32_t bottom = p10[c] * (256 - wx) + p11[c] * wx;
+    px[c] = (top * (256 - wy) + bottom * wy + 32768) >> 16;
+  }
+}
+
+// Source coordinate of output column/row 0 and the step per pixel when a
+// bitmap of |size| pixels is drawn at |scale| around its center.
+void ScaleMapping(int size, double scale, int32_t* origin, int32_t* step) {
+  const double center = size / 2.0;
+  const double src0 = (0.5 - center) / scale + center - 0.5;
+  *origin = (int32_t)std::lround(src0 * 65536.0);
+  *step = (int32_t)std::lround(65536.0 / scale);
+}
+
+// With a |plate|, each line's text is its samples minus the plate sampled
+// at the same point, blended over the plate in place.
+void Scale(const uint8_t* from, const uint8_t* to, uint8_t* out, int width,
+           int height, size_t stride, int weight, double progress,
+           const uint8_t* plate) {
+  const double from_scale = 1.0 + (kScaleOut - 1.0) * progress;
+  const double to_scale = kScaleIn + (1.0 - kScaleIn) * progress;
+  int32_t from_x0, from_dx, from_y0, from_dy;
+  int32_t to_x0, to_dx, to_y0, to_dy;
+  ScaleMapping(width, from_scale, &from_x0, &from_dx);
+  ScaleMapping(height, from_scale, &from_y0, &from_dy);
+  ScaleMapping(width, to_scale, &to_x0, &to_dx);
+  ScaleMapping(height, to_scale, &to_y0, &to_dy);
+  for (int y = 0; y < height; ++y) {
+    uint8_t* o = out + y * stride;
+    const int32_t from_fy = from_y0 + y * from_dy;
+    const int32_t to_fy = to_y0 + y * to_dy;
+    const uint8_t* p = plate ? plate + y * stride : nullptr;
+    for (int x = 0; x < width; ++x, o += 4) {
+      uint32_t f[4];
+      uint32_t t[4];
+      const int32_t from_fx = from_x0 + x * from_dx;
+      const int32_t to_fx = to_x0 + x * to_dx;
+      Sample(from, width, height, stride, from_fx, from_fy, f);
+      Sample(to, width, height, stride, to_fx, to_fy, t);
+      if (!p) {
+        for (int c = 0; c < 4; ++c) {
+          o[c] =
+              (uint8_t)((f[c] * (256 - weight) + t[c] * weight + 128) >> 8);
+        }
+        continue;
+      }
+      uint32_t fp[4];
+      uint32_t tp[4];
+      Sample(plate, width, height, stride, from_fx, from_fy, fp);
+      Sample(plate, width, height, stride, to_fx, to_fy, tp);
+      for (int c = 0; c < 4; ++c) {
+        const int text = ((int)f[c] - (int)fp[c]) * (256 - weight) +
+                         ((int)t[c] - (int)tp[c]) * weight;
+        const int faded = ((text + 128 + 65536) >> 8) - 256;
+        o[c] = (uint8_t)std::clamp(p[x * 4 + c] + faded, 0, 255);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+double EaseTransition(double t) {
+  t = std::clamp(t, 0.0, 1.0);
+  const double inv = 1.0 - t;
+  return 1.0 - inv * inv * inv;
+}
+
+void BlendTransition(TransitionKind kind, const uint8_t* from,
+                     const uint8_t* to, uint8_t* out, int width, int height,
+                     size_t stride, double progress, const uint8_t* plate) {
+  if (width <= 0 || height <= 0) return;
+  progress = std::clamp(progress, 0.0, 1.0);
+  const int weight = (int)std::lround(progress * 256.0);
+  switch (kind) {
+    case TransitionKind::kNone:
+      for (int y = 0; y < height; ++y) {
+        std::memcpy(out + y * stride, to + y * stride, (size_t)width * 4);
+      }
+      break;
+    case TransitionKind::kCrossfade:
+      // The plate is in both lines at the same place, so it cancels out.
+      Crossfade(from, to, out, width, height, stride, weight);
+      break;
+    case TransitionKind::kSlideUp:
+      SlideUp(from, to, out, width, height, stride, weight,
+              (int)std::lround(progress * height), plate);
+      break;
+    case TransitionKind::kScale:
+      Scale(from, to, out, width, height, stride, weight, progress, plate);
+      break;
+  }
+}
+
+void LineTransition::Start(TransitionKind kind, int duration_ms,
+                           int64_t now_ms, const uint8_t* from, int width,
+                           int height, size_t stride,
+                           const BackgroundPlate& plate, PixelFormat format) {
+  active_ = false;
+  if (kind == TransitionKind::kNone || duration_ms <= 0 || width <= 0 ||
+      height <= 0) {
+    return;
+  }
+  from_.assign(from, from + stride * height);
+  if (plate.alpha > 0) {
+    plate_.resize(stride * height);
+    RenderBackgroundPlate(plate, format, width, height, plate_.data(),
+                          stride);
+  } else {
+    plate_.clear();
+  }
+  kind_ = kind;
+  start_ms_ = now_ms;
+  duration_ms_ = duration_ms;
+  width_ = width;
+  height_ = height;
+  stride_ = stride;
+  active_ = true;
+}
+
+bool LineTransition::Frame(const uint8_t* to, uint8_t* out, int width,
+                           int height, size_t stride, int64_t now_ms) {
+  if (!active_) return false;
+  const int64_t elapsed = now_ms - start_ms_;
+  if (elapsed >= duration_ms_ || width != width_ || height != height_ ||
+      stride != stride_) {
+    active_ = false;
+    return false;
+  }
+  ScopedStageTimer timer(TimingStage::kBlend);
+  const double t = (double)std::max<int64_t>(elapsed, 0) / duration_ms_;
+  BlendTransition(kind_, from_.data(), to, out, width, height, stride,
+                  EaseTransition(t), plate_.empty() ? nullptr : plate_.data());
+  return true;
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,80 @@
+// line_transition.h
+#ifndef OVERLAY_CORE_LINE_TRANSITION_H_
+#define OVERLAY_CORE_LINE_TRANSITION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "overlay_core/compositor.h"
+
+namespace tono_overlay {
+
+// How the overlay animates from one lyric line to the next.
+enum class TransitionKind : int {
+  kNone = 0,       // the new line replaces the old one at once
+  kCrossfade = 1,  // the old line fades out as the new one fades in
+  kSlideUp = 2,    // the old line leaves through the top, the new one
+                   // enters from the bottom
+  kScale = 3,      // the old line grows and fades, the new one grows into
+                   // place from 80%
+};
+
+// Ease-out cubic: fast start, gentle landing. |t| is clamped to 0..1.
+double EaseTransition(double t);
+
+// Writes one frame of a line change into |out|. |from| (the line leaving),
+// |to| (the line arriving) and |out| are width x height premultiplied
+// 4-byte pixels, |stride| bytes per row; |out| must not alias the inputs.
+// |progress| runs from 0 (|out| = |from|) to 1 (|out| = |to|). Only the two
+// bitmaps are read, so a frame costs one pass over the pixels and no text
+// rasterization. When both lines were composited over the background
+// |plate| (RenderBackgroundPlate() pixels, same layout), only their text
+// moves and fades: the plate stays in place at full strength.
+void BlendTransition(TransitionKind kind, const uint8_t* from,
+                     const uint8_t* to, uint8_t* out, int width, int height,
+                     size_t stride, double progress,
+                     const uint8_t* plate = nullptr);
+
+// One line change in flight. Keeps a copy of the pixels that were on
+// screen when it started; the new line is read from the caller's output
+// surface on every frame, so it may keep changing (a karaoke sweep).
+// Single-threaded, times in milliseconds of any monotonic clock.
+class LineTransition {
+ public:
+  // Starts animating away from |from| (copied). Does nothing, and leaves
+  // the transition inactive, for kNone, a duration <= 0 or an empty size.
+  // A running transition is replaced. Both lines are composited over
+  // |plate|, which then stays still (see BlendTransition()).
+  void Start(TransitionKind kind, int duration_ms, int64_t now_ms,
+             const uint8_t* from, int width, int height, size_t stride,
+             const BackgroundPlate& plate = BackgroundPlate(),
+             PixelFormat format = PixelFormat());
+
+  // Blends the frame for |now_ms| into |out|. Returns false, without
+  // touching |out|, once the transition is over or if |to| does not have
+  // the size it started with; the caller then shows |to| itself.
+  bool Frame(const uint8_t* to, uint8_t* out, int width, int height,
+             size_t stride, int64_t now_ms);
+
+  void Cancel() { active_ = false; }
+  bool active() const { return active_; }
+  TransitionKind kind() const { return kind_; }
+
+ private:
+  bool active_ = false;
+  TransitionKind kind_ = TransitionKind::kNone;
+  int64_t start_ms_ = 0;
+  int duration_ms_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+  size_t stride_ = 0;
+  // Reused across transitions of the same size.
+  std::vector<uint8_t> from_;
+  // Pixels of the plate; empty without one.
+  std::vector<uint8_t> plate_;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_LINE_TRANSITION_H_
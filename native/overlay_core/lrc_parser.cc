@@ -0,0 +1,212 @@
+// lrc_parser.cc
+#include "overlay_core/lrc_parser.h"
+
+#include <algorithm>
+
+namespace tono_overlay {
+
+namespace {
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' ||
+         c == '\v';
+}
+
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+std::string_view Trim(std::string_view s) {
+  size_t begin = 0, end = s.size();
+  while (begin < end && IsSpace(s[begin])) ++begin;
+  while (end > begin && IsSpace(s[end - 1])) --end;
+  return s.substr(begin, end - begin);
+}
+
+// Reads up to |max_digits| digits at |*pos|. Returns false if there are
+// none.
+bool ReadNumber(std::string_view s, size_t* pos, int max_digits,
+                int64_t* value) {
+  int64_t v = 0;
+  int digits = 0;
+  while (*pos < s.size() && IsDigit(s[*pos]) && digits < max_digits) {
+    v = v * 10 + (s[*pos] - '0');
+    ++*pos;
+    ++digits;
+  }
+  *value = v;
+  return digits > 0;
+}
+
+// Parses the inside of a time tag ("mm:ss", "mm:ss.xx", ...).
+bool ParseTimeTag(std::string_view tag, int64_t* time_ms) {
+  size_t pos = 0;
+  int64_t minutes = 0, seconds = 0;
+  if (!ReadNumber(tag, &pos, 6, &minutes)) return false;
+  if (pos >= tag.size() || tag[pos] != ':') return false;
+  ++pos;
+  if (!ReadNumber(tag, &pos, 2, &seconds)) return false;
+  int64_t ms = 0;
+  if (pos < tag.size()) {
+    if (tag[pos] != '.' && tag[pos] != ':') return false;
+    ++pos;
+    const size_t frac_begin = pos;
+    int64_t frac = 0;
+    if (!ReadNumber(tag, &pos, 3, &frac)) return false;
+    // Precision beyond milliseconds is dropped.
+    while (pos < tag.size() && IsDigit(tag[pos])) ++pos;
+    if (pos != tag.size()) return false;
+    const size_t frac_digits = std::min<size_t>(pos - frac_begin, 3);
+    ms = frac * (frac_digits == 1 ? 100 : frac_digits == 2 ? 10 : 1);
+  }
+  *time_ms = (minutes * 60 + seconds) * 1000 + ms;
+  return true;
+}
+
+// Parses the value of an [offset:] tag. Malformed values count as 0.
+int64_t ParseOffset(std::string_view value) {
+  value = Trim(value);
+  bool negative = false;
+  if (!value.empty() && (value[0] == '+' || value[0] == '-')) {
+    negative = value[0] == '-';
+    value.remove_prefix(1);
+  }
+  size_t pos = 0;
+  int64_t v = 0;
+  if (!ReadNumber(value, &pos, 9, &v)) return 0;
+  return negative ? -v : v;
+}
+
+bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    char x = a[i], y = b[i];
+    if (x >= 'A' && x <= 'Z') x = (char)(x - 'A' + 'a');
+    if (y >= 'A' && y <= 'Z') y = (char)(y - 'A' + 'a');
+    if (x != y) return false;
+  }
+  return true;
+}
+
+bool EarlierLine(const LrcLine& a, const LrcLine& b) {
+  return a.time_ms < b.time_ms;
+}
+
+}  // namespace
+
+bool StripWordTimings(std::string_view text, std::string* plain,
+                      std::vector<LrcWord>* words) {
+  plain->clear();
+  words->clear();
+  size_t pos = 0;
+  while (pos < text.size()) {
+    const size_t open = text.find('<', pos);
+    if (open == std::string_view::npos) break;
+    const size_t close = text.find('>', open + 1);
+    if (close == std::string_view::npos) break;
+    int64_t time_ms = 0;
+    if (!ParseTimeTag(text.substr(open + 1, close - open - 1), &time_ms)) {
+      // Not a word tag; keep the '<' as text.
+      plain->append(text.substr(pos, open + 1 - pos));
+      pos = open + 1;
+      continue;
+    }
+    plain->append(text.substr(pos, open - pos));
+    LrcWord word;
+    word.time_ms = time_ms;
+    word.begin = plain->size();
+    words->push_back(word);
+    pos = close + 1;
+  }
+  plain->append(text.substr(pos));
+  return !words->empty();
+}
+
+int64_t LrcParser::ParseInto(std::string_view lrc, std::vector<LrcLine>* out) {
+  const size_t first = out->size();
+  int64_t offset = 0;
+  bool sorted = true;
+  // UTF-8 byte order mark.
+  if (lrc.substr(0, 3) == "\xEF\xBB\xBF") lrc.remove_prefix(3);
+
+  size_t line_begin = 0;
+  while (line_begin < lrc.size()) {
+    size_t line_end = lrc.find('\n', line_begin);
+    if (line_end == std::string_view::npos) line_end = lrc.size();
+    std::string_view line = lrc.substr(line_begin, line_end - line_begin);
+    line_begin = line_end + 1;
+
+    // Leading tags; text starts after the last one.
+    const size_t stamps_begin = out->size();
+    size_t pos = 0;
+    while (pos < line.size() && IsSpace(line[pos])) ++pos;
+    while (pos < line.size() && line[pos] == '[') {
+      const size_t close = line.find(']', pos + 1);
+      if (close == std::string_view::npos) break;
+      std::string_view tag = line.substr(pos + 1, close - pos - 1);
+      int64_t time_ms = 0;
+      if (ParseTimeTag(tag, &time_ms)) {
+        LrcLine entry;
+        entry.time_ms = time_ms;
+        if (out->size() > first && time_ms < out->back().time_ms) {
+          sorted = false;
+        }
+        out->push_back(entry);
+      } else if (out->size() == stamps_begin) {
+        // Header tag ([ar:], [ti:], [offset:], ...). Only meaningful on a
+        // line without timestamps.
+        const size_t colon = tag.find(':');
+        if (colon != std::string_view::npos &&
+            EqualsIgnoreCase(Trim(tag.substr(0, colon)), "offset")) {
+          offset = ParseOffset(tag.substr(colon + 1));
+        }
+      } else {
+        break;
+      }
+      pos = close + 1;
+    }
+    const std::string_view text = Trim(line.substr(pos));
+    for (size_t i = stamps_begin; i < out->size(); ++i) {
+      (*out)[i].text = text;
+    }
+  }
+
+  if (!sorted) {
+    std::stable_sort(out->begin() + first, out->end(), EarlierLine);
+  }
+  return offset;
+}
+
+const std::vector<LrcLine>& LrcParser::Parse(std::string_view lyric,
+                                             std::string_view translation) {
+  lines_.clear();
+  offset_ms_ = ParseInto(lyric, &lines_);
+
+  if (!translation.empty()) {
+    translation_lines_.clear();
+    ParseInto(translation, &translation_lines_);
+    // Both sides are sorted: attach each translation to the first main line
+    // with the same (raw) timestamp in one merge pass. Translations without
+    // a matching line are dropped.
+    size_t t = 0;
+    for (LrcLine& line : lines_) {
+      while (t < translation_lines_.size() &&
+             translation_lines_[t].time_ms < line.time_ms) {
+        ++t;
+      }
+      if (t < translation_lines_.size() &&
+          translation_lines_[t].time_ms == line.time_ms) {
+        line.translation = translation_lines_[t].text;
+        ++t;
+      }
+    }
+  }
+
+  // Shifting every line by the same amount keeps them sorted.
+  if (offset_ms_ != 0) {
+    for (LrcLine& line : lines_) {
+      line.time_ms = std::max<int64_t>(line.time_ms - offset_ms_, 0);
+    }
+  }
+  return lines_;
+}
+
+}  // namespace tono_overlay
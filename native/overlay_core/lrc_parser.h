@@ -0,0 +1,70 @@
+// lrc_parser.h
+#ifndef OVERLAY_CORE_LRC_PARSER_H_
+#define OVERLAY_CORE_LRC_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tono_overlay {
+
+// One timed lyric line. The views point into the buffers passed to
+// LrcParser::Parse and are only valid while those buffers are.
+struct LrcLine {
+  int64_t time_ms = 0;
+  // Whitespace-trimmed text; empty for timing-only lines.
+  std::string_view text;
+  // Text of the translation line with the same timestamp, if any.
+  std::string_view translation;
+};
+
+// A word timing from an enhanced LRC <mm:ss.xx> tag: the stripped line text
+// from byte |begin| on starts being sung at |time_ms|. A tag at the end of
+// the line (|begin| == text size) marks when the last word ends.
+struct LrcWord {
+  int64_t time_ms = 0;
+  size_t begin = 0;
+};
+
+// Copies |text| into |plain| without its <mm:ss.xx> word tags and lists the
+// tags in |words|; both are cleared first. Returns true if the line had any
+// word tags. Word times are not shifted by the sheet's [offset:].
+bool StripWordTimings(std::string_view text, std::string* plain,
+                      std::vector<LrcWord>* words);
+
+// Parses LRC lyrics without copying text or allocating per line:
+//   - [mm:ss], [mm:ss.x], [mm:ss.xx] and [mm:ss.xxx] (also ':' before the
+//     fraction); minutes may exceed 99
+//   - several leading timestamps on one line ([00:12.00][01:30.00]text)
+//   - [offset:+/-ms], where a positive offset shows lines earlier
+//   - other [tag:value] header lines are ignored
+// Output storage is reused across calls, so parsing a playlist's worth of
+// lyrics with one parser settles into no allocations at all.
+class LrcParser {
+ public:
+  // Parses |lyric| and merges |translation| (same format, e.g. a tlyric
+  // stream) into it by timestamp; the translation follows the lyric's
+  // offset. Returns the lines sorted by time; lines sharing a timestamp keep
+  // their order in |lyric|.
+  const std::vector<LrcLine>& Parse(std::string_view lyric,
+                                    std::string_view translation = {});
+
+  const std::vector<LrcLine>& lines() const { return lines_; }
+  // [offset:] of the last |lyric| parsed (already applied to the lines).
+  int64_t offset_ms() const { return offset_ms_; }
+
+ private:
+  // Appends the lines of |lrc| to |out| sorted by their raw timestamps.
+  // Returns the [offset:] value, which the caller applies.
+  static int64_t ParseInto(std::string_view lrc, std::vector<LrcLine>* out);
+
+  std::vector<LrcLine> lines_;
+  std::vector<LrcLine> translation_lines_;
+  int64_t offset_ms_ = 0;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_LRC_PARSER_H_
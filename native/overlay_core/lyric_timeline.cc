@@ -0,0 +1,48 @@
+// lyric_timeline.cc
+#include "overlay_core/lyric_timeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace tono_overlay {
+
+void LyricTimeline::SetTimes(std::vector<int64_t> times_ms) {
+  times_ = std::move(times_ms);
+}
+
+void LyricTimeline::SetAnchor(int64_t position_ms, double rate, bool paused) {
+  anchor_position_ms_ = position_ms;
+  anchor_clock_ms_ = clock_->NowMs();
+  rate_ = rate;
+  paused_ = paused;
+}
+
+double LyricTimeline::ExactPositionMs() const {
+  if (paused_ || rate_ <= 0.0) return (double)anchor_position_ms_;
+  return (double)anchor_position_ms_ +
+         (double)(clock_->NowMs() - anchor_clock_ms_) * rate_;
+}
+
+int64_t LyricTimeline::PositionMs() const {
+  return (int64_t)std::floor(ExactPositionMs());
+}
+
+int LyricTimeline::IndexAt(int64_t position_ms) const {
+  auto next = std::upper_bound(times_.begin(), times_.end(), position_ms);
+  return (int)(next - times_.begin()) - 1;
+}
+
+int64_t LyricTimeline::MsUntilNextChange() const {
+  if (paused_ || rate_ <= 0.0) return -1;
+  const double position = ExactPositionMs();
+  // First line starting after the position; lines sharing a timestamp
+  // change together.
+  auto next = std::upper_bound(times_.begin(), times_.end(),
+                               (int64_t)std::floor(position));
+  if (next == times_.end()) return -1;
+  const int64_t delay = (int64_t)std::ceil(((double)*next - position) / rate_);
+  return std::max<int64_t>(delay, 1);
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,60 @@
+// lyric_timeline.h
+#ifndef OVERLAY_CORE_LYRIC_TIMELINE_H_
+#define OVERLAY_CORE_LYRIC_TIMELINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "overlay_core/clock.h"
+
+namespace tono_overlay {
+
+// Maps the playback clock to the current lyric line without the player
+// reporting every position tick. The player sends an anchor (position,
+// rate, paused) whenever playback jumps or changes speed, and the position
+// is extrapolated from the clock in between.
+class LyricTimeline {
+ public:
+  // |clock| must outlive this object.
+  explicit LyricTimeline(const Clock* clock) : clock_(clock) {}
+
+  // Line start times in milliseconds, sorted ascending. Index i is the
+  // sheet line the runner shows for times_ms[i].
+  void SetTimes(std::vector<int64_t> times_ms);
+
+  // Playback was at |position_ms| just now, moving at |rate| media
+  // milliseconds per clock millisecond unless |paused|.
+  void SetAnchor(int64_t position_ms, double rate, bool paused);
+
+  // Extrapolated playback position.
+  int64_t PositionMs() const;
+
+  // Last line starting at or before |position_ms|, or -1 before the first.
+  int IndexAt(int64_t position_ms) const;
+  int CurrentIndex() const { return IndexAt(PositionMs()); }
+
+  // Clock milliseconds until CurrentIndex() next changes (at least 1), or
+  // -1 if it will not change without a new anchor: paused, stopped, or past
+  // the last line.
+  int64_t MsUntilNextChange() const;
+
+  const std::vector<int64_t>& times() const { return times_; }
+  bool empty() const { return times_.empty(); }
+  size_t size() const { return times_.size(); }
+  bool paused() const { return paused_; }
+
+ private:
+  double ExactPositionMs() const;
+
+  const Clock* clock_;
+  std::vector<int64_t> times_;
+  int64_t anchor_position_ms_ = 0;
+  int64_t anchor_clock_ms_ = 0;
+  double rate_ = 1.0;
+  bool paused_ = true;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_LYRIC_TIMELINE_H_
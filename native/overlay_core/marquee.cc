@@ -0,0 +1,232 @@
+// marquee.cc
+#include "overlay_core/marquee.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "overlay_core/overlay_stats.h"
+
+namespace tono_overlay {
+
+int MarqueeStripWidth(TextRasterizer* rasterizer, const std::string& text,
+                      const OverlayStyle& style, int width) {
+  if (!style.marquee || style.lines > 1 || width <= 0 || text.empty()) {
+    return width;
+  }
+  const int line = rasterizer->MeasureLine(text, style);
+  if (line <= 0) return width;
+  const int needed =
+      std::min(line, kMaxMarqueeStripWidth) + 2 * style.padding;
+  if (needed <= width) return width;
+  return std::max(std::min(needed, kMaxMarqueeStripWidth), width);
+}
+
+OverlayStyle MarqueeStripStyle(const OverlayStyle& style) {
+  OverlayStyle strip = style;
+  strip.text_align = 0;
+  strip.background_alpha = 0;
+  return strip;
+}
+
+MarqueeMotion MarqueeMotionOf(const OverlayStyle& style) {
+  MarqueeMotion motion;
+  motion.speed = style.marquee_speed;
+  motion.pause_ms = style.marquee_pause_ms;
+  return motion;
+}
+
+namespace {
+
+// Row of |bytes| bytes starting |frac| / 256 pixels into |src|: each byte
+// blends with the one a pixel to its right. Written byte-wise so the
+// compiler vectorizes it.
+void ShiftRow(const uint8_t* src, uint8_t* out, size_t bytes, uint32_t frac) {
+  const uint32_t keep = 256 - frac;
+  for (size_t i = 0; i < bytes; ++i) {
+    out[i] = (uint8_t)((src[i] * keep + src[i + 4] * frac + 128) >> 8);
+  }
+}
+
+// Puts |plate| under the premultiplied text in |row|:
+// text + round(plate * (255 - text alpha) / 255), two channels at a time
+// in the 16-bit halves of a word. Sums stay within a byte, since the text
+// covers no more than its alpha.
+void UnderPlateRow(uint8_t* row, const uint8_t* plate, size_t bytes) {
+  for (size_t i = 0; i < bytes; i += 4) {
+    const uint32_t under = 255 - row[i + 3];
+    if (under == 0) continue;
+    uint32_t text, back;
+    std::memcpy(&text, row + i, 4);
+    std::memcpy(&back, plate + i, 4);
+    uint32_t even = (back & 0x00FF00FF) * under + 0x00800080;
+    even = ((even + ((even >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    uint32_t odd = ((back >> 8) & 0x00FF00FF) * under + 0x00800080;
+    odd = (odd + ((odd >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+    text += even | odd;
+    std::memcpy(row + i, &text, 4);
+  }
+}
+
+}  // namespace
+
+void BlitMarquee(const uint8_t* strip, size_t strip_stride, uint8_t* out,
+                 int width, int height, size_t stride, int32_t offset,
+                 const uint8_t* plate) {
+  if (width <= 0 || height <= 0) return;
+  offset = std::max(offset, 0);
+  const size_t whole = (size_t)(offset >> 8);
+  const uint32_t frac = (uint32_t)offset & 0xFF;
+  const size_t bytes = (size_t)width * 4;
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* src = strip + y * strip_stride + whole * 4;
+    uint8_t* o = out + y * stride;
+    // With a fraction the column after the window is read too; it is
+    // inside the strip, since the offset never reaches its end.
+    if (frac) {
+      ShiftRow(src, o, bytes, frac);
+    } else {
+      std::memcpy(o, src, bytes);
+    }
+    if (plate) UnderPlateRow(o, plate + y * stride, bytes);
+  }
+}
+
+void Marquee::Start(int strip_width, int width, int height, int64_t now_ms) {
+  active_ = false;
+  if (width <= 0 || height <= 0 || strip_width <= width) return;
+  const bool resized = width != width_ || height != height_;
+  strip_width_ = strip_width;
+  width_ = width;
+  height_ = height;
+  phase_ = Phase::kRestStart;
+  phase_start_ms_ = now_ms;
+  phase_offset_ = 0.0;
+  offset_ = 0.0;
+  drawn_ = false;
+  active_ = true;
+  if (resized) RenderPlate();
+}
+
+void Marquee::SetMotion(const MarqueeMotion& motion, int64_t now_ms) {
+  if (motion.speed == motion_.speed && motion.pause_ms == motion_.pause_ms) {
+    return;
+  }
+  if (active_) {
+    Advance(now_ms);
+    // A move goes on from here at the new speed; a rest keeps the time
+    // already spent.
+    if (phase_ == Phase::kForward || phase_ == Phase::kBack) {
+      phase_start_ms_ = std::max(now_ms, phase_start_ms_);
+      phase_offset_ = offset_;
+    }
+  }
+  motion_ = motion;
+}
+
+void Marquee::SetPlate(const BackgroundPlate& plate, PixelFormat format) {
+  if (plate.color.r == plate_.color.r && plate.color.g == plate_.color.g &&
+      plate.color.b == plate_.color.b && plate.alpha == plate_.alpha &&
+      plate.corner_radius == plate_.corner_radius &&
+      format.r_index == format_.r_index && format.g_index == format_.g_index &&
+      format.b_index == format_.b_index) {
+    return;
+  }
+  plate_ = plate;
+  format_ = format;
+  RenderPlate();
+  drawn_ = false;
+}
+
+void Marquee::RenderPlate() {
+  if (plate_.alpha <= 0 || width_ <= 0 || height_ <= 0) {
+    plate_pixels_.clear();
+    return;
+  }
+  const size_t stride = (size_t)width_ * 4;
+  plate_pixels_.resize(stride * height_);
+  RenderBackgroundPlate(plate_, format_, width_, height_,
+                        plate_pixels_.data(), stride);
+}
+
+void Marquee::Advance(int64_t now_ms) {
+  const double overflow = strip_width_ - width_;
+  const double speed = std::max(motion_.speed, 1);
+  const int64_t pause = std::max(motion_.pause_ms, 0);
+  const int64_t travel = (int64_t)std::ceil(overflow * 1000.0 / speed);
+  const int64_t cycle = 2 * (pause + travel);
+  for (;;) {
+    const int64_t elapsed = std::max<int64_t>(now_ms - phase_start_ms_, 0);
+    switch (phase_) {
+      case Phase::kRestStart:
+        // Whole cycles are skipped at once, so a long gap between frames
+        // costs no more than a short one.
+        if (cycle > 0 && elapsed >= cycle) {
+          phase_start_ms_ += elapsed - elapsed % cycle;
+          continue;
+        }
+        offset_ = 0.0;
+        if (elapsed < pause) return;
+        phase_start_ms_ += pause;
+        phase_ = Phase::kForward;
+        phase_offset_ = 0.0;
+        continue;
+      case Phase::kForward: {
+        const double left = overflow - phase_offset_;
+        const double moved = elapsed * speed / 1000.0;
+        if (moved < left) {
+          offset_ = phase_offset_ + moved;
+          return;
+        }
+        phase_start_ms_ += (int64_t)std::ceil(left * 1000.0 / speed);
+        phase_ = Phase::kRestEnd;
+        offset_ = overflow;
+        continue;
+      }
+      case Phase::kRestEnd:
+        offset_ = overflow;
+        if (elapsed < pause) return;
+        phase_start_ms_ += pause;
+        phase_ = Phase::kBack;
+        phase_offset_ = overflow;
+        continue;
+      case Phase::kBack: {
+        const double moved = elapsed * speed / 1000.0;
+        if (moved < phase_offset_) {
+          offset_ = phase_offset_ - moved;
+          return;
+        }
+        phase_start_ms_ += (int64_t)std::ceil(phase_offset_ * 1000.0 / speed);
+        phase_ = Phase::kRestStart;
+        offset_ = 0.0;
+        continue;
+      }
+    }
+  }
+}
+
+int32_t Marquee::Offset(int64_t now_ms) {
+  if (!active_) return 0;
+  Advance(now_ms);
+  const int32_t limit = (strip_width_ - width_) * 256;
+  return std::clamp((int32_t)std::lround(offset_ * 256.0), 0, limit);
+}
+
+bool Marquee::NeedsFrame(int64_t now_ms) {
+  return active_ && (!drawn_ || Offset(now_ms) != drawn_offset_);
+}
+
+bool Marquee::Frame(const uint8_t* strip, uint8_t* out, int64_t now_ms) {
+  if (!active_) return false;
+  const int32_t offset = Offset(now_ms);
+  if (drawn_ && offset == drawn_offset_) return false;
+  ScopedStageTimer timer(TimingStage::kScroll);
+  BlitMarquee(strip, (size_t)strip_width_ * 4, out, width_, height_,
+              (size_t)width_ * 4, offset,
+              plate_pixels_.empty() ? nullptr : plate_pixels_.data());
+  drawn_ = true;
+  drawn_offset_ = offset;
+  return true;
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,117 @@
+// marquee.h
+#ifndef OVERLAY_CORE_MARQUEE_H_
+#define OVERLAY_CORE_MARQUEE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "overlay_core/compositor.h"
+#include "overlay_core/overlay_state.h"
+#include "overlay_core/text_layer.h"
+
+namespace tono_overlay {
+
+// Widest strip a marquee line is drawn into. A longer line is cut with an
+// ellipsis at that width, as it would be at the window's without the
+// marquee.
+constexpr int kMaxMarqueeStripWidth = 16384;
+
+// Width of the layer |text| is drawn into for a |width| pixel window: the
+// whole line plus the padding on both sides when |style| scrolls and that
+// is wider than |width| (capped at kMaxMarqueeStripWidth), else |width|.
+// Only single-line styles scroll.
+int MarqueeStripWidth(TextRasterizer* rasterizer, const std::string& text,
+                      const OverlayStyle& style, int width);
+
+// |style| as a marquee strip is drawn with: left aligned, and without the
+// background plate, which Marquee keeps still under the moving text.
+OverlayStyle MarqueeStripStyle(const OverlayStyle& style);
+
+// How the window moves over the strip.
+struct MarqueeMotion {
+  int speed = 40;       // pixels per second, > 0
+  int pause_ms = 1500;  // rest at each end
+};
+
+// The motion set in |style|.
+MarqueeMotion MarqueeMotionOf(const OverlayStyle& style);
+
+// Copies the |width| x |height| window of |strip| that starts |offset| /
+// 256 pixels in to |out|. A fractional offset blends the two neighboring
+// columns, so a slow scroll glides instead of stepping a pixel at a time.
+// Pixels are premultiplied 4-byte, the window must lie inside the strip,
+// and |out| must not alias it. With |plate| (RenderBackgroundPlate()
+// pixels, laid out like |out|) the window is drawn over it, so the plate
+// stays put while the text moves.
+void BlitMarquee(const uint8_t* strip, size_t strip_stride, uint8_t* out,
+                 int width, int height, size_t stride, int32_t offset,
+                 const uint8_t* plate = nullptr);
+
+// A line scrolling through a window narrower than it. The line is drawn
+// once into a strip (MarqueeStripWidth() wide, with MarqueeStripStyle());
+// each frame then only copies the window at the current offset out of it,
+// so scrolling never lays out, rasterizes or strokes text again. The
+// window rests at the start of the line, moves to its end, rests there and
+// moves back, over and over. Single-threaded, times in milliseconds of any
+// monotonic clock.
+class Marquee {
+ public:
+  // Shows the start of a |strip_width| x |height| strip through a |width|
+  // x |height| window, resting from |now_ms| on. Leaves the marquee
+  // inactive if the strip fits the window.
+  void Start(int strip_width, int width, int height, int64_t now_ms);
+  void Stop() { active_ = false; }
+  bool active() const { return active_; }
+  int strip_width() const { return strip_width_; }
+
+  // Speed and pauses from |now_ms| on. The window carries on from where the
+  // previous motion put it.
+  void SetMotion(const MarqueeMotion& motion, int64_t now_ms);
+  // Draws the window over |plate| (none while its alpha is 0).
+  void SetPlate(const BackgroundPlate& plate, PixelFormat format);
+  // Makes the next Frame() draw even if the window did not move, e.g.
+  // because a karaoke sweep changed the strip.
+  void Invalidate() { drawn_ = false; }
+
+  // Offset of the window into the strip at |now_ms|, in 1/256 pixels.
+  // Times before an earlier call count as the time of that call.
+  int32_t Offset(int64_t now_ms);
+  // Whether Frame() at |now_ms| would draw.
+  bool NeedsFrame(int64_t now_ms);
+
+  // Draws the window at |now_ms| from |strip| into |out|, both tightly
+  // packed at the sizes given to Start(). Returns false, without touching
+  // |out|, while inactive or when the window shows what was drawn last
+  // (at rest).
+  bool Frame(const uint8_t* strip, uint8_t* out, int64_t now_ms);
+
+ private:
+  enum class Phase { kRestStart, kForward, kRestEnd, kBack };
+
+  // Moves the phase and offset_ on to |now_ms|.
+  void Advance(int64_t now_ms);
+  void RenderPlate();
+
+  bool active_ = false;
+  int strip_width_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+  MarqueeMotion motion_;
+  Phase phase_ = Phase::kRestStart;
+  int64_t phase_start_ms_ = 0;
+  // Offsets in pixels where the phase began and as of the last Advance().
+  double phase_offset_ = 0.0;
+  double offset_ = 0.0;
+  bool drawn_ = false;
+  int32_t drawn_offset_ = 0;
+  BackgroundPlate plate_;
+  PixelFormat format_;
+  // Pixels of the plate at the window size; empty without one.
+  std::vector<uint8_t> plate_pixels_;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_MARQUEE_H_
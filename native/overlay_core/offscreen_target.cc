@@ -0,0 +1,91 @@
+// offscreen_target.cc
+#include "overlay_core/offscreen_target.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "overlay_core/line_cache.h"
+
+namespace tono_overlay {
+
+OffscreenTarget::OffscreenTarget(TextRasterizer* rasterizer)
+    : pipeline_(rasterizer), surfaces_(pipeline_.CreateSurfaces()) {}
+
+const Surface* OffscreenTarget::Render(const std::string& text,
+                                       const OverlayStyle& style, int width,
+                                       int height) {
+  valid_ = pipeline_.Render(text, style, width, height, surfaces_.get()) !=
+           nullptr;
+  return frame();
+}
+
+const Surface* OffscreenTarget::frame() const {
+  return valid_ ? surfaces_->surface(kTextLayerOutput) : nullptr;
+}
+
+uint64_t OffscreenTarget::Digest() const {
+  const Surface* surface = frame();
+  if (!surface) return 0;
+  return HashBuilder()
+      .Add(surface->width())
+      .Add(surface->height())
+      .Add(surface->data(), surface->size_bytes())
+      .hash();
+}
+
+std::vector<uint8_t> SurfaceToRgba(const Surface& surface,
+                                   PixelFormat format) {
+  const size_t pixels = (size_t)surface.width() * surface.height();
+  std::vector<uint8_t> rgba(pixels * 4);
+  const uint8_t* src = surface.data();
+  for (size_t i = 0; i < pixels; ++i, src += 4) {
+    rgba[i * 4 + 0] = src[format.r_index];
+    rgba[i * 4 + 1] = src[format.g_index];
+    rgba[i * 4 + 2] = src[format.b_index];
+    rgba[i * 4 + 3] = src[3];
+  }
+  return rgba;
+}
+
+bool WritePam(const Surface& surface, PixelFormat format,
+              const std::string& path) {
+  if (surface.bytes_per_pixel() != 4) return false;
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+  file << "P7\nWIDTH " << surface.width() << "\nHEIGHT " << surface.height()
+       << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+  const std::vector<uint8_t> rgba = SurfaceToRgba(surface, format);
+  file.write(reinterpret_cast<const char*>(rgba.data()),
+             (std::streamsize)rgba.size());
+  return (bool)file;
+}
+
+bool ReadPam(const std::string& path, int* width, int* height,
+             std::vector<uint8_t>* rgba) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  std::string line;
+  if (!std::getline(file, line) || line != "P7") return false;
+  int w = 0, h = 0, depth = 0, maxval = 0;
+  while (std::getline(file, line) && line != "ENDHDR") {
+    std::istringstream fields(line);
+    std::string key;
+    fields >> key;
+    if (key == "WIDTH") fields >> w;
+    if (key == "HEIGHT") fields >> h;
+    if (key == "DEPTH") fields >> depth;
+    if (key == "MAXVAL") fields >> maxval;
+  }
+  if (line != "ENDHDR" || w <= 0 || h <= 0 || depth != 4 || maxval != 255) {
+    return false;
+  }
+  rgba->resize((size_t)w * h * 4);
+  file.read(reinterpret_cast<char*>(rgba->data()),
+            (std::streamsize)rgba->size());
+  if (!file) return false;
+  *width = w;
+  *height = h;
+  return true;
+}
+
+}  // namespace tono_overlay
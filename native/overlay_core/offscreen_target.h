@@ -0,0 +1,55 @@
+// offscreen_target.h
+#ifndef OVERLAY_CORE_OFFSCREEN_TARGET_H_
+#define OVERLAY_CORE_OFFSCREEN_TARGET_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "overlay_core/text_layer.h"
+
+namespace tono_overlay {
+
+// Renders text layers into memory with no window or display, so tests and
+// benchmarks can run the whole pipeline headlessly and golden-image checks
+// can compare its output.
+class OffscreenTarget {
+ public:
+  // |rasterizer| must outlive the target.
+  explicit OffscreenTarget(TextRasterizer* rasterizer);
+
+  // Renders |text| into a width x height premultiplied frame. Returns the
+  // frame, or null if rendering failed.
+  const Surface* Render(const std::string& text, const OverlayStyle& style,
+                        int width, int height);
+
+  // The last frame Render() produced, or null.
+  const Surface* frame() const;
+  PixelFormat pixel_format() const { return surfaces_->pixel_format(); }
+
+  // FNV-1a of the last frame's size and pixels; 0 without a frame. The
+  // pipeline is deterministic, so equal inputs give equal digests.
+  uint64_t Digest() const;
+
+ private:
+  TextLayerPipeline pipeline_;
+  std::unique_ptr<SurfacePool> surfaces_;
+  bool valid_ = false;
+};
+
+// Writes |surface| (32-bit, premultiplied, channel order |format|) as a
+// binary PAM image with RGB_ALPHA tuples. Returns false on I/O errors.
+bool WritePam(const Surface& surface, PixelFormat format,
+              const std::string& path);
+
+// Reads a PAM written by WritePam into tightly packed RGBA bytes.
+bool ReadPam(const std::string& path, int* width, int* height,
+             std::vector<uint8_t>* rgba);
+
+// Converts |surface| to the RGBA byte order ReadPam returns.
+std::vector<uint8_t> SurfaceToRgba(const Surface& surface, PixelFormat format);
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_OFFSCREEN_TARGET_H_
@@ -0,0 +1,298 @@
+// overlay_api.cc
+#include "overlay_core/overlay_api.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <utility>
+
+
+namespace tono_overlay {
+
+namespace {
+
+enum class AbiKind { kInt, kColor, kBool, kString };
+
+// TonoOverlayStyle member behind each field bit, and the applyOverlayStyle
+// key it is decoded as.
+struct AbiField {
+  uint32_t bit;
+  const char* key;
+  AbiKind kind;
+  size_t offset;
+};
+
+#define TONO_ABI_FIELD(bit, key, kind, member) \
+  {bit, key, AbiKind::kind, offsetof(TonoOverlayStyle, member)}
+
+const AbiField kAbiFields[] = {
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_FONT_FAMILY, "fontFamily", kString,
+                   font_family),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_FONT_SIZE, "fontSize", kInt, font_size),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_FONT_WEIGHT, "fontWeight", kInt,
+                   font_weight),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_BOLD, "bold", kBool, bold),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_TEXT_COLOR, "textColor", kColor,
+                   text_color),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_TEXT_OPACITY, "textOpacity", kInt,
+                   text_opacity),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_STROKE_WIDTH, "strokeWidth", kInt,
+                   stroke_width),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_STROKE_COLOR, "strokeColor", kColor,
+                   stroke_color),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_HIGHLIGHT_COLOR, "highlightColor",
+                   kColor, highlight_color),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_TEXT_ALIGN, "textAlign", kInt,
+                   text_align),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_WIDTH, "width", kInt, width),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_LINES, "lines", kInt, lines),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_PADDING, "padding", kInt, padding),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_X, "x", kInt, x),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_Y, "y", kInt, y),
+    TONO_ABI_FIELD(TONO_OVERLAY_STYLE_BACKGROUND_ALPHA, "backgroundAlpha",
+                   kInt, background_alpha),
+};
+
+#undef TONO_ABI_FIELD
+
+template <typename T>
+T ReadMember(const TonoOverlayStyle& style, size_t offset) {
+  T value;
+  std::memcpy(&value, reinterpret_cast<const char*>(&style) + offset,
+              sizeof(value));
+  return value;
+}
+
+// Calls from other threads, waiting for the host thread. Each kind keeps
+// only its latest value; style fields merge.
+struct PendingCalls {
+  bool has_text = false;
+  std::string text;
+  OverlayStyleUpdate style;
+  bool has_sheet = false;
+  std::string sheet_lrc;
+  bool has_playback = false;
+  int64_t position_ms = 0;
+  bool playing = false;
+  double rate = 1.0;
+  // Clock time of the playback call, to age the position when applied.
+  int64_t playback_at_ms = 0;
+
+  void Clear() {
+    has_text = false;
+    style.Clear();
+    has_sheet = false;
+    has_playback = false;
+  }
+};
+
+struct ApiRouter {
+  std::mutex mutex;
+  OverlayApiHost* host = nullptr;
+  const Clock* clock = nullptr;
+  SteadyClock steady_clock;
+  PendingCalls pending;
+  // Wake() was called and the drain has not run yet.
+  bool wake_posted = false;
+
+  // Host thread only. Swapped with |pending| on every drain, so both keep
+  // their string storage and a steady stream of calls does not allocate.
+  PendingCalls draining;
+  std::string direct_text;
+  LrcParser lrc_parser;
+};
+
+ApiRouter& Router() {
+  static ApiRouter* router = new ApiRouter();
+  return *router;
+}
+
+// Requests a drain for the first call queued since the last one. Called
+// with the router's mutex held.
+void WakeLocked(ApiRouter& r) {
+  if (r.wake_posted) return;
+  r.wake_posted = true;
+  r.host->Wake();
+}
+
+}  // namespace
+
+void SetOverlayApiHost(OverlayApiHost* host, const Clock* clock) {
+  ApiRouter& r = Router();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.host = host;
+  r.clock = clock ? clock : &r.steady_clock;
+  r.pending.Clear();
+  r.wake_posted = false;
+}
+
+void DrainOverlayApi() {
+  ApiRouter& r = Router();
+  OverlayApiHost* host = nullptr;
+  int64_t now_ms = 0;
+  {
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.wake_posted = false;
+    host = r.host;
+    if (!host) return;
+    std::swap(r.pending, r.draining);
+    now_ms = r.clock->NowMs();
+  }
+  PendingCalls& calls = r.draining;
+  // Style first, so the text is rendered once, with it.
+  if (!calls.style.empty()) host->ApplyStyle(calls.style);
+  // Before the playback anchor, which then picks a line of the new sheet.
+  if (calls.has_sheet) host->SetSheet(r.lrc_parser.Parse(calls.sheet_lrc));
+  if (calls.has_text) host->SetText(calls.text);
+  if (calls.has_playback) {
+    int64_t position_ms = calls.position_ms;
+    if (calls.playing) {
+      position_ms += (int64_t)std::llround(
+          (double)(now_ms - calls.playback_at_ms) * calls.rate);
+    }
+    host->SetPlayback(position_ms, calls.playing, calls.rate);
+  }
+  calls.Clear();
+}
+
+bool StyleUpdateFromAbi(const TonoOverlayStyle& style,
+                        OverlayStyleUpdate* update, const char** error) {
+  uint32_t known = 0;
+  for (const AbiField& field : kAbiFields) known |= field.bit;
+  if (style.fields & ~known) {
+    *error = "unknown style field bits";
+    return false;
+  }
+  for (const AbiField& field : kAbiFields) {
+    if (!(style.fields & field.bit)) continue;
+    StyleValue value;
+    switch (field.kind) {
+      case AbiKind::kInt:
+        value = StyleValue::Number(ReadMember<int32_t>(style, field.offset));
+        break;
+      case AbiKind::kColor:
+        value = StyleValue::Number(ReadMember<uint32_t>(style, field.offset));
+        break;
+      case AbiKind::kBool:
+        value =
+            StyleValue::Bool(ReadMember<int32_t>(style, field.offset) != 0);
+        break;
+      case AbiKind::kString: {
+        const char* text = ReadMember<const char*>(style, field.offset);
+        if (!text) {
+          *error = field.key;
+          return false;
+        }
+        value = StyleValue::String(text);
+        break;
+      }
+    }
+    if (!update->Decode(field.key, value, nullptr)) {
+      *error = field.key;
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace tono_overlay
+
+using tono_overlay::ApiRouter;
+using tono_overlay::Router;
+
+extern "C" {
+
+int32_t tono_overlay_api_version(void) { return TONO_OVERLAY_API_VERSION; }
+
+int32_t tono_overlay_set_text(const char* utf8, size_t len) {
+  if (!utf8 && len != 0) return TONO_OVERLAY_ERROR_INVALID_ARGUMENT;
+  if (!utf8) utf8 = "";
+  ApiRouter& r = Router();
+  std::unique_lock<std::mutex> lock(r.mutex);
+  if (!r.host) return TONO_OVERLAY_ERROR_NO_OVERLAY;
+  if (r.host->OnHostThread()) {
+    tono_overlay::OverlayApiHost* host = r.host;
+    lock.unlock();
+    // Calls queued by other threads came first.
+    tono_overlay::DrainOverlayApi();
+    r.direct_text.assign(utf8, len);
+    host->SetText(r.direct_text);
+    return TONO_OVERLAY_OK;
+  }
+  r.pending.text.assign(utf8, len);
+  r.pending.has_text = true;
+  tono_overlay::WakeLocked(r);
+  return TONO_OVERLAY_OK;
+}
+
+int32_t tono_overlay_apply_style(const TonoOverlayStyle* style) {
+  if (!style || style->struct_size < sizeof(TonoOverlayStyle)) {
+    return TONO_OVERLAY_ERROR_INVALID_ARGUMENT;
+  }
+  // Decoded in place; the queued path merges it into |pending| by value.
+  tono_overlay::OverlayStyleUpdate update;
+  const char* error = nullptr;
+  if (!tono_overlay::StyleUpdateFromAbi(*style, &update, &error)) {
+    return TONO_OVERLAY_ERROR_INVALID_ARGUMENT;
+  }
+  ApiRouter& r = Router();
+  std::unique_lock<std::mutex> lock(r.mutex);
+  if (!r.host) return TONO_OVERLAY_ERROR_NO_OVERLAY;
+  if (r.host->OnHostThread()) {
+    tono_overlay::OverlayApiHost* host = r.host;
+    lock.unlock();
+    tono_overlay::DrainOverlayApi();
+    host->ApplyStyle(update);
+    return TONO_OVERLAY_OK;
+  }
+  r.pending.style.MergeFrom(update);
+  tono_overlay::WakeLocked(r);
+  return TONO_OVERLAY_OK;
+}
+
+int32_t tono_overlay_set_sheet_lrc(const char* utf8, size_t len) {
+  if (!utf8 && len != 0) return TONO_OVERLAY_ERROR_INVALID_ARGUMENT;
+  ApiRouter& r = Router();
+  std::unique_lock<std::mutex> lock(r.mutex);
+  if (!r.host) return TONO_OVERLAY_ERROR_NO_OVERLAY;
+  if (r.host->OnHostThread()) {
+    tono_overlay::OverlayApiHost* host = r.host;
+    lock.unlock();
+    tono_overlay::DrainOverlayApi();
+    // Parsed in place: the lines view the caller's buffer.
+    const std::string_view lrc(utf8 ? utf8 : "", len);
+    host->SetSheet(r.lrc_parser.Parse(lrc));
+    return TONO_OVERLAY_OK;
+  }
+  r.pending.sheet_lrc.assign(utf8 ? utf8 : "", len);
+  r.pending.has_sheet = true;
+  tono_overlay::WakeLocked(r);
+  return TONO_OVERLAY_OK;
+}
+
+int32_t tono_overlay_set_playback(int64_t position_ms, int32_t playing,
+                                  double rate) {
+  if (position_ms < 0 || !std::isfinite(rate) || rate <= 0.0) {
+    return TONO_OVERLAY_ERROR_INVALID_ARGUMENT;
+  }
+  ApiRouter& r = Router();
+  std::unique_lock<std::mutex> lock(r.mutex);
+  if (!r.host) return TONO_OVERLAY_ERROR_NO_OVERLAY;
+  if (r.host->OnHostThread()) {
+    tono_overlay::OverlayApiHost* host = r.host;
+    lock.unlock();
+    tono_overlay::DrainOverlayApi();
+    host->SetPlayback(position_ms, playing != 0, rate);
+    return TONO_OVERLAY_OK;
+  }
+  r.pending.has_playback = true;
+  r.pending.position_ms = position_ms;
+  r.pending.playing = playing != 0;
+  r.pending.rate = rate;
+  r.pending.playback_at_ms = r.clock->NowMs();
+  tono_overlay::WakeLocked(r);
+  return TONO_OVERLAY_OK;
+}
+
+}  // extern "C"
@@ -0,0 +1,59 @@
+// overlay_api.h
+#ifndef OVERLAY_CORE_OVERLAY_API_H_
+#define OVERLAY_CORE_OVERLAY_API_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "overlay_core/clock.h"
+#include "overlay_core/lrc_parser.h"
+#include "overlay_core/overlay_style_decoder.h"
+#include "overlay_core/tono_overlay_api.h"
+
+namespace tono_overlay {
+
+// The overlay behind the C API of tono_overlay_api.h, implemented by each
+// runner. The Set/Apply methods run on the host thread only.
+class OverlayApiHost {
+ public:
+  virtual ~OverlayApiHost() = default;
+
+  // True on the thread that owns the overlay. Calls made there are applied
+  // directly.
+  virtual bool OnHostThread() const = 0;
+  // Called on another thread after it queued the first call of a batch;
+  // must make the host thread call DrainOverlayApi() soon (post a message,
+  // add an idle source). Not called again until that drain.
+  virtual void Wake() = 0;
+
+  virtual void SetText(const std::string& utf8) = 0;
+  virtual void ApplyStyle(const OverlayStyleUpdate& update) = 0;
+  // The parsed sheet, sorted by time. The views are only valid during the
+  // call.
+  virtual void SetSheet(const std::vector<LrcLine>& lines) = 0;
+  virtual void SetPlayback(int64_t position_ms, bool playing,
+                           double rate) = 0;
+};
+
+// Routes the C API to |host| (null: none, calls fail with
+// TONO_OVERLAY_ERROR_NO_OVERLAY). |clock| (null: a SteadyClock) ages the
+// position of a queued tono_overlay_set_playback() until it is applied.
+// Both must outlive the registration; calls queued for a previous host are
+// dropped.
+void SetOverlayApiHost(OverlayApiHost* host, const Clock* clock = nullptr);
+
+// Applies the calls queued by other threads. Called on the host thread,
+// after OverlayApiHost::Wake().
+void DrainOverlayApi();
+
+// Decodes the members of |style| selected by its field bits, validated like
+// applyOverlayStyle, without allocating; the font family is copied into
+// |update|. On failure returns false with the key of the first invalid
+// field, or a note on the field bits, in |error|.
+bool StyleUpdateFromAbi(const TonoOverlayStyle& style,
+                        OverlayStyleUpdate* update, const char** error);
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_OVERLAY_API_H_
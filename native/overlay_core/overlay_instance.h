@@ -0,0 +1,95 @@
+// overlay_instance.h
+#ifndef OVERLAY_CORE_OVERLAY_INSTANCE_H_
+#define OVERLAY_CORE_OVERLAY_INSTANCE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace tono_overlay {
+
+// Addresses one overlay window of the process: the optional "id" argument
+// of every window channel method. Calls without one, and the C API of
+// tono_overlay_api.h, go to kDefaultOverlayId.
+using OverlayId = int64_t;
+constexpr OverlayId kDefaultOverlayId = 0;
+
+// The overlay instances of a runner by id, created on first use. Each one
+// is a window with its own text, style, sheet and timeline (original and
+// translated lyrics, one overlay per monitor); what they share, such as
+// fonts, the line cache and the render worker, is up to the factory.
+// Not thread-safe: runners keep it on the window thread.
+template <typename Instance>
+class OverlayRegistry {
+ public:
+  static constexpr size_t kDefaultMaxInstances = 16;
+
+  // Creates the instance for |id|; null on failure.
+  using Factory = std::function<std::unique_ptr<Instance>(OverlayId id)>;
+
+  explicit OverlayRegistry(Factory factory,
+                           size_t max_instances = kDefaultMaxInstances)
+      : factory_(std::move(factory)), max_instances_(max_instances) {}
+
+  OverlayRegistry(const OverlayRegistry&) = delete;
+  OverlayRegistry& operator=(const OverlayRegistry&) = delete;
+
+  // The instance for |id|, or null.
+  Instance* Find(OverlayId id) const {
+    auto it = instances_.find(id);
+    return it != instances_.end() ? it->second.get() : nullptr;
+  }
+
+  // The instance for |id|, created if needed. Null if the factory failed
+  // or |max_instances| others already exist, so a runaway caller cannot
+  // open windows without bound.
+  Instance* Get(OverlayId id) {
+    if (Instance* instance = Find(id)) return instance;
+    if (instances_.size() >= max_instances_) return nullptr;
+    std::unique_ptr<Instance> instance = factory_(id);
+    if (!instance) return nullptr;
+    Instance* raw = instance.get();
+    instances_.emplace(id, std::move(instance));
+    return raw;
+  }
+
+  // Destroys the instance for |id|; false if there is none. It is out of
+  // the registry before its destructor runs.
+  bool Remove(OverlayId id) {
+    auto it = instances_.find(id);
+    if (it == instances_.end()) return false;
+    std::unique_ptr<Instance> instance = std::move(it->second);
+    instances_.erase(it);
+    return true;
+  }
+
+  // Calls |fn(id, instance)| for every instance in id order. |fn| must not
+  // add or remove instances.
+  template <typename Fn>
+  void ForEach(Fn fn) const {
+    for (const auto& entry : instances_) fn(entry.first, entry.second.get());
+  }
+
+  std::vector<OverlayId> ids() const {
+    std::vector<OverlayId> ids;
+    ids.reserve(instances_.size());
+    for (const auto& entry : instances_) ids.push_back(entry.first);
+    return ids;
+  }
+
+  size_t size() const { return instances_.size(); }
+  size_t max_instances() const { return max_instances_; }
+
+ private:
+  Factory factory_;
+  const size_t max_instances_;
+  std::map<OverlayId, std::unique_ptr<Instance>> instances_;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_OVERLAY_INSTANCE_H_
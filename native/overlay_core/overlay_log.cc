@@ -0,0 +1,192 @@
+// overlay_log.cc
+#include "overlay_core/overlay_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace tono_overlay {
+
+namespace {
+
+std::atomic<AsyncLogger*> g_logger{nullptr};
+
+size_t RoundUpToPowerOfTwo(size_t n) {
+  size_t p = 2;
+  while (p < n) p <<= 1;
+  return p;
+}
+
+int64_t WallClockMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// "HH:MM:SS.mmm X " in UTC.
+void AppendPrefix(std::string* out, int64_t time_ms, LogLevel level) {
+  const int64_t day_ms = ((time_ms % 86400000) + 86400000) % 86400000;
+  char prefix[32];
+  const int n = std::snprintf(
+      prefix, sizeof(prefix), "%02d:%02d:%02d.%03d %c ",
+      (int)(day_ms / 3600000), (int)(day_ms / 60000 % 60),
+      (int)(day_ms / 1000 % 60), (int)(day_ms % 1000), LogLevelLetter(level));
+  if (n > 0) out->append(prefix, std::min((size_t)n, sizeof(prefix) - 1));
+}
+
+}  // namespace
+
+char LogLevelLetter(LogLevel level) {
+  switch (level) {
+    case LogLevel::kVerbose:
+      return 'V';
+    case LogLevel::kInfo:
+      return 'I';
+    case LogLevel::kWarning:
+      return 'W';
+    case LogLevel::kError:
+      return 'E';
+  }
+  return '?';
+}
+
+FileLogSink::FileLogSink(const std::string& path)
+    : file_(path, std::ios::binary | std::ios::app) {}
+
+void FileLogSink::Write(const char* data, size_t size) {
+  if (!file_) return;
+  file_.write(data, (std::streamsize)size);
+  file_.flush();
+}
+
+AsyncLogger::AsyncLogger(std::unique_ptr<LogSink> sink, size_t capacity,
+                         int flush_interval_ms)
+    : sink_(std::move(sink)),
+      flush_interval_ms_(std::max(flush_interval_ms, 1)) {
+  capacity = RoundUpToPowerOfTwo(capacity);
+  slots_.reset(new Slot[capacity]);
+  mask_ = capacity - 1;
+  for (size_t i = 0; i < capacity; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  flusher_ = std::thread(&AsyncLogger::Run, this);
+}
+
+AsyncLogger::~AsyncLogger() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  flusher_.join();
+}
+
+// Bounded multi-producer queue after Dmitry Vyukov: each slot's sequence
+// says whether it is free for the producer at that position (== pos) or
+// published for the consumer (== pos + 1).
+bool AsyncLogger::Log(LogLevel level, std::string_view message) {
+  if (!IsEnabled(level)) return false;
+  size_t pos = enqueue_.pos.load(std::memory_order_relaxed);
+  Slot* slot;
+  for (;;) {
+    slot = &slots_[pos & mask_];
+    const size_t seq = slot->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (enqueue_.pos.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The flusher has not freed this slot yet: the ring is full.
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = enqueue_.pos.load(std::memory_order_relaxed);
+    }
+  }
+  slot->time_ms = WallClockMs();
+  slot->level = level;
+  slot->size = (uint16_t)std::min(message.size(), kMaxMessageBytes);
+  std::memcpy(slot->text, message.data(), slot->size);
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+void AsyncLogger::Flush() {
+  const size_t target = enqueue_.pos.load(std::memory_order_acquire);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (dequeue_.pos.load(std::memory_order_acquire) < target && !stop_) {
+    flush_requested_ = true;
+    wake_.notify_one();
+    drained_.wait(lock);
+  }
+}
+
+void AsyncLogger::Drain(std::string* batch) {
+  batch->clear();
+  size_t pos = dequeue_.pos.load(std::memory_order_relaxed);
+  uint64_t count = 0;
+  for (;;) {
+    Slot& slot = slots_[pos & mask_];
+    // Stops at a slot a producer has claimed but not finished writing; the
+    // next pass picks it up.
+    if (slot.sequence.load(std::memory_order_acquire) != pos + 1) break;
+    AppendPrefix(batch, slot.time_ms, slot.level);
+    batch->append(slot.text, slot.size);
+    batch->push_back('\n');
+    slot.sequence.store(pos + mask_ + 1, std::memory_order_release);
+    ++pos;
+    ++count;
+  }
+  const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+  if (dropped != dropped_reported_) {
+    AppendPrefix(batch, WallClockMs(), LogLevel::kWarning);
+    batch->append("log ring full, dropped ");
+    batch->append(std::to_string(dropped - dropped_reported_));
+    batch->append(" record(s)\n");
+    dropped_reported_ = dropped;
+  }
+  if (!batch->empty() && sink_) sink_->Write(batch->data(), batch->size());
+  written_.fetch_add(count, std::memory_order_relaxed);
+  // Published after the write, so Flush() returning means "on disk".
+  dequeue_.pos.store(pos, std::memory_order_release);
+}
+
+void AsyncLogger::Run() {
+  // Reused across batches so steady-state flushing does not allocate.
+  std::string batch;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait_for(lock, std::chrono::milliseconds(flush_interval_ms_),
+                   [this] { return stop_ || flush_requested_; });
+    const bool stop = stop_;
+    flush_requested_ = false;
+    lock.unlock();
+    Drain(&batch);
+    lock.lock();
+    drained_.notify_all();
+    if (stop) break;
+  }
+}
+
+void SetOverlayLogger(AsyncLogger* logger) {
+  g_logger.store(logger, std::memory_order_release);
+}
+
+AsyncLogger* OverlayLogger() {
+  return g_logger.load(std::memory_order_acquire);
+}
+
+ScopedOverlayLogger::ScopedOverlayLogger(std::unique_ptr<AsyncLogger> logger)
+    : logger_(std::move(logger)) {
+  SetOverlayLogger(logger_.get());
+}
+
+ScopedOverlayLogger::~ScopedOverlayLogger() {
+  if (OverlayLogger() == logger_.get()) SetOverlayLogger(nullptr);
+}
+
+}  // namespace tono_overlay
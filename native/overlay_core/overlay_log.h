@@ -0,0 +1,181 @@
+// overlay_log.h
+#ifndef OVERLAY_CORE_OVERLAY_LOG_H_
+#define OVERLAY_CORE_OVERLAY_LOG_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Verbose logging is compiled out of release builds unless the build sets
+// TONO_OVERLAY_VERBOSE_LOGGING=1.
+#ifndef TONO_OVERLAY_VERBOSE_LOGGING
+#ifdef NDEBUG
+#define TONO_OVERLAY_VERBOSE_LOGGING 0
+#else
+#define TONO_OVERLAY_VERBOSE_LOGGING 1
+#endif
+#endif
+
+namespace tono_overlay {
+
+enum class LogLevel : int { kVerbose = 0, kInfo, kWarning, kError };
+
+// One letter per level: V, I, W, E.
+char LogLevelLetter(LogLevel level);
+
+// Where the logger's flusher thread writes batches of formatted lines.
+class LogSink {
+ public:
+  virtual ~LogSink() = default;
+  virtual void Write(const char* data, size_t size) = 0;
+};
+
+// Appends to a file kept open for the logger's lifetime.
+class FileLogSink : public LogSink {
+ public:
+  explicit FileLogSink(const std::string& path);
+
+  bool is_open() const { return file_.is_open(); }
+  void Write(const char* data, size_t size) override;
+
+ private:
+  std::ofstream file_;
+};
+
+// Logger whose Log() never blocks or allocates: records go into a bounded
+// lock-free multi-producer ring and a background thread formats and writes
+// them in batches. When the ring is full the record is dropped and counted;
+// the flusher reports the count in the log.
+class AsyncLogger {
+ public:
+  // Records in the ring; rounded up to a power of two.
+  static constexpr size_t kDefaultCapacity = 1024;
+  // Longer messages are truncated.
+  static constexpr size_t kMaxMessageBytes = 232;
+  static constexpr int kDefaultFlushIntervalMs = 50;
+
+  explicit AsyncLogger(std::unique_ptr<LogSink> sink,
+                       size_t capacity = kDefaultCapacity,
+                       int flush_interval_ms = kDefaultFlushIntervalMs);
+  // Writes everything still queued, then stops the flusher.
+  ~AsyncLogger();
+
+  AsyncLogger(const AsyncLogger&) = delete;
+  AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+  // Defaults to kVerbose when TONO_OVERLAY_VERBOSE_LOGGING is on, kInfo
+  // otherwise.
+  void SetMinLevel(LogLevel level) {
+    min_level_.store((int)level, std::memory_order_relaxed);
+  }
+  bool IsEnabled(LogLevel level) const {
+    return (int)level >= min_level_.load(std::memory_order_relaxed);
+  }
+
+  // Queues one line. Safe from any thread. Returns false if the level is
+  // disabled or the ring was full.
+  bool Log(LogLevel level, std::string_view message);
+
+  // Blocks until every record queued before the call has been written.
+  void Flush();
+
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+  uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence{0};
+    int64_t time_ms = 0;
+    LogLevel level = LogLevel::kInfo;
+    uint16_t size = 0;
+    char text[kMaxMessageBytes];
+  };
+  // A ring position padded to its own cache line, so producers bumping the
+  // enqueue position do not contend with the flusher. Plain padding rather
+  // than alignas, which MSVC warns about (C4324).
+  struct Cursor {
+    std::atomic<size_t> pos{0};
+    char padding[64 - sizeof(std::atomic<size_t>)];
+  };
+
+  // Moves every published record into the sink. Flusher thread only.
+  void Drain(std::string* batch);
+  void Run();
+
+  std::unique_ptr<LogSink> sink_;
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  const int flush_interval_ms_;
+  std::atomic<int> min_level_{TONO_OVERLAY_VERBOSE_LOGGING
+                                  ? (int)LogLevel::kVerbose
+                                  : (int)LogLevel::kInfo};
+  Cursor enqueue_;
+  Cursor dequeue_;
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> written_{0};
+  uint64_t dropped_reported_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable drained_;
+  bool flush_requested_ = false;
+  bool stop_ = false;
+  std::thread flusher_;
+};
+
+// Process-wide logger used by the TONO_LOG macros; null until a runner
+// installs one. Whoever owns the logger must uninstall it (nullptr) before
+// destroying it; ScopedOverlayLogger does both.
+void SetOverlayLogger(AsyncLogger* logger);
+AsyncLogger* OverlayLogger();
+
+// Installs |logger| as the process logger for its lifetime.
+class ScopedOverlayLogger {
+ public:
+  explicit ScopedOverlayLogger(std::unique_ptr<AsyncLogger> logger);
+  ~ScopedOverlayLogger();
+
+  ScopedOverlayLogger(const ScopedOverlayLogger&) = delete;
+  ScopedOverlayLogger& operator=(const ScopedOverlayLogger&) = delete;
+
+  AsyncLogger* get() const { return logger_.get(); }
+
+ private:
+  std::unique_ptr<AsyncLogger> logger_;
+};
+
+}  // namespace tono_overlay
+
+// TONO_LOG(kInfo, "size=" << w << "x" << h). The stream expression is only
+// evaluated when a logger is installed and the level is enabled.
+#define TONO_LOG(level, expr)                                              \
+  do {                                                                     \
+    ::tono_overlay::AsyncLogger* tono_logger_ =                            \
+        ::tono_overlay::OverlayLogger();                                   \
+    if (tono_logger_ &&                                                    \
+        tono_logger_->IsEnabled(::tono_overlay::LogLevel::level)) {        \
+      std::ostringstream tono_log_stream_;                                 \
+      tono_log_stream_ << expr;                                            \
+      tono_logger_->Log(::tono_overlay::LogLevel::level,                   \
+                        tono_log_stream_.str());                           \
+    }                                                                      \
+  } while (0)
+
+// Per-frame and per-call tracing; compiled out of release builds.
+#if TONO_OVERLAY_VERBOSE_LOGGING
+#define TONO_VLOG(expr) TONO_LOG(kVerbose, expr)
+#else
+#define TONO_VLOG(expr) \
+  do {                  \
+  } while (0)
+#endif
+
+#endif  // OVERLAY_CORE_OVERLAY_LOG_H_
@@ -0,0 +1,146 @@
+// overlay_state.cc
+#include "overlay_core/overlay_state.h"
+
+#include <algorithm>
+
+namespace tono_overlay {
+
+uint32_t StagesForFields(uint32_t fields) {
+  uint32_t stages = 0;
+  if (fields & (kFieldFontFamily | kFieldFontSize | kFieldFontWeight)) {
+    stages |= kStageFont;
+  }
+  if (fields & (kFieldLines | kFieldWidth | kFieldPadding)) {
+    stages |= kStageLayout;
+  }
+  if (fields & (kFieldStrokeWidth | kFieldTextAlign | kFieldMarquee)) {
+    stages |= kStageRaster;
+  }
+  if (fields & (kFieldTextColor | kFieldTextOpacity | kFieldStrokeColor |
+                kFieldHighlightColor | kFieldBackgroundColor |
+                kFieldBackgroundAlpha | kFieldCornerRadius)) {
+    stages |= kStageComposite;
+  }
+  if (fields & kFieldPosition) stages |= kStageWindow;
+  // A font changes line height, the layout changes the surface size, new
+  // masks need compositing, and new pixels need presenting.
+  if (stages & kStageFont) stages |= kStageLayout;
+  if (stages & kStageLayout) stages |= kStageRaster;
+  if (stages & kStageRaster) stages |= kStageComposite;
+  if (stages & kStageComposite) stages |= kStagePresent;
+  return stages;
+}
+
+uint32_t OverlayState::TakeDirtyStages() {
+  const uint32_t stages = StagesForFields(dirty_);
+  dirty_ = 0;
+  return stages;
+}
+
+bool OverlayState::SetFontFamily(std::string_view family) {
+  return Set(&OverlayStyle::font_family, family, kFieldFontFamily);
+}
+
+bool OverlayState::SetFontSize(int points) {
+  return Set(&OverlayStyle::font_size, std::max(points, 1), kFieldFontSize);
+}
+
+bool OverlayState::SetFontWeight(int weight) {
+  weight = std::clamp(weight, 100, 900);
+  bool changed = Set(&OverlayStyle::font_weight, weight, kFieldFontWeight);
+  changed |= Set(&OverlayStyle::font_bold, weight >= 700, kFieldFontWeight);
+  return changed;
+}
+
+bool OverlayState::SetBold(bool bold) {
+  bool changed = Set(&OverlayStyle::font_bold, bold, kFieldFontWeight);
+  changed |= Set(&OverlayStyle::font_weight, bold ? 700 : 400,
+                 kFieldFontWeight);
+  return changed;
+}
+
+bool OverlayState::SetTextColor(uint32_t rgb) {
+  return Set(&OverlayStyle::text_color, rgb & 0xFFFFFFu, kFieldTextColor);
+}
+
+bool OverlayState::SetTextOpacity(int alpha) {
+  return Set(&OverlayStyle::text_opacity, std::clamp(alpha, 0, 255),
+             kFieldTextOpacity);
+}
+
+bool OverlayState::SetStrokeWidth(int width) {
+  return Set(&OverlayStyle::stroke_width,
+             std::clamp(width, 0, kMaxStrokeWidth), kFieldStrokeWidth);
+}
+
+bool OverlayState::SetStrokeColor(uint32_t rgb) {
+  return Set(&OverlayStyle::stroke_color, rgb & 0xFFFFFFu, kFieldStrokeColor);
+}
+
+bool OverlayState::SetHighlightColor(uint32_t rgb) {
+  return Set(&OverlayStyle::highlight_color, rgb & 0xFFFFFFu,
+             kFieldHighlightColor);
+}
+
+bool OverlayState::SetTextAlign(int align) {
+  return Set(&OverlayStyle::text_align, std::clamp(align, 0, 2),
+             kFieldTextAlign);
+}
+
+bool OverlayState::SetLines(int lines) {
+  return Set(&OverlayStyle::lines, std::max(lines, 1), kFieldLines);
+}
+
+bool OverlayState::SetWidth(int width) {
+  return Set(&OverlayStyle::width, std::max(width, 1), kFieldWidth);
+}
+
+bool OverlayState::SetPadding(int padding) {
+  return Set(&OverlayStyle::padding, std::max(padding, 0), kFieldPadding);
+}
+
+bool OverlayState::SetPosition(int x, int y) {
+  bool changed = Set(&OverlayStyle::x, x, kFieldPosition);
+  changed |= Set(&OverlayStyle::y, y, kFieldPosition);
+  return changed;
+}
+
+bool OverlayState::SetBackgroundAlpha(int alpha) {
+  return Set(&OverlayStyle::background_alpha, std::clamp(alpha, 0, 255),
+             kFieldBackgroundAlpha);
+}
+
+bool OverlayState::SetBackgroundColor(uint32_t rgb) {
+  return Set(&OverlayStyle::background_color, rgb & 0xFFFFFFu,
+             kFieldBackgroundColor);
+}
+
+bool OverlayState::SetCornerRadius(int radius) {
+  return Set(&OverlayStyle::corner_radius,
+             std::clamp(radius, 0, kMaxCornerRadius), kFieldCornerRadius);
+}
+
+bool OverlayState::SetTransition(TransitionKind kind) {
+  return Set(&OverlayStyle::transition, kind, kFieldTransition);
+}
+
+bool OverlayState::SetTransitionDuration(int ms) {
+  return Set(&OverlayStyle::transition_ms,
+             std::clamp(ms, 0, kMaxTransitionMs), kFieldTransition);
+}
+
+bool OverlayState::SetMarquee(bool enable) {
+  return Set(&OverlayStyle::marquee, enable, kFieldMarquee);
+}
+
+bool OverlayState::SetMarqueeSpeed(int speed) {
+  return Set(&OverlayStyle::marquee_speed,
+             std::clamp(speed, 1, kMaxMarqueeSpeed), kFieldMarqueeMotion);
+}
+
+bool OverlayState::SetMarqueePause(int ms) {
+  return Set(&OverlayStyle::marquee_pause_ms,
+             std::clamp(ms, 0, kMaxMarqueePauseMs), kFieldMarqueeMotion);
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,154 @@
+// overlay_state.h
+#ifndef OVERLAY_CORE_OVERLAY_STATE_H_
+#define OVERLAY_CORE_OVERLAY_STATE_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "overlay_core/line_transition.h"
+
+namespace tono_overlay {
+
+// One bit per overlay setting.
+enum OverlayField : uint32_t {
+  kFieldFontFamily = 1u << 0,
+  kFieldFontSize = 1u << 1,
+  kFieldFontWeight = 1u << 2,  // weight and the bold flag
+  kFieldTextColor = 1u << 3,
+  kFieldTextOpacity = 1u << 4,
+  kFieldStrokeWidth = 1u << 5,
+  kFieldStrokeColor = 1u << 6,
+  kFieldHighlightColor = 1u << 7,
+  kFieldTextAlign = 1u << 8,
+  kFieldLines = 1u << 9,
+  kFieldWidth = 1u << 10,
+  kFieldPadding = 1u << 11,
+  kFieldPosition = 1u << 12,
+  kFieldBackgroundAlpha = 1u << 13,
+  kFieldTransition = 1u << 14,  // kind and duration
+  kFieldBackgroundColor = 1u << 15,
+  kFieldCornerRadius = 1u << 16,
+  kFieldMarquee = 1u << 17,        // scrolling overlong lines on or off
+  kFieldMarqueeMotion = 1u << 18,  // scroll speed and pauses
+};
+
+// Work an overlay update can need. Font, layout, raster, composite and
+// present form a pipeline: each stage implies the ones after it. The
+// background plate is composited with the text, so it is a composite
+// change; window covers the position, which never touches the pixels. The
+// line transition needs no stage: it is read when the next line arrives.
+// Neither does the marquee's motion, which is read on every frame; turning
+// the marquee on or off redraws the line into a strip or back.
+enum OverlayStage : uint32_t {
+  kStageFont = 1u << 0,       // rebuild the font object
+  kStageLayout = 1u << 1,     // recompute the window size
+  kStageRaster = 1u << 2,     // redraw the fill/stroke masks
+  kStageComposite = 1u << 3,  // recolor the masks into the output
+  kStagePresent = 1u << 4,    // push the output to the screen
+  kStageWindow = 1u << 5,     // move the window
+};
+
+// Stages needed after the fields in |fields| changed, with the pipeline
+// implications applied.
+uint32_t StagesForFields(uint32_t fields);
+
+// Every style setting of the overlay. Colors are 0xRRGGBB.
+struct OverlayStyle {
+  std::string font_family = "Segoe UI";  // UTF-8
+  int font_size = 14;                    // points
+  int font_weight = 400;                 // 100..900
+  bool font_bold = false;
+  uint32_t text_color = 0xFFFFFF;
+  int text_opacity = 255;
+  int stroke_width = 0;  // 0 = no stroke
+  uint32_t stroke_color = 0x000000;
+  uint32_t highlight_color = 0xFFC840;
+  int text_align = 0;  // 0 = left, 1 = center, 2 = right
+  int lines = 1;
+  int width = 600;
+  int padding = 8;
+  int x = 100;
+  int y = 100;
+  // Plate under the text, composited into the same layer.
+  uint32_t background_color = 0x000000;
+  int background_alpha = 30;
+  int corner_radius = 0;  // pixels
+  TransitionKind transition = TransitionKind::kCrossfade;
+  int transition_ms = 200;  // 0 = no transition
+  // A single line too long for the window scrolls back and forth instead
+  // of being cut with an ellipsis.
+  bool marquee = false;
+  int marquee_speed = 40;       // pixels per second
+  int marquee_pause_ms = 1500;  // rest at each end
+};
+
+// The overlay style plus a record of what changed since the runner last
+// rendered. Setters clamp their input, ignore values equal to the current
+// one and otherwise set the field's dirty bit and bump the version.
+class OverlayState {
+ public:
+  static constexpr int kMaxStrokeWidth = 20;
+  static constexpr int kMaxTransitionMs = 2000;
+  static constexpr int kMaxCornerRadius = 256;
+  static constexpr int kMaxMarqueeSpeed = 2000;
+  static constexpr int kMaxMarqueePauseMs = 60000;
+
+  const OverlayStyle& style() const { return style_; }
+  // Incremented on every effective change.
+  uint64_t version() const { return version_; }
+  uint32_t dirty_fields() const { return dirty_; }
+
+  // Returns the stages the pending changes need and clears the dirty bits.
+  uint32_t TakeDirtyStages();
+  // Clears dirty bits for changes the runner has already applied (e.g. a
+  // position that came from the user dragging the window).
+  void MarkClean(uint32_t fields) { dirty_ &= ~fields; }
+
+  bool SetFontFamily(std::string_view family);
+  bool SetFontSize(int points);
+  // Clamped to 100..900; bold follows (>= 700).
+  bool SetFontWeight(int weight);
+  // Bold maps to weight 700, regular to 400.
+  bool SetBold(bool bold);
+  bool SetTextColor(uint32_t rgb);
+  bool SetTextOpacity(int alpha);
+  bool SetStrokeWidth(int width);
+  bool SetStrokeColor(uint32_t rgb);
+  bool SetHighlightColor(uint32_t rgb);
+  bool SetTextAlign(int align);
+  bool SetLines(int lines);
+  bool SetWidth(int width);
+  bool SetPadding(int padding);
+  bool SetPosition(int x, int y);
+  bool SetBackgroundAlpha(int alpha);
+  bool SetBackgroundColor(uint32_t rgb);
+  // Clamped to 0..kMaxCornerRadius; the plate caps it at half its size.
+  bool SetCornerRadius(int radius);
+  bool SetTransition(TransitionKind kind);
+  // Clamped to 0..kMaxTransitionMs.
+  bool SetTransitionDuration(int ms);
+  bool SetMarquee(bool enable);
+  // Clamped to 1..kMaxMarqueeSpeed pixels per second.
+  bool SetMarqueeSpeed(int speed);
+  // Clamped to 0..kMaxMarqueePauseMs.
+  bool SetMarqueePause(int ms);
+
+ private:
+  template <typename T, typename V>
+  bool Set(T OverlayStyle::*member, const V& value, uint32_t field) {
+    if (style_.*member == value) return false;
+    style_.*member = value;
+    dirty_ |= field;
+    ++version_;
+    return true;
+  }
+
+  OverlayStyle style_;
+  uint64_t version_ = 0;
+  uint32_t dirty_ = 0;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_OVERLAY_STATE_H_
@@ -0,0 +1,135 @@
+// overlay_stats.cc
+#include "overlay_core/overlay_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "overlay_core/overlay_trace.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace tono_overlay {
+
+namespace {
+
+const char* const kStageNames[] = {
+    "font",   "layout", "rasterize", "stroke",  "composite",
+    "render", "blend",  "scroll",    "present", "update",
+};
+static_assert(sizeof(kStageNames) / sizeof(kStageNames[0]) ==
+                  (size_t)TimingStage::kCount,
+              "one name per TimingStage");
+
+// Index of the highest set bit of |v| > 0.
+int HighestBit(uint64_t v) {
+#if defined(_MSC_VER)
+  unsigned long index = 0;
+  _BitScanReverse64(&index, v);
+  return (int)index;
+#else
+  return 63 - __builtin_clzll(v);
+#endif
+}
+
+}  // namespace
+
+const char* TimingStageName(TimingStage stage) {
+  const int index = (int)stage;
+  if (index < 0 || index >= (int)TimingStage::kCount) return "unknown";
+  return kStageNames[index];
+}
+
+int LatencyHistogram::BucketFor(int64_t ns) {
+  if (ns < ((int64_t)1 << kMinShift)) return 0;
+  const int msb = HighestBit((uint64_t)ns);
+  const int octave = msb - kMinShift;
+  if (octave >= kOctaves) return kBucketCount - 1;
+  const int sub = (int)(ns >> (msb - kSubBucketBits)) & (kSubBuckets - 1);
+  return 1 + octave * kSubBuckets + sub;
+}
+
+int64_t LatencyHistogram::BucketLimitNs(int index) {
+  if (index <= 0) return (int64_t)1 << kMinShift;
+  const int octave = (index - 1) / kSubBuckets;
+  const int sub = (index - 1) % kSubBuckets;
+  const int shift = octave + kMinShift - kSubBucketBits;
+  return (int64_t)(kSubBuckets + sub + 1) << shift;
+}
+
+void LatencyHistogram::Record(int64_t ns) {
+  if (ns < 0) ns = 0;
+  buckets_[BucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_ns_.fetch_add((uint64_t)ns, std::memory_order_relaxed);
+  int64_t max = max_ns_.load(std::memory_order_relaxed);
+  while (ns > max && !max_ns_.compare_exchange_weak(
+                         max, ns, std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::Reset() {
+  for (std::atomic<uint64_t>& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_ns_.store(0, std::memory_order_relaxed);
+  max_ns_.store(0, std::memory_order_relaxed);
+}
+
+LatencySummary LatencyHistogram::Summary() const {
+  uint64_t counts[kBucketCount];
+  uint64_t total = 0;
+  for (int i = 0; i < kBucketCount; ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  LatencySummary summary;
+  if (total == 0) return summary;
+  const int64_t max_ns = max_ns_.load(std::memory_order_relaxed);
+  // Percentiles come from the buckets alone, so a Record() racing with
+  // this only shifts the mean.
+  auto percentile = [&](double p) {
+    const uint64_t rank =
+        std::max<uint64_t>(1, (uint64_t)std::ceil(p * (double)total));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+        return (double)std::min(BucketLimitNs(i), max_ns) / 1000.0;
+      }
+    }
+    return (double)max_ns / 1000.0;
+  };
+  const uint64_t count = count_.load(std::memory_order_relaxed);
+  summary.count = total;
+  summary.mean_us =
+      count ? (double)sum_ns_.load(std::memory_order_relaxed) / count / 1000.0
+            : 0;
+  summary.p50_us = percentile(0.50);
+  summary.p95_us = percentile(0.95);
+  summary.p99_us = percentile(0.99);
+  summary.max_us = (double)max_ns / 1000.0;
+  return summary;
+}
+
+OverlayStats& OverlayStats::Global() {
+  // Never destroyed: threads may still record during shutdown.
+  static OverlayStats* stats = new OverlayStats();
+  return *stats;
+}
+
+void OverlayStats::Reset() {
+  for (LatencyHistogram& histogram : histograms_) histogram.Reset();
+}
+
+void RecordStage(TimingStage stage, int64_t start_ns, int64_t end_ns) {
+  OverlayStats::Global().Record(stage, end_ns - start_ns);
+  OverlayTracer& tracer = OverlayTracer::Global();
+  if (tracer.enabled()) {
+    tracer.Complete("overlay", TimingStageName(stage), start_ns, end_ns);
+  }
+}
+
+}  // namespace tono_overlay
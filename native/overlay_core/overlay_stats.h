@@ -0,0 +1,117 @@
+// overlay_stats.h
+#ifndef OVERLAY_CORE_OVERLAY_STATS_H_
+#define OVERLAY_CORE_OVERLAY_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace tono_overlay {
+
+// Timed steps of the overlay pipeline.
+enum class TimingStage : int {
+  kFont,       // opening a font (a FontCache miss) or resizing one
+  kLayout,     // measuring, line breaking and alignment (TextLayout); part
+               // of kRasterize
+  kRasterize,  // drawing the text into the fill mask (GDI, FreeType)
+  kStroke,     // dilating the fill mask into the stroke mask
+  kComposite,  // coloring the masks into the output
+  kRender,     // one render-thread frame, cache hits included
+  kBlend,      // one line transition frame
+  kScroll,     // one marquee frame
+  kPresent,    // uploading the output (UpdateLayeredWindow, cairo paint)
+  kUpdate,     // from posting a snapshot to presenting its frame
+  kCount,
+};
+
+// Short lowercase name used as the key in getOverlayStats.
+const char* TimingStageName(TimingStage stage);
+
+// Nanoseconds on the monotonic clock the stage timers use.
+inline int64_t StatsNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Percentiles of a LatencyHistogram, in microseconds. A percentile is the
+// upper edge of the bucket it falls in (capped at the maximum seen), so it
+// overstates by at most one bucket width, 12.5%.
+struct LatencySummary {
+  uint64_t count = 0;
+  double mean_us = 0;
+  double p50_us = 0;
+  double p95_us = 0;
+  double p99_us = 0;
+  double max_us = 0;
+};
+
+// Log-linear latency histogram with fixed buckets: everything below 1 us,
+// then 8 buckets per power of two up to about 17 s. Recording is a few
+// relaxed atomic adds, so any number of threads can record at once without
+// locks or allocation.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr int kSubBuckets = 1 << kSubBucketBits;
+  // 2^10 ns: the end of bucket 0.
+  static constexpr int kMinShift = 10;
+  static constexpr int kOctaves = 24;
+  static constexpr int kBucketCount = 1 + kOctaves * kSubBuckets;
+
+  void Record(int64_t ns);
+  // Not atomic with concurrent Record() calls: one in flight may survive.
+  void Reset();
+  LatencySummary Summary() const;
+
+  static int BucketFor(int64_t ns);
+  // Exclusive upper edge of bucket |index|, in nanoseconds.
+  static int64_t BucketLimitNs(int index);
+
+ private:
+  std::atomic<uint64_t> buckets_[kBucketCount] = {};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_ns_{0};
+  std::atomic<int64_t> max_ns_{0};
+};
+
+// One histogram per TimingStage for the whole process, recorded from the
+// window, render and prerender threads alike.
+class OverlayStats {
+ public:
+  static OverlayStats& Global();
+
+  void Record(TimingStage stage, int64_t ns) {
+    histograms_[(int)stage].Record(ns);
+  }
+  LatencySummary Summary(TimingStage stage) const {
+    return histograms_[(int)stage].Summary();
+  }
+  void Reset();
+
+ private:
+  LatencyHistogram histograms_[(int)TimingStage::kCount];
+};
+
+// Records |end_ns| - |start_ns| under |stage| in OverlayStats::Global(),
+// and the span itself when OverlayTracer::Global() is recording.
+void RecordStage(TimingStage stage, int64_t start_ns, int64_t end_ns);
+
+// Records the time from construction to destruction under |stage|.
+class ScopedStageTimer {
+ public:
+  explicit ScopedStageTimer(TimingStage stage)
+      : stage_(stage), start_ns_(StatsNowNs()) {}
+  ~ScopedStageTimer() { RecordStage(stage_, start_ns_, StatsNowNs()); }
+
+  ScopedStageTimer(const ScopedStageTimer&) = delete;
+  ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+ private:
+  TimingStage stage_;
+  int64_t start_ns_;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_OVERLAY_STATS_H_
@@ -0,0 +1,555 @@
+// overlay_style_decoder.cc
+#include "overlay_core/overlay_style_decoder.h"
+
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace tono_overlay {
+
+namespace {
+
+enum class Kind {
+  kString,
+  kInt,
+  kColor,
+  kBool,
+  kWeight,
+  kAlign,
+  kTransition,
+};
+
+struct FieldSpec {
+  const char* key;
+  Kind kind;
+  int min_value;
+  int max_value;
+  bool (*apply)(OverlayState* state, int number, std::string_view text);
+  // Field that carries the same setting more precisely; when both are in a
+  // batch this one is ignored, so re-applying the batch is a no-op.
+  const char* superseded_by = nullptr;
+};
+
+// fontFamily is the only kString field: OverlayStyleUpdate keeps its text
+// in one inline buffer.
+const FieldSpec kFields[] = {
+    {"fontFamily", Kind::kString, 0, 0,
+     [](OverlayState* s, int, std::string_view t) {
+       return s->SetFontFamily(t);
+     }},
+    {"fontSize", Kind::kInt, 0, 1000,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetFontSize(n);
+     }},
+    {"bold", Kind::kBool, 0, 1,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetBold(n != 0);
+     },
+     "fontWeight"},
+    {"fontWeight", Kind::kWeight, 1, INT_MAX,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetFontWeight(n);
+     }},
+    {"textColor", Kind::kColor, 0, 0xFFFFFF,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetTextColor((uint32_t)n);
+     }},
+    {"textOpacity", Kind::kInt, 0, INT_MAX,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetTextOpacity(n);
+     }},
+    {"strokeWidth", Kind::kInt, 0, INT_MAX,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetStrokeWidth(n);
+     }},
+    {"strokeColor", Kind::kColor, 0, 0xFFFFFF,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetStrokeColor((uint32_t)n);
+     }},
+    {"highlightColor", Kind::kColor, 0, 0xFFFFFF,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetHighlightColor((uint32_t)n);
+     }},
+    {"textAlign", Kind::kAlign, 0, 2,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetTextAlign(n);
+     }},
+    {"lines", Kind::kInt, 1, 100,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetLines(n);
+     }},
+    {"width", Kind::kInt, 1, 16384,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetWidth(n);
+     }},
+    {"padding", Kind::kInt, 0, 1000,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetPadding(n);
+     }},
+    {"x", Kind::kInt, INT_MIN, INT_MAX,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetPosition(n, s->style().y);
+     }},
+    {"y", Kind::kInt, INT_MIN, INT_MAX,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetPosition(s->style().x, n);
+     }},
+    {"backgroundAlpha", Kind::kInt, INT_MIN, INT_MAX,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetBackgroundAlpha(n);
+     }},
+    {"backgroundColor", Kind::kColor, 0, 0xFFFFFF,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetBackgroundColor((uint32_t)n);
+     }},
+    {"cornerRadius", Kind::kInt, 0, INT_MAX,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetCornerRadius(n);
+     }},
+    {"transition", Kind::kTransition, 0, 3,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetTransition((TransitionKind)n);
+     }},
+    {"transitionMs", Kind::kInt, 0, INT_MAX,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetTransitionDuration(n);
+     }},
+    {"marquee", Kind::kBool, 0, 1,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetMarquee(n != 0);
+     }},
+    {"marqueeSpeed", Kind::kInt, 1, INT_MAX,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetMarqueeSpeed(n);
+     }},
+    {"marqueePauseMs", Kind::kInt, 0, INT_MAX,
+     [](OverlayState* s, int n, std::string_view) {
+       return s->SetMarqueePause(n);
+     }},
+};
+constexpr int kFieldCount = (int)(sizeof(kFields) / sizeof(kFields[0]));
+static_assert(kFieldCount <= OverlayStyleUpdate::kMaxFields,
+              "raise OverlayStyleUpdate::kMaxFields");
+
+int FindField(std::string_view key) {
+  for (int i = 0; i < kFieldCount; ++i) {
+    if (key == kFields[i].key) return i;
+  }
+  return -1;
+}
+
+std::string Trim(std::string_view s) {
+  size_t begin = 0;
+  size_t end = s.size();
+  while (begin < end && std::isspace((unsigned char)s[begin])) ++begin;
+  while (end > begin && std::isspace((unsigned char)s[end - 1])) --end;
+  return std::string(s.substr(begin, end - begin));
+}
+
+std::string Lower(std::string s) {
+  for (char& c : s) c = (char)std::tolower((unsigned char)c);
+  return s;
+}
+
+// Whole-string decimal number ("12", "-3", "12.5").
+bool ParseNumberText(std::string_view text, double* out) {
+  const std::string s = Trim(text);
+  if (s.empty()) return false;
+  // strtod would also take hex and "inf"; settings are plain decimals.
+  for (char c : s) {
+    if (!std::isdigit((unsigned char)c) && c != '-' && c != '+' && c != '.') {
+      return false;
+    }
+  }
+  char* end = nullptr;
+  const double value = std::strtod(s.c_str(), &end);
+  if (end != s.c_str() + s.size() || !std::isfinite(value)) return false;
+  *out = value;
+  return true;
+}
+
+bool ToInt(double value, int* out) {
+  value = std::round(value);
+  if (!std::isfinite(value) || value < (double)INT_MIN ||
+      value > (double)INT_MAX) {
+    return false;
+  }
+  *out = (int)value;
+  return true;
+}
+
+bool DecodeInt(const StyleValue& v, int* out) {
+  double number = 0;
+  switch (v.type) {
+    case StyleValue::Type::kNumber:
+      number = v.number;
+      break;
+    case StyleValue::Type::kString:
+      if (!ParseNumberText(v.text, &number)) return false;
+      break;
+    case StyleValue::Type::kBool:
+      return false;
+  }
+  return ToInt(number, out);
+}
+
+bool DecodeColor(const StyleValue& v, int* out) {
+  if (v.type == StyleValue::Type::kNumber) {
+    if (!(v.number >= 0 && v.number <= 0xFFFFFFFFu)) return false;
+    *out = (int)((uint32_t)v.number & 0xFFFFFFu);
+    return true;
+  }
+  if (v.type != StyleValue::Type::kString) return false;
+  std::string s = Trim(v.text);
+  if (!s.empty() && s[0] == '#') {
+    s.erase(0, 1);
+  } else if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+    s.erase(0, 2);
+  }
+  // Up to AARRGGBB; the alpha byte is ignored.
+  if (s.empty() || s.size() > 8) return false;
+  for (char c : s) {
+    if (!std::isxdigit((unsigned char)c)) return false;
+  }
+  *out = (int)(std::strtoul(s.c_str(), nullptr, 16) & 0xFFFFFFu);
+  return true;
+}
+
+bool DecodeBool(const StyleValue& v, int* out) {
+  switch (v.type) {
+    case StyleValue::Type::kBool:
+      *out = v.boolean ? 1 : 0;
+      return true;
+    case StyleValue::Type::kNumber:
+      *out = v.number != 0 ? 1 : 0;
+      return true;
+    case StyleValue::Type::kString: {
+      const std::string s = Lower(Trim(v.text));
+      if (s == "true") {
+        *out = 1;
+        return true;
+      }
+      if (s == "false") {
+        *out = 0;
+        return true;
+      }
+      int number = 0;
+      if (!DecodeInt(v, &number)) return false;
+      *out = number != 0 ? 1 : 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+struct NamedValue {
+  const char* name;
+  int value;
+};
+
+// CSS/OpenType weight names plus the Chinese labels of the settings page.
+const NamedValue kWeightNames[] = {
+    {"thin", 100},      {"hairline", 100},   {"extralight", 200},
+    {"ultralight", 200}, {"light", 300},     {"regular", 400},
+    {"normal", 400},    {"medium", 500},     {"semibold", 600},
+    {"demibold", 600},  {"bold", 700},       {"extrabold", 800},
+    {"ultrabold", 800}, {"black", 900},      {"heavy", 900},
+    {"极细", 100},      {"超细", 100},       {"纤细", 200},
+    {"细", 300},        {"常规", 400},       {"正常", 400},
+    {"中", 500},        {"中等", 500},       {"半粗", 600},
+    {"中粗", 600},      {"粗", 700},         {"加粗", 700},
+    {"特粗", 800},      {"超粗", 800},       {"黑", 900},
+    {"重", 900},        {"黑体", 900},
+};
+
+const NamedValue kAlignNames[] = {
+    {"left", 0}, {"center", 1}, {"centre", 1}, {"right", 2},
+};
+
+// Lowercased, like every name the decoder compares.
+const NamedValue kTransitionNames[] = {
+    {"none", 0},    {"crossfade", 1}, {"fade", 1},
+    {"slideup", 2}, {"slide", 2},     {"scale", 3},
+};
+
+template <size_t N>
+bool DecodeNamed(const StyleValue& v, const NamedValue (&names)[N],
+                 int* out) {
+  if (DecodeInt(v, out)) return true;
+  if (v.type != StyleValue::Type::kString) return false;
+  const std::string s = Lower(Trim(v.text));
+  for (const NamedValue& named : names) {
+    if (s == named.name) {
+      *out = named.value;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* Describe(Kind kind) {
+  switch (kind) {
+    case Kind::kString:
+      return "a non-empty string";
+    case Kind::kInt:
+      return "an integer";
+    case Kind::kColor:
+      return "a 0xRRGGBB color";
+    case Kind::kBool:
+      return "a bool";
+    case Kind::kWeight:
+      return "a weight (100..900) or weight name";
+    case Kind::kAlign:
+      return "'left', 'center', 'right' or 0..2";
+    case Kind::kTransition:
+      return "'none', 'crossfade', 'slideUp', 'scale' or 0..3";
+  }
+  return "a value";
+}
+
+}  // namespace
+
+StyleValue StyleValue::Number(double value) {
+  StyleValue v;
+  v.type = Type::kNumber;
+  v.number = value;
+  return v;
+}
+
+StyleValue StyleValue::String(std::string_view value) {
+  StyleValue v;
+  v.type = Type::kString;
+  v.text = value;
+  return v;
+}
+
+StyleValue StyleValue::Bool(bool value) {
+  StyleValue v;
+  v.type = Type::kBool;
+  v.boolean = value;
+  return v;
+}
+
+bool StyleValueToInt(const StyleValue& value, int* out) {
+  return DecodeInt(value, out);
+}
+
+bool StyleValueToNumber(const StyleValue& value, double* out) {
+  switch (value.type) {
+    case StyleValue::Type::kNumber:
+      if (!std::isfinite(value.number)) return false;
+      *out = value.number;
+      return true;
+    case StyleValue::Type::kString:
+      return ParseNumberText(value.text, out);
+    case StyleValue::Type::kBool:
+      return false;
+  }
+  return false;
+}
+
+bool StyleValueToBool(const StyleValue& value, bool* out) {
+  int flag = 0;
+  if (!DecodeBool(value, &flag)) return false;
+  *out = flag != 0;
+  return true;
+}
+
+OverlayStyleUpdate::OverlayStyleUpdate() = default;
+
+bool OverlayStyleUpdate::Decode(std::string_view key,
+                                const StyleValue& value,
+                                std::string* error) {
+  const int index = FindField(key);
+  if (index < 0) {
+    if (error) *error = "unknown style field '" + std::string(key) + "'";
+    return false;
+  }
+  const FieldSpec& spec = kFields[index];
+  int number = 0;
+  bool ok = false;
+  switch (spec.kind) {
+    case Kind::kString:
+      ok = value.type == StyleValue::Type::kString && !value.text.empty() &&
+           value.text.size() < kMaxTextBytes;
+      break;
+    case Kind::kInt:
+      ok = DecodeInt(value, &number);
+      break;
+    case Kind::kColor:
+      ok = DecodeColor(value, &number);
+      break;
+    case Kind::kBool:
+      ok = DecodeBool(value, &number);
+      break;
+    case Kind::kWeight:
+      ok = DecodeNamed(value, kWeightNames, &number);
+      break;
+    case Kind::kAlign:
+      ok = DecodeNamed(value, kAlignNames, &number);
+      break;
+    case Kind::kTransition:
+      ok = DecodeNamed(value, kTransitionNames, &number);
+      break;
+  }
+  if (ok && spec.kind != Kind::kString) {
+    ok = number >= spec.min_value && number <= spec.max_value;
+  }
+  if (!ok) {
+    if (error) {
+      *error = std::string(spec.key) + ": expected " + Describe(spec.kind);
+      if (spec.kind == Kind::kString) {
+        *error += " under " + std::to_string(kMaxTextBytes) + " bytes";
+      }
+      if (spec.kind == Kind::kInt &&
+          (spec.min_value != INT_MIN || spec.max_value != INT_MAX)) {
+        *error += " in " + std::to_string(spec.min_value) + ".." +
+                  (spec.max_value == INT_MAX ? std::string()
+                                             : std::to_string(spec.max_value));
+      }
+    }
+    return false;
+  }
+  if (spec.kind == Kind::kString) {
+    std::memcpy(text_, value.text.data(), value.text.size());
+    text_size_ = value.text.size();
+  }
+  numbers_[index] = number;
+  present_.set(index);
+  return true;
+}
+
+void OverlayStyleUpdate::MergeFrom(const OverlayStyleUpdate& other) {
+  for (int i = 0; i < kFieldCount; ++i) {
+    if (!other.present_.test(i)) continue;
+    numbers_[i] = other.numbers_[i];
+    if (kFields[i].kind == Kind::kString) {
+      std::memcpy(text_, other.text_, other.text_size_);
+      text_size_ = other.text_size_;
+    }
+    present_.set(i);
+  }
+}
+
+bool OverlayStyleUpdate::has(std::string_view key) const {
+  const int index = FindField(key);
+  return index >= 0 && present_.test(index);
+}
+
+bool OverlayStyleUpdate::ApplyTo(OverlayState* state) const {
+  bool changed = false;
+  for (int i = 0; i < kFieldCount; ++i) {
+    if (!present_.test(i)) continue;
+    if (kFields[i].superseded_by && has(kFields[i].superseded_by)) continue;
+    const std::string_view text = kFields[i].kind == Kind::kString
+                                      ? std::string_view(text_, text_size_)
+                                      : std::string_view();
+    changed |= kFields[i].apply(state, numbers_[i], text);
+  }
+  return changed;
+}
+
+namespace {
+
+const StyleSetter kStyleSetters[] = {
+    {"setOverlayWidth", {{"width", "width"}}, "Expected {width: int>0}"},
+    {"setOverlayLines", {{"lines", "lines"}}, "Expected {lines: int>0}"},
+    {"setLyricsFontFamily",
+     {{"family", "fontFamily"}},
+     "Expected {family: String} or a font family String"},
+    {"setLyricsFontSize",
+     {{"fontSize", "fontSize"}},
+     "Expected {fontSize: int}"},
+    {"setLyricsFontWeight",
+     {{"weight", "fontWeight"}},
+     "Expected {weight: int 100..900 | String name}"},
+    {"setLyricsTextColor",
+     {{"textColor", "textColor"}},
+     "Expected {textColor: int 0xRRGGBB}"},
+    {"setLyricsHighlightColor",
+     {{"color", "highlightColor"}},
+     "Expected {color: int 0xRRGGBB}"},
+    {"setLyricsBold", {{"bold", "bold"}}, "Expected {bold: bool}"},
+    {"setLyricsPosition",
+     {{"x", "x"}, {"y", "y"}},
+     "Expected {x: int, y: int}"},
+    {"setOverlayOpacity",
+     {{"alpha", "backgroundAlpha"}},
+     "Expected {alpha: int 0..255}"},
+    {"setLyricsStroke",
+     {{"width", "strokeWidth"}, {"color", "strokeColor"}},
+     "Expected {width: int>=0, color: int 0xRRGGBB}"},
+    {"setLyricsTextAlign",
+     {{"align", "textAlign"}},
+     "Expected {align: 'left'|'center'|'right'|0|1|2}"},
+    {"setLyricsTextOpacity",
+     {{"alpha", "textOpacity"}},
+     "Expected {alpha: int 0..255}"},
+    {"setLyricsTransition",
+     {{"kind", "transition"}, {"durationMs", "transitionMs"}},
+     "Expected {kind: 'none'|'crossfade'|'slideUp'|'scale', "
+     "durationMs: int>=0}"},
+    {"setLyricsMarquee",
+     {{"enabled", "marquee"},
+      {"speed", "marqueeSpeed"},
+      {"pauseMs", "marqueePauseMs"}},
+     "Expected {enabled: bool, speed: int>0, pauseMs: int>=0}"},
+};
+
+}  // namespace
+
+const StyleSetter* FindStyleSetter(const std::string& method) {
+  for (const StyleSetter& setter : kStyleSetters) {
+    if (method == setter.method) return &setter;
+  }
+  return nullptr;
+}
+
+bool DecodeStyleSetter(const StyleSetter& setter, const StyleArgs& args,
+                       OverlayStyleUpdate* update, std::string* error) {
+  const bool single = setter.args[1].key == nullptr;
+  std::string reason;
+  for (const StyleSetter::Arg& arg : setter.args) {
+    if (!arg.key) break;
+    StyleValue value;
+    StyleArgs::Lookup lookup = args.Find(arg.key, &value);
+    if (lookup == StyleArgs::Lookup::kMissing && single) {
+      lookup = args.Self(&value);
+    }
+    if (lookup != StyleArgs::Lookup::kFound ||
+        !update->Decode(arg.field, value, &reason)) {
+      *error = setter.usage;
+      if (!reason.empty()) *error += " (" + reason + ")";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DecodeStyleMap(const StyleArgs& args, OverlayStyleUpdate* update,
+                    std::string* error) {
+  if (!args.IsMap()) {
+    *error = "Expected a map of style fields";
+    return false;
+  }
+  bool ok = true;
+  args.ForEach([&](const char* key, StyleArgs::Lookup lookup,
+                   const StyleValue& value) {
+    if (!key) {
+      *error = "Style field names must be strings";
+      return ok = false;
+    }
+    if (std::strcmp(key, "id") == 0) return true;
+    if (lookup != StyleArgs::Lookup::kFound) {
+      *error = std::string(key) + ": unsupported value type";
+      return ok = false;
+    }
+    return ok = update->Decode(key, value, error);
+  });
+  return ok;
+}
+
+}  // namespace tono_overlay
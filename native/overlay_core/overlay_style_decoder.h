@@ -0,0 +1,153 @@
+// overlay_style_decoder.h
+#ifndef OVERLAY_CORE_OVERLAY_STYLE_DECODER_H_
+#define OVERLAY_CORE_OVERLAY_STYLE_DECODER_H_
+
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "overlay_core/overlay_state.h"
+
+namespace tono_overlay {
+
+// A scalar argument from a platform channel. Older Dart builds sent numbers
+// as strings, so every kind of field accepts strings too. The text is
+// borrowed from the caller's argument and must outlive the decoding.
+struct StyleValue {
+  enum class Type { kNumber, kString, kBool };
+
+  static StyleValue Number(double value);
+  static StyleValue String(std::string_view value);
+  static StyleValue Bool(bool value);
+
+  Type type = Type::kString;
+  double number = 0;
+  std::string_view text;
+  bool boolean = false;
+};
+
+// The scalar decoding the style fields use, for channel arguments that are
+// not style fields (playback position, flags, byte budgets). Each takes the
+// string form too, and returns false without touching |out| for a value of
+// the wrong kind.
+bool StyleValueToInt(const StyleValue& value, int* out);
+bool StyleValueToNumber(const StyleValue& value, double* out);
+bool StyleValueToBool(const StyleValue& value, bool* out);
+
+// A validated set of style changes, decoded field by field from a key table
+// and applied to an OverlayState in one step. Fixed size: decoding, copying
+// and merging never allocate.
+//   fontFamily    string, non-empty, under kMaxTextBytes
+//   fontSize      int >= 0, points
+//   fontWeight    100..900, or a name ("bold", "light", "粗", ...)
+//   bold          bool
+//   textColor, strokeColor, highlightColor, backgroundColor
+//                 0xRRGGBB number, or "#RRGGBB" / "0xRRGGBB" / "RRGGBB"
+//   textOpacity   int >= 0 (clamped to 255)
+//   strokeWidth   int >= 0 (clamped to OverlayState::kMaxStrokeWidth)
+//   textAlign     "left" | "center" | "right" | 0..2
+//   width, lines  int > 0
+//   padding       int >= 0
+//   x, y          int
+//   backgroundAlpha  int (clamped to 0..255)
+//   cornerRadius  int >= 0 (clamped to OverlayState::kMaxCornerRadius)
+//   transition    "none" | "crossfade" | "slideUp" | "scale" | 0..3
+//   transitionMs  int >= 0 (clamped to OverlayState::kMaxTransitionMs)
+//   marquee       bool: scroll a single line that does not fit
+//   marqueeSpeed  int > 0, pixels per second (clamped to
+//                 OverlayState::kMaxMarqueeSpeed)
+//   marqueePauseMs  int >= 0, rest at each end (clamped to
+//                 OverlayState::kMaxMarqueePauseMs)
+class OverlayStyleUpdate {
+ public:
+  OverlayStyleUpdate();
+
+  // Decodes |key| = |value|. On failure returns false with a message in
+  // |error|, if not null, and leaves the update as it was. A repeated key
+  // replaces the earlier value.
+  bool Decode(std::string_view key, const StyleValue& value,
+              std::string* error);
+
+  // Takes every field decoded in |other|, replacing the same fields here.
+  void MergeFrom(const OverlayStyleUpdate& other);
+
+  // Forgets every field.
+  void Clear() { present_.reset(); }
+  bool empty() const { return present_.none(); }
+  bool has(std::string_view key) const;
+
+  // Applies every decoded field; bold is ignored when fontWeight is also
+  // present. Returns true if any setting changed. Rendering is left to the
+  // caller, which sees all changes as one set of dirty stages.
+  bool ApplyTo(OverlayState* state) const;
+
+  static constexpr int kMaxFields = 24;
+  // Bound on the text of a string field, terminator included.
+  static constexpr size_t kMaxTextBytes = 256;
+
+ private:
+  std::bitset<kMaxFields> present_;
+  int numbers_[kMaxFields] = {};
+  // Text of the string field; fontFamily is the only one.
+  char text_[kMaxTextBytes] = {};
+  size_t text_size_ = 0;
+};
+
+// The arguments of a window channel call, as the runner's codec decoded
+// them (flutter::EncodableValue on Windows, FlValue on Linux). A runner
+// only converts its scalars to StyleValue; the style calls are decoded
+// below, the same way on every platform.
+class StyleArgs {
+ public:
+  // kUnsupported: present, but not a scalar StyleValue can hold.
+  enum class Lookup { kFound, kMissing, kUnsupported };
+  // Visits one map entry; |key| is null for a key that is not a string.
+  // Returning false stops the walk.
+  using EntryVisitor = std::function<bool(const char* key, Lookup lookup,
+                                          const StyleValue& value)>;
+
+  virtual ~StyleArgs() = default;
+
+  virtual bool IsMap() const = 0;
+  // The value under |key|, or kMissing if the arguments are not a map.
+  virtual Lookup Find(const char* key, StyleValue* value) const = 0;
+  // The arguments themselves when they are a bare scalar, else kMissing.
+  virtual Lookup Self(StyleValue* value) const = 0;
+  virtual void ForEach(const EntryVisitor& visit) const = 0;
+};
+
+// A single-purpose style method (setLyricsFontSize, setLyricsStroke, ...).
+// Each maps its arguments onto OverlayStyleUpdate fields, so it shares the
+// decoding and validation of applyOverlayStyle.
+struct StyleSetter {
+  struct Arg {
+    const char* key;    // channel argument
+    const char* field;  // OverlayStyleUpdate key
+  };
+
+  const char* method;
+  Arg args[3];
+  const char* usage;
+};
+
+// The setter called |method|, or null.
+const StyleSetter* FindStyleSetter(const std::string& method);
+
+// Decodes the arguments of |setter| into |update|. A map must hold every
+// key of the setter; a setter with one field also accepts the bare value.
+// On failure returns false with the usage, and why, in |error|.
+bool DecodeStyleSetter(const StyleSetter& setter, const StyleArgs& args,
+                       OverlayStyleUpdate* update, std::string* error);
+
+// Decodes applyOverlayStyle: a map of any subset of the fields. The "id"
+// entry picks the overlay (overlay_instance.h) and is skipped. On failure
+// returns false with a message in |error|; |update| may then hold some of
+// the fields and should not be applied.
+bool DecodeStyleMap(const StyleArgs& args, OverlayStyleUpdate* update,
+                    std::string* error);
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_OVERLAY_STYLE_DECODER_H_
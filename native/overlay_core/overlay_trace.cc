@@ -0,0 +1,258 @@
+// overlay_trace.cc
+#include "overlay_core/overlay_trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+#include "overlay_core/overlay_stats.h"
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace tono_overlay {
+
+namespace {
+
+// Distinguishes tracer instances in the per-thread cache below, so a
+// tracer allocated where a destroyed one lived is not mistaken for it.
+std::atomic<uint64_t> next_tracer_id{1};
+
+int ProcessId() {
+#if defined(_WIN32)
+  return _getpid();
+#else
+  return (int)getpid();
+#endif
+}
+
+void WriteEscaped(std::ostream& out, const char* text) {
+  for (const char* p = text; *p; ++p) {
+    const unsigned char c = (unsigned char)*p;
+    switch (c) {
+      case '"':
+        out << "\\\"";
+        break;
+      case '\\':
+        out << "\\\\";
+        break;
+      default:
+        if (c < 0x20) {
+          static const char kHex[] = "0123456789abcdef";
+          out << "\\u00" << kHex[c >> 4] << kHex[c & 0xF];
+        } else {
+          out << (char)c;
+        }
+    }
+  }
+}
+
+// |ns| >= 0 as microseconds with three decimals.
+void WriteMicros(std::ostream& out, int64_t ns) {
+  out << ns / 1000 << '.' << std::setw(3) << std::setfill('0')
+      << ns % 1000;
+}
+
+}  // namespace
+
+bool ParseTraceFlag(std::string_view arg, std::string* path) {
+  const std::string_view flag = kTraceFlag;
+  if (arg.size() <= flag.size() + 1 || arg.substr(0, flag.size()) != flag ||
+      arg[flag.size()] != '=') {
+    return false;
+  }
+  *path = std::string(arg.substr(flag.size() + 1));
+  return true;
+}
+
+OverlayTracer::OverlayTracer()
+    : id_(next_tracer_id.fetch_add(1, std::memory_order_relaxed)) {}
+
+OverlayTracer& OverlayTracer::Global() {
+  // Never destroyed, like OverlayStats: threads may trace during shutdown.
+  static OverlayTracer* tracer = new OverlayTracer();
+  return *tracer;
+}
+
+void OverlayTracer::Start(std::string path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  path_ = std::move(path);
+  dropped_.store(0, std::memory_order_relaxed);
+  // Buffers from an earlier session are reset by their own threads on
+  // their next event; WriteJson() skips the ones that have not been.
+  session_.fetch_add(1, std::memory_order_relaxed);
+  enabled_.store(true, std::memory_order_release);
+}
+
+bool OverlayTracer::Stop() {
+  enabled_.store(false, std::memory_order_relaxed);
+  std::string path;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    path = path_;
+  }
+  if (path.empty()) return true;
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+  WriteJson(file);
+  file.flush();
+  return (bool)file;
+}
+
+OverlayTracer::ThreadBuffer* OverlayTracer::Buffer() {
+  struct Cache {
+    uint64_t tracer_id = 0;
+    ThreadBuffer* buffer = nullptr;
+  };
+  thread_local Cache cache;
+  if (cache.tracer_id != id_) {
+    const std::thread::id thread = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ThreadBuffer* found = nullptr;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers_) {
+      if (buffer->thread == thread) found = buffer.get();
+    }
+    if (!found) {
+      buffers_.push_back(std::make_unique<ThreadBuffer>());
+      found = buffers_.back().get();
+      found->thread = thread;
+      found->tid = (int)buffers_.size();
+      found->events.reset(new Event[kEventsPerThread]);
+    }
+    cache.tracer_id = id_;
+    cache.buffer = found;
+  }
+  ThreadBuffer* buffer = cache.buffer;
+  const uint32_t session = session_.load(std::memory_order_relaxed);
+  if (buffer->session.load(std::memory_order_relaxed) != session) {
+    buffer->size.store(0, std::memory_order_relaxed);
+    buffer->session.store(session, std::memory_order_release);
+  }
+  return buffer;
+}
+
+void OverlayTracer::Add(const char* category, std::string_view name,
+                        int64_t ts_ns, int64_t dur_ns, const char* arg0,
+                        int64_t value0, const char* arg1, int64_t value1) {
+  ThreadBuffer* buffer = Buffer();
+  const size_t size = buffer->size.load(std::memory_order_relaxed);
+  if (size >= kEventsPerThread) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Event& event = buffer->events[size];
+  event.ts_ns = ts_ns;
+  event.dur_ns = dur_ns;
+  event.category = category;
+  event.arg_names[0] = arg0;
+  event.arg_values[0] = value0;
+  event.arg_names[1] = arg1;
+  event.arg_values[1] = value1;
+  size_t length = std::min(name.size(), kMaxNameBytes);
+  // Do not cut a UTF-8 sequence in half.
+  if (length < name.size()) {
+    while (length > 0 && ((unsigned char)name[length] & 0xC0) == 0x80) {
+      --length;
+    }
+  }
+  std::memcpy(event.name, name.data(), length);
+  event.name[length] = '\0';
+  buffer->size.store(size + 1, std::memory_order_release);
+}
+
+void OverlayTracer::Complete(const char* category, std::string_view name,
+                             int64_t start_ns, int64_t end_ns) {
+  if (!enabled()) return;
+  Add(category, name, start_ns, std::max<int64_t>(end_ns - start_ns, 0),
+      nullptr, 0, nullptr, 0);
+}
+
+void OverlayTracer::Instant(const char* category, std::string_view name,
+                            int64_t ts_ns, const char* arg0, int64_t value0,
+                            const char* arg1, int64_t value1) {
+  if (!enabled()) return;
+  Add(category, name, ts_ns, -1, arg0, value0, arg1, value1);
+}
+
+void OverlayTracer::SetThreadName(const char* name) {
+  if (!enabled()) return;
+  ThreadBuffer* buffer = Buffer();
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffer->name = name;
+}
+
+void OverlayTracer::WriteJson(std::ostream& out) const {
+  const int pid = ProcessId();
+  const uint32_t session = session_.load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(mutex_);
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  auto begin = [&]() {
+    if (!first) out << ",\n";
+    first = false;
+  };
+  for (const std::unique_ptr<ThreadBuffer>& buffer : buffers_) {
+    if (buffer->name) {
+      begin();
+      out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+          << ",\"tid\":" << buffer->tid << ",\"args\":{\"name\":\"";
+      WriteEscaped(out, buffer->name);
+      out << "\"}}";
+    }
+    if (buffer->session.load(std::memory_order_acquire) != session) continue;
+    const size_t size = buffer->size.load(std::memory_order_acquire);
+    for (size_t i = 0; i < size; ++i) {
+      const Event& event = buffer->events[i];
+      begin();
+      out << "{\"name\":\"";
+      WriteEscaped(out, event.name);
+      out << "\",\"cat\":\"";
+      WriteEscaped(out, event.category ? event.category : "");
+      out << "\",\"ph\":\"" << (event.dur_ns >= 0 ? 'X' : 'i')
+          << "\",\"ts\":";
+      WriteMicros(out, event.ts_ns);
+      if (event.dur_ns >= 0) {
+        out << ",\"dur\":";
+        WriteMicros(out, event.dur_ns);
+      } else {
+        out << ",\"s\":\"t\"";
+      }
+      out << ",\"pid\":" << pid << ",\"tid\":" << buffer->tid;
+      if (event.arg_names[0] || event.arg_names[1]) {
+        out << ",\"args\":{";
+        bool first_arg = true;
+        for (int a = 0; a < 2; ++a) {
+          if (!event.arg_names[a]) continue;
+          if (!first_arg) out << ',';
+          first_arg = false;
+          out << '"';
+          WriteEscaped(out, event.arg_names[a]);
+          out << "\":" << event.arg_values[a];
+        }
+        out << '}';
+      }
+      out << '}';
+    }
+  }
+  out << "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":\""
+      << dropped_.load(std::memory_order_relaxed) << "\"}}\n";
+}
+
+ScopedTraceEvent::ScopedTraceEvent(const char* category,
+                                   std::string_view name)
+    : category_(category), name_(name) {
+  if (OverlayTracer::Global().enabled()) start_ns_ = StatsNowNs();
+}
+
+ScopedTraceEvent::~ScopedTraceEvent() {
+  if (start_ns_ == 0) return;
+  OverlayTracer::Global().Complete(category_, name_, start_ns_,
+                                   StatsNowNs());
+}
+
+}  // namespace tono_overlay
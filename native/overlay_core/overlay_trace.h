@@ -0,0 +1,128 @@
+// overlay_trace.h
+#ifndef OVERLAY_CORE_OVERLAY_TRACE_H_
+#define OVERLAY_CORE_OVERLAY_TRACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace tono_overlay {
+
+// Command-line flag and environment variable that turn tracing on; both
+// take the path of the JSON file to write at exit.
+constexpr char kTraceFlag[] = "--overlay-trace";
+constexpr char kTraceEnvVar[] = "TONO_OVERLAY_TRACE";
+
+// If |arg| is "--overlay-trace=<path>", stores the path and returns true.
+bool ParseTraceFlag(std::string_view arg, std::string* path);
+
+// Records Chrome trace events ("Trace Event Format", as loaded by
+// chrome://tracing and ui.perfetto.dev) for channel calls, render stages,
+// font rebuilds and window moves. Timestamps are steady_clock
+// microseconds, the clock the Flutter engine timeline uses, so both traces
+// line up when loaded together.
+//
+// Each thread appends to its own fixed-size buffer, allocated on its first
+// event: recording takes no lock, and while tracing is off every call is a
+// single relaxed load. A full buffer drops further events and counts them.
+class OverlayTracer {
+ public:
+  // Events kept per thread, about 100 bytes each.
+  static constexpr size_t kEventsPerThread = 1 << 15;
+  // Longer event names are truncated.
+  static constexpr size_t kMaxNameBytes = 47;
+
+  static OverlayTracer& Global();
+
+  OverlayTracer();
+  OverlayTracer(const OverlayTracer&) = delete;
+  OverlayTracer& operator=(const OverlayTracer&) = delete;
+
+  // Starts recording, discarding what earlier sessions left behind.
+  // Stop() writes the events to |path|; an empty path keeps them in memory
+  // for WriteJson().
+  void Start(std::string path);
+  // Stops recording and writes the trace file, if Start() named one.
+  // Returns false if writing failed.
+  bool Stop();
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  // A span from |start_ns| to |end_ns| (StatsNowNs()) on this thread.
+  // |category| must be a string literal; |name| is copied.
+  void Complete(const char* category, std::string_view name,
+                int64_t start_ns, int64_t end_ns);
+  // A point event with up to two integer arguments; a null |arg0| or
+  // |arg1| name leaves that argument out. Names must be literals.
+  void Instant(const char* category, std::string_view name, int64_t ts_ns,
+               const char* arg0 = nullptr, int64_t value0 = 0,
+               const char* arg1 = nullptr, int64_t value1 = 0);
+  // Labels the calling thread in the viewer. |name| must be a literal.
+  void SetThreadName(const char* name);
+
+  // Writes every event recorded so far as a JSON object. Safe while other
+  // threads keep recording; their newest events may be left out.
+  void WriteJson(std::ostream& out) const;
+
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Event {
+    int64_t ts_ns = 0;
+    int64_t dur_ns = 0;  // < 0 for an instant event
+    const char* category = nullptr;
+    const char* arg_names[2] = {nullptr, nullptr};
+    int64_t arg_values[2] = {0, 0};
+    char name[kMaxNameBytes + 1];
+  };
+  // Written only by its thread. |size| is published with release order
+  // after the event is complete, so readers see whole events.
+  struct ThreadBuffer {
+    std::thread::id thread;
+    int tid = 0;
+    const char* name = nullptr;
+    std::atomic<uint32_t> session{0};
+    std::atomic<size_t> size{0};
+    std::unique_ptr<Event[]> events;
+  };
+
+  // The calling thread's buffer, emptied if it holds an earlier session.
+  ThreadBuffer* Buffer();
+  void Add(const char* category, std::string_view name, int64_t ts_ns,
+           int64_t dur_ns, const char* arg0, int64_t value0,
+           const char* arg1, int64_t value1);
+
+  const uint64_t id_;
+  std::atomic<bool> enabled_{false};
+  std::atomic<uint32_t> session_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::string path_;
+
+  mutable std::mutex mutex_;  // guards buffers_ and path_
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+};
+
+// Records a Complete() event for its scope when tracing is on.
+class ScopedTraceEvent {
+ public:
+  ScopedTraceEvent(const char* category, std::string_view name);
+  ~ScopedTraceEvent();
+
+  ScopedTraceEvent(const ScopedTraceEvent&) = delete;
+  ScopedTraceEvent& operator=(const ScopedTraceEvent&) = delete;
+
+ private:
+  const char* category_;
+  std::string_view name_;
+  int64_t start_ns_ = 0;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_OVERLAY_TRACE_H_
@@ -0,0 +1,163 @@
+// render_thread.cc
+#include "overlay_core/render_thread.h"
+
+#include <utility>
+
+#include "overlay_core/overlay_stats.h"
+#include "overlay_core/overlay_trace.h"
+
+namespace tono_overlay {
+
+RenderWorker::RenderWorker() {
+  thread_ = std::thread(&RenderWorker::Run, this);
+}
+
+RenderWorker::~RenderWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  thread_.join();
+}
+
+void RenderWorker::Schedule(RenderThread* thread) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(thread);
+  }
+  wake_.notify_one();
+}
+
+void RenderWorker::Remove(RenderThread* thread) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (auto it = queue_.begin(); it != queue_.end();) {
+    it = *it == thread ? queue_.erase(it) : it + 1;
+  }
+  done_.wait(lock, [this, thread] { return current_ != thread; });
+}
+
+void RenderWorker::Run() {
+  OverlayTracer::Global().SetThreadName("overlay render");
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+    if (stop_) break;
+    current_ = queue_.front();
+    queue_.pop_front();
+    lock.unlock();
+    current_->RenderPending();
+    lock.lock();
+    current_ = nullptr;
+    done_.notify_all();
+  }
+}
+
+RenderThread::RenderThread(RenderFn render, FrameReadyFn frame_ready)
+    : RenderThread(std::make_shared<RenderWorker>(), std::move(render),
+                   std::move(frame_ready)) {}
+
+RenderThread::RenderThread(std::shared_ptr<RenderWorker> worker,
+                           RenderFn render, FrameReadyFn frame_ready)
+    : worker_(std::move(worker)),
+      render_(std::move(render)),
+      frame_ready_(std::move(frame_ready)) {}
+
+RenderThread::~RenderThread() {
+  worker_->Remove(this);
+  // Wakes a WaitIdle() on another thread; nothing renders any more.
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_.reset();
+  idle_.notify_all();
+}
+
+void RenderThread::Post(RenderSnapshot snapshot) {
+  bool schedule = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshot.sequence = ++stats_.posted;
+    snapshot.posted_ns = StatsNowNs();
+    if (pending_) {
+      ++stats_.superseded;
+      *pending_ = std::move(snapshot);
+    } else {
+      pending_.reset(new RenderSnapshot(std::move(snapshot)));
+    }
+    schedule = !scheduled_;
+    scheduled_ = true;
+  }
+  if (schedule) worker_->Schedule(this);
+}
+
+RenderBuffer* RenderThread::AcquireFrame(const ReleaseFn& release) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (ready_ < 0) return nullptr;
+  // The worker only draws into a buffer that is neither front_ nor ready_,
+  // so the previous front is still intact here.
+  if (release) release(front_ >= 0 ? &buffers_[front_] : nullptr);
+  front_ = ready_;
+  ready_ = -1;
+  ++stats_.presented;
+  return &buffers_[front_];
+}
+
+RenderBuffer* RenderThread::front() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return front_ >= 0 ? &buffers_[front_] : nullptr;
+}
+
+void RenderThread::WaitIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return !pending_ && !busy_; });
+}
+
+RenderThreadStats RenderThread::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void RenderThread::RenderPending() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  scheduled_ = false;
+  if (!pending_) return;
+  std::shared_ptr<const RenderSnapshot> snapshot(pending_.release());
+
+  // Prefer a free buffer; otherwise take back the finished frame the
+  // window thread has not picked up, which this one replaces anyway.
+  int index = -1;
+  for (int i = 0; i < kBufferCount; ++i) {
+    if (i != front_ && i != ready_) index = i;
+  }
+  if (index < 0) {
+    index = ready_;
+    ready_ = -1;
+    ++stats_.discarded;
+  }
+  busy_ = true;
+  RenderBuffer* buffer = &buffers_[index];
+
+  lock.unlock();
+  const int64_t start_ns = StatsNowNs();
+  const bool ok = render_(*snapshot, buffer);
+  RecordStage(TimingStage::kRender, start_ns, StatsNowNs());
+  lock.lock();
+
+  if (ok) {
+    buffer->snapshot = std::move(snapshot);
+    if (ready_ >= 0) ++stats_.discarded;
+    ready_ = index;
+    ++stats_.rendered;
+    if (frame_ready_) {
+      lock.unlock();
+      frame_ready_();
+      lock.lock();
+    }
+  } else {
+    buffer->snapshot.reset();
+    ++stats_.failed;
+  }
+  busy_ = false;
+  idle_.notify_all();
+}
+
+}  // namespace tono_overlay
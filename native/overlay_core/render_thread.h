@@ -0,0 +1,188 @@
+// render_thread.h
+#ifndef OVERLAY_CORE_RENDER_THREAD_H_
+#define OVERLAY_CORE_RENDER_THREAD_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "overlay_core/karaoke.h"
+#include "overlay_core/lrc_parser.h"
+#include "overlay_core/overlay_state.h"
+#include "overlay_core/surface.h"
+
+namespace tono_overlay {
+
+// Everything needed to draw one frame of the overlay, copied on the window
+// thread so the render thread never reads runner state.
+struct RenderSnapshot {
+  // Runner-encoded line text (the same bytes as its LineCacheKey text).
+  std::string text;
+  OverlayStyle style;
+  // Size of the text layer in pixels.
+  int width = 0;
+  int height = 0;
+  // Word timings of a karaoke line (LrcWord::begin in runner text units)
+  // and the time the line ends; empty for a plain line.
+  std::vector<LrcWord> words;
+  int64_t line_end_ms = 0;
+  // Assigned by RenderThread::Post, starting at 1.
+  uint64_t sequence = 0;
+  // StatsNowNs() at Post, for the kUpdate latency of the frame.
+  int64_t posted_ns = 0;
+};
+
+// One of the buffers a RenderThread alternates between. The RenderFn owns
+// the contents; the thread only tracks which snapshot a buffer holds.
+struct RenderBuffer {
+  // Snapshot last rendered into this buffer; null until the first
+  // successful render.
+  std::shared_ptr<const RenderSnapshot> snapshot;
+  // Output and scratch surfaces, created by the RenderFn.
+  std::unique_ptr<SurfacePool> surfaces;
+  // Sweep segments of a karaoke frame, in pixels.
+  std::vector<KaraokeSegment> karaoke_segments;
+  // Renderer-defined hashes of the inputs the surfaces were drawn with
+  // (0 = unknown), so a later render can skip stages whose inputs match.
+  uint64_t raster_hash = 0;
+  uint64_t style_hash = 0;
+};
+
+struct RenderThreadStats {
+  uint64_t posted = 0;
+  // Snapshots replaced in the mailbox before the worker picked them up.
+  uint64_t superseded = 0;
+  uint64_t rendered = 0;
+  uint64_t failed = 0;
+  // Finished frames replaced by a newer one before they were presented.
+  uint64_t discarded = 0;
+  uint64_t presented = 0;
+};
+
+class RenderThread;
+
+// The thread RenderThreads draw on. Several overlays can share one, so an
+// extra overlay window costs its buffers but no thread, and whatever the
+// RenderFns keep per thread (fonts, glyph caches) is shared as well.
+// Overlays with a snapshot waiting are served in turn, one render each.
+class RenderWorker {
+ public:
+  RenderWorker();
+  // Every RenderThread using it must be gone by now; they hold a
+  // reference, so this runs after the last of them.
+  ~RenderWorker();
+
+  RenderWorker(const RenderWorker&) = delete;
+  RenderWorker& operator=(const RenderWorker&) = delete;
+
+ private:
+  friend class RenderThread;
+
+  // Queues |thread| for a render unless it is queued already.
+  void Schedule(RenderThread* thread);
+  // Unqueues |thread| and waits until it is not rendering.
+  void Remove(RenderThread* thread);
+  void Run();
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::deque<RenderThread*> queue_;
+  // Rendering right now, outside |mutex_|.
+  RenderThread* current_ = nullptr;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+// Renders overlay frames off the window thread, on a RenderWorker of its
+// own or one shared with other overlays. The window thread posts
+// snapshots into a one-slot, latest-wins mailbox, so Post never waits for
+// a render and a burst of updates costs at most the render in flight plus
+// one for the newest snapshot.
+//
+// Frames are double-buffered: the window thread keeps the buffer it last
+// acquired (the front) for as long as it presents from it, and the worker
+// only ever draws into the other one.
+class RenderThread {
+ public:
+  static constexpr int kBufferCount = 2;
+
+  // Draws |snapshot| into |buffer|. Runs on the render thread. Returns
+  // false if nothing could be drawn; the frame is then dropped.
+  using RenderFn =
+      std::function<bool(const RenderSnapshot& snapshot, RenderBuffer* buffer)>;
+  // Called on the render thread after a frame is ready. Typically posts a
+  // message that makes the window thread call AcquireFrame().
+  using FrameReadyFn = std::function<void()>;
+  // Called on the window thread by AcquireFrame() with the front buffer it
+  // is about to hand back (null if there is none yet), while the worker
+  // cannot draw into it.
+  using ReleaseFn = std::function<void(RenderBuffer* previous)>;
+
+  // Renders on a worker of its own.
+  RenderThread(RenderFn render, FrameReadyFn frame_ready);
+  // Renders on |worker|, which may be shared: |render| is then called on
+  // the same thread as the RenderFns of the other overlays.
+  RenderThread(std::shared_ptr<RenderWorker> worker, RenderFn render,
+               FrameReadyFn frame_ready);
+  // Waits for an in-flight render to finish. Pending snapshots are
+  // dropped.
+  ~RenderThread();
+
+  RenderThread(const RenderThread&) = delete;
+  RenderThread& operator=(const RenderThread&) = delete;
+
+  // Queues |snapshot|, replacing one the worker has not started yet.
+  void Post(RenderSnapshot snapshot);
+
+  // Window thread. Makes the newest finished frame the front buffer and
+  // returns it, handing the previous front back to the worker. Returns
+  // null if no frame finished since the last call. |release| runs only
+  // when a frame is returned, before the previous front goes back, so it
+  // can save pixels that must outlive it (a line transition).
+  RenderBuffer* AcquireFrame(const ReleaseFn& release = nullptr);
+
+  // The buffer last returned by AcquireFrame(), or null. Only the window
+  // thread may touch it, until the next AcquireFrame() that returns non-null.
+  RenderBuffer* front();
+
+  // Blocks until the mailbox is empty and no render is in flight.
+  void WaitIdle();
+
+  RenderThreadStats stats() const;
+
+ private:
+  friend class RenderWorker;
+
+  // Renders the pending snapshot, if any. Called by the worker.
+  void RenderPending();
+
+  std::shared_ptr<RenderWorker> worker_;
+  RenderFn render_;
+  FrameReadyFn frame_ready_;
+  RenderBuffer buffers_[kBufferCount];
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::unique_ptr<RenderSnapshot> pending_;
+  // Buffer indices, -1 = none. The worker draws into a buffer that is
+  // neither the front nor ready (or takes back the ready one).
+  int front_ = -1;
+  int ready_ = -1;
+  // A render, or the FrameReadyFn after it, is running.
+  bool busy_ = false;
+  // In the worker's queue.
+  bool scheduled_ = false;
+  RenderThreadStats stats_;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_RENDER_THREAD_H_
@@ -0,0 +1,150 @@
+// stroke_engine.cc
+#include "overlay_core/stroke_engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace tono_overlay {
+namespace {
+
+// Stands in for "no seed". Finite so the envelope intersections stay finite.
+constexpr float kFar = 1e20f;
+
+// Squared sub-pixel offset of a seed: 0 for solid pixels, approaching one
+// pixel as coverage fades out. Uncovered pixels are not seeds.
+float SeedValue(uint8_t coverage) {
+  if (coverage == 0) return kFar;
+  const float offset = 1.0f - coverage / 255.0f;
+  return offset * offset;
+}
+
+// 1D squared distance transform of the sampled function |f| (length n):
+//   d[q] = min_p (q - p)^2 + f[p]
+// using the lower envelope of parabolas. |v| needs n ints, |z| n + 1 floats.
+void DistanceTransform1d(const float* f, int n, float* d, int* v, float* z) {
+  int k = 0;
+  v[0] = 0;
+  z[0] = -kFar;
+  z[1] = kFar;
+  for (int q = 1; q < n; ++q) {
+    const float fq = f[q] + (float)q * q;
+    float s = (fq - (f[v[k]] + (float)v[k] * v[k])) / (float)(2 * (q - v[k]));
+    // z[0] is below any reachable intersection, so this stops at k == 0.
+    while (s <= z[k]) {
+      --k;
+      s = (fq - (f[v[k]] + (float)v[k] * v[k])) / (float)(2 * (q - v[k]));
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = kFar;
+  }
+  k = 0;
+  for (int q = 0; q < n; ++q) {
+    while (z[k + 1] < (float)q) ++k;
+    const float dq = (float)(q - v[k]);
+    d[q] = dq * dq + f[v[k]];
+  }
+}
+
+}  // namespace
+
+void StrokeEngine::DistanceTransform(const uint8_t* coverage, int width,
+                                     int /*height*/, int x0, int y0, int x1,
+                                     int y1, float max_d2) {
+  const int rw = x1 - x0;
+  const int rh = y1 - y0;
+  const int longest = std::max(rw, rh);
+  grid_.resize((size_t)rw * rh);
+  line_in_.resize(longest);
+  line_out_.resize(longest);
+  envelope_v_.resize(longest);
+  envelope_z_.resize(longest + 1);
+
+  // Columns first: a column without seeds stays "far" and skips the solve.
+  for (int x = x0; x < x1; ++x) {
+    bool any = false;
+    for (int y = y0; y < y1; ++y) {
+      const float s = SeedValue(coverage[(size_t)y * width + x]);
+      line_in_[y - y0] = s;
+      any = any || s < kFar;
+    }
+    float* col = &grid_[x - x0];
+    if (!any) {
+      for (int y = 0; y < rh; ++y) col[(size_t)y * rw] = kFar;
+      continue;
+    }
+    DistanceTransform1d(line_in_.data(), rh, line_out_.data(),
+                        envelope_v_.data(), envelope_z_.data());
+    for (int y = 0; y < rh; ++y) {
+      // Anything beyond the stroke reach is as good as no seed; clamping
+      // keeps those columns from lowering the row envelope needlessly.
+      const float d = line_out_[y];
+      col[(size_t)y * rw] = d < max_d2 ? d : kFar;
+    }
+  }
+  // Then rows, in place.
+  for (int y = 0; y < rh; ++y) {
+    float* row = &grid_[(size_t)y * rw];
+    bool any = false;
+    for (int x = 0; x < rw; ++x) any = any || row[x] < kFar;
+    if (!any) continue;
+    std::memcpy(line_in_.data(), row, sizeof(float) * rw);
+    DistanceTransform1d(line_in_.data(), rw, row, envelope_v_.data(),
+                        envelope_z_.data());
+  }
+}
+
+void StrokeEngine::BuildA8(const uint8_t* fill, uint8_t* stroke, int width,
+                           int height, int radius) {
+  if (width <= 0 || height <= 0) return;
+  const size_t n = (size_t)width * height;
+  if (radius <= 0) {
+    std::memcpy(stroke, fill, n);
+    return;
+  }
+
+  // Only the bounding box of the text grown by the stroke reach can change.
+  int min_x = width, min_y = height, max_x = -1, max_y = -1;
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* row = fill + (size_t)y * width;
+    for (int x = 0; x < width; ++x) {
+      if (!row[x]) continue;
+      if (x < min_x) min_x = x;
+      if (x > max_x) max_x = x;
+      if (y < min_y) min_y = y;
+      max_y = y;
+    }
+  }
+  std::memset(stroke, 0, n);
+  if (max_x < 0) return;
+
+  const int reach = radius + 1;
+  const int x0 = std::max(0, min_x - reach);
+  const int y0 = std::max(0, min_y - reach);
+  const int x1 = std::min(width, max_x + reach + 1);
+  const int y1 = std::min(height, max_y + reach + 1);
+  const float max_d2 = (float)reach * reach;
+  DistanceTransform(fill, width, height, x0, y0, x1, y1, max_d2);
+
+  const int rw = x1 - x0;
+  for (int y = y0; y < y1; ++y) {
+    const float* d2 = &grid_[(size_t)(y - y0) * rw];
+    const uint8_t* src = fill + (size_t)y * width;
+    uint8_t* dst = stroke + (size_t)y * width;
+    for (int x = x0; x < x1; ++x) {
+      const float d = d2[x - x0];
+      uint8_t a = src[x];
+      if (d < max_d2) {
+        float cov = (float)reach - std::sqrt(d);
+        if (cov > 1.0f) cov = 1.0f;
+        const uint8_t edge = (uint8_t)(cov * 255.0f + 0.5f);
+        if (edge > a) a = edge;
+      }
+      dst[x] = a;
+    }
+  }
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,42 @@
+// stroke_engine.h
+#ifndef OVERLAY_CORE_STROKE_ENGINE_H_
+#define OVERLAY_CORE_STROKE_ENGINE_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace tono_overlay {
+
+// Builds a text stroke mask from an already rasterized fill mask, instead of
+// rasterizing the text once per offset inside the stroke disk. The fill mask
+// is dilated with a Euclidean distance transform (Felzenszwalb-Huttenlocher,
+// two separable linear passes), so the cost does not depend on the radius.
+//
+// Antialiased fill pixels seed the transform with a sub-pixel offset derived
+// from their coverage, and the stroke edge falls off linearly over one pixel:
+//   stroke = max(fill, clamp(radius + 1 - distance, 0, 1))
+//
+// Scratch buffers are kept between calls and only grow.
+class StrokeEngine {
+ public:
+  StrokeEngine() = default;
+
+  // Dilates |fill| (one coverage byte per pixel) by |radius| pixels into
+  // |stroke|. Both planes hold width * height bytes. radius <= 0 copies.
+  void BuildA8(const uint8_t* fill, uint8_t* stroke, int width, int height,
+               int radius);
+
+ private:
+  void DistanceTransform(const uint8_t* coverage, int width, int height,
+                         int x0, int y0, int x1, int y1, float max_d2);
+
+  std::vector<float> grid_;
+  std::vector<float> line_in_;
+  std::vector<float> line_out_;
+  std::vector<float> envelope_z_;
+  std::vector<int> envelope_v_;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_STROKE_ENGINE_H_
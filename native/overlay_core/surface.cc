@@ -0,0 +1,62 @@
+// surface.cc
+#include "overlay_core/surface.h"
+
+#include <cstring>
+#include <utility>
+
+namespace tono_overlay {
+
+void Surface::Clear() {
+  if (data_) std::memset(data_, 0, size_bytes());
+}
+
+MemorySurface::MemorySurface(int width, int height, int bytes_per_pixel)
+    : Surface(width, height, bytes_per_pixel),
+      storage_((size_t)width * height * bytes_per_pixel, 0) {
+  set_data(storage_.data());
+}
+
+std::unique_ptr<Surface> MemorySurfaceAllocator::Allocate(
+    int width, int height, int bytes_per_pixel) {
+  if (width <= 0 || height <= 0) return nullptr;
+  return std::make_unique<MemorySurface>(width, height, bytes_per_pixel);
+}
+
+SurfacePool::SurfacePool(std::unique_ptr<SurfaceAllocator> allocator,
+                         int slot_count)
+    : SurfacePool(std::move(allocator), std::vector<int>(slot_count, 4)) {}
+
+SurfacePool::SurfacePool(std::unique_ptr<SurfaceAllocator> allocator,
+                         std::vector<int> slot_bytes_per_pixel)
+    : allocator_(std::move(allocator)),
+      bytes_per_pixel_(std::move(slot_bytes_per_pixel)),
+      surfaces_(bytes_per_pixel_.size()) {}
+
+bool SurfacePool::EnsureSize(int width, int height) {
+  if (width <= 0 || height <= 0) {
+    Release();
+    return false;
+  }
+  if (width == width_ && height == height_) return true;
+  Release();
+  for (size_t slot = 0; slot < surfaces_.size(); ++slot) {
+    std::unique_ptr<Surface>& surface = surfaces_[slot];
+    surface = allocator_->Allocate(width, height, bytes_per_pixel_[slot]);
+    if (!surface) {
+      Release();
+      return false;
+    }
+    ++allocation_count_;
+  }
+  width_ = width;
+  height_ = height;
+  return true;
+}
+
+void SurfacePool::Release() {
+  for (auto& surface : surfaces_) surface.reset();
+  width_ = 0;
+  height_ = 0;
+}
+
+}  // namespace tono_overlay
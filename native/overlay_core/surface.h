@@ -0,0 +1,125 @@
+// surface.h
+#ifndef OVERLAY_CORE_SURFACE_H_
+#define OVERLAY_CORE_SURFACE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tono_overlay {
+
+// Memory layout of a 32-bit pixel: byte index of the R, G and B channels.
+// Alpha always lives in byte 3. The default matches a BI_RGB DIB (BGRA).
+struct PixelFormat {
+  int r_index = 2;
+  int g_index = 1;
+  int b_index = 0;
+};
+
+// A CPU-addressable, tightly packed pixel buffer (stride = width * bpp):
+// 32-bit pixels in a PixelFormat, or with one byte per pixel an A8
+// coverage mask. Backends subclass it to attach OS objects (e.g. a DIB
+// section and its DC) to the same memory.
+class Surface {
+ public:
+  virtual ~Surface() = default;
+
+  Surface(const Surface&) = delete;
+  Surface& operator=(const Surface&) = delete;
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  int bytes_per_pixel() const { return bytes_per_pixel_; }
+  size_t stride() const { return (size_t)width_ * bytes_per_pixel_; }
+  size_t size_bytes() const { return stride() * height_; }
+  uint8_t* data() { return data_; }
+  const uint8_t* data() const { return data_; }
+
+  // Zeroes every pixel in place. Backends that render asynchronously
+  // override this to synchronize first.
+  virtual void Clear();
+
+ protected:
+  Surface(int width, int height, int bytes_per_pixel)
+      : width_(width), height_(height), bytes_per_pixel_(bytes_per_pixel) {}
+
+  void set_data(uint8_t* data) { data_ = data; }
+
+ private:
+  int width_;
+  int height_;
+  int bytes_per_pixel_;
+  uint8_t* data_ = nullptr;
+};
+
+// Heap-backed surface used by headless targets and tests.
+class MemorySurface : public Surface {
+ public:
+  MemorySurface(int width, int height, int bytes_per_pixel);
+
+ private:
+  std::vector<uint8_t> storage_;
+};
+
+// Creates surfaces for a SurfacePool.
+class SurfaceAllocator {
+ public:
+  virtual ~SurfaceAllocator() = default;
+
+  // Returns a zeroed surface of the given size with |bytes_per_pixel| 4
+  // (32-bit pixels) or 1 (an A8 mask), or null on failure.
+  virtual std::unique_ptr<Surface> Allocate(int width, int height,
+                                            int bytes_per_pixel) = 0;
+
+  // Channel order of the 32-bit surfaces this allocator returns.
+  virtual PixelFormat pixel_format() const { return PixelFormat(); }
+};
+
+class MemorySurfaceAllocator : public SurfaceAllocator {
+ public:
+  std::unique_ptr<Surface> Allocate(int width, int height,
+                                    int bytes_per_pixel) override;
+};
+
+// A fixed set of same-sized surfaces (e.g. output, stroke, fill) kept alive
+// across renders. Surfaces are only reallocated when the size changes.
+class SurfacePool {
+ public:
+  // |slot_count| 32-bit surfaces.
+  SurfacePool(std::unique_ptr<SurfaceAllocator> allocator, int slot_count);
+  // One surface per entry of |slot_bytes_per_pixel|, with that many bytes
+  // per pixel.
+  SurfacePool(std::unique_ptr<SurfaceAllocator> allocator,
+              std::vector<int> slot_bytes_per_pixel);
+
+  SurfacePool(const SurfacePool&) = delete;
+  SurfacePool& operator=(const SurfacePool&) = delete;
+
+  // Makes every slot width x height. Returns false if the size is empty or
+  // an allocation failed, in which case the pool is left empty.
+  bool EnsureSize(int width, int height);
+
+  // Frees all surfaces; the next EnsureSize reallocates.
+  void Release();
+
+  Surface* surface(int slot) { return surfaces_[slot].get(); }
+  int width() const { return width_; }
+  int height() const { return height_; }
+  PixelFormat pixel_format() const { return allocator_->pixel_format(); }
+
+  // Total surfaces allocated over the pool's lifetime.
+  uint64_t allocation_count() const { return allocation_count_; }
+
+ private:
+  std::unique_ptr<SurfaceAllocator> allocator_;
+  std::vector<int> bytes_per_pixel_;
+  std::vector<std::unique_ptr<Surface>> surfaces_;
+  int width_ = 0;
+  int height_ = 0;
+  uint64_t allocation_count_ = 0;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_SURFACE_H_
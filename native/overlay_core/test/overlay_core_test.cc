@@ -0,0 +1,2484 @@
+// overlay_core_test.cc
+//
+// Unit tests for the portable overlay core. Deliberately dependency free:
+// each test is a plain function and failures are counted by the EXPECT
+// macros, so the binary runs anywhere ctest does.
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "overlay_core/clock.h"
+#include "overlay_core/compositor.h"
+#include "overlay_core/font_cache.h"
+#include "overlay_core/karaoke.h"
+#include "overlay_core/line_breaker.h"
+#include "overlay_core/line_cache.h"
+#include "overlay_core/line_prerenderer.h"
+#include "overlay_core/line_transition.h"
+#include "overlay_core/lrc_parser.h"
+#include "overlay_core/lyric_timeline.h"
+#include "overlay_core/marquee.h"
+#include "overlay_core/offscreen_target.h"
+#include "overlay_core/overlay_api.h"
+#include "overlay_core/overlay_instance.h"
+#include "overlay_core/overlay_log.h"
+#include "overlay_core/overlay_state.h"
+#include "overlay_core/overlay_stats.h"
+#include "overlay_core/overlay_style_decoder.h"
+#include "overlay_core/overlay_trace.h"
+#include "overlay_core/render_thread.h"
+#include "overlay_core/stroke_engine.h"
+#include "overlay_core/surface.h"
+#include "overlay_core/text_layer.h"
+#include "overlay_core/text_layout.h"
+
+namespace {
+// Heap allocations made by this thread while it counts them (>= 0); see
+// AllocationsDuring().
+thread_local int t_allocations = -1;
+}  // namespace
+
+void* operator new(std::size_t size) {
+  if (t_allocations >= 0) ++t_allocations;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+int g_failures = 0;
+
+// Heap allocations |fn| makes on the calling thread.
+int AllocationsDuring(const std::function<void()>& fn) {
+  t_allocations = 0;
+  fn();
+  const int count = t_allocations;
+  t_allocations = -1;
+  return count;
+}
+
+#define EXPECT_TRUE(cond)                                                 \
+  do {                                                                    \
+    if (!(cond)) {                                                        \
+      std::fprintf(stderr, "%s:%d: EXPECT_TRUE(%s) failed\n", __FILE__,   \
+                   __LINE__, #cond);                                      \
+      ++g_failures;                                                       \
+    }                                                                     \
+  } while (0)
+
+#define EXPECT_EQ(a, b)                                                   \
+  do {                                                                    \
+    if (!((a) == (b))) {                                                  \
+      std::fprintf(stderr, "%s:%d: EXPECT_EQ(%s, %s) failed\n", __FILE__, \
+                   __LINE__, #a, #b);                                     \
+      ++g_failures;                                                       \
+    }                                                                     \
+  } while (0)
+
+using tono_overlay::CompositeParams;
+using tono_overlay::CompositorIsa;
+
+// Verbatim port of the per-pixel loop update_text_layer() used before the
+// compositor module existed. Every kernel must match it exactly.
+void LegacyComposite(const uint8_t* pFill, const uint8_t* pStroke,
+                     uint8_t* out, int w, int h, int overlay_stroke_width,
+                     int overlay_text_opacity, const CompositeParams& p) {
+  const int byteIndexR = p.format.r_index;
+  const int byteIndexG = p.format.g_index;
+  const int byteIndexB = p.format.b_index;
+  uint8_t fill_r = p.fill.r, fill_g = p.fill.g, fill_b = p.fill.b;
+  uint8_t stroke_r = p.stroke.r, stroke_g = p.stroke.g, stroke_b = p.stroke.b;
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      int idx = (y * w + x) * 4;
+      uint8_t fsr = pFill[idx + byteIndexR];
+      uint8_t fsg = pFill[idx + byteIndexG];
+      uint8_t fsb = pFill[idx + byteIndexB];
+      uint8_t fA = fsr; if (fsg > fA) fA = fsg; if (fsb > fA) fA = fsb;
+      uint8_t ssr = 0, ssg = 0, ssb = 0; uint8_t sA = 0;
+      if (overlay_stroke_width > 0 && pStroke) {
+        ssr = pStroke[idx + byteIndexR];
+        ssg = pStroke[idx + byteIndexG];
+        ssb = pStroke[idx + byteIndexB];
+        sA = ssr; if (ssg > sA) sA = ssg; if (ssb > sA) sA = ssb;
+      }
+      if (overlay_text_opacity < 255) {
+        fA = (uint8_t)((fA * overlay_text_opacity + 127) / 255);
+        sA = (uint8_t)((sA * overlay_text_opacity + 127) / 255);
+      }
+      uint32_t out_r = 0, out_g = 0, out_b = 0, out_a = 0;
+      if (sA) {
+        out_r = (stroke_r * sA + 127) / 255;
+        out_g = (stroke_g * sA + 127) / 255;
+        out_b = (stroke_b * sA + 127) / 255;
+        out_a = sA;
+      }
+      if (fA) {
+        uint32_t inv = 255 - fA;
+        uint32_t nr = (fill_r * fA + (out_r * inv)) / 255;
+        uint32_t ng = (fill_g * fA + (out_g * inv)) / 255;
+        uint32_t nb = (fill_b * fA + (out_b * inv)) / 255;
+        uint32_t na = fA + (out_a * inv) / 255;
+        out_r = nr; out_g = ng; out_b = nb; out_a = na;
+      }
+      out[idx + byteIndexR] = (uint8_t)out_r;
+      out[idx + byteIndexG] = (uint8_t)out_g;
+      out[idx + byteIndexB] = (uint8_t)out_b;
+      out[idx + 3] = (uint8_t)out_a;
+    }
+  }
+}
+
+// Random mask with the value mix GDI produces: mostly empty or solid, with
+// antialiased edges and occasional unequal channels (ClearType fringes).
+std::vector<uint8_t> RandomMask(std::mt19937& rng, size_t pixels) {
+  std::vector<uint8_t> m(pixels * 4);
+  std::uniform_int_distribution<int> kind(0, 9);
+  std::uniform_int_distribution<int> byte(0, 255);
+  for (size_t i = 0; i < pixels; ++i) {
+    uint8_t* px = &m[i * 4];
+    switch (kind(rng)) {
+      case 0: case 1: case 2: case 3:
+        px[0] = px[1] = px[2] = 0;
+        break;
+      case 4: case 5:
+        px[0] = px[1] = px[2] = 255;
+        break;
+      case 6: case 7: {
+        uint8_t v = (uint8_t)byte(rng);
+        px[0] = px[1] = px[2] = v;
+        break;
+      }
+      default:
+        px[0] = (uint8_t)byte(rng);
+        px[1] = (uint8_t)byte(rng);
+        px[2] = (uint8_t)byte(rng);
+        break;
+    }
+    px[3] = (uint8_t)byte(rng);  // mask alpha must be ignored
+  }
+  return m;
+}
+
+// The A8 coverage the kernels read for a 32-bit legacy mask.
+std::vector<uint8_t> ToA8(const std::vector<uint8_t>& mask) {
+  std::vector<uint8_t> a8(mask.size() / 4);
+  tono_overlay::MaskToA8(mask.data(), a8.data(), a8.size());
+  return a8;
+}
+
+void TestCompositorMatchesLegacy() {
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> byte(0, 255);
+  const tono_overlay::PixelFormat formats[3] = {{2, 1, 0}, {0, 1, 2}, {1, 0, 2}};
+  const int opacities[] = {255, 254, 128, 1, 0};
+  const CompositorIsa isas[] = {CompositorIsa::kScalar, CompositorIsa::kSse2,
+                                CompositorIsa::kAvx2, CompositorIsa::kNeon};
+  // Widths exercise the scalar tails of every vector width.
+  const int sizes[][2] = {{1, 1}, {3, 5}, {17, 3}, {33, 2}, {3840, 2}};
+  int kernels_run = 0;
+  for (const auto& size : sizes) {
+    const int w = size[0], h = size[1];
+    const size_t n = (size_t)w * h;
+    std::vector<uint8_t> fill = RandomMask(rng, n);
+    std::vector<uint8_t> stroke = RandomMask(rng, n);
+    const std::vector<uint8_t> fill8 = ToA8(fill), stroke8 = ToA8(stroke);
+    for (const auto& format : formats) {
+      for (int opacity : opacities) {
+        for (int stroke_width : {0, 3}) {
+          CompositeParams p;
+          p.fill = {(uint8_t)byte(rng), (uint8_t)byte(rng), (uint8_t)byte(rng)};
+          p.stroke = {(uint8_t)byte(rng), (uint8_t)byte(rng),
+                      (uint8_t)byte(rng)};
+          p.text_opacity = opacity;
+          p.format = format;
+          std::vector<uint8_t> expected(n * 4);
+          LegacyComposite(fill.data(), stroke.data(), expected.data(), w, h,
+                          stroke_width, opacity, p);
+          const uint8_t* s = stroke_width > 0 ? stroke8.data() : nullptr;
+          for (CompositorIsa isa : isas) {
+            std::vector<uint8_t> got(n * 4, 0xCD);
+            if (!tono_overlay::CompositeStrokeFillWithIsa(
+                    isa, fill8.data(), s, got.data(), n, p)) {
+              continue;
+            }
+            ++kernels_run;
+            if (got != expected) {
+              std::fprintf(stderr, "kernel %s differs: %dx%d op=%d stroke=%d\n",
+                           tono_overlay::CompositorIsaName(isa), w, h,
+                           opacity, stroke_width);
+              ++g_failures;
+            }
+          }
+          std::vector<uint8_t> dispatched(n * 4);
+          tono_overlay::CompositeStrokeFill(fill8.data(), s,
+                                            dispatched.data(), n, p);
+          EXPECT_TRUE(dispatched == expected);
+        }
+      }
+    }
+  }
+  EXPECT_TRUE(kernels_run > 0);
+}
+
+void TestCompositorExhaustiveAlphaPairs() {
+  // Every (fill, stroke) coverage pair for a few colors and opacities.
+  const size_t n = 256 * 256;
+  std::vector<uint8_t> fill(n * 4), stroke(n * 4);
+  for (size_t i = 0; i < n; ++i) {
+    std::memset(&fill[i * 4], (int)(i & 0xFF), 3);
+    std::memset(&stroke[i * 4], (int)(i >> 8), 3);
+  }
+  const std::vector<uint8_t> fill8 = ToA8(fill), stroke8 = ToA8(stroke);
+  for (int opacity : {255, 200}) {
+    CompositeParams p;
+    p.fill = {255, 128, 1};
+    p.stroke = {0, 77, 254};
+    p.text_opacity = opacity;
+    std::vector<uint8_t> expected(n * 4);
+    LegacyComposite(fill.data(), stroke.data(), expected.data(), 256, 256, 1,
+                    opacity, p);
+    std::vector<uint8_t> got(n * 4);
+    tono_overlay::CompositeStrokeFill(fill8.data(), stroke8.data(), got.data(),
+                                      n, p);
+    EXPECT_TRUE(got == expected);
+  }
+}
+
+void TestCompositorBackgroundPlate() {
+  using tono_overlay::BackgroundPlate;
+  std::mt19937 rng(23);
+  std::uniform_int_distribution<int> byte(0, 255);
+  const CompositorIsa isas[] = {CompositorIsa::kScalar, CompositorIsa::kSse2,
+                                CompositorIsa::kAvx2, CompositorIsa::kNeon};
+  const tono_overlay::PixelFormat format = {2, 1, 0};
+  // Every kernel puts the premultiplied plate under the text's alpha:
+  // out = text + plate * (255 - text alpha) / 255, rounded.
+  for (int w : {1, 7, 33, 130}) {
+    const size_t n = (size_t)w * 3;
+    std::vector<uint8_t> fill = RandomMask(rng, n);
+    std::vector<uint8_t> stroke = RandomMask(rng, n);
+    const std::vector<uint8_t> fill8 = ToA8(fill), stroke8 = ToA8(stroke);
+    for (int opacity : {255, 90}) {
+      for (int stroke_width : {0, 2}) {
+        CompositeParams p;
+        p.fill = {(uint8_t)byte(rng), (uint8_t)byte(rng), (uint8_t)byte(rng)};
+        p.stroke = {(uint8_t)byte(rng), (uint8_t)byte(rng),
+                    (uint8_t)byte(rng)};
+        p.text_opacity = opacity;
+        p.format = format;
+        p.background.color = {(uint8_t)byte(rng), (uint8_t)byte(rng),
+                              (uint8_t)byte(rng)};
+        p.background.alpha = 1 + byte(rng) % 255;
+        std::vector<uint8_t> expected(n * 4);
+        LegacyComposite(fill.data(), stroke.data(), expected.data(), w, 3,
+                        stroke_width, opacity, p);
+        const int a = p.background.alpha;
+        const int plate[4] = {(p.background.color.b * a + 127) / 255,
+                              (p.background.color.g * a + 127) / 255,
+                              (p.background.color.r * a + 127) / 255, a};
+        for (size_t i = 0; i < n * 4; i += 4) {
+          const int under = 255 - expected[i + 3];
+          for (int c = 0; c < 4; ++c) {
+            expected[i + c] =
+                (uint8_t)(expected[i + c] + (plate[c] * under + 127) / 255);
+          }
+        }
+        const uint8_t* s = stroke_width > 0 ? stroke8.data() : nullptr;
+        for (CompositorIsa isa : isas) {
+          std::vector<uint8_t> got(n * 4, 0xCD);
+          if (!tono_overlay::CompositeStrokeFillWithIsa(
+                  isa, fill8.data(), s, got.data(), n, p)) {
+            continue;
+          }
+          if (got != expected) {
+            std::fprintf(stderr, "plate kernel %s differs: w=%d op=%d\n",
+                         tono_overlay::CompositorIsaName(isa), w, opacity);
+            ++g_failures;
+          }
+        }
+      }
+    }
+  }
+
+  // Without text the layer is the plate alone: transparent outside the
+  // rounded corners, solid inside, and symmetric.
+  const int w = 40, h = 20;
+  const size_t n = (size_t)w * h;
+  std::vector<uint8_t> empty(n * 4, 0);
+  CompositeParams p;
+  p.format = format;
+  p.background = {{10, 200, 30}, 180, 6};
+  std::vector<uint8_t> layer(n * 4, 0xCD), plate(n * 4, 0xCD);
+  tono_overlay::CompositeLayer(empty.data(), nullptr, layer.data(), w, h, 0,
+                               w, p);
+  tono_overlay::RenderBackgroundPlate(p.background, format, w, h,
+                                      plate.data(), (size_t)w * 4);
+  EXPECT_TRUE(layer == plate);
+  EXPECT_EQ(layer[3], 0);
+  const size_t center = ((size_t)(h / 2) * w + w / 2) * 4;
+  EXPECT_EQ(layer[center + 3], 180);
+  EXPECT_EQ(layer[center + 1], (uint8_t)((200 * 180 + 127) / 255));
+  bool symmetric = true;
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      const size_t mirrored = ((size_t)(h - 1 - y) * w + (w - 1 - x)) * 4;
+      symmetric &= layer[((size_t)y * w + x) * 4 + 3] == layer[mirrored + 3];
+    }
+  }
+  EXPECT_TRUE(symmetric);
+  // The radius is capped at half the shorter side; alpha 0 draws nothing.
+  p.background.corner_radius = 1000;
+  tono_overlay::RenderBackgroundPlate(p.background, format, w, h,
+                                      plate.data(), (size_t)w * 4);
+  EXPECT_EQ(plate[center + 3], 180);
+  EXPECT_EQ(plate[((size_t)2 * w + 2) * 4 + 3], 0);
+  EXPECT_EQ(layer[((size_t)2 * w + 2) * 4 + 3], 180);
+  p.background.alpha = 0;
+  tono_overlay::RenderBackgroundPlate(p.background, format, w, h,
+                                      plate.data(), (size_t)w * 4);
+  EXPECT_TRUE(plate == empty);
+
+  // Column ranges, as the karaoke sweep composites them, add up to the
+  // whole layer, corners included.
+  const std::vector<uint8_t> fill = ToA8(RandomMask(rng, n));
+  const std::vector<uint8_t> stroke = ToA8(RandomMask(rng, n));
+  p.background = {{90, 60, 250}, 220, 7};
+  p.text_opacity = 200;
+  tono_overlay::CompositeLayer(fill.data(), stroke.data(), layer.data(), w, h,
+                               0, w, p);
+  std::vector<uint8_t> columns(n * 4, 0xCD);
+  const int splits[] = {0, 3, 17, 36, w};
+  for (size_t i = 0; i + 1 < sizeof(splits) / sizeof(splits[0]); ++i) {
+    tono_overlay::CompositeLayer(fill.data(), stroke.data(), columns.data(),
+                                 w, h, splits[i], splits[i + 1], p);
+  }
+  EXPECT_TRUE(columns == layer);
+}
+
+void TestStrokeEngineDilatesToDisk() {
+  // A single solid pixel dilates to a disk: solid within the radius, fading
+  // out over the next pixel, empty beyond.
+  const int w = 64, h = 64, cx = 32, cy = 32;
+  std::vector<uint8_t> fill((size_t)w * h, 0), stroke((size_t)w * h);
+  fill[(size_t)cy * w + cx] = 255;
+  tono_overlay::StrokeEngine engine;
+  for (int radius : {1, 5, 20}) {
+    engine.BuildA8(fill.data(), stroke.data(), w, h, radius);
+    bool ok = true;
+    for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < w; ++x) {
+        const int d2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+        const uint8_t v = stroke[(size_t)y * w + x];
+        if (d2 <= radius * radius && v != 255) ok = false;
+        if (d2 >= (radius + 1) * (radius + 1) && v != 0) ok = false;
+      }
+    }
+    EXPECT_TRUE(ok);
+  }
+}
+
+void TestStrokeEngineCoversFillAndOldDisk() {
+  // The stroke always contains the fill, and every pixel the old disk
+  // stamping covered solidly is covered solidly by the engine too.
+  std::mt19937 rng(99);
+  const int w = 96, h = 40, radius = 3;
+  std::vector<uint8_t> fill((size_t)w * h, 0);
+  std::uniform_int_distribution<int> coord(10, 85), row(10, 29);
+  for (int i = 0; i < 40; ++i) fill[(size_t)row(rng) * w + coord(rng)] = 255;
+  std::vector<uint8_t> stroke((size_t)w * h);
+  tono_overlay::StrokeEngine engine;
+  engine.BuildA8(fill.data(), stroke.data(), w, h, radius);
+  bool contains_fill = true, covers_disk = true;
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      if (stroke[(size_t)y * w + x] < fill[(size_t)y * w + x]) {
+        contains_fill = false;
+      }
+      bool stamped = false;
+      for (int dy = -radius; dy <= radius && !stamped; ++dy) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+          if (dx * dx + dy * dy > radius * radius) continue;
+          const int sx = x - dx, sy = y - dy;
+          if (sx < 0 || sy < 0 || sx >= w || sy >= h) continue;
+          if (fill[(size_t)sy * w + sx] == 255) { stamped = true; break; }
+        }
+      }
+      if (stamped && stroke[(size_t)y * w + x] != 255) covers_disk = false;
+    }
+  }
+  EXPECT_TRUE(contains_fill);
+  EXPECT_TRUE(covers_disk);
+
+}
+
+// Counts allocations so tests can assert a render path allocates nothing.
+class CountingAllocator : public tono_overlay::MemorySurfaceAllocator {
+ public:
+  explicit CountingAllocator(int* count) : count_(count) {}
+  std::unique_ptr<tono_overlay::Surface> Allocate(
+      int width, int height, int bytes_per_pixel) override {
+    ++*count_;
+    return MemorySurfaceAllocator::Allocate(width, height, bytes_per_pixel);
+  }
+
+ private:
+  int* count_;
+};
+
+void TestSurfacePoolReusesSurfaces() {
+  int allocations = 0;
+  tono_overlay::SurfacePool pool(std::make_unique<CountingAllocator>(&allocations),
+                                 3);
+  EXPECT_TRUE(pool.EnsureSize(600, 64));
+  EXPECT_EQ(allocations, 3);
+  tono_overlay::Surface* first = pool.surface(0);
+  EXPECT_EQ(first->stride(), (size_t)600 * 4);
+
+  // Steady-state updates at the same size allocate nothing and keep the
+  // same memory; Clear() works in place.
+  for (int update = 0; update < 100; ++update) {
+    EXPECT_TRUE(pool.EnsureSize(600, 64));
+    pool.surface(update % 3)->data()[update] = 0xFF;
+    pool.surface(update % 3)->Clear();
+  }
+  EXPECT_EQ(allocations, 3);
+  EXPECT_EQ(pool.allocation_count(), (uint64_t)3);
+  EXPECT_TRUE(pool.surface(0) == first);
+  bool zero = true;
+  for (int slot = 0; slot < 3; ++slot) {
+    const tono_overlay::Surface* s = pool.surface(slot);
+    for (size_t i = 0; i < s->size_bytes(); ++i) zero = zero && !s->data()[i];
+  }
+  EXPECT_TRUE(zero);
+
+  // A resize reallocates every slot once.
+  EXPECT_TRUE(pool.EnsureSize(800, 64));
+  EXPECT_EQ(allocations, 6);
+  EXPECT_EQ(pool.surface(2)->width(), 800);
+  EXPECT_TRUE(pool.EnsureSize(800, 64));
+  EXPECT_EQ(allocations, 6);
+
+  // Empty sizes fail and release; release forces a fresh allocation.
+  EXPECT_TRUE(!pool.EnsureSize(0, 64));
+  EXPECT_TRUE(pool.surface(0) == nullptr);
+  EXPECT_TRUE(pool.EnsureSize(800, 64));
+  EXPECT_EQ(allocations, 9);
+
+  // Slots keep their own pixel size: A8 masks next to a 32-bit output.
+  tono_overlay::SurfacePool mixed(
+      std::make_unique<tono_overlay::MemorySurfaceAllocator>(), {1, 1, 4});
+  EXPECT_TRUE(mixed.EnsureSize(600, 64));
+  EXPECT_EQ(mixed.surface(0)->bytes_per_pixel(), 1);
+  EXPECT_EQ(mixed.surface(1)->stride(), (size_t)600);
+  EXPECT_EQ(mixed.surface(2)->stride(), (size_t)600 * 4);
+  EXPECT_EQ(mixed.surface(1)->size_bytes(), (size_t)600 * 64);
+}
+
+void TestLineCacheLruAndBudget() {
+  using tono_overlay::LineCache;
+  using tono_overlay::LineCacheKey;
+  // Each 10x10 line is 400 bytes; the budget fits three.
+  LineCache cache(1200);
+  std::vector<uint8_t> pixels(400), out(400);
+  auto key = [](const char* text, uint64_t style) {
+    LineCacheKey k;
+    k.text = text;
+    k.style_hash = style;
+    return k;
+  };
+  auto lookup = [&](const char* text, uint64_t style) {
+    return cache.Lookup(key(text, style), out.data(), out.size());
+  };
+  for (int i = 0; i < 3; ++i) {
+    pixels[0] = (uint8_t)i;
+    cache.Insert(key(i == 0 ? "a" : i == 1 ? "b" : "c", 1), 10, 10,
+                 pixels.data());
+  }
+  EXPECT_EQ(cache.stats().bytes, (size_t)1200);
+  // Same text, different style is a different line.
+  EXPECT_TRUE(!lookup("a", 2));
+  EXPECT_TRUE(lookup("a", 1) && out[0] == 0);
+  // A destination of the wrong size is a miss, not an overrun.
+  EXPECT_TRUE(!cache.Lookup(key("a", 1), out.data(), 399));
+  // "b" is now least recently used and gets evicted by "d".
+  cache.Insert(key("d", 1), 10, 10, pixels.data());
+  EXPECT_TRUE(!cache.Contains(key("b", 1)));
+  EXPECT_TRUE(!lookup("b", 1));
+  EXPECT_TRUE(lookup("a", 1));
+  EXPECT_TRUE(lookup("c", 1) && out[0] == 2);
+  tono_overlay::LineCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.hits, (uint64_t)3);
+  EXPECT_EQ(stats.misses, (uint64_t)3);
+  EXPECT_EQ(stats.evictions, (uint64_t)1);
+  EXPECT_EQ(stats.entries, (size_t)3);
+
+  // Oversized lines are skipped; shrinking the budget evicts.
+  cache.Insert(key("huge", 1), 40, 10, std::vector<uint8_t>(1600).data());
+  EXPECT_TRUE(!cache.Contains(key("huge", 1)));
+  cache.SetByteBudget(400);
+  EXPECT_EQ(cache.stats().entries, (size_t)1);
+  EXPECT_TRUE(cache.Contains(key("c", 1)));
+  cache.SetByteBudget(0);
+  EXPECT_EQ(cache.stats().bytes, (size_t)0);
+  cache.ResetStats();
+  EXPECT_EQ(cache.stats().hits, (uint64_t)0);
+}
+
+void TestLinePrerendererRendersLookahead() {
+  using tono_overlay::LineBitmap;
+  using tono_overlay::LineCache;
+  using tono_overlay::LineCacheKey;
+  using tono_overlay::LinePrerenderer;
+  using tono_overlay::LyricLine;
+  LineCache cache;
+  LinePrerenderer prerenderer(&cache, 2);
+  std::vector<LyricLine> sheet;
+  const char* texts[] = {"one", "two", " ", "three", "two", "four"};
+  for (int i = 0; i < 6; ++i) {
+    LyricLine line;
+    line.time_ms = i * 1000;
+    line.text = texts[i];
+    sheet.push_back(line);
+  }
+  auto render = [](uint8_t tag) {
+    return [tag](const std::string& text, LineBitmap* out) {
+      out->width = (int)text.size();
+      out->height = 1;
+      out->pixels.assign(text.size() * 4, tag);
+      return true;
+    };
+  };
+  auto cached = [&](const char* text, uint64_t style) {
+    LineCacheKey key;
+    key.text = text;
+    key.style_hash = style;
+    return cache.Contains(key);
+  };
+
+  // Nothing renders until a style is known.
+  prerenderer.SetSheet(sheet);
+  prerenderer.WaitIdle();
+  EXPECT_EQ(prerenderer.rendered_count(), (uint64_t)0);
+
+  // Before the first line the lookahead covers lines 0 and 1.
+  prerenderer.SetStyle(7, render(1));
+  prerenderer.WaitIdle();
+  EXPECT_TRUE(cached("one", 7) && cached("two", 7));
+  EXPECT_TRUE(!cached("three", 7));
+
+  // Showing "two" pre-renders the next two lines; the blank is skipped.
+  EXPECT_EQ(prerenderer.NoteText("two"), 1);
+  prerenderer.WaitIdle();
+  EXPECT_TRUE(cached("three", 7));
+  EXPECT_EQ(prerenderer.rendered_count(), (uint64_t)3);
+
+  // The repeated "two" resolves to its next occurrence, and already cached
+  // lines are not rendered again.
+  EXPECT_EQ(prerenderer.NoteText("three"), 3);
+  EXPECT_EQ(prerenderer.NoteText("two"), 4);
+  EXPECT_EQ(prerenderer.NoteText("two"), 4);
+  prerenderer.WaitIdle();
+  EXPECT_TRUE(cached("four", 7));
+  EXPECT_EQ(prerenderer.rendered_count(), (uint64_t)4);
+
+  // Unknown text keeps the position; seeking back finds the earlier line.
+  EXPECT_EQ(prerenderer.NoteText("status message"), -1);
+  EXPECT_EQ(prerenderer.current_index(), 4);
+  EXPECT_EQ(prerenderer.NoteText("one"), 0);
+
+  // A new style renders the lookahead again under the new key.
+  prerenderer.SetStyle(8, render(2));
+  prerenderer.WaitIdle();
+  EXPECT_TRUE(cached("two", 8) && !cached("three", 8));
+  std::vector<uint8_t> out(12);
+  LineCacheKey key;
+  key.text = "two";
+  key.style_hash = 8;
+  EXPECT_TRUE(cache.Lookup(key, out.data(), out.size()) && out[0] == 2);
+}
+
+// Drives the timeline the way the runner's timer does: sleep for
+// MsUntilNextChange(), then read CurrentIndex(). Every line must be shown
+// on the first clock millisecond at or after its start.
+void TestLyricTimelineFollowsSimulatedClock() {
+  using tono_overlay::LyricTimeline;
+  using tono_overlay::ManualClock;
+  ManualClock clock(5000);
+  LyricTimeline timeline(&clock);
+  const std::vector<int64_t> starts = {1000, 2500, 2500, 4000, 9000};
+  timeline.SetTimes(starts);
+  EXPECT_EQ(timeline.CurrentIndex(), -1);
+  // Paused by default: no timer needed.
+  EXPECT_EQ(timeline.MsUntilNextChange(), (int64_t)-1);
+
+  const double rates[] = {1.0, 1.25, 0.5, 3.0};
+  for (double rate : rates) {
+    timeline.SetAnchor(0, rate, false);
+    int shown = -1;
+    int changes = 0;
+    for (int64_t delay = timeline.MsUntilNextChange(); delay >= 0;
+         delay = timeline.MsUntilNextChange()) {
+      EXPECT_TRUE(delay >= 1);
+      clock.Advance(delay);
+      const int index = timeline.CurrentIndex();
+      EXPECT_TRUE(index > shown);
+      // On time: the line has started, but had not one clock millisecond
+      // earlier.
+      EXPECT_TRUE(timeline.PositionMs() >= starts[index]);
+      clock.Advance(-1);
+      EXPECT_EQ(timeline.CurrentIndex(), shown);
+      clock.Advance(1);
+      shown = index;
+      ++changes;
+    }
+    // Lines sharing a timestamp change together; 4 distinct start times.
+    EXPECT_EQ(changes, 4);
+    EXPECT_EQ(shown, 4);
+  }
+
+  // Pausing freezes the position; seeking back re-selects the line.
+  timeline.SetAnchor(3000, 1.0, true);
+  clock.Advance(10000);
+  EXPECT_EQ(timeline.PositionMs(), (int64_t)3000);
+  EXPECT_EQ(timeline.CurrentIndex(), 2);
+  EXPECT_EQ(timeline.MsUntilNextChange(), (int64_t)-1);
+  timeline.SetAnchor(3000, 1.0, false);
+  EXPECT_EQ(timeline.MsUntilNextChange(), (int64_t)1000);
+  timeline.SetAnchor(500, 1.0, false);
+  EXPECT_EQ(timeline.CurrentIndex(), -1);
+  EXPECT_EQ(timeline.MsUntilNextChange(), (int64_t)500);
+  EXPECT_EQ(timeline.IndexAt(2500), 2);
+  EXPECT_EQ(timeline.IndexAt(2499), 0);
+}
+
+void TestLrcParser() {
+  using tono_overlay::LrcLine;
+  using tono_overlay::LrcParser;
+  const std::string lyric =
+      "\xEF\xBB\xBF[ti:Song]\r\n"
+      "[offset:+200]\r\n"
+      "[00:01.5]  first  \r\n"
+      "[00:03.25][01:02.125]chorus\r\n"
+      "[00:05]\r\n"
+      "[00:04:50]colon\r\n"
+      "[xx:yy]not a tag\r\n"
+      "[00:07.00]<kept>[00:08.00]";
+  const std::string translation =
+      "[00:01.50]premier\n[00:02.00]orphan\n[00:03.25]refrain\n";
+  LrcParser parser;
+  const std::vector<LrcLine>& lines = parser.Parse(lyric, translation);
+  EXPECT_EQ(parser.offset_ms(), (int64_t)200);
+  EXPECT_EQ(lines.size(), (size_t)6);
+  if (lines.size() != 6) return;
+  // Sorted, offset applied, precision normalized to milliseconds.
+  EXPECT_EQ(lines[0].time_ms, (int64_t)1300);
+  EXPECT_TRUE(lines[0].text == "first");
+  EXPECT_TRUE(lines[0].translation == "premier");
+  EXPECT_EQ(lines[1].time_ms, (int64_t)3050);
+  EXPECT_TRUE(lines[1].text == "chorus" && lines[1].translation == "refrain");
+  EXPECT_EQ(lines[2].time_ms, (int64_t)4300);
+  EXPECT_TRUE(lines[2].text == "colon" && lines[2].translation.empty());
+  EXPECT_EQ(lines[3].time_ms, (int64_t)4800);
+  EXPECT_TRUE(lines[3].text.empty());
+  EXPECT_EQ(lines[4].time_ms, (int64_t)6800);
+  EXPECT_TRUE(lines[4].text == "<kept>[00:08.00]");
+  EXPECT_EQ(lines[5].time_ms, (int64_t)61925);
+  EXPECT_TRUE(lines[5].text == "chorus" && lines[5].translation.empty());
+  // Views point into the caller's buffer.
+  EXPECT_TRUE(lines[1].text.data() >= lyric.data() &&
+              lines[1].text.data() < lyric.data() + lyric.size());
+
+  // Reuse keeps the storage; a negative offset delays lines.
+  const LrcLine* storage = lines.data();
+  parser.Parse("[offset:-1000]\n[00:00.10]a\n[00:00.20]b");
+  EXPECT_TRUE(parser.lines().data() == storage);
+  EXPECT_EQ(parser.lines().size(), (size_t)2);
+  EXPECT_EQ(parser.lines()[0].time_ms, (int64_t)1100);
+  EXPECT_TRUE(parser.Parse("").empty());
+}
+
+void TestStripWordTimings() {
+  std::string plain;
+  std::vector<tono_overlay::LrcWord> words;
+  EXPECT_TRUE(tono_overlay::StripWordTimings(
+      "<00:01.00>Hel<00:01.50>lo <1<2> <00:02.25>world<00:03.00>", &plain,
+      &words));
+  EXPECT_TRUE(plain == "Hello <1<2> world");
+  EXPECT_EQ(words.size(), (size_t)4);
+  if (words.size() == 4) {
+    EXPECT_EQ(words[0].time_ms, (int64_t)1000);
+    EXPECT_EQ(words[0].begin, (size_t)0);
+    EXPECT_EQ(words[1].begin, (size_t)3);
+    EXPECT_EQ(words[2].time_ms, (int64_t)2250);
+    EXPECT_EQ(words[2].begin, (size_t)12);
+    EXPECT_EQ(words[3].begin, plain.size());
+  }
+  EXPECT_TRUE(!tono_overlay::StripWordTimings("plain <b>", &plain, &words));
+  EXPECT_TRUE(plain == "plain <b>" && words.empty());
+}
+
+void TestKaraokeSweepRecompositesOnlyCrossedColumns() {
+  using tono_overlay::CompositeParams;
+  using tono_overlay::KaraokeCompositor;
+  using tono_overlay::KaraokeSegment;
+  std::vector<KaraokeSegment> segments(2);
+  segments[0] = {1000, 2000, 10, 50};
+  segments[1] = {2500, 3000, 60, 100};
+  EXPECT_EQ(tono_overlay::KaraokeSweepX(segments, 0), 0);
+  EXPECT_EQ(tono_overlay::KaraokeSweepX(segments, 1500), 30);
+  EXPECT_EQ(tono_overlay::KaraokeSweepX(segments, 2200), 50);
+  EXPECT_EQ(tono_overlay::KaraokeSweepX(segments, 2750), 80);
+  EXPECT_EQ(tono_overlay::KaraokeSweepX(segments, 9000), 100);
+
+  const int w = 37, h = 5;
+  const size_t n = (size_t)w * h;
+  std::mt19937 rng(5);
+  std::vector<uint8_t> fill(n), stroke(n);
+  for (auto& v : fill) v = (uint8_t)rng();
+  for (auto& v : stroke) v = (uint8_t)rng();
+  CompositeParams base;
+  base.fill = {200, 210, 220};
+  base.stroke = {10, 20, 30};
+  base.text_opacity = 230;
+  CompositeParams lit = base;
+  lit.fill = {255, 40, 0};
+  std::vector<uint8_t> base_out(n * 4), lit_out(n * 4), out(n * 4);
+  tono_overlay::CompositeStrokeFill(fill.data(), stroke.data(),
+                                    base_out.data(), n, base);
+  tono_overlay::CompositeStrokeFill(fill.data(), stroke.data(),
+                                    lit_out.data(), n, lit);
+  auto expect_sweep = [&](int sweep) {
+    for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < w; ++x) {
+        const size_t i = ((size_t)y * w + x) * 4;
+        const std::vector<uint8_t>& ref = x < sweep ? lit_out : base_out;
+        EXPECT_TRUE(std::memcmp(&out[i], &ref[i], 4) == 0);
+      }
+    }
+  };
+
+  KaraokeCompositor karaoke;
+  karaoke.Reset(fill.data(), stroke.data(), out.data(), w, h, base, lit.fill);
+  expect_sweep(0);
+  int begin = -1, end = -1;
+  EXPECT_TRUE(karaoke.SetSweep(13, &begin, &end));
+  EXPECT_TRUE(begin == 0 && end == 13);
+  expect_sweep(13);
+  EXPECT_TRUE(!karaoke.SetSweep(13, &begin, &end));
+  // Columns outside the dirty range are not touched.
+  out[(size_t)2 * 4] = 7;
+  EXPECT_TRUE(karaoke.SetSweep(100, &begin, &end));
+  EXPECT_TRUE(begin == 13 && end == w);
+  EXPECT_EQ(out[(size_t)2 * 4], 7);
+  out[(size_t)2 * 4] = lit_out[(size_t)2 * 4];
+  expect_sweep(w);
+  EXPECT_TRUE(karaoke.SetSweep(5, &begin, &end));
+  EXPECT_TRUE(begin == 5 && end == w);
+  expect_sweep(5);
+}
+
+void TestLineTransitionBlendsCachedBitmaps() {
+  using tono_overlay::BlendTransition;
+  using tono_overlay::LineTransition;
+  using tono_overlay::TransitionKind;
+  const int w = 23, h = 6;
+  const size_t stride = (size_t)w * 4;
+  const size_t n = stride * h;
+  // Premultiplied: every color byte is at most the pixel's alpha.
+  std::mt19937 rng(16);
+  auto random_line = [&]() {
+    std::vector<uint8_t> line(n);
+    for (size_t i = 0; i < n; i += 4) {
+      const uint8_t a = (uint8_t)rng();
+      for (int c = 0; c < 3; ++c) line[i + c] = (uint8_t)(rng() % (a + 1));
+      line[i + 3] = a;
+    }
+    return line;
+  };
+  const std::vector<uint8_t> from = random_line();
+  const std::vector<uint8_t> to = random_line();
+  std::vector<uint8_t> out(n);
+
+  // Every kind starts on the old line and lands on the new one exactly.
+  const TransitionKind kinds[] = {TransitionKind::kCrossfade,
+                                  TransitionKind::kSlideUp,
+                                  TransitionKind::kScale};
+  for (TransitionKind kind : kinds) {
+    BlendTransition(kind, from.data(), to.data(), out.data(), w, h, stride,
+                    0.0);
+    EXPECT_TRUE(out == from);
+    BlendTransition(kind, from.data(), to.data(), out.data(), w, h, stride,
+                    1.0);
+    EXPECT_TRUE(out == to);
+    // Intermediate frames stay premultiplied.
+    BlendTransition(kind, from.data(), to.data(), out.data(), w, h, stride,
+                    0.37);
+    bool premultiplied = true;
+    for (size_t i = 0; i < n; i += 4) {
+      for (int c = 0; c < 3; ++c) premultiplied &= out[i + c] <= out[i + 3];
+    }
+    EXPECT_TRUE(premultiplied);
+  }
+
+  // Crossfade halfway is the rounded average.
+  BlendTransition(TransitionKind::kCrossfade, from.data(), to.data(),
+                  out.data(), w, h, stride, 0.5);
+  bool averaged = true;
+  for (size_t i = 0; i < n; ++i) {
+    averaged &= out[i] == (uint8_t)((from[i] + to[i] + 1) / 2);
+  }
+  EXPECT_TRUE(averaged);
+
+  // Slide-up halfway: the old line's bottom half on top, faded to half,
+  // then the new line's top half.
+  BlendTransition(TransitionKind::kSlideUp, from.data(), to.data(),
+                  out.data(), w, h, stride, 0.5);
+  EXPECT_EQ(out[0], (uint8_t)((from[3 * stride] * 128 + 128) >> 8));
+  EXPECT_EQ(out[3 * stride + 5],
+            (uint8_t)((to[5] * 128 + 128) >> 8));
+
+  // Timing follows the clock; the frame past the duration hands back to
+  // the caller without touching the output.
+  tono_overlay::ManualClock clock(1000);
+  LineTransition transition;
+  transition.Start(TransitionKind::kNone, 200, clock.NowMs(), from.data(),
+                   w, h, stride);
+  EXPECT_TRUE(!transition.active());
+  transition.Start(TransitionKind::kCrossfade, 200, clock.NowMs(),
+                   from.data(), w, h, stride);
+  EXPECT_TRUE(transition.active());
+  EXPECT_TRUE(transition.Frame(to.data(), out.data(), w, h, stride,
+                               clock.NowMs()));
+  EXPECT_TRUE(out == from);
+  clock.Advance(100);
+  EXPECT_TRUE(transition.Frame(to.data(), out.data(), w, h, stride,
+                               clock.NowMs()));
+  std::vector<uint8_t> eased(n);
+  BlendTransition(TransitionKind::kCrossfade, from.data(), to.data(),
+                  eased.data(), w, h, stride,
+                  tono_overlay::EaseTransition(0.5));
+  EXPECT_TRUE(out == eased);
+  clock.Advance(100);
+  out.assign(n, 9);
+  EXPECT_TRUE(!transition.Frame(to.data(), out.data(), w, h, stride,
+                                clock.NowMs()));
+  EXPECT_TRUE(!transition.active());
+  EXPECT_EQ(out[0], 9);
+
+  // A new line of another size (a layout change) ends it at once.
+  transition.Start(TransitionKind::kScale, 200, clock.NowMs(), from.data(),
+                   w, h, stride);
+  EXPECT_TRUE(!transition.Frame(to.data(), out.data(), w, h - 1, stride,
+                                clock.NowMs()));
+  EXPECT_TRUE(!transition.active());
+}
+
+void TestLineTransitionKeepsPlateStill() {
+  using tono_overlay::BlendTransition;
+  using tono_overlay::TransitionKind;
+  const int w = 23, h = 12;
+  const size_t stride = (size_t)w * 4;
+  const size_t n = stride * h;
+  CompositeParams p;
+  p.background = {{40, 80, 120}, 190, 4};
+  std::vector<uint8_t> plate(n);
+  tono_overlay::RenderBackgroundPlate(p.background, p.format, w, h,
+                                      plate.data(), stride);
+  std::mt19937 rng(31);
+  std::vector<uint8_t> fill = ToA8(RandomMask(rng, (size_t)w * h));
+  std::vector<uint8_t> from(n), to(n), out(n);
+  tono_overlay::CompositeLayer(fill.data(), nullptr, from.data(), w, h, 0, w,
+                               p);
+  fill = ToA8(RandomMask(rng, (size_t)w * h));
+  tono_overlay::CompositeLayer(fill.data(), nullptr, to.data(), w, h, 0, w,
+                               p);
+
+  // Only the text moves: two empty lines blend to the plate at any
+  // progress, and the ends are still the lines themselves.
+  const TransitionKind kinds[] = {TransitionKind::kCrossfade,
+                                  TransitionKind::kSlideUp,
+                                  TransitionKind::kScale};
+  for (TransitionKind kind : kinds) {
+    for (double progress : {0.2, 0.5, 0.9}) {
+      BlendTransition(kind, plate.data(), plate.data(), out.data(), w, h,
+                      stride, progress, plate.data());
+      EXPECT_TRUE(out == plate);
+    }
+    BlendTransition(kind, from.data(), to.data(), out.data(), w, h, stride,
+                    0.0, plate.data());
+    EXPECT_TRUE(out == from);
+    BlendTransition(kind, from.data(), to.data(), out.data(), w, h, stride,
+                    1.0, plate.data());
+    EXPECT_TRUE(out == to);
+  }
+
+  // LineTransition renders the plate itself from the style's.
+  tono_overlay::ManualClock clock(0);
+  tono_overlay::LineTransition transition;
+  transition.Start(TransitionKind::kSlideUp, 100, clock.NowMs(), plate.data(),
+                   w, h, stride, p.background, p.format);
+  clock.Advance(50);
+  EXPECT_TRUE(transition.Frame(plate.data(), out.data(), w, h, stride,
+                               clock.NowMs()));
+  EXPECT_TRUE(out == plate);
+}
+
+void TestMarqueeMotionPingPongs() {
+  using tono_overlay::Marquee;
+  using tono_overlay::MarqueeMotion;
+  // 40 px of overflow at 40 px/s: one second each way, with 1 s rests.
+  MarqueeMotion motion;
+  motion.speed = 40;
+  motion.pause_ms = 1000;
+  Marquee marquee;
+  marquee.SetMotion(motion, 0);
+  marquee.Start(100, 60, 10, 0);
+  EXPECT_TRUE(marquee.active());
+  EXPECT_EQ(marquee.Offset(0), 0);
+  EXPECT_EQ(marquee.Offset(999), 0);
+  EXPECT_EQ(marquee.Offset(1500), 20 * 256);
+  EXPECT_EQ(marquee.Offset(2000), 40 * 256);
+  EXPECT_EQ(marquee.Offset(2500), 40 * 256);
+  EXPECT_EQ(marquee.Offset(3500), 20 * 256);
+  EXPECT_EQ(marquee.Offset(4000), 0);
+  // A long gap skips whole cycles.
+  EXPECT_EQ(marquee.Offset(405500), 20 * 256);
+  // Sub-pixel steps.
+  EXPECT_EQ(marquee.Offset(405525), 20 * 256 + 256);
+  EXPECT_EQ(marquee.Offset(405512), 20 * 256 + 123);
+
+  // A new speed carries on from the current offset.
+  marquee.Start(100, 60, 10, 0);
+  EXPECT_EQ(marquee.Offset(1500), 20 * 256);
+  motion.speed = 80;
+  marquee.SetMotion(motion, 1500);
+  EXPECT_EQ(marquee.Offset(1500), 20 * 256);
+  EXPECT_EQ(marquee.Offset(1625), 30 * 256);
+  EXPECT_EQ(marquee.Offset(1750), 40 * 256);
+
+  // A strip that fits does not scroll.
+  marquee.Start(60, 60, 10, 0);
+  EXPECT_TRUE(!marquee.active());
+  EXPECT_EQ(marquee.Offset(1500), 0);
+}
+
+void TestMarqueeBlitsWindow() {
+  using tono_overlay::BlitMarquee;
+  using tono_overlay::Marquee;
+  // A 3 x 1 strip seen through a 2 x 1 window.
+  const uint8_t strip[12] = {0,   0,   0,   0,   200, 200,
+                             200, 200, 100, 100, 100, 100};
+  uint8_t out[8];
+  BlitMarquee(strip, 12, out, 2, 1, 8, 0);
+  EXPECT_TRUE(std::memcmp(out, strip, 8) == 0);
+  BlitMarquee(strip, 12, out, 2, 1, 8, 256);
+  EXPECT_TRUE(std::memcmp(out, strip + 4, 8) == 0);
+  // Half a pixel in blends the neighbors.
+  BlitMarquee(strip, 12, out, 2, 1, 8, 128);
+  EXPECT_EQ(out[0], 100);
+  EXPECT_EQ(out[3], 100);
+  EXPECT_EQ(out[4], 150);
+  EXPECT_EQ(out[7], 150);
+  // The plate shows through where the text is transparent.
+  const uint8_t plate[8] = {10, 20, 30, 40, 10, 20, 30, 40};
+  BlitMarquee(strip, 12, out, 2, 1, 8, 0, plate);
+  EXPECT_TRUE(std::memcmp(out, plate, 4) == 0);
+  EXPECT_EQ(out[4], 202);
+  EXPECT_EQ(out[7], 209);
+
+  // Frames are only drawn when the window moved or was invalidated.
+  Marquee marquee;
+  marquee.Start(3, 2, 1, 0);
+  std::memset(out, 0xEE, sizeof(out));
+  EXPECT_TRUE(marquee.Frame(strip, out, 0));
+  EXPECT_TRUE(std::memcmp(out, strip, 8) == 0);
+  EXPECT_TRUE(!marquee.NeedsFrame(10));
+  EXPECT_TRUE(!marquee.Frame(strip, out, 10));
+  marquee.Invalidate();
+  EXPECT_TRUE(marquee.NeedsFrame(10));
+  EXPECT_TRUE(marquee.Frame(strip, out, 10));
+  // After the rest, 40 px/s moves the window a pixel in 25 ms.
+  const tono_overlay::MarqueeMotion motion;
+  EXPECT_TRUE(marquee.Frame(strip, out, motion.pause_ms + 25));
+  EXPECT_TRUE(std::memcmp(out, strip + 4, 8) == 0);
+  marquee.Stop();
+  EXPECT_TRUE(!marquee.Frame(strip, out, motion.pause_ms + 50));
+}
+
+void TestOverlayStateDirtyStages() {
+  using namespace tono_overlay;
+  OverlayState state;
+  // Setting the current value is a no-op.
+  EXPECT_TRUE(!state.SetTextColor(0xFFFFFF));
+  EXPECT_TRUE(!state.SetFontSize(14));
+  EXPECT_EQ(state.version(), (uint64_t)0);
+  EXPECT_EQ(state.TakeDirtyStages(), 0u);
+
+  // Colors only recomposite and present.
+  EXPECT_TRUE(state.SetTextColor(0x123456));
+  EXPECT_EQ(state.version(), (uint64_t)1);
+  EXPECT_EQ(state.TakeDirtyStages(),
+            (uint32_t)(kStageComposite | kStagePresent));
+  EXPECT_EQ(state.TakeDirtyStages(), 0u);
+
+  // Position only moves the window.
+  EXPECT_TRUE(state.SetPosition(5, 6));
+  EXPECT_EQ(state.TakeDirtyStages(), (uint32_t)kStageWindow);
+
+  // The background plate is composited with the text, so it recomposites.
+  EXPECT_TRUE(state.SetBackgroundAlpha(300));
+  EXPECT_EQ(state.style().background_alpha, 255);
+  EXPECT_TRUE(state.SetBackgroundColor(0x203040));
+  EXPECT_TRUE(state.SetCornerRadius(1000));
+  EXPECT_EQ(state.style().corner_radius, OverlayState::kMaxCornerRadius);
+  EXPECT_TRUE(!state.SetCornerRadius(OverlayState::kMaxCornerRadius));
+  EXPECT_EQ(state.TakeDirtyStages(),
+            (uint32_t)(kStageComposite | kStagePresent));
+
+  // A font change runs the whole pipeline.
+  EXPECT_TRUE(state.SetFontWeight(750));
+  EXPECT_TRUE(state.style().font_bold);
+  EXPECT_EQ(state.TakeDirtyStages(),
+            (uint32_t)(kStageFont | kStageLayout | kStageRaster |
+                       kStageComposite | kStagePresent));
+  EXPECT_TRUE(!state.SetFontWeight(750));
+  EXPECT_TRUE(state.SetBold(false));
+  EXPECT_EQ(state.style().font_weight, 400);
+
+  // Stroke width re-rasterizes but keeps the layout; clamped to the max.
+  state.TakeDirtyStages();
+  EXPECT_TRUE(state.SetStrokeWidth(99));
+  EXPECT_EQ(state.style().stroke_width, OverlayState::kMaxStrokeWidth);
+  EXPECT_EQ(state.TakeDirtyStages(),
+            (uint32_t)(kStageRaster | kStageComposite | kStagePresent));
+
+  // Changes the runner already applied can be marked clean.
+  EXPECT_TRUE(state.SetPosition(7, 8));
+  state.MarkClean(kFieldPosition);
+  EXPECT_EQ(state.dirty_fields(), 0u);
+}
+
+void TestOverlayStyleDecoderTransaction() {
+  using namespace tono_overlay;
+  OverlayState state;
+  OverlayStyleUpdate update;
+  std::string error;
+  // Native numbers, and the strings older Dart builds sent.
+  EXPECT_TRUE(update.Decode("fontSize", StyleValue::String("20"), &error));
+  EXPECT_TRUE(update.Decode("fontWeight", StyleValue::String("Bold"), &error));
+  EXPECT_TRUE(update.Decode("textColor", StyleValue::String("#102030"),
+                            &error));
+  EXPECT_TRUE(update.Decode("strokeColor", StyleValue::Number(0xABCDEF),
+                            &error));
+  EXPECT_TRUE(update.Decode("textAlign", StyleValue::String("center"),
+                            &error));
+  EXPECT_TRUE(update.Decode("bold", StyleValue::Bool(false), &error));
+  EXPECT_TRUE(update.Decode("x", StyleValue::String("-40"), &error));
+  EXPECT_TRUE(update.Decode("y", StyleValue::Number(12), &error));
+
+  // Invalid values are rejected without touching the update.
+  EXPECT_TRUE(!update.Decode("fontSize", StyleValue::String("big"), &error));
+  EXPECT_TRUE(error.find("fontSize") != std::string::npos);
+  EXPECT_TRUE(!update.Decode("lines", StyleValue::String("0"), &error));
+  EXPECT_TRUE(!update.Decode("textColor", StyleValue::String("#12345g"),
+                             &error));
+  EXPECT_TRUE(!update.Decode("fontFamily", StyleValue::Number(3), &error));
+  EXPECT_TRUE(!update.Decode("nope", StyleValue::String("1"), &error));
+  EXPECT_TRUE(!update.has("lines"));
+  EXPECT_EQ(state.version(), (uint64_t)0);
+
+  // One transaction: every field lands, and the stages are the union.
+  EXPECT_TRUE(update.ApplyTo(&state));
+  const OverlayStyle& style = state.style();
+  EXPECT_EQ(style.font_size, 20);
+  // fontWeight supersedes bold.
+  EXPECT_EQ(style.font_weight, 700);
+  EXPECT_TRUE(style.font_bold);
+  EXPECT_EQ(style.text_color, 0x102030u);
+  EXPECT_EQ(style.stroke_color, 0xABCDEFu);
+  EXPECT_EQ(style.text_align, 1);
+  EXPECT_EQ(style.x, -40);
+  EXPECT_EQ(style.y, 12);
+  EXPECT_EQ(state.TakeDirtyStages(),
+            (uint32_t)(kStageFont | kStageLayout | kStageRaster |
+                       kStageComposite | kStagePresent | kStageWindow));
+
+  // Re-applying the same batch is a no-op.
+  EXPECT_TRUE(!update.ApplyTo(&state));
+  EXPECT_EQ(state.TakeDirtyStages(), 0u);
+
+  OverlayStyleUpdate names;
+  EXPECT_TRUE(names.Decode("fontWeight", StyleValue::String("粗"), &error));
+  EXPECT_TRUE(names.Decode("bold", StyleValue::String("0"), &error));
+  EXPECT_TRUE(names.Decode("textColor", StyleValue::String("0xff00ff00"),
+                           &error));
+  EXPECT_TRUE(names.Decode("fontFamily", StyleValue::String("Noto Sans"),
+                           &error));
+  EXPECT_TRUE(names.ApplyTo(&state));
+  EXPECT_EQ(state.style().text_color, 0x00FF00u);
+  EXPECT_EQ(state.style().font_family, std::string("Noto Sans"));
+
+  // The line transition is read when the next line arrives; it needs no
+  // render stage.
+  state.TakeDirtyStages();
+  OverlayStyleUpdate transition;
+  EXPECT_TRUE(transition.Decode("transition", StyleValue::String("slideUp"),
+                                &error));
+  EXPECT_TRUE(transition.Decode("transitionMs", StyleValue::Number(9000),
+                                &error));
+  EXPECT_TRUE(!transition.Decode("transition", StyleValue::String("spin"),
+                                 &error));
+  EXPECT_TRUE(transition.ApplyTo(&state));
+  EXPECT_TRUE(state.style().transition == TransitionKind::kSlideUp);
+  EXPECT_EQ(state.style().transition_ms, OverlayState::kMaxTransitionMs);
+  EXPECT_EQ(state.dirty_fields(), (uint32_t)kFieldTransition);
+  EXPECT_EQ(state.TakeDirtyStages(), 0u);
+
+  // Turning the marquee on redraws the line into a strip; its motion is
+  // read every frame.
+  OverlayStyleUpdate marquee;
+  EXPECT_TRUE(marquee.Decode("marquee", StyleValue::String("true"), &error));
+  EXPECT_TRUE(!marquee.Decode("marqueeSpeed", StyleValue::Number(0), &error));
+  EXPECT_TRUE(marquee.ApplyTo(&state));
+  EXPECT_TRUE(state.style().marquee);
+  EXPECT_EQ(state.TakeDirtyStages(),
+            (uint32_t)(kStageRaster | kStageComposite | kStagePresent));
+  OverlayStyleUpdate motion;
+  EXPECT_TRUE(motion.Decode("marqueeSpeed", StyleValue::String("90000"),
+                            &error));
+  EXPECT_TRUE(motion.Decode("marqueePauseMs", StyleValue::Number(250),
+                            &error));
+  EXPECT_TRUE(motion.ApplyTo(&state));
+  EXPECT_EQ(state.style().marquee_speed, OverlayState::kMaxMarqueeSpeed);
+  EXPECT_EQ(state.style().marquee_pause_ms, 250);
+  EXPECT_EQ(state.dirty_fields(), (uint32_t)kFieldMarqueeMotion);
+  EXPECT_EQ(state.TakeDirtyStages(), 0u);
+
+  // Arguments that are not style fields go through the same scalar paths,
+  // native or as strings.
+  int position = -1;
+  EXPECT_TRUE(StyleValueToInt(StyleValue::Number(1500.4), &position));
+  EXPECT_EQ(position, 1500);
+  EXPECT_TRUE(StyleValueToInt(StyleValue::String("42"), &position));
+  EXPECT_EQ(position, 42);
+  EXPECT_TRUE(!StyleValueToInt(StyleValue::String("42ms"), &position));
+  EXPECT_TRUE(!StyleValueToInt(StyleValue::Bool(true), &position));
+  EXPECT_EQ(position, 42);
+  bool playing = false;
+  EXPECT_TRUE(StyleValueToBool(StyleValue::Bool(true), &playing));
+  EXPECT_TRUE(playing);
+  EXPECT_TRUE(StyleValueToBool(StyleValue::String("False"), &playing));
+  EXPECT_TRUE(!playing);
+  EXPECT_TRUE(!StyleValueToBool(StyleValue::String("maybe"), &playing));
+  double rate = 0;
+  EXPECT_TRUE(StyleValueToNumber(StyleValue::String("1.25"), &rate));
+  EXPECT_TRUE(rate == 1.25);
+  EXPECT_TRUE(!StyleValueToNumber(StyleValue::Bool(true), &rate));
+}
+
+// Channel arguments for the style decoding: a map of scalars, a bare
+// scalar, or none. A key mapped to nullopt holds a value that is not a
+// scalar; "" stands for a key that is not a string.
+class FakeStyleArgs : public tono_overlay::StyleArgs {
+ public:
+  using Entry =
+      std::pair<std::string, std::unique_ptr<tono_overlay::StyleValue>>;
+
+  static FakeStyleArgs Map() { return FakeStyleArgs(true); }
+  static FakeStyleArgs Bare(tono_overlay::StyleValue value) {
+    FakeStyleArgs args(false);
+    args.bare_ = std::make_unique<tono_overlay::StyleValue>(std::move(value));
+    return args;
+  }
+
+  FakeStyleArgs& Add(std::string key, tono_overlay::StyleValue value) {
+    entries_.emplace_back(std::move(key),
+                          std::make_unique<tono_overlay::StyleValue>(
+                              std::move(value)));
+    return *this;
+  }
+  FakeStyleArgs& AddUnsupported(std::string key) {
+    entries_.emplace_back(std::move(key), nullptr);
+    return *this;
+  }
+
+  bool IsMap() const override { return is_map_; }
+  Lookup Find(const char* key, tono_overlay::StyleValue* value) const override {
+    for (const Entry& entry : entries_) {
+      if (entry.first == key) return Copy(entry.second.get(), value);
+    }
+    return Lookup::kMissing;
+  }
+  Lookup Self(tono_overlay::StyleValue* value) const override {
+    if (!bare_) return Lookup::kMissing;
+    *value = *bare_;
+    return Lookup::kFound;
+  }
+  void ForEach(const EntryVisitor& visit) const override {
+    for (const Entry& entry : entries_) {
+      tono_overlay::StyleValue value;
+      const Lookup lookup = Copy(entry.second.get(), &value);
+      if (!visit(entry.first.empty() ? nullptr : entry.first.c_str(), lookup,
+                 value)) {
+        return;
+      }
+    }
+  }
+
+ private:
+  explicit FakeStyleArgs(bool is_map) : is_map_(is_map) {}
+
+  static Lookup Copy(const tono_overlay::StyleValue* from,
+                     tono_overlay::StyleValue* to) {
+    if (!from) return Lookup::kUnsupported;
+    *to = *from;
+    return Lookup::kFound;
+  }
+
+  bool is_map_;
+  std::vector<Entry> entries_;
+  std::unique_ptr<tono_overlay::StyleValue> bare_;
+};
+
+void TestStyleSettersShareTheDecoder() {
+  using namespace tono_overlay;
+  EXPECT_TRUE(FindStyleSetter("setLyricsBogus") == nullptr);
+  const StyleSetter* font_size = FindStyleSetter("setLyricsFontSize");
+  const StyleSetter* stroke = FindStyleSetter("setLyricsStroke");
+  EXPECT_TRUE(font_size != nullptr && stroke != nullptr);
+  if (!font_size || !stroke) return;
+
+  // A one-field setter takes its key from a map, or the bare value.
+  OverlayState state;
+  OverlayStyleUpdate update;
+  std::string error;
+  EXPECT_TRUE(DecodeStyleSetter(
+      *font_size,
+      FakeStyleArgs::Map().Add("fontSize", StyleValue::Number(30)), &update,
+      &error));
+  EXPECT_TRUE(update.has("fontSize"));
+  update.Clear();
+  EXPECT_TRUE(DecodeStyleSetter(*font_size,
+                                FakeStyleArgs::Bare(StyleValue::String("31")),
+                                &update, &error));
+  EXPECT_TRUE(update.ApplyTo(&state));
+  EXPECT_EQ(state.style().font_size, 31);
+
+  // A missing key, or a value no scalar holds, gives the usage alone; a
+  // value the field rejects adds why.
+  update.Clear();
+  EXPECT_TRUE(!DecodeStyleSetter(*font_size, FakeStyleArgs::Map(), &update,
+                                 &error));
+  EXPECT_EQ(error, std::string("Expected {fontSize: int}"));
+  EXPECT_TRUE(!DecodeStyleSetter(
+      *font_size, FakeStyleArgs::Map().AddUnsupported("fontSize"), &update,
+      &error));
+  EXPECT_EQ(error, std::string("Expected {fontSize: int}"));
+  EXPECT_TRUE(!DecodeStyleSetter(
+      *font_size,
+      FakeStyleArgs::Map().Add("fontSize", StyleValue::Number(-1)), &update,
+      &error));
+  EXPECT_EQ(error, std::string("Expected {fontSize: int} "
+                               "(fontSize: expected an integer in 0..1000)"));
+
+  // A setter with several fields needs the map, with every key.
+  update.Clear();
+  EXPECT_TRUE(!DecodeStyleSetter(
+      *stroke, FakeStyleArgs::Bare(StyleValue::Number(2)), &update, &error));
+  EXPECT_TRUE(!DecodeStyleSetter(
+      *stroke, FakeStyleArgs::Map().Add("width", StyleValue::Number(2)),
+      &update, &error));
+  EXPECT_EQ(error.rfind("Expected {width: int>=0, color: int 0xRRGGBB}", 0),
+            0u);
+  update.Clear();
+  EXPECT_TRUE(DecodeStyleSetter(
+      *stroke,
+      FakeStyleArgs::Map()
+          .Add("width", StyleValue::Number(3))
+          .Add("color", StyleValue::String("#102030")),
+      &update, &error));
+  EXPECT_TRUE(update.ApplyTo(&state));
+  EXPECT_EQ(state.style().stroke_width, 3);
+  EXPECT_EQ(state.style().stroke_color, 0x102030u);
+}
+
+void TestStyleMapDecoding() {
+  using namespace tono_overlay;
+  OverlayStyleUpdate update;
+  std::string error;
+  EXPECT_TRUE(!DecodeStyleMap(FakeStyleArgs::Bare(StyleValue::Number(1)),
+                              &update, &error));
+  EXPECT_EQ(error, std::string("Expected a map of style fields"));
+
+  // "id" addresses the overlay and is not a field.
+  EXPECT_TRUE(DecodeStyleMap(FakeStyleArgs::Map()
+                                 .Add("id", StyleValue::Number(2))
+                                 .Add("fontSize", StyleValue::Number(28))
+                                 .Add("bold", StyleValue::Bool(true)),
+                             &update, &error));
+  EXPECT_TRUE(update.has("fontSize") && update.has("bold"));
+  EXPECT_TRUE(!update.has("id"));
+
+  update.Clear();
+  EXPECT_TRUE(!DecodeStyleMap(
+      FakeStyleArgs::Map().Add("", StyleValue::Number(1)), &update, &error));
+  EXPECT_EQ(error, std::string("Style field names must be strings"));
+  EXPECT_TRUE(!DecodeStyleMap(FakeStyleArgs::Map().AddUnsupported("lines"),
+                              &update, &error));
+  EXPECT_EQ(error, std::string("lines: unsupported value type"));
+  EXPECT_TRUE(!DecodeStyleMap(
+      FakeStyleArgs::Map().Add("lines", StyleValue::Number(0)), &update,
+      &error));
+  EXPECT_EQ(error.rfind("lines: expected an integer", 0), 0u);
+  EXPECT_TRUE(!DecodeStyleMap(
+      FakeStyleArgs::Map().Add("fontColour", StyleValue::Number(0)), &update,
+      &error));
+  EXPECT_TRUE(!error.empty());
+}
+
+void TestLatencyHistogramPercentiles() {
+  using tono_overlay::LatencyHistogram;
+  using tono_overlay::LatencySummary;
+  using tono_overlay::OverlayStats;
+  using tono_overlay::TimingStage;
+  // Bucket edges: below 1 us, then 8 buckets per power of two.
+  EXPECT_EQ(LatencyHistogram::BucketFor(0), 0);
+  EXPECT_EQ(LatencyHistogram::BucketFor(1023), 0);
+  EXPECT_EQ(LatencyHistogram::BucketFor(1024), 1);
+  EXPECT_EQ(LatencyHistogram::BucketFor(1151), 1);
+  EXPECT_EQ(LatencyHistogram::BucketFor(1152), 2);
+  EXPECT_EQ(LatencyHistogram::BucketFor(2048), 9);
+  EXPECT_EQ(LatencyHistogram::BucketFor(INT64_MAX),
+            LatencyHistogram::kBucketCount - 1);
+  for (int i = 0; i + 1 < LatencyHistogram::kBucketCount; ++i) {
+    const int64_t limit = LatencyHistogram::BucketLimitNs(i);
+    EXPECT_EQ(LatencyHistogram::BucketFor(limit - 1), i);
+    EXPECT_EQ(LatencyHistogram::BucketFor(limit), i + 1);
+  }
+
+  // 1..1000 us, once each: every percentile within one bucket (12.5%)
+  // above the exact value.
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.Summary().count, (uint64_t)0);
+  for (int us = 1; us <= 1000; ++us) histogram.Record((int64_t)us * 1000);
+  LatencySummary summary = histogram.Summary();
+  EXPECT_EQ(summary.count, (uint64_t)1000);
+  EXPECT_TRUE(summary.mean_us > 500.4 && summary.mean_us < 500.6);
+  EXPECT_TRUE(summary.p50_us >= 500 && summary.p50_us <= 500 * 1.125);
+  EXPECT_TRUE(summary.p95_us >= 950 && summary.p95_us <= 950 * 1.125);
+  EXPECT_TRUE(summary.p99_us >= 990 && summary.p99_us <= 1000);
+  EXPECT_TRUE(summary.max_us == 1000);
+  histogram.Reset();
+  EXPECT_EQ(histogram.Summary().count, (uint64_t)0);
+
+  // Concurrent recorders lose nothing.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&histogram, t] {
+      for (int i = 0; i < 10000; ++i) histogram.Record(1000 * (t + 1));
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  summary = histogram.Summary();
+  EXPECT_EQ(summary.count, (uint64_t)40000);
+  EXPECT_TRUE(summary.max_us == 4);
+
+  // Stage timers land in the global table, which resets as a whole.
+  OverlayStats& stats = OverlayStats::Global();
+  stats.Reset();
+  { tono_overlay::ScopedStageTimer timer(TimingStage::kPresent); }
+  EXPECT_EQ(stats.Summary(TimingStage::kPresent).count, (uint64_t)1);
+  EXPECT_EQ(stats.Summary(TimingStage::kFont).count, (uint64_t)0);
+  EXPECT_EQ(std::string(tono_overlay::TimingStageName(TimingStage::kUpdate)),
+            std::string("update"));
+  stats.Reset();
+  EXPECT_EQ(stats.Summary(TimingStage::kPresent).count, (uint64_t)0);
+}
+
+size_t CountOccurrences(const std::string& text, const std::string& what) {
+  size_t count = 0;
+  for (size_t pos = text.find(what); pos != std::string::npos;
+       pos = text.find(what, pos + what.size())) {
+    ++count;
+  }
+  return count;
+}
+
+void TestOverlayTracerWritesTraceEvents() {
+  using tono_overlay::OverlayTracer;
+  std::string path;
+  EXPECT_TRUE(tono_overlay::ParseTraceFlag("--overlay-trace=/tmp/t.json",
+                                           &path));
+  EXPECT_EQ(path, std::string("/tmp/t.json"));
+  EXPECT_TRUE(!tono_overlay::ParseTraceFlag("--overlay-trace", &path));
+  EXPECT_TRUE(!tono_overlay::ParseTraceFlag("--overlay-trace=", &path));
+  EXPECT_TRUE(!tono_overlay::ParseTraceFlag("--overlay-tracer=x", &path));
+
+  // Nothing is kept while tracing is off.
+  OverlayTracer tracer;
+  tracer.Complete("channel", "ignored", 1000, 2000);
+  std::ostringstream empty;
+  tracer.WriteJson(empty);
+  EXPECT_EQ(CountOccurrences(empty.str(), "ignored"), (size_t)0);
+
+  tracer.Start("");
+  tracer.SetThreadName("platform");
+  tracer.Complete("channel", "setLyricsText", 1500, 4250);
+  tracer.Instant("window", "move", 5000, "x", -20, "y", 300);
+  tracer.Complete("channel", "a \"quoted\"\nname", 6000, 6000);
+  std::thread worker([&tracer] {
+    tracer.SetThreadName("overlay render");
+    for (int i = 0; i < 3; ++i) tracer.Complete("overlay", "render", i, i);
+  });
+  worker.join();
+  std::ostringstream out;
+  tracer.WriteJson(out);
+  const std::string json = out.str();
+  EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), (size_t)0);
+  EXPECT_TRUE(json.find("\"name\":\"setLyricsText\",\"cat\":\"channel\","
+                        "\"ph\":\"X\",\"ts\":1.500,\"dur\":2.750") !=
+              std::string::npos);
+  EXPECT_TRUE(json.find("\"ph\":\"i\",\"ts\":5.000,\"s\":\"t\"") !=
+              std::string::npos);
+  EXPECT_TRUE(json.find("\"args\":{\"x\":-20,\"y\":300}") !=
+              std::string::npos);
+  EXPECT_TRUE(json.find("a \\\"quoted\\\"\\u000aname") !=
+              std::string::npos);
+  EXPECT_EQ(CountOccurrences(json, "\"name\":\"render\""), (size_t)3);
+  EXPECT_EQ(CountOccurrences(json, "\"thread_name\""), (size_t)2);
+  EXPECT_TRUE(json.find("\"tid\":2") != std::string::npos);
+  EXPECT_EQ(CountOccurrences(json, "\"ph\":"), (size_t)8);
+
+  // A new session starts empty; a full buffer drops and counts.
+  tracer.Stop();
+  tracer.Start("");
+  std::string long_name(OverlayTracer::kMaxNameBytes + 10, 'n');
+  for (size_t i = 0; i < OverlayTracer::kEventsPerThread + 5; ++i) {
+    tracer.Complete("overlay", long_name, 0, 1);
+  }
+  EXPECT_EQ(tracer.dropped(), (uint64_t)5);
+  std::ostringstream full;
+  tracer.WriteJson(full);
+  EXPECT_EQ(CountOccurrences(full.str(), "setLyricsText"), (size_t)0);
+  EXPECT_EQ(CountOccurrences(
+                full.str(), std::string(OverlayTracer::kMaxNameBytes, 'n') +
+                                "\""),
+            OverlayTracer::kEventsPerThread);
+  EXPECT_TRUE(tracer.Stop());
+}
+
+// One character per position of |text|: 'x' no break, '/' allowed, '!'
+// mandatory.
+std::string BreakString(const std::u32string& text) {
+  std::vector<tono_overlay::LineBreakClass> classes;
+  for (char32_t c : text) {
+    classes.push_back(tono_overlay::LineBreakClassOf((uint32_t)c));
+  }
+  std::vector<tono_overlay::BreakAction> breaks;
+  tono_overlay::FindLineBreaks(classes.data(), classes.size(), &breaks);
+  std::string out;
+  for (tono_overlay::BreakAction action : breaks) {
+    out += action == tono_overlay::BreakAction::kProhibited ? 'x'
+           : action == tono_overlay::BreakAction::kAllowed  ? '/'
+                                                            : '!';
+  }
+  return out;
+}
+
+void TestLineBreakerRules() {
+  using tono_overlay::LineBreakClass;
+  using tono_overlay::LineBreakClassOf;
+  EXPECT_TRUE(LineBreakClassOf('a') == LineBreakClass::kAL);
+  EXPECT_TRUE(LineBreakClassOf(0x3002) == LineBreakClass::kCL);
+  EXPECT_TRUE(LineBreakClassOf(0x3063) == LineBreakClass::kNS);
+  EXPECT_TRUE(LineBreakClassOf(0x30FC) == LineBreakClass::kNS);
+  EXPECT_TRUE(LineBreakClassOf(0x6B4C) == LineBreakClass::kID);
+  EXPECT_TRUE(LineBreakClassOf(0xAC00) == LineBreakClass::kID);
+  EXPECT_TRUE(LineBreakClassOf(0x1F600) == LineBreakClass::kID);
+  EXPECT_TRUE(LineBreakClassOf(0x0301) == LineBreakClass::kCM);
+  EXPECT_TRUE(LineBreakClassOf(0x0416) == LineBreakClass::kAL);
+
+  EXPECT_EQ(BreakString(U"ab cd"), std::string("xxx/x!"));
+  EXPECT_EQ(BreakString(U"a\nb"), std::string("xx!!"));
+  EXPECT_EQ(BreakString(U"a\r\nb"), std::string("xxx!!"));
+  EXPECT_EQ(BreakString(U"e\u0301"), std::string("xx!"));
+  EXPECT_EQ(BreakString(U"12.5%"), std::string("xxxxx!"));
+  EXPECT_EQ(BreakString(U"a-b"), std::string("xx/!"));
+  EXPECT_EQ(BreakString(U"a\u200Bb"), std::string("xx/!"));
+  EXPECT_EQ(BreakString(U"a\u00A0b"), std::string("xxx!"));
+  // Ideographs break anywhere, but never before 。 or small kana, and
+  // never after an opening bracket (kinsoku).
+  EXPECT_EQ(BreakString(U"日本語。"), std::string("x//x!"));
+  EXPECT_EQ(BreakString(U"ちょっと"), std::string("xxx/!"));
+  EXPECT_EQ(BreakString(U"歌「歌」歌"),
+            std::string("x/xx/!"));
+  // Flags pair up; a skin tone stays on its emoji.
+  EXPECT_EQ(BreakString(U"\U0001F1EF\U0001F1F5\U0001F1FA\U0001F1F8"),
+            std::string("xx/x!"));
+  EXPECT_EQ(BreakString(U"\U0001F44D\U0001F3FD\U0001F44D"),
+            std::string("xx/!"));
+}
+
+// Every glyph is 10 px wide; the glyph index is the code point.
+class FakeGlyphSource : public tono_overlay::GlyphSource {
+ public:
+  uint32_t GlyphIndex(uint32_t codepoint) override { return codepoint; }
+  int32_t GlyphAdvance(uint32_t) override { return 10 * 64; }
+};
+
+// Code points of line |index| of |layout| as UTF-32.
+std::u32string LineText(const tono_overlay::TextLayout& layout,
+                        size_t index) {
+  std::u32string text;
+  const tono_overlay::LayoutLine& line = layout.lines()[index];
+  for (size_t i = line.begin; i < line.end; ++i) {
+    text += (char32_t)layout.glyphs()[i].codepoint;
+  }
+  return text;
+}
+
+void TestTextLayoutWrapsAndCaches() {
+  FakeGlyphSource source;
+  tono_overlay::TextLayout layout;
+  tono_overlay::LayoutParams params;
+  params.max_width = 5 * 10 * 64;
+  params.max_lines = 3;
+  params.font_key = 1;
+
+  layout.Layout("aaa bbb ccc", params, &source);
+  EXPECT_EQ(layout.lines().size(), (size_t)3);
+  EXPECT_TRUE(LineText(layout, 0) == U"aaa");
+  EXPECT_TRUE(LineText(layout, 2) == U"ccc");
+  EXPECT_EQ(layout.lines()[1].width, 3 * 10 * 64);
+  EXPECT_EQ(layout.glyphs()[layout.lines()[1].begin].x, 0);
+  EXPECT_EQ(layout.shape_count(), (uint64_t)1);
+  // a, space, b, c and the ellipsis.
+  EXPECT_EQ(layout.advance_cache().misses(), (uint64_t)5);
+
+  // Width and alignment only refit the measured glyphs.
+  params.max_width = 8 * 10 * 64;
+  params.align = 2;
+  layout.Layout("aaa bbb ccc", params, &source);
+  EXPECT_EQ(layout.lines().size(), (size_t)2);
+  EXPECT_TRUE(LineText(layout, 0) == U"aaa bbb");
+  EXPECT_EQ(layout.glyphs()[layout.lines()[1].begin].x, 5 * 10 * 64);
+  params.align = 1;
+  layout.Layout("aaa bbb ccc", params, &source);
+  EXPECT_EQ(layout.glyphs()[0].x, 10 * 64 / 2);
+  layout.Layout("aaa bbb ccc", params, &source);
+  EXPECT_EQ(layout.shape_count(), (uint64_t)1);
+  layout.Layout("ccc bbb", params, &source);
+  EXPECT_EQ(layout.shape_count(), (uint64_t)2);
+  EXPECT_EQ(layout.advance_cache().misses(), (uint64_t)5);
+  params.font_key = 2;
+  layout.Layout("ccc bbb", params, &source);
+  EXPECT_EQ(layout.advance_cache().misses(), (uint64_t)9);
+
+  // Kinsoku: 。 does not start the second line, so え moves down with it.
+  params.max_width = 4 * 10 * 64;
+  params.max_lines = 2;
+  params.align = 0;
+  layout.Layout("\xE3\x81\x82\xE3\x81\x84\xE3\x81\x86\xE3\x81\x88"
+                "\xE3\x80\x82",
+                params, &source);
+  EXPECT_EQ(layout.lines().size(), (size_t)2);
+  EXPECT_TRUE(LineText(layout, 1) == U"え。");
+
+  // A word wider than the line is split, but not inside a cluster.
+  params.max_width = 5 * 10 * 64;
+  layout.Layout("abcde\xCC\x81" "f", params, &source);
+  EXPECT_TRUE(LineText(layout, 0) == U"abcd");
+  EXPECT_TRUE(LineText(layout, 1) == U"e\u0301f");
+
+  // Hard breaks are kept, and overflow ends in an ellipsis.
+  layout.Layout("ab\n\ncd", params, &source);
+  EXPECT_EQ(layout.lines().size(), (size_t)2);
+  EXPECT_TRUE(LineText(layout, 1) == U"…");
+  EXPECT_TRUE(layout.lines()[1].ellipsis);
+  params.max_lines = 1;
+  layout.Layout("ab\ncdefgh", params, &source);
+  EXPECT_EQ(layout.lines().size(), (size_t)1);
+  EXPECT_TRUE(LineText(layout, 0) == U"ab c…");
+  EXPECT_EQ(layout.lines()[0].width, 5 * 10 * 64);
+}
+
+// Opens a font for every family except "missing"; counts opens.
+class FakeFontFactory : public tono_overlay::FontFactory {
+ public:
+  explicit FakeFontFactory(int* opens) : opens_(opens) {}
+  std::unique_ptr<tono_overlay::FontInstance> Open(
+      const tono_overlay::FontKey& key) override {
+    ++*opens_;
+    if (key.family == "missing") return nullptr;
+    return std::make_unique<tono_overlay::FontInstance>();
+  }
+
+ private:
+  int* opens_;
+};
+
+void TestFontCacheEvictsLeastRecentlyUsed() {
+  int opens = 0;
+  tono_overlay::FontCache cache(std::make_unique<FakeFontFactory>(&opens),
+                                2);
+  tono_overlay::FontKey karaoke{"Noto Sans", 36, 700, 96};
+  tono_overlay::FontKey minimal{"Noto Sans", 20, 400, 96};
+  tono_overlay::FontKey hidpi = minimal;
+  hidpi.dpi = 144;
+  EXPECT_TRUE(tono_overlay::FontKeyHash(minimal) !=
+              tono_overlay::FontKeyHash(hidpi));
+
+  // Switching between two presets opens each font once.
+  auto first = cache.Get(karaoke);
+  EXPECT_TRUE(first != nullptr);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(cache.Get(minimal) != nullptr);
+    EXPECT_TRUE(cache.Get(karaoke) == first);
+  }
+  EXPECT_EQ(opens, 2);
+  tono_overlay::FontCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.misses, (uint64_t)2);
+  EXPECT_EQ(stats.hits, (uint64_t)19);
+  EXPECT_EQ(stats.entries, (size_t)2);
+
+  // A third key evicts the least recently used one (minimal); the
+  // evicted font stays valid for its holders.
+  auto held = cache.Get(minimal);
+  cache.Get(karaoke);
+  cache.Get(hidpi);
+  EXPECT_EQ(cache.stats().evictions, (uint64_t)1);
+  EXPECT_TRUE(held != nullptr);
+  EXPECT_TRUE(cache.Get(karaoke) == first);
+  EXPECT_TRUE(cache.Get(minimal) != held);
+  EXPECT_EQ(opens, 4);
+
+  // Failures are remembered.
+  tono_overlay::FontKey missing{"missing", 20, 400, 96};
+  EXPECT_TRUE(cache.Get(missing) == nullptr);
+  EXPECT_TRUE(cache.Get(missing) == nullptr);
+  EXPECT_EQ(opens, 5);
+
+  cache.ResetStats();
+  cache.Clear();
+  EXPECT_EQ(cache.stats().entries, (size_t)0);
+  EXPECT_EQ(cache.stats().hits, (uint64_t)0);
+}
+
+// Appends what the logger's flusher writes to a string the test owns, so
+// it outlives the logger. Read after Flush(), which orders it after the
+// writes.
+class MemoryLogSink : public tono_overlay::LogSink {
+ public:
+  explicit MemoryLogSink(std::string* out) : out_(out) {}
+  void Write(const char* data, size_t size) override {
+    out_->append(data, size);
+  }
+
+ private:
+  std::string* out_;
+};
+
+void TestAsyncLoggerConcurrentProducers() {
+  using namespace tono_overlay;
+  std::string text;
+  const int kThreads = 4;
+  const int kPerThread = 5000;
+  {
+    AsyncLogger logger(std::make_unique<MemoryLogSink>(&text), 256, 1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&logger, t] {
+        char line[32];
+        for (int i = 0; i < kPerThread; ++i) {
+          std::snprintf(line, sizeof(line), "t%d #%d", t, i);
+          logger.Log(LogLevel::kInfo, line);
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+    logger.Flush();
+    // Every record is either written or counted as dropped.
+    EXPECT_EQ(logger.written() + logger.dropped(),
+              (uint64_t)(kThreads * kPerThread));
+    EXPECT_TRUE(logger.written() > 0);
+
+    // Each thread's surviving records arrive in order and intact.
+    std::vector<int> last(kThreads, -1);
+    size_t lines = 0;
+    bool ordered = true;
+    size_t begin = 0;
+    while (begin < text.size()) {
+      size_t end = text.find('\n', begin);
+      const std::string line = text.substr(begin, end - begin);
+      begin = end + 1;
+      int t = -1, i = -1;
+      // "HH:MM:SS.mmm I t<thread> #<index>"
+      if (std::sscanf(line.c_str() + 15, "t%d #%d", &t, &i) == 2) {
+        ++lines;
+        if (line[13] != 'I' || t < 0 || t >= kThreads || i <= last[t]) {
+          ordered = false;
+        } else {
+          last[t] = i;
+        }
+      }
+    }
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ((uint64_t)lines, logger.written());
+    if (logger.dropped() > 0) {
+      EXPECT_TRUE(text.find("dropped") != std::string::npos);
+    }
+
+    // Disabled levels are rejected before touching the ring.
+    logger.SetMinLevel(LogLevel::kWarning);
+    EXPECT_TRUE(!logger.Log(LogLevel::kInfo, "skipped"));
+    EXPECT_TRUE(logger.Log(LogLevel::kError, "kept"));
+
+    // The macros go through the installed logger; long lines are cut.
+    SetOverlayLogger(&logger);
+    TONO_LOG(kWarning, "macro " << 42 << std::string(500, 'x'));
+    TONO_LOG(kInfo, "filtered");
+    SetOverlayLogger(nullptr);
+    TONO_LOG(kError, "no logger");
+    logger.Flush();
+  }
+  // The destructor drained everything.
+  EXPECT_TRUE(text.find("E kept\n") != std::string::npos);
+  EXPECT_TRUE(text.find("W macro 42xxx") != std::string::npos);
+  EXPECT_TRUE(text.find("filtered") == std::string::npos);
+  EXPECT_TRUE(text.find("no logger") == std::string::npos);
+  EXPECT_TRUE(text.find(std::string(
+                  AsyncLogger::kMaxMessageBytes - 8, 'x')) !=
+              std::string::npos);
+  EXPECT_TRUE(text.find(std::string(
+                  AsyncLogger::kMaxMessageBytes, 'x')) == std::string::npos);
+}
+
+void TestRenderThreadLatestWins() {
+  using namespace tono_overlay;
+  std::mutex gate_mutex;
+  std::condition_variable gate;
+  bool started = false;
+  bool released = false;
+  // Worker-side record of what was drawn and where.
+  std::vector<std::string> rendered_texts;
+  std::vector<RenderBuffer*> targets;
+  std::atomic<int> ready_calls{0};
+
+  RenderThread thread(
+      [&](const RenderSnapshot& snapshot, RenderBuffer* buffer) {
+        {
+          // The first render blocks until the burst has been posted.
+          std::unique_lock<std::mutex> lock(gate_mutex);
+          started = true;
+          gate.notify_all();
+          gate.wait(lock, [&] { return released; });
+        }
+        if (snapshot.text == "fail") return false;
+        if (!buffer->surfaces) {
+          buffer->surfaces.reset(new SurfacePool(
+              std::make_unique<MemorySurfaceAllocator>(), 1));
+        }
+        if (!buffer->surfaces->EnsureSize(snapshot.width, snapshot.height)) {
+          return false;
+        }
+        rendered_texts.push_back(snapshot.text);
+        targets.push_back(buffer);
+        return true;
+      },
+      [&] { ++ready_calls; });
+
+  auto post = [&thread](const std::string& text) {
+    RenderSnapshot snapshot;
+    snapshot.text = text;
+    snapshot.width = 8;
+    snapshot.height = 4;
+    thread.Post(std::move(snapshot));
+  };
+
+  // A burst of 1000 updates while a render is in flight costs two renders:
+  // the one in flight and the newest snapshot.
+  post("0");
+  {
+    std::unique_lock<std::mutex> lock(gate_mutex);
+    gate.wait(lock, [&] { return started; });
+  }
+  for (int i = 1; i < 1000; ++i) post(std::to_string(i));
+  {
+    std::lock_guard<std::mutex> lock(gate_mutex);
+    released = true;
+  }
+  gate.notify_all();
+  thread.WaitIdle();
+
+  RenderThreadStats stats = thread.stats();
+  EXPECT_EQ(stats.posted, (uint64_t)1000);
+  EXPECT_EQ(stats.rendered, (uint64_t)2);
+  EXPECT_EQ(stats.superseded, (uint64_t)998);
+  EXPECT_EQ(rendered_texts.size(), (size_t)2);
+  EXPECT_EQ(ready_calls.load(), 2);
+  // Frame "0" was never acquired, so "999" replaced it.
+  EXPECT_EQ(stats.discarded, (uint64_t)1);
+
+  RenderBuffer* front = thread.AcquireFrame();
+  EXPECT_TRUE(front != nullptr);
+  if (front) {
+    EXPECT_TRUE(front->snapshot->text == "999");
+    EXPECT_EQ(front->snapshot->sequence, (uint64_t)1000);
+  }
+  EXPECT_TRUE(thread.AcquireFrame() == nullptr);
+  EXPECT_TRUE(thread.front() == front);
+
+  // While the window thread holds the front buffer, the worker only draws
+  // into the other one.
+  for (int i = 0; i < 3; ++i) {
+    post("next " + std::to_string(i));
+    thread.WaitIdle();
+    EXPECT_TRUE(targets.back() != front);
+  }
+  RenderBuffer* next = thread.AcquireFrame();
+  EXPECT_TRUE(next != nullptr && next != front);
+  if (next) EXPECT_TRUE(next->snapshot->text == "next 2");
+
+  // A failed render is dropped and leaves the front alone.
+  post("fail");
+  thread.WaitIdle();
+  EXPECT_EQ(thread.stats().failed, (uint64_t)1);
+  EXPECT_TRUE(thread.AcquireFrame() == nullptr);
+  EXPECT_TRUE(thread.front() == next);
+  EXPECT_EQ(thread.stats().presented, (uint64_t)2);
+}
+
+void TestTransitionStartsOnAcquiredFrame() {
+  using namespace tono_overlay;
+  const int w = 8, h = 4;
+  // Each frame is filled with the first byte of its text.
+  RenderThread thread(
+      [&](const RenderSnapshot& snapshot, RenderBuffer* buffer) {
+        if (!buffer->surfaces) {
+          buffer->surfaces.reset(new SurfacePool(
+              std::make_unique<MemorySurfaceAllocator>(), 1));
+        }
+        if (!buffer->surfaces->EnsureSize(snapshot.width, snapshot.height)) {
+          return false;
+        }
+        Surface* out = buffer->surfaces->surface(0);
+        std::memset(out->data(), snapshot.text[0], out->size_bytes());
+        return true;
+      },
+      [] {});
+  auto post = [&thread](const std::string& text) {
+    RenderSnapshot snapshot;
+    snapshot.text = text;
+    snapshot.width = w;
+    snapshot.height = h;
+    thread.Post(std::move(snapshot));
+    thread.WaitIdle();
+  };
+
+  // The window starts the transition from the line leaving the screen, as
+  // the runners do, only once a new frame is actually taken.
+  ManualClock clock(1000);
+  LineTransition transition;
+  int releases = 0;
+  auto start = [&](RenderBuffer* previous) {
+    ++releases;
+    if (!previous) return;
+    Surface* shown = previous->surfaces->surface(0);
+    transition.Start(TransitionKind::kCrossfade, 200, clock.NowMs(),
+                     shown->data(), w, h, shown->stride());
+  };
+
+  // Nothing ready: no frame, and no transition left without a new line.
+  EXPECT_TRUE(thread.AcquireFrame(start) == nullptr);
+  EXPECT_EQ(releases, 0);
+  EXPECT_TRUE(!transition.active());
+
+  post("A");
+  RenderBuffer* first = thread.AcquireFrame(start);
+  EXPECT_TRUE(first != nullptr);
+  EXPECT_EQ(releases, 1);
+  EXPECT_TRUE(!transition.active());
+
+  post("B");
+  RenderBuffer* second = thread.AcquireFrame(start);
+  EXPECT_TRUE(second != nullptr && second != first);
+  EXPECT_EQ(releases, 2);
+  EXPECT_TRUE(transition.active());
+  EXPECT_TRUE(thread.AcquireFrame(start) == nullptr);
+  EXPECT_EQ(releases, 2);
+  if (!first || !second) return;
+
+  // The worker then draws the next line over the old front; the transition
+  // still starts on the old pixels.
+  post("C");
+  EXPECT_EQ(first->surfaces->surface(0)->data()[0], (uint8_t)'C');
+  Surface* to = second->surfaces->surface(0);
+  std::vector<uint8_t> out(to->size_bytes());
+  EXPECT_TRUE(transition.Frame(to->data(), out.data(), w, h, to->stride(),
+                               clock.NowMs()));
+  EXPECT_TRUE(out == std::vector<uint8_t>(out.size(), 'A'));
+}
+
+void TestRenderWorkerSharedByOverlays() {
+  using namespace tono_overlay;
+  auto worker = std::make_shared<RenderWorker>();
+  std::mutex seen_mutex;
+  std::vector<std::thread::id> render_threads;
+  std::atomic<int> ready_calls{0};
+  auto render = [&](const RenderSnapshot& snapshot, RenderBuffer* buffer) {
+    {
+      std::lock_guard<std::mutex> lock(seen_mutex);
+      render_threads.push_back(std::this_thread::get_id());
+    }
+    if (!buffer->surfaces) {
+      buffer->surfaces.reset(new SurfacePool(
+          std::make_unique<MemorySurfaceAllocator>(), 1));
+    }
+    return buffer->surfaces->EnsureSize(snapshot.width, snapshot.height);
+  };
+  auto post = [](RenderThread* thread, const std::string& text) {
+    RenderSnapshot snapshot;
+    snapshot.text = text;
+    snapshot.width = 8;
+    snapshot.height = 4;
+    thread->Post(std::move(snapshot));
+  };
+
+  constexpr int kOverlays = 12;
+  std::vector<std::unique_ptr<RenderThread>> overlays;
+  for (int i = 0; i < kOverlays; ++i) {
+    overlays.push_back(std::make_unique<RenderThread>(
+        worker, render, [&] { ++ready_calls; }));
+  }
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < kOverlays; ++i) {
+      post(overlays[i].get(), std::to_string(i) + "/" +
+                                  std::to_string(round));
+    }
+  }
+  for (auto& overlay : overlays) overlay->WaitIdle();
+  // Every overlay ends with its own newest snapshot, all drawn on the one
+  // worker thread.
+  for (int i = 0; i < kOverlays; ++i) {
+    RenderBuffer* frame = overlays[i]->AcquireFrame();
+    EXPECT_TRUE(frame != nullptr);
+    if (frame) EXPECT_EQ(frame->snapshot->text, std::to_string(i) + "/2");
+    const RenderThreadStats stats = overlays[i]->stats();
+    EXPECT_EQ(stats.posted, (uint64_t)3);
+    EXPECT_EQ(stats.rendered + stats.superseded, (uint64_t)3);
+  }
+  {
+    std::lock_guard<std::mutex> lock(seen_mutex);
+    EXPECT_TRUE(!render_threads.empty());
+    for (const std::thread::id& id : render_threads) {
+      EXPECT_TRUE(id == render_threads.front());
+    }
+    EXPECT_TRUE(render_threads.front() != std::this_thread::get_id());
+    EXPECT_EQ(ready_calls.load(), (int)render_threads.size());
+  }
+
+  // Destroying overlays with snapshots still queued leaves the rest
+  // working.
+  for (int i = 0; i < kOverlays; ++i) post(overlays[i].get(), "last");
+  for (int i = 0; i < kOverlays; i += 2) overlays[i].reset();
+  for (int i = 1; i < kOverlays; i += 2) {
+    overlays[i]->WaitIdle();
+    RenderBuffer* frame = overlays[i]->AcquireFrame();
+    EXPECT_TRUE(frame != nullptr && frame->snapshot->text == "last");
+  }
+  overlays.clear();
+  // The worker outlives its overlays only as long as someone holds it.
+  EXPECT_EQ(worker.use_count(), 1L);
+}
+
+struct FakeOverlay {
+  explicit FakeOverlay(int* live) : live(live) { ++*live; }
+  ~FakeOverlay() { --*live; }
+  int* live;
+  std::string text;
+};
+
+void TestOverlayRegistryCreatesOnDemand() {
+  using tono_overlay::OverlayId;
+  int live = 0;
+  std::vector<OverlayId> created;
+  tono_overlay::OverlayRegistry<FakeOverlay> registry(
+      [&](OverlayId id) {
+        created.push_back(id);
+        return std::make_unique<FakeOverlay>(&live);
+      },
+      3);
+  EXPECT_TRUE(registry.Find(tono_overlay::kDefaultOverlayId) == nullptr);
+  FakeOverlay* main = registry.Get(tono_overlay::kDefaultOverlayId);
+  EXPECT_TRUE(main != nullptr);
+  main->text = "original";
+  EXPECT_TRUE(registry.Get(tono_overlay::kDefaultOverlayId) == main);
+  FakeOverlay* translated = registry.Get(7);
+  EXPECT_TRUE(translated != nullptr && translated != main);
+  EXPECT_TRUE(registry.Get(-2) != nullptr);
+  // At the limit, only existing instances are handed out.
+  EXPECT_TRUE(registry.Get(8) == nullptr);
+  EXPECT_TRUE(registry.Get(7) == translated);
+  EXPECT_EQ(live, 3);
+  EXPECT_EQ(created.size(), (size_t)3);
+  EXPECT_TRUE(registry.ids() == (std::vector<OverlayId>{-2, 0, 7}));
+
+  EXPECT_TRUE(registry.Remove(7));
+  EXPECT_TRUE(!registry.Remove(7));
+  EXPECT_EQ(live, 2);
+  EXPECT_TRUE(registry.Find(7) == nullptr);
+  EXPECT_TRUE(registry.Get(8) != nullptr);
+  EXPECT_EQ(registry.Find(tono_overlay::kDefaultOverlayId)->text,
+            std::string("original"));
+  int visited = 0;
+  registry.ForEach([&](OverlayId, FakeOverlay*) { ++visited; });
+  EXPECT_EQ(visited, 3);
+
+  // A failing factory creates nothing.
+  tono_overlay::OverlayRegistry<FakeOverlay> failing(
+      [](OverlayId) { return std::unique_ptr<FakeOverlay>(); });
+  EXPECT_TRUE(failing.Get(1) == nullptr);
+  EXPECT_EQ(failing.size(), (size_t)0);
+}
+
+// Draws each non-space character as a solid 6x10 box, 8 px apart from the
+// padding, centered vertically; a stand-in for a font backend.
+class BoxRasterizer : public tono_overlay::TextRasterizer {
+ public:
+  std::unique_ptr<tono_overlay::SurfaceAllocator> CreateSurfaceAllocator()
+      override {
+    return std::make_unique<tono_overlay::MemorySurfaceAllocator>();
+  }
+  bool Rasterize(const std::string& text,
+                 const tono_overlay::OverlayStyle& style,
+                 tono_overlay::Surface* fill) override {
+    if (style.font_family.empty()) return false;
+    const int top = (fill->height() - 10) / 2;
+    for (size_t i = 0; i < text.size(); ++i) {
+      if (text[i] == ' ') continue;
+      const int left = style.padding + (int)i * 8;
+      for (int y = top; y < top + 10; ++y) {
+        for (int x = left; x < left + 6 && x < fill->width(); ++x) {
+          fill->data()[(size_t)y * fill->stride() + x] = 255;
+        }
+      }
+    }
+    return true;
+  }
+  // Each character advances 8 px; the last box is 6 px wide.
+  int MeasureLine(const std::string& text,
+                  const tono_overlay::OverlayStyle& style) override {
+    (void)style;
+    return text.empty() ? 0 : (int)text.size() * 8 - 2;
+  }
+};
+
+void TestMarqueeStripWidth() {
+  using tono_overlay::MarqueeStripWidth;
+  BoxRasterizer rasterizer;
+  tono_overlay::OverlayStyle style;
+  const std::string text = "abcdefghij";
+  // Off by default: the line is cut to the window.
+  EXPECT_EQ(MarqueeStripWidth(&rasterizer, text, style, 60), 60);
+  style.marquee = true;
+  // 78 px of text plus 8 px of padding on both sides.
+  EXPECT_EQ(MarqueeStripWidth(&rasterizer, text, style, 60), 94);
+  EXPECT_EQ(MarqueeStripWidth(&rasterizer, text, style, 100), 100);
+  style.lines = 2;
+  EXPECT_EQ(MarqueeStripWidth(&rasterizer, text, style, 60), 60);
+
+  const tono_overlay::OverlayStyle strip =
+      tono_overlay::MarqueeStripStyle(style);
+  EXPECT_EQ(strip.background_alpha, 0);
+  EXPECT_EQ(strip.text_align, 0);
+}
+
+void TestTextLayerPipelineOffscreen() {
+  BoxRasterizer rasterizer;
+  tono_overlay::OffscreenTarget target(&rasterizer);
+  tono_overlay::OverlayStyle style;
+  style.text_color = 0x20C0FF;
+  style.stroke_width = 2;
+  style.stroke_color = 0x102030;
+  // Text alone; the plate under it is covered by the compositor tests.
+  style.background_alpha = 0;
+  EXPECT_TRUE(target.frame() == nullptr);
+  EXPECT_EQ(target.Digest(), 0u);
+
+  const tono_overlay::Surface* frame = target.Render("a b", style, 64, 20);
+  EXPECT_TRUE(frame != nullptr);
+  if (!frame) return;
+  EXPECT_EQ(frame->width(), 64);
+  EXPECT_EQ(frame->height(), 20);
+  const tono_overlay::PixelFormat fmt = target.pixel_format();
+  auto pixel = [&](int x, int y) {
+    return target.frame()->data() + (size_t)y * target.frame()->stride() +
+           x * 4;
+  };
+  // Inside the first box: opaque text color.
+  EXPECT_EQ(pixel(10, 10)[3], 255);
+  EXPECT_EQ(pixel(10, 10)[fmt.r_index], 0x20);
+  EXPECT_EQ(pixel(10, 10)[fmt.b_index], 0xFF);
+  // Just left of it: stroke only.
+  EXPECT_EQ(pixel(7, 10)[3], 255);
+  EXPECT_EQ(pixel(7, 10)[fmt.r_index], 0x10);
+  // The space and the far right stay empty.
+  EXPECT_EQ(pixel(20, 10)[3], 0);
+  EXPECT_EQ(pixel(60, 10)[3], 0);
+
+  // Deterministic: the same inputs give the same digest after other work.
+  const uint64_t digest = target.Digest();
+  target.Render("other", style, 80, 24);
+  EXPECT_TRUE(target.Digest() != digest);
+  target.Render("a b", style, 64, 20);
+  EXPECT_EQ(target.Digest(), digest);
+
+  // Hashes split raster inputs from colors.
+  tono_overlay::OverlayStyle recolored = style;
+  recolored.text_color = 0xFF0000;
+  EXPECT_EQ(tono_overlay::TextLayerRasterHash("a b", style, 64, 20),
+            tono_overlay::TextLayerRasterHash("a b", recolored, 64, 20));
+  EXPECT_TRUE(tono_overlay::TextLayerStyleHash(style, 64, 20, fmt) !=
+              tono_overlay::TextLayerStyleHash(recolored, 64, 20, fmt));
+  recolored.stroke_width = 3;
+  EXPECT_TRUE(tono_overlay::TextLayerRasterHash("a b", style, 64, 20) !=
+              tono_overlay::TextLayerRasterHash("a b", recolored, 64, 20));
+  recolored.stroke_width = style.stroke_width;
+  // The plate is composited, not rasterized.
+  tono_overlay::OverlayStyle plated = style;
+  plated.corner_radius = 8;
+  EXPECT_EQ(tono_overlay::TextLayerRasterHash("a b", style, 64, 20),
+            tono_overlay::TextLayerRasterHash("a b", plated, 64, 20));
+  EXPECT_TRUE(tono_overlay::TextLayerStyleHash(style, 64, 20, fmt) !=
+              tono_overlay::TextLayerStyleHash(plated, 64, 20, fmt));
+
+  // Recompositing the masks matches a full render with the new color.
+  tono_overlay::TextLayerPipeline pipeline(&rasterizer);
+  auto surfaces = pipeline.CreateSurfaces();
+  EXPECT_TRUE(pipeline.Render("a b", style, 64, 20, surfaces.get()));
+  tono_overlay::Surface* recomposited =
+      pipeline.Recomposite(recolored, surfaces.get());
+  target.Render("a b", recolored, 64, 20);
+  EXPECT_TRUE(recomposited != nullptr &&
+              std::memcmp(recomposited->data(), target.frame()->data(),
+                          recomposited->size_bytes()) == 0);
+  // So does one with a plate under the text.
+  plated.background_alpha = 160;
+  recomposited = pipeline.Recomposite(plated, surfaces.get());
+  target.Render("a b", plated, 64, 20);
+  EXPECT_TRUE(recomposited != nullptr &&
+              std::memcmp(recomposited->data(), target.frame()->data(),
+                          recomposited->size_bytes()) == 0);
+  EXPECT_EQ(pixel(20, 10)[3], 160);
+  target.Render("a b", style, 64, 20);
+
+  // PAM round trip.
+  const std::string path = "overlay_core_test_frame.pam";
+  EXPECT_TRUE(tono_overlay::WritePam(*target.frame(), fmt, path));
+  int w = 0, h = 0;
+  std::vector<uint8_t> rgba;
+  EXPECT_TRUE(tono_overlay::ReadPam(path, &w, &h, &rgba));
+  EXPECT_EQ(w, 64);
+  EXPECT_EQ(h, 20);
+  EXPECT_TRUE(rgba == tono_overlay::SurfaceToRgba(*target.frame(), fmt));
+  std::remove(path.c_str());
+
+  // A rasterizer failure leaves no frame.
+  style.font_family.clear();
+  EXPECT_TRUE(target.Render("a b", style, 64, 20) == nullptr);
+  EXPECT_TRUE(target.frame() == nullptr);
+}
+
+// Records what the C API delivers. Calls count as on the host thread only
+// on the thread that created it.
+class RecordingApiHost : public tono_overlay::OverlayApiHost {
+ public:
+  bool OnHostThread() const override {
+    return std::this_thread::get_id() == thread_;
+  }
+  void Wake() override { ++wakes; }
+  void SetText(const std::string& utf8) override {
+    text = utf8;
+    ++text_calls;
+  }
+  void ApplyStyle(const tono_overlay::OverlayStyleUpdate& update) override {
+    update.ApplyTo(&state);
+    ++style_calls;
+  }
+  void SetSheet(const std::vector<tono_overlay::LrcLine>& lines) override {
+    sheet_times.clear();
+    sheet_texts.clear();
+    for (const tono_overlay::LrcLine& line : lines) {
+      sheet_times.push_back(line.time_ms);
+      sheet_texts.emplace_back(line.text);
+    }
+    ++sheet_calls;
+  }
+  void SetPlayback(int64_t position, bool is_playing, double r) override {
+    position_ms = position;
+    playing = is_playing;
+    rate = r;
+  }
+
+  std::atomic<int> wakes{0};
+  std::string text;
+  int text_calls = 0;
+  tono_overlay::OverlayState state;
+  int style_calls = 0;
+  std::vector<int64_t> sheet_times;
+  std::vector<std::string> sheet_texts;
+  int sheet_calls = 0;
+  int64_t position_ms = -1;
+  bool playing = false;
+  double rate = 0.0;
+
+ private:
+  std::thread::id thread_ = std::this_thread::get_id();
+};
+
+TonoOverlayStyle AbiStyle() {
+  TonoOverlayStyle style;
+  std::memset(&style, 0, sizeof(style));
+  style.struct_size = sizeof(style);
+  return style;
+}
+
+void TestOverlayCApiRoutesToHost() {
+  EXPECT_EQ(tono_overlay_api_version(), TONO_OVERLAY_API_VERSION);
+  EXPECT_EQ(tono_overlay_set_text("x", 1), TONO_OVERLAY_ERROR_NO_OVERLAY);
+
+  RecordingApiHost host;
+  tono_overlay::ManualClock clock(1000);
+  tono_overlay::SetOverlayApiHost(&host, &clock);
+
+  // On the host thread every call is applied before it returns.
+  EXPECT_EQ(tono_overlay_set_text("hello world", 5), TONO_OVERLAY_OK);
+  EXPECT_EQ(host.text, std::string("hello"));
+  TonoOverlayStyle style = AbiStyle();
+  style.fields = TONO_OVERLAY_STYLE_FONT_SIZE | TONO_OVERLAY_STYLE_TEXT_COLOR |
+                 TONO_OVERLAY_STYLE_FONT_FAMILY;
+  style.font_size = 31;
+  style.text_color = 0x123456;
+  style.font_family = "Noto Sans";
+  EXPECT_EQ(tono_overlay_apply_style(&style), TONO_OVERLAY_OK);
+  EXPECT_EQ(host.state.style().font_size, 31);
+  EXPECT_EQ(host.state.style().text_color, 0x123456u);
+  EXPECT_EQ(host.state.style().font_family, std::string("Noto Sans"));
+  EXPECT_EQ(tono_overlay_set_playback(5000, 1, 1.0), TONO_OVERLAY_OK);
+  EXPECT_EQ(host.position_ms, 5000);
+  // The sheet goes as raw LRC and is parsed natively, word tags kept.
+  const std::string lrc =
+      "[offset:100]\n[00:02.00]two\n[00:01.00]<00:01.00>one <00:01.50>x\n";
+  EXPECT_EQ(tono_overlay_set_sheet_lrc(lrc.data(), lrc.size()),
+            TONO_OVERLAY_OK);
+  EXPECT_EQ(host.sheet_calls, 1);
+  EXPECT_TRUE(host.sheet_times == std::vector<int64_t>({900, 1900}));
+  EXPECT_TRUE(host.sheet_texts ==
+              std::vector<std::string>({"<00:01.00>one <00:01.50>x", "two"}));
+  EXPECT_EQ(tono_overlay_set_sheet_lrc(nullptr, 0), TONO_OVERLAY_OK);
+  EXPECT_TRUE(host.sheet_texts.empty());
+  EXPECT_EQ(tono_overlay_set_sheet_lrc(nullptr, 4),
+            TONO_OVERLAY_ERROR_INVALID_ARGUMENT);
+  EXPECT_EQ(host.sheet_calls, 2);
+  EXPECT_EQ(host.wakes.load(), 0);
+
+  // Invalid input changes nothing: out of range, unknown bits, null
+  // strings, an older struct, bad playback.
+  const int style_calls = host.style_calls;
+  style = AbiStyle();
+  style.fields = TONO_OVERLAY_STYLE_FONT_SIZE | TONO_OVERLAY_STYLE_WIDTH;
+  style.font_size = 12;
+  style.width = 0;
+  EXPECT_EQ(tono_overlay_apply_style(&style),
+            TONO_OVERLAY_ERROR_INVALID_ARGUMENT);
+  style.fields = 1u << 30;
+  EXPECT_EQ(tono_overlay_apply_style(&style),
+            TONO_OVERLAY_ERROR_INVALID_ARGUMENT);
+  style.fields = TONO_OVERLAY_STYLE_FONT_FAMILY;
+  EXPECT_EQ(tono_overlay_apply_style(&style),
+            TONO_OVERLAY_ERROR_INVALID_ARGUMENT);
+  style.fields = TONO_OVERLAY_STYLE_FONT_SIZE;
+  style.struct_size = 8;
+  EXPECT_EQ(tono_overlay_apply_style(&style),
+            TONO_OVERLAY_ERROR_INVALID_ARGUMENT);
+  EXPECT_EQ(tono_overlay_apply_style(nullptr),
+            TONO_OVERLAY_ERROR_INVALID_ARGUMENT);
+  EXPECT_EQ(host.style_calls, style_calls);
+  EXPECT_EQ(host.state.style().font_size, 31);
+  EXPECT_EQ(tono_overlay_set_text(nullptr, 3),
+            TONO_OVERLAY_ERROR_INVALID_ARGUMENT);
+  EXPECT_EQ(tono_overlay_set_playback(0, 1, 0.0),
+            TONO_OVERLAY_ERROR_INVALID_ARGUMENT);
+
+  // From another thread calls queue with one wake-up, keep the latest
+  // text, merge style fields and age the playback position.
+  const int text_calls = host.text_calls;
+  std::thread ui([] {
+    tono_overlay_set_text("first", 5);
+    tono_overlay_set_text("second", 6);
+    TonoOverlayStyle a = AbiStyle();
+    a.fields = TONO_OVERLAY_STYLE_LINES | TONO_OVERLAY_STYLE_BOLD;
+    a.lines = 2;
+    a.bold = 1;
+    tono_overlay_apply_style(&a);
+    TonoOverlayStyle b = AbiStyle();
+    b.fields = TONO_OVERLAY_STYLE_LINES | TONO_OVERLAY_STYLE_X;
+    b.lines = 3;
+    b.x = 77;
+    tono_overlay_apply_style(&b);
+    // The queue owns a copy of the LRC; the caller's buffer is gone.
+    std::string sheet = "[00:03.00]old";
+    tono_overlay_set_sheet_lrc(sheet.data(), sheet.size());
+    sheet = "[00:04.00]new\n[00:05.00]last";
+    tono_overlay_set_sheet_lrc(sheet.data(), sheet.size());
+    sheet.assign(sheet.size(), '?');
+    tono_overlay_set_playback(2000, 1, 1.5);
+  });
+  ui.join();
+  EXPECT_EQ(host.wakes.load(), 1);
+  EXPECT_EQ(host.text_calls, text_calls);
+  clock.Advance(100);
+  tono_overlay::DrainOverlayApi();
+  EXPECT_EQ(host.text, std::string("second"));
+  EXPECT_EQ(host.text_calls, text_calls + 1);
+  EXPECT_EQ(host.style_calls, style_calls + 1);
+  EXPECT_EQ(host.state.style().lines, 3);
+  EXPECT_TRUE(host.state.style().font_bold);
+  EXPECT_EQ(host.state.style().x, 77);
+  EXPECT_EQ(host.position_ms, 2150);
+  EXPECT_TRUE(host.playing);
+  EXPECT_EQ(host.sheet_calls, 3);
+  EXPECT_TRUE(host.sheet_times == std::vector<int64_t>({4000, 5000}));
+  EXPECT_TRUE(host.sheet_texts == std::vector<std::string>({"new", "last"}));
+  // Nothing left; the next queued call wakes the host again.
+  tono_overlay::DrainOverlayApi();
+  EXPECT_EQ(host.text_calls, text_calls + 1);
+  std::thread again([] { tono_overlay_set_text("third", 5); });
+  again.join();
+  EXPECT_EQ(host.wakes.load(), 2);
+
+  // Unregistering drops what was queued.
+  tono_overlay::SetOverlayApiHost(nullptr);
+  tono_overlay::DrainOverlayApi();
+  EXPECT_EQ(host.text, std::string("second"));
+  EXPECT_EQ(tono_overlay_set_text("x", 1), TONO_OVERLAY_ERROR_NO_OVERLAY);
+}
+
+void TestOverlayCApiStyleDoesNotAllocate() {
+  RecordingApiHost host;
+  tono_overlay::SetOverlayApiHost(&host);
+  TonoOverlayStyle style = AbiStyle();
+  style.fields = TONO_OVERLAY_STYLE_FONT_FAMILY | TONO_OVERLAY_STYLE_FONT_SIZE |
+                 TONO_OVERLAY_STYLE_TEXT_COLOR | TONO_OVERLAY_STYLE_BOLD;
+  // Too long for any std::string to keep inline.
+  style.font_family = "Noto Sans CJK SC Medium";
+  style.bold = 1;
+  // The host's state takes the family once.
+  EXPECT_EQ(tono_overlay_apply_style(&style), TONO_OVERLAY_OK);
+
+  // Applied on the host thread: decoding and the host call allocate
+  // nothing, and neither does a rejected style.
+  EXPECT_EQ(AllocationsDuring([&] {
+              for (int i = 0; i < 100; ++i) {
+                style.font_size = 20 + i % 10;
+                style.text_color = (uint32_t)i;
+                tono_overlay_apply_style(&style);
+              }
+              TonoOverlayStyle bad = style;
+              bad.fields |= TONO_OVERLAY_STYLE_WIDTH;
+              bad.width = 0;
+              EXPECT_EQ(tono_overlay_apply_style(&bad),
+                        TONO_OVERLAY_ERROR_INVALID_ARGUMENT);
+            }),
+            0);
+  EXPECT_EQ(host.state.style().font_size, 29);
+  EXPECT_EQ(host.state.style().text_color, 99u);
+
+  // Queued from another thread, merged, then drained on the host thread.
+  int queued_allocations = -1;
+  std::thread ui([&] {
+    queued_allocations = AllocationsDuring([&] {
+      for (int i = 0; i < 100; ++i) {
+        TonoOverlayStyle queued = style;
+        queued.font_size = 40 + i % 10;
+        tono_overlay_apply_style(&queued);
+      }
+    });
+  });
+  ui.join();
+  EXPECT_EQ(queued_allocations, 0);
+  EXPECT_EQ(AllocationsDuring([] { tono_overlay::DrainOverlayApi(); }), 0);
+  EXPECT_EQ(host.state.style().font_size, 49);
+  EXPECT_EQ(host.state.style().font_family,
+            std::string("Noto Sans CJK SC Medium"));
+  // The family is kept inline, so it has a bound.
+  const std::string long_family(tono_overlay::OverlayStyleUpdate::kMaxTextBytes,
+                                'a');
+  style.font_family = long_family.c_str();
+  EXPECT_EQ(tono_overlay_apply_style(&style),
+            TONO_OVERLAY_ERROR_INVALID_ARGUMENT);
+  tono_overlay::SetOverlayApiHost(nullptr);
+}
+
+}  // namespace
+
+int main() {
+  std::printf("compositor isa: %s\n",
+              tono_overlay::CompositorIsaName(
+                  tono_overlay::ActiveCompositorIsa()));
+  TestCompositorMatchesLegacy();
+  TestCompositorExhaustiveAlphaPairs();
+  TestCompositorBackgroundPlate();
+  TestStrokeEngineDilatesToDisk();
+  TestStrokeEngineCoversFillAndOldDisk();
+  TestSurfacePoolReusesSurfaces();
+  TestLineCacheLruAndBudget();
+  TestLinePrerendererRendersLookahead();
+  TestLyricTimelineFollowsSimulatedClock();
+  TestLrcParser();
+  TestStripWordTimings();
+  TestKaraokeSweepRecompositesOnlyCrossedColumns();
+  TestLineTransitionBlendsCachedBitmaps();
+  TestLineTransitionKeepsPlateStill();
+  TestMarqueeMotionPingPongs();
+  TestMarqueeBlitsWindow();
+  TestOverlayStateDirtyStages();
+  TestOverlayStyleDecoderTransaction();
+  TestStyleSettersShareTheDecoder();
+  TestStyleMapDecoding();
+  TestOverlayCApiRoutesToHost();
+  TestOverlayCApiStyleDoesNotAllocate();
+  TestLatencyHistogramPercentiles();
+  TestOverlayTracerWritesTraceEvents();
+  TestLineBreakerRules();
+  TestTextLayoutWrapsAndCaches();
+  TestFontCacheEvictsLeastRecentlyUsed();
+  TestAsyncLoggerConcurrentProducers();
+  TestRenderThreadLatestWins();
+  TestTransitionStartsOnAcquiredFrame();
+  TestRenderWorkerSharedByOverlays();
+  TestOverlayRegistryCreatesOnDemand();
+  TestTextLayerPipelineOffscreen();
+  TestMarqueeStripWidth();
+  if (g_failures) {
+    std::fprintf(stderr, "%d failure(s)\n", g_failures);
+    return 1;
+  }
+  std::printf("all tests passed\n");
+  return 0;
+}
@@ -0,0 +1,116 @@
+// text_layer.cc
+#include "overlay_core/text_layer.h"
+
+#include <utility>
+#include <vector>
+
+#include "overlay_core/line_cache.h"
+#include "overlay_core/overlay_stats.h"
+
+namespace tono_overlay {
+
+namespace {
+
+Rgb RgbFrom(uint32_t rgb) {
+  return {(uint8_t)(rgb >> 16), (uint8_t)(rgb >> 8), (uint8_t)rgb};
+}
+
+// Layout and font inputs shared by both hashes.
+HashBuilder& AddRasterInputs(HashBuilder& builder, const OverlayStyle& style,
+                             int width, int height) {
+  return builder.Add(style.font_family)
+      .Add(style.font_size)
+      .Add(style.font_weight)
+      .Add(style.font_bold ? 1 : 0)
+      .Add(style.stroke_width)
+      .Add(style.text_align)
+      .Add(style.lines)
+      .Add(style.padding)
+      .Add(style.marquee ? 1 : 0)
+      .Add(width)
+      .Add(height);
+}
+
+}  // namespace
+
+CompositeParams TextLayerCompositeParams(const OverlayStyle& style,
+                                         PixelFormat format) {
+  CompositeParams params;
+  params.fill = RgbFrom(style.text_color);
+  params.stroke = RgbFrom(style.stroke_color);
+  params.text_opacity = style.text_opacity;
+  params.background.color = RgbFrom(style.background_color);
+  params.background.alpha = style.background_alpha;
+  params.background.corner_radius = style.corner_radius;
+  params.format = format;
+  return params;
+}
+
+uint64_t TextLayerStyleHash(const OverlayStyle& style, int width, int height,
+                            PixelFormat format) {
+  HashBuilder builder;
+  return AddRasterInputs(builder, style, width, height)
+      .Add((int64_t)style.text_color)
+      .Add((int64_t)style.stroke_color)
+      .Add(style.text_opacity)
+      .Add((int64_t)style.background_color)
+      .Add(style.background_alpha)
+      .Add(style.corner_radius)
+      .Add(format.r_index * 16 + format.g_index * 4 + format.b_index)
+      .hash();
+}
+
+uint64_t TextLayerRasterHash(const std::string& text, const OverlayStyle& style,
+                             int width, int height) {
+  HashBuilder builder;
+  builder.Add(text);
+  return AddRasterInputs(builder, style, width, height).hash();
+}
+
+TextLayerPipeline::TextLayerPipeline(TextRasterizer* rasterizer)
+    : rasterizer_(rasterizer) {}
+
+std::unique_ptr<SurfacePool> TextLayerPipeline::CreateSurfaces() {
+  std::vector<int> bytes_per_pixel(kTextLayerSlotCount, 1);
+  bytes_per_pixel[kTextLayerOutput] = 4;
+  return std::make_unique<SurfacePool>(rasterizer_->CreateSurfaceAllocator(),
+                                       std::move(bytes_per_pixel));
+}
+
+Surface* TextLayerPipeline::Render(const std::string& text,
+                                   const OverlayStyle& style, int width,
+                                   int height, SurfacePool* surfaces) {
+  if (!surfaces->EnsureSize(width, height)) return nullptr;
+  Surface* fill = surfaces->surface(kTextLayerFill);
+  // The stroke mask and the output are fully overwritten below.
+  fill->Clear();
+  {
+    ScopedStageTimer timer(TimingStage::kRasterize);
+    if (!rasterizer_->Rasterize(text, style, fill)) return nullptr;
+  }
+  if (style.stroke_width > 0) {
+    ScopedStageTimer timer(TimingStage::kStroke);
+    Surface* stroke = surfaces->surface(kTextLayerStroke);
+    stroke_engine_.BuildA8(fill->data(), stroke->data(), width, height,
+                           style.stroke_width);
+  }
+  return Recomposite(style, surfaces);
+}
+
+Surface* TextLayerPipeline::Recomposite(const OverlayStyle& style,
+                                        SurfacePool* surfaces) {
+  Surface* output = surfaces->surface(kTextLayerOutput);
+  if (!output) return nullptr;
+  ScopedStageTimer timer(TimingStage::kComposite);
+  const uint8_t* stroke = style.stroke_width > 0
+                              ? surfaces->surface(kTextLayerStroke)->data()
+                              : nullptr;
+  const CompositeParams params =
+      TextLayerCompositeParams(style, surfaces->pixel_format());
+  CompositeLayer(surfaces->surface(kTextLayerFill)->data(), stroke,
+                 output->data(), output->width(), output->height(), 0,
+                 output->width(), params);
+  return output;
+}
+
+}  // namespace tono_overlay
@@ -0,0 +1,105 @@
+// text_layer.h
+#ifndef OVERLAY_CORE_TEXT_LAYER_H_
+#define OVERLAY_CORE_TEXT_LAYER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "overlay_core/compositor.h"
+#include "overlay_core/overlay_state.h"
+#include "overlay_core/stroke_engine.h"
+#include "overlay_core/surface.h"
+
+namespace tono_overlay {
+
+// Surfaces of a text layer, all the size of the layer. Only the output is
+// 32-bit; the masks hold one coverage byte per pixel (A8).
+enum TextLayerSlot {
+  kTextLayerOutput,  // premultiplied result
+  kTextLayerStroke,  // stroke mask
+  kTextLayerFill,    // fill mask, drawn by the TextRasterizer
+  kTextLayerSlotCount,
+};
+
+// The platform part of text rendering: font loading, layout and glyph
+// rasterization. Each thread that renders uses its own instance.
+class TextRasterizer {
+ public:
+  virtual ~TextRasterizer() = default;
+
+  // Allocator for the layer's surfaces (e.g. DIB sections for GDI, plain
+  // memory for FreeType).
+  virtual std::unique_ptr<SurfaceAllocator> CreateSurfaceAllocator() = 0;
+
+  // Lays out |text| (UTF-8) with the font, alignment, line count and
+  // padding of |style| and draws its coverage into |fill|, a zeroed A8
+  // surface.
+  // One line is centered vertically and cut with an ellipsis; more lines
+  // wrap at word boundaries from the top, and the last one is cut. Drawing
+  // is clipped to the padded box. Returns false if no font was available.
+  virtual bool Rasterize(const std::string& text, const OverlayStyle& style,
+                         Surface* fill) = 0;
+
+  // Width in pixels |text| takes as one line in the font of |style|,
+  // unwrapped and uncut; marquee strips are sized from it. 0 if unknown,
+  // which keeps the line in the window.
+  virtual int MeasureLine(const std::string& text, const OverlayStyle& style) {
+    (void)text;
+    (void)style;
+    return 0;
+  }
+};
+
+// Fill/stroke colors, text opacity and background plate of |style|.
+CompositeParams TextLayerCompositeParams(const OverlayStyle& style,
+                                         PixelFormat format);
+
+// Hash of every input that affects the pixels of a width x height text
+// layer drawn with |style| (for LineCacheKey::style_hash).
+uint64_t TextLayerStyleHash(const OverlayStyle& style, int width, int height,
+                            PixelFormat format);
+
+// Hash of |text| plus the inputs of its fill/stroke masks: everything in
+// TextLayerStyleHash() except colors, text opacity and the background.
+// Equal hashes mean a color change can recomposite the masks instead of
+// redrawing them.
+uint64_t TextLayerRasterHash(const std::string& text, const OverlayStyle& style,
+                             int width, int height);
+
+// Rasterizer, stroke and composite passes of a text layer. Not thread
+// safe; one per rendering thread, like its rasterizer.
+class TextLayerPipeline {
+ public:
+  // |rasterizer| must outlive the pipeline.
+  explicit TextLayerPipeline(TextRasterizer* rasterizer);
+
+  TextLayerPipeline(const TextLayerPipeline&) = delete;
+  TextLayerPipeline& operator=(const TextLayerPipeline&) = delete;
+
+  // An empty pool with the TextLayerSlot surfaces, from the rasterizer's
+  // allocator: a 32-bit output and two A8 masks.
+  std::unique_ptr<SurfacePool> CreateSurfaces();
+
+  // Draws |text| into |surfaces| (resized to width x height) and returns
+  // the output surface, or null if allocation or rasterization failed.
+  Surface* Render(const std::string& text, const OverlayStyle& style,
+                  int width, int height, SurfacePool* surfaces);
+
+  // Re-applies the colors, text opacity and background of |style| to the
+  // masks already in |surfaces| and returns the output surface.
+  Surface* Recomposite(const OverlayStyle& style, SurfacePool* surfaces);
+
+  TextRasterizer* rasterizer() const { return rasterizer_; }
+  // Draws with |rasterizer| from now on, keeping the stroke scratch.
+  // Surfaces already created stay usable if it allocates the same kind.
+  void set_rasterizer(TextRasterizer* rasterizer) { rasterizer_ = rasterizer; }
+
+ private:
+  TextRasterizer* rasterizer_;
+  StrokeEngine stroke_engine_;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_TEXT_LAYER_H_
@@ -0,0 +1,244 @@
+// text_layout.cc
+#include "overlay_core/text_layout.h"
+
+#include <algorithm>
+
+#include "overlay_core/overlay_stats.h"
+
+namespace tono_overlay {
+
+namespace {
+
+using C = LineBreakClass;
+
+constexpr uint32_t kEllipsisChar = 0x2026;
+
+bool IsHardBreak(C cls) {
+  return cls == C::kBK || cls == C::kLF || cls == C::kNL;
+}
+
+// May run past the right edge; trimmed from line ends.
+bool IsHanging(C cls) { return cls == C::kSP || IsHardBreak(cls); }
+
+// Marks, joiners and skin tones stay with the character before them, even
+// when a word has to be split to fit.
+bool StartsCluster(C cls, C prev) {
+  return cls != C::kCM && cls != C::kZWJ && cls != C::kEM && prev != C::kZWJ;
+}
+
+}  // namespace
+
+std::unordered_map<uint32_t, int32_t>* GlyphAdvanceCache::FontFor(
+    uint64_t font_key) {
+  for (size_t i = 0; i < fonts_.size(); ++i) {
+    if (fonts_[i].key != font_key) continue;
+    if (i > 0) {
+      std::rotate(fonts_.begin(), fonts_.begin() + i,
+                  fonts_.begin() + i + 1);
+    }
+    return &fonts_.front().advances;
+  }
+  if (fonts_.size() >= kMaxFonts) fonts_.pop_back();
+  fonts_.insert(fonts_.begin(), Font());
+  fonts_.front().key = font_key;
+  return &fonts_.front().advances;
+}
+
+int32_t GlyphAdvanceCache::Get(uint64_t font_key, uint32_t glyph,
+                               GlyphSource* source) {
+  std::unordered_map<uint32_t, int32_t>* advances = FontFor(font_key);
+  auto it = advances->find(glyph);
+  if (it != advances->end()) return it->second;
+  ++misses_;
+  const int32_t advance = source->GlyphAdvance(glyph);
+  advances->emplace(glyph, advance);
+  return advance;
+}
+
+void GlyphAdvanceCache::Clear() { fonts_.clear(); }
+
+void TextLayout::Layout(const std::string& text, const LayoutParams& params,
+                        GlyphSource* source) {
+  const bool single_line = params.max_lines <= 1;
+  const int max_lines = std::max(params.max_lines, 1);
+  const bool reshape = !shaped_valid_ || params.font_key != font_key_ ||
+                       single_line != single_line_ || text != text_;
+  if (!reshape && fit_valid_ && params.max_width == max_width_ &&
+      max_lines == max_lines_ && params.align == align_) {
+    return;
+  }
+  ScopedStageTimer timer(TimingStage::kLayout);
+  if (reshape) {
+    text_ = text;
+    font_key_ = params.font_key;
+    single_line_ = single_line;
+    Shape(text, single_line, source);
+    shaped_valid_ = true;
+  }
+  max_width_ = params.max_width;
+  max_lines_ = max_lines;
+  align_ = params.align;
+  Fit(params);
+  fit_valid_ = true;
+}
+
+void TextLayout::Invalidate() {
+  shaped_valid_ = false;
+  fit_valid_ = false;
+}
+
+void TextLayout::Shape(const std::string& text, bool single_line,
+                       GlyphSource* source) {
+  ++shape_count_;
+  shaped_.clear();
+  classes_.clear();
+  uint32_t prev_glyph = 0;
+  for (size_t i = 0; i < text.size();) {
+    Shaped shaped;
+    shaped.codepoint = NextUtf8Codepoint(text, &i);
+    if (shaped.codepoint == '\r') continue;
+    shaped.cls = LineBreakClassOf(shaped.codepoint);
+    if (shaped.codepoint == '\t' || (single_line && IsHardBreak(shaped.cls))) {
+      shaped.codepoint = ' ';
+      shaped.cls = C::kSP;
+    }
+    if (IsHardBreak(shaped.cls)) {
+      // No ink, no advance, no kerning across it.
+      shaped_.push_back(shaped);
+      classes_.push_back(shaped.cls);
+      prev_glyph = 0;
+      continue;
+    }
+    shaped.glyph = source->GlyphIndex(shaped.codepoint);
+    shaped.advance = advances_.Get(font_key_, shaped.glyph, source);
+    if (prev_glyph && shaped.glyph) {
+      shaped.kerning = source->Kerning(prev_glyph, shaped.glyph);
+    }
+    prev_glyph = shaped.glyph;
+    shaped_.push_back(shaped);
+    classes_.push_back(shaped.cls);
+  }
+  FindLineBreaks(classes_.data(), classes_.size(), &breaks_);
+
+  ellipsis_codepoint_ = kEllipsisChar;
+  ellipsis_glyph_ = source->GlyphIndex(kEllipsisChar);
+  ellipsis_count_ = 1;
+  if (ellipsis_glyph_ == 0) {
+    ellipsis_codepoint_ = '.';
+    ellipsis_glyph_ = source->GlyphIndex('.');
+    ellipsis_count_ = 3;
+  }
+  ellipsis_advance_ = advances_.Get(font_key_, ellipsis_glyph_, source);
+}
+
+int32_t TextLayout::Width(size_t begin, size_t end) const {
+  int32_t width = 0;
+  for (size_t i = begin; i < end; ++i) {
+    if (i > begin) width += shaped_[i].kerning;
+    width += shaped_[i].advance;
+  }
+  return width;
+}
+
+void TextLayout::Fit(const LayoutParams& params) {
+  glyphs_.clear();
+  lines_.clear();
+  const size_t n = shaped_.size();
+  const int32_t max_width = params.max_width;
+  size_t pos = 0;
+  while (pos < n && (int)lines_.size() < max_lines_) {
+    int32_t width = 0;
+    // Last allowed break after |pos|; 0 = none yet.
+    size_t break_at = 0;
+    size_t i = pos;
+    bool hard = false;
+    for (; i < n; ++i) {
+      if (i > pos && breaks_[i] == BreakAction::kMandatory) {
+        hard = true;
+        break;
+      }
+      const Shaped& shaped = shaped_[i];
+      const int32_t next =
+          width + (i > pos ? shaped.kerning : 0) + shaped.advance;
+      if (next > max_width && i > pos && !IsHanging(shaped.cls)) break;
+      width = next;
+      if (breaks_[i + 1] == BreakAction::kAllowed) break_at = i + 1;
+    }
+    size_t end = i;
+    if (!hard && i < n) {
+      if (break_at > pos) {
+        end = break_at;
+      } else {
+        // A single word wider than the line: split it between clusters.
+        while (end > pos + 1 &&
+               !StartsCluster(shaped_[end].cls, shaped_[end - 1].cls)) {
+          --end;
+        }
+      }
+    }
+    if ((int)lines_.size() + 1 == max_lines_ && end < n) {
+      // Text that did not fit: the last line runs on and is cut.
+      Emit(pos, EllipsisCut(pos, max_width), true, params);
+      return;
+    }
+    Emit(pos, end, false, params);
+    pos = end;
+  }
+}
+
+size_t TextLayout::EllipsisCut(size_t begin, int32_t max_width) const {
+  const int32_t ellipsis_width = ellipsis_advance_ * ellipsis_count_;
+  const size_t n = shaped_.size();
+  int32_t width = 0;
+  size_t end = begin;
+  for (; end < n; ++end) {
+    const Shaped& shaped = shaped_[end];
+    if (IsHardBreak(shaped.cls)) break;
+    const int32_t next =
+        width + (end > begin ? shaped.kerning : 0) + shaped.advance;
+    if (next + ellipsis_width > max_width) break;
+    width = next;
+  }
+  while (end > begin && end < n &&
+         !StartsCluster(shaped_[end].cls, shaped_[end - 1].cls)) {
+    --end;
+  }
+  return end;
+}
+
+void TextLayout::Emit(size_t begin, size_t end, bool ellipsis,
+                      const LayoutParams& params) {
+  while (end > begin && IsHanging(shaped_[end - 1].cls)) --end;
+  LayoutLine line;
+  line.begin = glyphs_.size();
+  line.ellipsis = ellipsis;
+  line.width = Width(begin, end);
+  if (ellipsis) line.width += ellipsis_advance_ * ellipsis_count_;
+  int32_t pen = 0;
+  if (line.width < params.max_width) {
+    if (params.align == 1) pen = (params.max_width - line.width) / 2;
+    if (params.align == 2) pen = params.max_width - line.width;
+  }
+  for (size_t i = begin; i < end; ++i) {
+    const Shaped& shaped = shaped_[i];
+    if (i > begin) pen += shaped.kerning;
+    LayoutGlyph glyph;
+    glyph.codepoint = shaped.codepoint;
+    glyph.glyph = shaped.glyph;
+    glyph.x = pen;
+    glyphs_.push_back(glyph);
+    pen += shaped.advance;
+  }
+  for (int k = 0; ellipsis && k < ellipsis_count_; ++k) {
+    LayoutGlyph glyph;
+    glyph.codepoint = ellipsis_codepoint_;
+    glyph.glyph = ellipsis_glyph_;
+    glyph.x = pen;
+    glyphs_.push_back(glyph);
+    pen += ellipsis_advance_;
+  }
+  line.end = glyphs_.size();
+  lines_.push_back(line);
+}
+
+}  // namespace tono_overlay
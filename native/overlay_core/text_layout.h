@@ -0,0 +1,153 @@
+// text_layout.h
+#ifndef OVERLAY_CORE_TEXT_LAYOUT_H_
+#define OVERLAY_CORE_TEXT_LAYOUT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "overlay_core/line_breaker.h"
+
+namespace tono_overlay {
+
+// The font queries TextLayout needs from a backend. One code point maps to
+// one glyph (no complex shaping). Advances and kerning are 26.6 fixed
+// point.
+class GlyphSource {
+ public:
+  virtual ~GlyphSource() = default;
+
+  // Glyph for |codepoint|, 0 if the font has none.
+  virtual uint32_t GlyphIndex(uint32_t codepoint) = 0;
+  virtual int32_t GlyphAdvance(uint32_t glyph) = 0;
+  // Adjustment between two adjacent glyphs.
+  virtual int32_t Kerning(uint32_t left, uint32_t right) {
+    (void)left;
+    (void)right;
+    return 0;
+  }
+};
+
+// Advance widths of the last few fonts used, so switching between two
+// styles does not measure every glyph again.
+class GlyphAdvanceCache {
+ public:
+  static constexpr size_t kMaxFonts = 8;
+
+  // Advance of |glyph| in the font identified by |font_key|, asking
+  // |source| on a miss.
+  int32_t Get(uint64_t font_key, uint32_t glyph, GlyphSource* source);
+  void Clear();
+
+  uint64_t misses() const { return misses_; }
+
+ private:
+  struct Font {
+    uint64_t key = 0;
+    std::unordered_map<uint32_t, int32_t> advances;
+  };
+
+  std::unordered_map<uint32_t, int32_t>* FontFor(uint64_t font_key);
+
+  std::vector<Font> fonts_;  // most recently used first
+  uint64_t misses_ = 0;
+};
+
+struct LayoutParams {
+  int32_t max_width = 0;  // 26.6
+  // 1 keeps everything on one line, newlines included.
+  int max_lines = 1;
+  int align = 0;  // 0 = left, 1 = center, 2 = right
+  // Identifies the font |source| measures with: its face, size and
+  // synthesis. Cached measurements are reused while it stays the same.
+  uint64_t font_key = 0;
+};
+
+// A glyph ready to draw; |x| is the pen position in 26.6 from the left
+// edge of the layout box, alignment and kerning applied.
+struct LayoutGlyph {
+  uint32_t codepoint = 0;
+  uint32_t glyph = 0;
+  int32_t x = 0;
+};
+
+// Glyphs [begin, end) of TextLayout::glyphs(), ellipsis included.
+struct LayoutLine {
+  size_t begin = 0;
+  size_t end = 0;
+  int32_t width = 0;  // 26.6
+  bool ellipsis = false;
+};
+
+// Breaks text into lines with UAX #14 (kinsoku included: closing
+// punctuation and small kana never start a line), cuts what does not fit
+// with an ellipsis and aligns each line.
+//
+// Decoding, measuring and break analysis are kept for the last text and
+// font, so a call that only changes the width, line count or alignment
+// just refits the lines, and an identical call does nothing.
+class TextLayout {
+ public:
+  void Layout(const std::string& text, const LayoutParams& params,
+              GlyphSource* source);
+
+  const std::vector<LayoutGlyph>& glyphs() const { return glyphs_; }
+  const std::vector<LayoutLine>& lines() const { return lines_; }
+
+  // Forgets the last text, e.g. after the font behind a key changed.
+  void Invalidate();
+
+  GlyphAdvanceCache& advance_cache() { return advances_; }
+  // How many times text was decoded and measured; for tests and benches.
+  uint64_t shape_count() const { return shape_count_; }
+
+ private:
+  struct Shaped {
+    uint32_t codepoint = 0;
+    uint32_t glyph = 0;
+    int32_t advance = 0;
+    // Kerning against the previous glyph; not applied at a line start.
+    int32_t kerning = 0;
+    LineBreakClass cls = LineBreakClass::kAL;
+  };
+
+  void Shape(const std::string& text, bool single_line, GlyphSource* source);
+  void Fit(const LayoutParams& params);
+  int32_t Width(size_t begin, size_t end) const;
+  // Cuts the line that starts at |begin| where it fits |max_width| with
+  // the ellipsis; returns its end.
+  size_t EllipsisCut(size_t begin, int32_t max_width) const;
+  void Emit(size_t begin, size_t end, bool ellipsis,
+            const LayoutParams& params);
+
+  GlyphAdvanceCache advances_;
+  uint64_t shape_count_ = 0;
+
+  // Inputs of the last Shape().
+  bool shaped_valid_ = false;
+  std::string text_;
+  uint64_t font_key_ = 0;
+  bool single_line_ = true;
+  std::vector<Shaped> shaped_;
+  std::vector<BreakAction> breaks_;
+  uint32_t ellipsis_glyph_ = 0;
+  uint32_t ellipsis_codepoint_ = 0;
+  int ellipsis_count_ = 1;
+  int32_t ellipsis_advance_ = 0;
+
+  // Inputs of the last Fit().
+  bool fit_valid_ = false;
+  int32_t max_width_ = 0;
+  int max_lines_ = 0;
+  int align_ = 0;
+
+  std::vector<LineBreakClass> classes_;  // scratch
+  std::vector<LayoutGlyph> glyphs_;
+  std::vector<LayoutLine> lines_;
+};
+
+}  // namespace tono_overlay
+
+#endif  // OVERLAY_CORE_TEXT_LAYOUT_H_
@@ -0,0 +1,110 @@
+// tono_overlay_api.h
+//
+// C ABI of the lyrics overlay, exported by the runner executables for
+// dart:ffi. The calls take the same values as the window MethodChannel but
+// skip its codec, its asynchronous hop to the platform thread and its
+// string dispatch: a call made on the thread that owns the overlay is
+// applied before it returns, and one made on any other thread (the Dart UI
+// thread, when it is not merged with the platform thread) is queued,
+// latest value wins, and applied on the next turn of that thread's loop.
+//
+// Every function returns TONO_OVERLAY_OK or a negative TONO_OVERLAY_ERROR_*
+// code and never keeps the pointers it is given. The header is C.
+#ifndef OVERLAY_CORE_TONO_OVERLAY_API_H_
+#define OVERLAY_CORE_TONO_OVERLAY_API_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define TONO_OVERLAY_EXPORT __declspec(dllexport)
+#else
+#define TONO_OVERLAY_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bumped when a function or TonoOverlayStyle changes incompatibly.
+#define TONO_OVERLAY_API_VERSION 1
+
+#define TONO_OVERLAY_OK 0
+// A null or malformed argument, or a style value out of range.
+#define TONO_OVERLAY_ERROR_INVALID_ARGUMENT (-1)
+// The runner has not set up the overlay (yet).
+#define TONO_OVERLAY_ERROR_NO_OVERLAY (-2)
+
+// Bits of TonoOverlayStyle.fields, one per member.
+enum {
+  TONO_OVERLAY_STYLE_FONT_FAMILY = 1u << 0,
+  TONO_OVERLAY_STYLE_FONT_SIZE = 1u << 1,
+  TONO_OVERLAY_STYLE_FONT_WEIGHT = 1u << 2,
+  TONO_OVERLAY_STYLE_BOLD = 1u << 3,
+  TONO_OVERLAY_STYLE_TEXT_COLOR = 1u << 4,
+  TONO_OVERLAY_STYLE_TEXT_OPACITY = 1u << 5,
+  TONO_OVERLAY_STYLE_STROKE_WIDTH = 1u << 6,
+  TONO_OVERLAY_STYLE_STROKE_COLOR = 1u << 7,
+  TONO_OVERLAY_STYLE_HIGHLIGHT_COLOR = 1u << 8,
+  TONO_OVERLAY_STYLE_TEXT_ALIGN = 1u << 9,
+  TONO_OVERLAY_STYLE_WIDTH = 1u << 10,
+  TONO_OVERLAY_STYLE_LINES = 1u << 11,
+  TONO_OVERLAY_STYLE_PADDING = 1u << 12,
+  TONO_OVERLAY_STYLE_X = 1u << 13,
+  TONO_OVERLAY_STYLE_Y = 1u << 14,
+  TONO_OVERLAY_STYLE_BACKGROUND_ALPHA = 1u << 15
+};
+
+// A style change: only the members whose bit is set in |fields| are read.
+// Values and ranges are those of applyOverlayStyle; colors are 0xRRGGBB
+// and text_align is 0 (left), 1 (center) or 2 (right).
+typedef struct TonoOverlayStyle {
+  // sizeof(TonoOverlayStyle) as compiled by the caller.
+  uint32_t struct_size;
+  uint32_t fields;
+  // UTF-8, NUL-terminated.
+  const char* font_family;
+  int32_t font_size;
+  int32_t font_weight;
+  int32_t bold;
+  uint32_t text_color;
+  int32_t text_opacity;
+  int32_t stroke_width;
+  uint32_t stroke_color;
+  uint32_t highlight_color;
+  int32_t text_align;
+  int32_t width;
+  int32_t lines;
+  int32_t padding;
+  int32_t x;
+  int32_t y;
+  int32_t background_alpha;
+} TonoOverlayStyle;
+
+TONO_OVERLAY_EXPORT int32_t tono_overlay_api_version(void);
+
+// Shows |len| bytes of UTF-8 text. |utf8| may be null when |len| is 0.
+TONO_OVERLAY_EXPORT int32_t tono_overlay_set_text(const char* utf8,
+                                                  size_t len);
+
+// Applies every field of |style| or, if any is invalid, none of them.
+TONO_OVERLAY_EXPORT int32_t tono_overlay_apply_style(
+    const TonoOverlayStyle* style);
+
+// Replaces the song's lyric sheet with |len| bytes of LRC text (enhanced
+// <mm:ss.xx> word tags allowed), parsed natively. |utf8| may be null when
+// |len| is 0, which clears the sheet.
+TONO_OVERLAY_EXPORT int32_t tono_overlay_set_sheet_lrc(const char* utf8,
+                                                       size_t len);
+
+// Anchors the lyric timeline: playback was at |position_ms| at the time of
+// the call, moving at |rate| (> 0) if |playing| is non-zero.
+TONO_OVERLAY_EXPORT int32_t tono_overlay_set_playback(int64_t position_ms,
+                                                      int32_t playing,
+                                                      double rate);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // OVERLAY_CORE_TONO_OVERLAY_API_H_
@@ -0,0 +1,76 @@
+#include "gdi_surface.h"
+
+#include <cstring>
+
+GdiSurface::GdiSurface(int width, int height)
+    : tono_overlay::Surface(width, height, 4) {}
+
+std::unique_ptr<GdiSurface> GdiSurface::Create(int width, int height) {
+  if (width <= 0 || height <= 0) return nullptr;
+  std::unique_ptr<GdiSurface> surface(new GdiSurface(width, height));
+  // A memory DC created from NULL is compatible with the screen, so no
+  // GetDC(NULL) round trip is needed.
+  surface->dc_ = CreateCompatibleDC(NULL);
+  if (!surface->dc_) return nullptr;
+
+  BITMAPINFO bmi = {};
+  bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+  bmi.bmiHeader.biWidth = width;
+  // top-down DIB
+  bmi.bmiHeader.biHeight = -height;
+  bmi.bmiHeader.biPlanes = 1;
+  bmi.bmiHeader.biBitCount = 32;
+  // Use BI_RGB (default DIB ordering); the allocator detects the byte
+  // ordering once. BI_BITFIELDS caused platform-dependent interpretation
+  // issues.
+  bmi.bmiHeader.biCompression = BI_RGB;
+
+  void* bits = nullptr;
+  surface->bitmap_ =
+      CreateDIBSection(surface->dc_, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+  if (!surface->bitmap_ || !bits) return nullptr;
+  surface->old_bitmap_ = SelectObject(surface->dc_, surface->bitmap_);
+  surface->set_data(static_cast<uint8_t*>(bits));
+  SetBkMode(surface->dc_, TRANSPARENT);
+  return surface;
+}
+
+GdiSurface::~GdiSurface() {
+  if (dc_ && old_bitmap_) SelectObject(dc_, old_bitmap_);
+  if (bitmap_) DeleteObject(bitmap_);
+  if (dc_) DeleteDC(dc_);
+}
+
+void GdiSurface::Clear() {
+  GdiFlush();
+  tono_overlay::Surface::Clear();
+}
+
+std::unique_ptr<tono_overlay::Surface> GdiSurfaceAllocator::Allocate(
+    int width, int height, int bytes_per_pixel) {
+  if (bytes_per_pixel != 4) {
+    if (width <= 0 || height <= 0) return nullptr;
+    return std::make_unique<tono_overlay::MemorySurface>(width, height,
+                                                         bytes_per_pixel);
+  }
+  std::unique_ptr<GdiSurface> surface = GdiSurface::Create(width, height);
+  if (surface && !format_detected_) DetectPixelFormat(surface.get());
+  return surface;
+}
+
+// Draws a known red pixel at (0,0) and checks which byte received it. This
+// handles differences in channel ordering (BGRA vs RGBA memory layout).
+void GdiSurfaceAllocator::DetectPixelFormat(GdiSurface* surface) {
+  SetPixel(surface->dc(), 0, 0, RGB(255, 0, 0));
+  GdiFlush();
+  const uint8_t* px = surface->data();
+  if (px[0] == 255) {
+    format_.r_index = 0; format_.g_index = 1; format_.b_index = 2;
+  } else if (px[1] == 255) {
+    format_.r_index = 1; format_.g_index = 0; format_.b_index = 2;
+  } else if (px[2] == 255) {
+    format_.r_index = 2; format_.g_index = 1; format_.b_index = 0;
+  }
+  std::memset(surface->data(), 0, 4);
+  format_detected_ = true;
+}
@@ -0,0 +1,50 @@
+#ifndef RUNNER_GDI_SURFACE_H_
+#define RUNNER_GDI_SURFACE_H_
+
+#include <windows.h>
+
+#include <memory>
+
+#include "overlay_core/surface.h"
+
+// A 32-bit top-down DIB section selected into its own memory DC, so GDI can
+// draw into it and the CPU can read and write the same pixels.
+class GdiSurface : public tono_overlay::Surface {
+ public:
+  // Returns null if the DC or DIB section could not be created.
+  static std::unique_ptr<GdiSurface> Create(int width, int height);
+
+  ~GdiSurface() override;
+
+  HDC dc() const { return dc_; }
+
+  // Flushes pending GDI drawing, then zeroes the pixels in place.
+  void Clear() override;
+
+ private:
+  GdiSurface(int width, int height);
+
+  HDC dc_ = nullptr;
+  HBITMAP bitmap_ = nullptr;
+  HGDIOBJ old_bitmap_ = nullptr;
+};
+
+// Allocates surfaces for a tono_overlay::SurfacePool: GdiSurfaces for 32-bit
+// slots, which GDI draws or presents from, and plain memory for A8 masks.
+// The DIB byte order is probed once, on the first GdiSurface, and reused
+// afterwards.
+class GdiSurfaceAllocator : public tono_overlay::SurfaceAllocator {
+ public:
+  std::unique_ptr<tono_overlay::Surface> Allocate(
+      int width, int height, int bytes_per_pixel) override;
+
+  tono_overlay::PixelFormat pixel_format() const override { return format_; }
+
+ private:
+  void DetectPixelFormat(GdiSurface* surface);
+
+  bool format_detected_ = false;
+  tono_overlay::PixelFormat format_;
+};
+
+#endif  // RUNNER_GDI_SURFACE_H_
@@ -0,0 +1,283 @@
+#include "gdi_text_rasterizer.h"
+
+#include <algorithm>
+
+#include "overlay_core/compositor.h"
+#include "overlay_core/marquee.h"
+#include "overlay_core/overlay_log.h"
+
+// Appends |codepoint| to |out| as UTF-16; returns the units written.
+static int append_utf16(uint32_t codepoint, std::wstring* out) {
+  if (codepoint < 0x10000) {
+    out->push_back((wchar_t)codepoint);
+    return 1;
+  }
+  codepoint -= 0x10000;
+  out->push_back((wchar_t)(0xD800 + (codepoint >> 10)));
+  out->push_back((wchar_t)(0xDC00 + (codepoint & 0x3FF)));
+  return 2;
+}
+
+struct CodepointRange {
+  uint32_t first;
+  uint32_t last;
+};
+
+// Format characters (Cf) and the supplementary-plane marks GetStringTypeW
+// cannot classify from one UTF-16 unit, sorted.
+static const CodepointRange kZeroWidthRanges[] = {
+    {0x00AD, 0x00AD},   {0x0600, 0x0605},   {0x061C, 0x061C},
+    {0x06DD, 0x06DD},   {0x070F, 0x070F},   {0x180E, 0x180E},
+    {0x200B, 0x200F},   {0x202A, 0x202E},   {0x2060, 0x2064},
+    {0x2066, 0x206F},   {0xFEFF, 0xFEFF},   {0xFFF9, 0xFFFB},
+    {0x110BD, 0x110BD}, {0x1D173, 0x1D17A}, {0xE0001, 0xE0001},
+    {0xE0020, 0xE007F}, {0xE0100, 0xE01EF},
+};
+
+// True for nonspacing and enclosing marks (Mn, Me) and format characters
+// (Cf). Measured alone GDI gives them a width of their own (a dotted
+// circle, or the box of a missing glyph), but drawn after their base they
+// take no room.
+static bool is_zero_width(uint32_t codepoint) {
+  for (const CodepointRange& range : kZeroWidthRanges) {
+    if (codepoint < range.first) break;
+    if (codepoint <= range.last) return true;
+  }
+  if (codepoint < 0x0300 || codepoint >= 0x10000) return false;
+  const wchar_t unit = (wchar_t)codepoint;
+  WORD type = 0;
+  return GetStringTypeW(CT_CTYPE3, &unit, 1, &type) &&
+         (type & C3_NONSPACING) != 0;
+}
+
+// 26.6 fixed point to the nearest whole pixel.
+static int round_px(int32_t v) { return (v + 32) >> 6; }
+
+int EffectiveFontWeight(int weight, bool bold) {
+  return weight > 0 ? weight : (bold ? FW_BOLD : FW_NORMAL);
+}
+
+HFONT CreateOverlayFont(const std::wstring& family, int size_pt, int weight,
+                        int dpi) {
+  // CreateFont expects height in logical units (pixels). Convert points to
+  // pixels.
+  int height = -MulDiv(size_pt, dpi, 72);
+  return CreateFontW(
+      height, 0, 0, 0, weight, FALSE, FALSE, FALSE,
+      DEFAULT_CHARSET,
+      OUT_TT_PRECIS,              // Prefer TrueType
+      CLIP_DEFAULT_PRECIS,
+      CLEARTYPE_NATURAL_QUALITY,  // Better weight rendering on LCD
+      DEFAULT_PITCH | FF_DONTCARE,
+      family.c_str());
+}
+
+std::wstring WideFromUtf8(const std::string& s) {
+  std::wstring wide;
+  int size_needed =
+      MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), NULL, 0);
+  if (size_needed > 0) {
+    wide.resize(size_needed);
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), &wide[0],
+                        size_needed);
+  }
+  return wide;
+}
+
+GdiFont::GdiFont(HFONT handle, const tono_overlay::FontMetrics& metrics)
+    : handle_(handle) {
+  metrics_ = metrics;
+}
+
+GdiFont::~GdiFont() {
+  DeleteObject(handle_);
+}
+
+// Opens GdiFonts and measures them on a memory DC.
+class GdiFontFactory : public tono_overlay::FontFactory {
+ public:
+  std::unique_ptr<tono_overlay::FontInstance> Open(
+      const tono_overlay::FontKey& key) override {
+    HFONT font = CreateOverlayFont(WideFromUtf8(key.family), key.size_pt,
+                                   key.weight, key.dpi);
+    if (!font) {
+      TONO_LOG(kError, "GdiFontFactory: CreateFontW failed for family="
+                           << key.family << " size=" << key.size_pt);
+      return nullptr;
+    }
+    tono_overlay::FontMetrics metrics;
+    HDC dc = CreateCompatibleDC(nullptr);
+    HGDIOBJ old_font = SelectObject(dc, font);
+    TEXTMETRICW tm = {};
+    if (GetTextMetricsW(dc, &tm)) {
+      metrics.ascent = tm.tmAscent;
+      metrics.descent = tm.tmDescent;
+      metrics.height = tm.tmHeight;
+      metrics.line_height = tm.tmHeight + tm.tmExternalLeading;
+    }
+    SelectObject(dc, old_font);
+    DeleteDC(dc);
+    TONO_VLOG("GdiFontFactory: family=" << key.family << " size="
+                                        << key.size_pt << " weight="
+                                        << key.weight << " dpi=" << key.dpi
+                                        << " line_height="
+                                        << metrics.line_height);
+    return std::make_unique<GdiFont>(font, metrics);
+  }
+};
+
+tono_overlay::FontKey OverlayFontKey(
+    const tono_overlay::OverlayStyle& style) {
+  // The system dpi is fixed for the process; one screen DC, once.
+  static const int dpi = [] {
+    HDC hdc = GetDC(NULL);
+    const int logpixely = GetDeviceCaps(hdc, LOGPIXELSY);
+    ReleaseDC(NULL, hdc);
+    return logpixely > 0 ? logpixely : 96;
+  }();
+  tono_overlay::FontKey key;
+  key.family = style.font_family;
+  key.size_pt = style.font_size;
+  key.weight = EffectiveFontWeight(style.font_weight, style.font_bold);
+  key.dpi = dpi;
+  return key;
+}
+
+tono_overlay::FontCache& GdiFontCache() {
+  // Never destroyed: render threads may still hold fonts during shutdown.
+  static tono_overlay::FontCache* cache =
+      new tono_overlay::FontCache(std::make_unique<GdiFontFactory>());
+  return *cache;
+}
+
+GdiTextRasterizer::~GdiTextRasterizer() {
+  if (measure_dc_) DeleteDC(measure_dc_);
+}
+
+std::unique_ptr<tono_overlay::SurfaceAllocator>
+GdiTextRasterizer::CreateSurfaceAllocator() {
+  return std::make_unique<GdiSurfaceAllocator>();
+}
+
+HFONT GdiTextRasterizer::FontFor(const tono_overlay::OverlayStyle& style) {
+  const tono_overlay::FontKey key = OverlayFontKey(style);
+  if (!has_key_ || key != key_) {
+    font_ = GdiFontCache().Get(key);
+    has_key_ = true;
+    key_ = key;
+    font_key_ = tono_overlay::FontKeyHash(key);
+  }
+  return font_ ? static_cast<GdiFont*>(font_.get())->handle() : nullptr;
+}
+
+HDC GdiTextRasterizer::MeasureDc() {
+  if (!measure_dc_) measure_dc_ = CreateCompatibleDC(NULL);
+  return measure_dc_;
+}
+
+int GdiTextRasterizer::MeasureLine(const std::string& text,
+                                   const tono_overlay::OverlayStyle& style) {
+  HDC dc = MeasureDc();
+  if (!dc) return 0;
+  HFONT font = FontFor(style);
+  HGDIOBJ old_font = font ? SelectObject(dc, font) : nullptr;
+  tono_overlay::LayoutParams params;
+  // Wide enough that no sensible line is cut; the marquee caps the strip.
+  params.max_width = (int32_t)tono_overlay::kMaxMarqueeStripWidth * 4 * 64;
+  params.max_lines = 1;
+  params.font_key = font_key_;
+  dc_ = dc;
+  layout_.Layout(text, params, this);
+  dc_ = nullptr;
+  if (old_font) SelectObject(dc, old_font);
+  if (layout_.lines().empty()) return 0;
+  return (layout_.lines()[0].width + 63) / 64;
+}
+
+uint32_t GdiTextRasterizer::GlyphIndex(uint32_t codepoint) {
+  return codepoint;
+}
+
+int32_t GdiTextRasterizer::GlyphAdvance(uint32_t glyph) {
+  // Marks ride on the character before them, so a cluster is as wide as
+  // its base and ExtTextOutW gets them a zero lpDx below.
+  if (is_zero_width(glyph)) return 0;
+  std::wstring units;
+  const int count = append_utf16(glyph, &units);
+  SIZE size = {};
+  if (!GetTextExtentPoint32W(dc_, units.c_str(), count, &size)) return 0;
+  return (int32_t)size.cx * 64;
+}
+
+bool GdiTextRasterizer::Rasterize(const std::string& text,
+                                  const tono_overlay::OverlayStyle& style,
+                                  tono_overlay::Surface* fill) {
+  if (fill->bytes_per_pixel() != 1) return false;
+  if (!scratch_ || scratch_->width() != fill->width() ||
+      scratch_->height() != fill->height()) {
+    scratch_ = GdiSurface::Create(fill->width(), fill->height());
+    if (!scratch_) return false;
+  } else {
+    scratch_->Clear();
+  }
+  HDC dc = scratch_->dc();
+  // Without a font GDI falls back to the DC's default one.
+  HFONT font = FontFor(style);
+  HGDIOBJ old_font = font ? SelectObject(dc, font) : nullptr;
+  SetTextColor(dc, RGB(255, 255, 255));
+  SetTextAlign(dc, TA_TOP | TA_LEFT | TA_NOUPDATECP);
+
+  RECT tr = {style.padding, style.padding, fill->width() - style.padding,
+             fill->height() - style.padding};
+  if (tr.right > tr.left && tr.bottom > tr.top) {
+    tono_overlay::LayoutParams params;
+    params.max_width = (int32_t)(tr.right - tr.left) * 64;
+    params.max_lines = std::max(style.lines, 1);
+    params.align = style.text_align;
+    params.font_key = font_key_;
+    dc_ = dc;
+    layout_.Layout(text, params, this);
+    dc_ = nullptr;
+
+    int line_height = font_ ? font_->metrics().height : 0;
+    if (line_height <= 0) {
+      TEXTMETRICW metrics = {};
+      GetTextMetricsW(dc, &metrics);
+      line_height = std::max((int)metrics.tmHeight, 1);
+    }
+    // One line is centered like DT_VCENTER; wrapped lines start at the top.
+    int top = tr.top;
+    if (style.lines <= 1) top += (tr.bottom - tr.top - line_height) / 2;
+    const std::vector<tono_overlay::LayoutGlyph>& glyphs = layout_.glyphs();
+    for (const tono_overlay::LayoutLine& line : layout_.lines()) {
+      if (line.begin == line.end) {
+        top += line_height;
+        continue;
+      }
+      // The whole line in one call, each character placed where the
+      // layout put it. A mark has no advance, so it starts where the next
+      // cluster does and its lpDx is 0: GDI shapes it onto the base
+      // character instead of giving it a cell of its own.
+      line_text_.clear();
+      line_dx_.clear();
+      const int x0 = round_px(glyphs[line.begin].x);
+      for (size_t i = line.begin; i < line.end; ++i) {
+        const int x = round_px(glyphs[i].x);
+        const int next = i + 1 < line.end ? round_px(glyphs[i + 1].x) : x;
+        const int units = append_utf16(glyphs[i].codepoint, &line_text_);
+        line_dx_.push_back(next - x);
+        if (units == 2) line_dx_.push_back(0);
+      }
+      ExtTextOutW(dc, tr.left + x0, top, ETO_CLIPPED, &tr, line_text_.c_str(),
+                  (UINT)line_text_.size(), line_dx_.data());
+      top += line_height;
+    }
+  }
+  // Deselect so the font can be deleted later.
+  if (old_font) SelectObject(dc, old_font);
+  // Make sure GDI has finished writing the DIB bits before they are read.
+  GdiFlush();
+  tono_overlay::MaskToA8(scratch_->data(), fill->data(),
+                         (size_t)fill->width() * fill->height());
+  return true;
+}
@@ -0,0 +1,105 @@
+#ifndef RUNNER_GDI_TEXT_RASTERIZER_H_
+#define RUNNER_GDI_TEXT_RASTERIZER_H_
+
+#include <windows.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gdi_surface.h"
+#include "overlay_core/font_cache.h"
+#include "overlay_core/text_layer.h"
+#include "overlay_core/text_layout.h"
+
+// Weight actually passed to CreateFontW for the given style settings.
+int EffectiveFontWeight(int weight, bool bold);
+
+// Creates the overlay HFONT for a family, a size in points, a weight and
+// the dpi the size is converted at.
+HFONT CreateOverlayFont(const std::wstring& family, int size_pt, int weight,
+                        int dpi);
+
+std::wstring WideFromUtf8(const std::string& s);
+
+// An HFONT with its metrics, owned by the FontCache it came from. GDI
+// fonts may be selected into DCs on several threads at once, so one cache
+// serves the window, render and prerender threads.
+class GdiFont : public tono_overlay::FontInstance {
+ public:
+  GdiFont(HFONT handle, const tono_overlay::FontMetrics& metrics);
+  ~GdiFont() override;
+
+  GdiFont(const GdiFont&) = delete;
+  GdiFont& operator=(const GdiFont&) = delete;
+
+  HFONT handle() const { return handle_; }
+
+ private:
+  HFONT handle_;
+};
+
+// FontCache key for |style| at the screen dpi, read once per process.
+tono_overlay::FontKey OverlayFontKey(
+    const tono_overlay::OverlayStyle& style);
+
+// The process-wide cache of GdiFonts.
+tono_overlay::FontCache& GdiFontCache();
+
+// tono_overlay::TextRasterizer on GDI: lays text out with
+// tono_overlay::TextLayout and draws each line with ExtTextOutW into a
+// 32-bit scratch GdiSurface, then reduces it to the A8 fill mask. Glyphs are
+// drawn by code point, so GDI font linking still supplies CJK and emoji the
+// chosen family lacks. Fonts come from GdiFontCache(); the layout state is
+// per instance, so one instance must stay on one thread.
+class GdiTextRasterizer : public tono_overlay::TextRasterizer,
+                          private tono_overlay::GlyphSource {
+ public:
+  GdiTextRasterizer() = default;
+  ~GdiTextRasterizer() override;
+
+  GdiTextRasterizer(const GdiTextRasterizer&) = delete;
+  GdiTextRasterizer& operator=(const GdiTextRasterizer&) = delete;
+
+  std::unique_ptr<tono_overlay::SurfaceAllocator> CreateSurfaceAllocator()
+      override;
+  bool Rasterize(const std::string& text,
+                 const tono_overlay::OverlayStyle& style,
+                 tono_overlay::Surface* fill) override;
+  int MeasureLine(const std::string& text,
+                  const tono_overlay::OverlayStyle& style) override;
+
+  // The font for |style| from GdiFontCache(), looked up again only when
+  // the family, size or weight changed since the last call. Null if
+  // CreateFontW failed.
+  HFONT FontFor(const tono_overlay::OverlayStyle& style);
+
+  // A memory DC for measuring text outside Rasterize(), created on first
+  // use. Null if CreateCompatibleDC failed.
+  HDC MeasureDc();
+
+ private:
+  // GlyphSource on |dc_| with the current font selected. The "glyph" is
+  // the code point itself; marks and format characters advance by 0.
+  uint32_t GlyphIndex(uint32_t codepoint) override;
+  int32_t GlyphAdvance(uint32_t glyph) override;
+
+  // Held so the font outlives its eviction while this instance draws.
+  std::shared_ptr<tono_overlay::FontInstance> font_;
+  bool has_key_ = false;
+  tono_overlay::FontKey key_;
+  // FontKeyHash(key_), naming the font for TextLayout's caches.
+  uint64_t font_key_ = 0;
+  HDC dc_ = nullptr;
+  HDC measure_dc_ = nullptr;
+  // What GDI draws into, as large as the last layer; the coverage is
+  // copied to the A8 fill mask after each draw.
+  std::unique_ptr<GdiSurface> scratch_;
+  tono_overlay::TextLayout layout_;
+  // Scratch reused across calls.
+  std::wstring line_text_;
+  std::vector<INT> line_dx_;
+};
+
+#endif  // RUNNER_GDI_TEXT_RASTERIZER_H_
@@ -9,78 +9,74 @@
 
 #include <windows.h>
 #include <shellapi.h>
-#include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
+#include <memory>
+#include <cstring>
 #include <cmath>
 #include <variant>
 
-// Keep overlay state in this compilation unit.
-static HWND overlay_hwnd = nullptr;
-// Separate topmost window used to render opaque text via UpdateLayeredWindow.
-static HWND overlay_text_hwnd = nullptr;
-static std::wstring overlay_text = L"";
-static int overlay_x = 100;
-static int overlay_y = 100;
-static int overlay_w = 600;
-static int overlay_h = 64;
+#include "gdi_surface.h"
+#include "gdi_text_rasterizer.h"
+#include "vsync_pacer.h"
+#include "overlay_core/clock.h"
+#include "overlay_core/font_cache.h"
+#include "overlay_core/karaoke.h"
+#include "overlay_core/line_cache.h"
+#include "overlay_core/line_prerenderer.h"
+#include "overlay_core/line_transition.h"
+#include "overlay_core/lrc_parser.h"
+#include "overlay_core/lyric_timeline.h"
+#include "overlay_core/marquee.h"
+#include "overlay_core/overlay_api.h"
+#include "overlay_core/overlay_instance.h"
+#include "overlay_core/overlay_log.h"
+#include "overlay_core/overlay_state.h"
+#include "overlay_core/overlay_stats.h"
+#include "overlay_core/overlay_style_decoder.h"
+#include "overlay_core/overlay_trace.h"
+#include "overlay_core/render_thread.h"
+#include "overlay_core/surface.h"
+#include "overlay_core/text_layer.h"
+
+// Every overlay window lives in an OverlayInstance, kept by id in
+// overlay_instances(). What follows is shared by all of them, so another
+// overlay costs its windows, state and frame buffers but no thread, font
+// or cache of its own.
 static ATOM overlay_class_atom = 0;
-// Current alpha value for layered window (0..255). Default to previous 230.
-static int overlay_alpha = 30;
-static std::wstring overlay_font_family = L"Segoe UI";
-static int overlay_font_size = 14; // points
-static HFONT overlay_hfont = nullptr;
-// Bold flag for font weight
-static bool overlay_font_bold = false;
-// Explicit font weight (GDI FW_*) 100..900; defaults to 400
-static int overlay_font_weight = FW_NORMAL;
-// Text color for drawing (RGB). Default white.
-static COLORREF overlay_text_color = RGB(255, 255, 255);
-// Number of text lines to display (for wrapping). 1 = single line.
-static int overlay_lines = 1;
-// Padding inside text bitmap (both background and text layer).
-static int overlay_padding = 8;
-// Text opacity multiplier 0..255 (255 fully opaque, 0 fully transparent)
-static int overlay_text_opacity = 255;
-// Stroke settings
-static int overlay_stroke_width = 0; // 0 = no stroke
-static COLORREF overlay_stroke_color = RGB(0, 0, 0);
-// Text horizontal alignment: 0=left,1=center,2=right
-static int overlay_text_align = 0;
-
-// Forward declaration of logging helper (defined later).
-static void AppendOverlayLog(const std::string& s);
-
-// Create or recreate HFONT based on current overlay_font_family and overlay_font_size.
-static void update_overlay_font() {
-  if (overlay_hfont) {
-    DeleteObject(overlay_hfont);
-    overlay_hfont = nullptr;
-  }
-  // CreateFont expects height in logical units (pixels). Convert points to pixels.
-  HDC hdc = GetDC(NULL);
-  int logpixely = GetDeviceCaps(hdc, LOGPIXELSY);
-  ReleaseDC(NULL, hdc);
-  int height = -MulDiv(overlay_font_size, logpixely, 72);
-  int weight = overlay_font_weight > 0 ? overlay_font_weight : (overlay_font_bold ? FW_BOLD : FW_NORMAL);
-  overlay_hfont = CreateFontW(
-      height, 0, 0, 0, weight, FALSE, FALSE, FALSE,
-      DEFAULT_CHARSET,
-      OUT_TT_PRECIS,              // Prefer TrueType
-      CLIP_DEFAULT_PRECIS,
-      CLEARTYPE_NATURAL_QUALITY,  // Better weight rendering on LCD
-      DEFAULT_PITCH | FF_DONTCARE,
-      overlay_font_family.c_str());
-  std::ostringstream ss;
-  ss << "update_overlay_font: size=" << overlay_font_size
-     << " weight=" << weight
-     << " family(wide) set";
-  AppendOverlayLog(ss.str());
-}
+// Finished lines keyed by text + style, so repeated lines (choruses, or
+// the same line in two overlays) skip rasterization and compositing.
+// Declared before anything that writes to it so it is destroyed last.
+static tono_overlay::LineCache overlay_line_cache;
+// The one thread every overlay's RenderThread draws on, and the text
+// pipeline it draws with. Created with the first window.
+static std::shared_ptr<tono_overlay::RenderWorker> overlay_render_worker;
+static const UINT kOverlayFrameReadyMessage = WM_APP + 1;
+// Message-only window that receives the wake-ups of the C API
+// (tono_overlay_api.h) and the vsync pacer.
+static HWND overlay_message_hwnd = nullptr;
+static const UINT kOverlayApiWakeMessage = WM_APP + 2;
+// Paces every upload to the display refresh. Finished frames, karaoke
+// sweeps and line transitions only request a frame; the next
+// kOverlayVsyncMessage then presents each overlay that asked once, so any
+// number of setters landing within one refresh cost a single
+// UpdateLayeredWindowIndirect per overlay. Created with the first window.
+static std::unique_ptr<VsyncPacer> overlay_vsync;
+static const UINT kOverlayVsyncMessage = WM_APP + 3;
+static const UINT_PTR kOverlayTimelineTimer = 1;
+static tono_overlay::SteadyClock overlay_clock;
+// Parses setLyricsSheet's {lrc} on the window thread; its storage is reused
+// from song to song.
+static tono_overlay::LrcParser overlay_lrc_parser;
 
-// Logging helper that appends a line to %TEMP%\tono_lyrics_overlay.log
-static void AppendOverlayLog(const std::string& s) {
+// Writes TONO_LOG output to %TEMP%\tono_lyrics_overlay.log from a background
+// thread. Installed by RegisterLyricsOverlayChannel.
+static std::unique_ptr<tono_overlay::ScopedOverlayLogger> overlay_logger;
+
+// Creates the overlay logger on first use.
+static void ensure_overlay_logger() {
+  if (overlay_logger) return;
   char* tmp_buf = nullptr;
   size_t bufsize = 0;
   std::string path;
@@ -91,94 +87,105 @@ static void AppendOverlayLog(const std::string& s) {
     path = ".";
   }
   path += "\\tono_lyrics_overlay.log";
-  std::ofstream f(path, std::ios::app);
-  if (f) f << s << std::endl;
+  overlay_logger = std::make_unique<tono_overlay::ScopedOverlayLogger>(
+      std::make_unique<tono_overlay::AsyncLogger>(std::make_unique<tono_overlay::FileLogSink>(path)));
 }
 
 static LRESULT CALLBACK OverlayWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
-// Forward declare text layer updater
-static void update_text_layer();
-static void update_overlay_size_and_redraw();
-static int get_line_height_pixels();
-
-// Robust parsing helpers for EncodableValue -> int/bool/color
-static bool ParseIntFromEncodable(const flutter::EncodableValue* v, int& out) {
-  if (!v) return false;
-  if (const int64_t* pi = std::get_if<int64_t>(v)) {
-    out = (int)*pi;
+
+// Converts a channel scalar for OverlayStyleUpdate::Decode.
+static bool StyleValueFromEncodable(const flutter::EncodableValue& v, tono_overlay::StyleValue* out) {
+  if (const std::string* ps = std::get_if<std::string>(&v)) {
+    *out = tono_overlay::StyleValue::String(*ps);
     return true;
   }
-  if (const double* pd = std::get_if<double>(v)) {
-    out = (int)std::round(*pd);
+  if (const bool* pb = std::get_if<bool>(&v)) {
+    *out = tono_overlay::StyleValue::Bool(*pb);
     return true;
   }
-  if (const std::string* ps = std::get_if<std::string>(v)) {
-    try {
-      out = std::stoi(*ps);
-      return true;
-    } catch (...) {
-      return false;
-    }
+  if (const int32_t* pi32 = std::get_if<int32_t>(&v)) {
+    *out = tono_overlay::StyleValue::Number(*pi32);
+    return true;
   }
-  if (const std::vector<uint8_t>* pb = std::get_if<std::vector<uint8_t>>(v)) {
-    try {
-      std::string s(pb->begin(), pb->end());
-      out = std::stoi(s);
-      return true;
-    } catch (...) {
-      return false;
-    }
+  if (const int64_t* pi = std::get_if<int64_t>(&v)) {
+    *out = tono_overlay::StyleValue::Number((double)*pi);
+    return true;
+  }
+  if (const double* pd = std::get_if<double>(&v)) {
+    *out = tono_overlay::StyleValue::Number(*pd);
+    return true;
+  }
+  if (const std::vector<uint8_t>* pbytes = std::get_if<std::vector<uint8_t>>(&v)) {
+    *out = tono_overlay::StyleValue::String(
+        std::string_view(reinterpret_cast<const char*>(pbytes->data()), pbytes->size()));
+    return true;
   }
   return false;
 }
 
-static bool ParseBoolFromEncodable(const flutter::EncodableValue* v, bool& out) {
-  if (!v) return false;
-    if (const std::string* ps = std::get_if<std::string>(v)) {
-    std::string s = *ps;
-    for (auto &c : s) c = (char)tolower(c);
-    if (s == "true" || s == "1") { out = true; return true; }
-    if (s == "false" || s == "0") { out = false; return true; }
-  }
-  return false;
+// Looks up |key| in a map argument; null if |arguments| is not a map or lacks it.
+static const flutter::EncodableValue* LookupArg(const flutter::EncodableValue* arguments, const char* key) {
+  const auto* map = std::get_if<flutter::EncodableMap>(arguments);
+  if (!map) return nullptr;
+  auto it = map->find(flutter::EncodableValue(key));
+  return it == map->end() ? nullptr : &it->second;
 }
 
-static bool ParseColorFromEncodable(const flutter::EncodableValue* v, int& out_rgb) {
-  if (!v) return false;
-  // Prefer string hex
-  if (const std::string* ps = std::get_if<std::string>(v)) {
-    try {
-      std::string s = *ps;
-      if (!s.empty() && s[0] == '#') s = s.substr(1);
-      if (s.rfind("0x", 0) == 0 || s.rfind("0X", 0) == 0) s = s.substr(2);
-      out_rgb = (int)std::stoul(s, nullptr, 16) & 0xFFFFFF;
-      return true;
-    } catch (...) {
-      // fall through
-    }
+// Scalar arguments that are not style fields (positions, flags, budgets),
+// decoded like the fields: native values or their string forms.
+static bool IntArg(const flutter::EncodableValue* v, int* out) {
+  tono_overlay::StyleValue value;
+  return v && StyleValueFromEncodable(*v, &value) && tono_overlay::StyleValueToInt(value, out);
+}
+
+static bool NumberArg(const flutter::EncodableValue* v, double* out) {
+  tono_overlay::StyleValue value;
+  return v && StyleValueFromEncodable(*v, &value) && tono_overlay::StyleValueToNumber(value, out);
+}
+
+static bool BoolArg(const flutter::EncodableValue* v, bool* out) {
+  tono_overlay::StyleValue value;
+  return v && StyleValueFromEncodable(*v, &value) && tono_overlay::StyleValueToBool(value, out);
+}
+
+// Channel arguments for the style decoding in overlay_core.
+class EncodableStyleArgs : public tono_overlay::StyleArgs {
+ public:
+  explicit EncodableStyleArgs(const flutter::EncodableValue* arguments) : arguments_(arguments) {}
+
+  bool IsMap() const override { return std::get_if<flutter::EncodableMap>(arguments_) != nullptr; }
+  Lookup Find(const char* key, tono_overlay::StyleValue* value) const override {
+    return Convert(LookupArg(arguments_, key), value);
   }
-  int tmp;
-  if (ParseIntFromEncodable(v, tmp)) {
-    out_rgb = tmp & 0xFFFFFF;
-    return true;
+  Lookup Self(tono_overlay::StyleValue* value) const override {
+    return IsMap() ? Lookup::kMissing : Convert(arguments_, value);
   }
-  if (const std::vector<uint8_t>* pb = std::get_if<std::vector<uint8_t>>(v)) {
-    try {
-      std::string s(pb->begin(), pb->end());
-      if (!s.empty() && s[0] == '#') s = s.substr(1);
-      out_rgb = (int)std::stoul(s, nullptr, 16) & 0xFFFFFF;
-      return true;
-    } catch (...) {}
+  void ForEach(const EntryVisitor& visit) const override {
+    const auto* map = std::get_if<flutter::EncodableMap>(arguments_);
+    if (!map) return;
+    for (const auto& entry : *map) {
+      const std::string* key = std::get_if<std::string>(&entry.first);
+      tono_overlay::StyleValue value;
+      const Lookup lookup = Convert(&entry.second, &value);
+      if (!visit(key ? key->c_str() : nullptr, lookup, value)) return;
+    }
   }
-  return false;
-}
+
+ private:
+  static Lookup Convert(const flutter::EncodableValue* v, tono_overlay::StyleValue* out) {
+    if (!v) return Lookup::kMissing;
+    return StyleValueFromEncodable(*v, out) ? Lookup::kFound : Lookup::kUnsupported;
+  }
+
+  const flutter::EncodableValue* arguments_;
+};
 
 static const wchar_t* kOverlayClass = L"TonoMusicLyricsOverlay";
 
 static void ensure_overlay_class() {
   WNDCLASSEX existing = {};
   if (GetClassInfoEx(GetModuleHandle(NULL), kOverlayClass, &existing)) {
-    AppendOverlayLog("ensure_overlay_class: class already registered");
+    TONO_VLOG("ensure_overlay_class: class already registered");
     return;
   }
   WNDCLASSEX wcex = {};
@@ -194,443 +201,1095 @@ static void ensure_overlay_class() {
   ATOM atom = RegisterClassEx(&wcex);
   if (atom) {
     overlay_class_atom = atom;
-    AppendOverlayLog("ensure_overlay_class: RegisterClassEx succeeded");
+    TONO_VLOG("ensure_overlay_class: RegisterClassEx succeeded");
   } else {
-    std::ostringstream ss;
-    ss << "ensure_overlay_class: RegisterClassEx failed, GetLastError=" << GetLastError();
-    AppendOverlayLog(ss.str());
+    TONO_LOG(kError, "ensure_overlay_class: RegisterClassEx failed, GetLastError=" << GetLastError());
   }
 }
 
-static bool create_overlay() {
-  if (overlay_hwnd) return true;
-  AppendOverlayLog("create_overlay: starting");
+// Creates the message-only window on first use.
+static HWND ensure_overlay_message_window() {
+  if (overlay_message_hwnd) return overlay_message_hwnd;
   ensure_overlay_class();
-  {
-    std::ostringstream ss;
-    ss << "create_overlay: params x=" << overlay_x << " y=" << overlay_y << " w=" << overlay_w << " h=" << overlay_h;
-    AppendOverlayLog(ss.str());
+  overlay_message_hwnd = CreateWindowEx(0, kOverlayClass, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, NULL,
+                                        GetModuleHandle(NULL), NULL);
+  if (!overlay_message_hwnd) {
+    TONO_LOG(kError, "ensure_overlay_message_window: CreateWindowEx failed, GetLastError=" << GetLastError());
+  }
+  return overlay_message_hwnd;
+}
+
+// Creates the render worker and the vsync pacer with the first window.
+static bool ensure_overlay_shared_resources() {
+  if (!overlay_render_worker) overlay_render_worker = std::make_shared<tono_overlay::RenderWorker>();
+  if (!overlay_vsync && ensure_overlay_message_window()) {
+    overlay_vsync = std::make_unique<VsyncPacer>(overlay_message_hwnd, kOverlayVsyncMessage);
+  }
+  return overlay_vsync != nullptr;
+}
+
+// Raw bytes of a wide string, used as line cache and sheet text.
+static std::string wide_bytes(const std::wstring& s) {
+  return std::string(reinterpret_cast<const char*>(s.data()), s.size() * sizeof(wchar_t));
+}
+
+// UTF-8 of text held as wide_bytes(), for the text rasterizer.
+static std::string utf8_from_wide_bytes(const std::string& bytes) {
+  const wchar_t* wide = reinterpret_cast<const wchar_t*>(bytes.data());
+  const int length = (int)(bytes.size() / sizeof(wchar_t));
+  std::string utf8;
+  int size_needed = WideCharToMultiByte(CP_UTF8, 0, wide, length, NULL, 0, NULL, NULL);
+  if (size_needed > 0) {
+    utf8.resize(size_needed);
+    WideCharToMultiByte(CP_UTF8, 0, wide, length, &utf8[0], size_needed, NULL, NULL);
+  }
+  return utf8;
+}
+
+// The output of a text layer drawn by a GdiTextRasterizer; its masks are
+// plain A8 memory.
+static GdiSurface* text_layer_output(tono_overlay::SurfacePool* surfaces) {
+  return static_cast<GdiSurface*>(surfaces->surface(tono_overlay::kTextLayerOutput));
+}
+
+// Text pipeline with its own HFONT and stroke scratch buffers, for one
+// thread.
+struct OverlayTextRenderer {
+  GdiTextRasterizer rasterizer;
+  tono_overlay::TextLayerPipeline pipeline{&rasterizer};
+};
+
+// Style and width |text| is drawn with for a |w| pixel window: the window
+// itself, or a wider strip without the plate when the line scrolls as a
+// marquee.
+static tono_overlay::OverlayStyle layer_style(GdiTextRasterizer* rasterizer, const std::string& text,
+                                              const tono_overlay::OverlayStyle& style, int w, int* layer_w) {
+  *layer_w = tono_overlay::MarqueeStripWidth(rasterizer, text, style, w);
+  return *layer_w > w ? tono_overlay::MarqueeStripStyle(style) : style;
+}
+
+// Text renderer and surfaces owned by one pre-render function. The worker
+// thread is the only user while the function is alive.
+struct OverlayPrerenderTarget {
+  OverlayTextRenderer renderer;
+  std::unique_ptr<tono_overlay::SurfacePool> surfaces;
+};
+
+// Returns the function the prerenderer uses to draw sheet lines (wide_bytes
+// text) with |style| into w x h layers, or wider strips for lines that scroll.
+// The worker gets its own surfaces and HFONT so it never shares GDI objects
+// with the window thread.
+static tono_overlay::LinePrerenderer::RenderFn make_prerender_fn(const tono_overlay::OverlayStyle& style, int w,
+                                                                 int h) {
+  auto state = std::make_shared<OverlayPrerenderTarget>();
+  return [style, w, h, state](const std::string& text, tono_overlay::LineBitmap* out) {
+    if (!state->surfaces) state->surfaces = state->renderer.pipeline.CreateSurfaces();
+    const std::string utf8 = utf8_from_wide_bytes(text);
+    int layer_w = w;
+    const tono_overlay::OverlayStyle drawn = layer_style(&state->renderer.rasterizer, utf8, style, w, &layer_w);
+    tono_overlay::Surface* output =
+        state->renderer.pipeline.Render(utf8, drawn, layer_w, h, state->surfaces.get());
+    if (!output) return false;
+    out->width = output->width();
+    out->height = output->height();
+    out->pixels.assign(output->data(), output->data() + output->size_bytes());
+    return true;
+  };
+}
+
+// Maps the word timings of a karaoke line to sweep segments in pixels,
+// measuring |text| with the font the fill mask was drawn with. Single-line
+// layout only, matching the one-line layout of GdiTextRasterizer.
+static void build_karaoke_segments(const tono_overlay::OverlayStyle& style, int width, const std::wstring& text,
+                                   const std::vector<tono_overlay::LrcWord>& words, int64_t line_end_ms,
+                                   HDC dc, HFONT font, std::vector<tono_overlay::KaraokeSegment>* segments) {
+  segments->clear();
+  if (text.empty() || words.empty() || !dc) return;
+  HGDIOBJ oldFont = font ? SelectObject(dc, font) : nullptr;
+  // extents[i] = width of the first i + 1 characters.
+  std::vector<int> extents(text.size());
+  SIZE size = {};
+  GetTextExtentExPointW(dc, text.c_str(), (int)text.size(), 0, NULL, extents.data(), &size);
+  if (oldFont) SelectObject(dc, oldFont);
+
+  const int avail = width - 2 * style.padding;
+  int x0 = style.padding;
+  if (size.cx < avail) {
+    if (style.text_align == 1) x0 += (avail - size.cx) / 2;
+    else if (style.text_align == 2) x0 += avail - size.cx;
+  }
+  auto x_at = [&](size_t offset) {
+    int x = x0 + (offset == 0 ? 0 : extents[std::min(offset, text.size()) - 1]);
+    return std::min(x, width - style.padding);
+  };
+  for (size_t i = 0; i < words.size(); ++i) {
+    if (words[i].begin >= text.size()) break;  // end-of-line marker
+    tono_overlay::KaraokeSegment segment;
+    segment.start_ms = words[i].time_ms;
+    segment.x_begin = x_at(words[i].begin);
+    if (i + 1 < words.size()) {
+      segment.end_ms = words[i + 1].time_ms;
+      segment.x_end = x_at(words[i + 1].begin);
+    } else {
+      segment.end_ms = std::max(line_end_ms, segment.start_ms);
+      segment.x_end = x_at(text.size());
+    }
+    segments->push_back(segment);
+  }
+}
+
+// Draws |snapshot| into |buffer| on the render thread. A word-timed line gets
+// its masks and sweep segments, which the window thread composites. A plain
+// line comes from the line cache, from recoloring the buffer's masks when only
+// colors changed, or from rasterizing. A line that scrolls is drawn into a
+// strip wider than the window, cached under the window's key like any other
+// line.
+static bool render_overlay_frame(OverlayTextRenderer* renderer, const tono_overlay::RenderSnapshot& snapshot,
+                                 tono_overlay::RenderBuffer* buffer) {
+  const int w = snapshot.width;
+  const int h = snapshot.height;
+  const std::string utf8 = utf8_from_wide_bytes(snapshot.text);
+  int layer_w = w;
+  const tono_overlay::OverlayStyle style = layer_style(&renderer->rasterizer, utf8, snapshot.style, w, &layer_w);
+  if (!buffer->surfaces) buffer->surfaces = renderer->pipeline.CreateSurfaces();
+  tono_overlay::SurfacePool* surfaces = buffer->surfaces.get();
+  const uint64_t allocations_before = surfaces->allocation_count();
+  if (!surfaces->EnsureSize(layer_w, h)) {
+    buffer->raster_hash = 0;
+    TONO_LOG(kError, "render_overlay_frame: surface allocation failed for " << layer_w << "x" << h);
+    return false;
+  }
+  if (surfaces->allocation_count() != allocations_before) {
+    buffer->raster_hash = 0;
+    tono_overlay::PixelFormat fmt = surfaces->pixel_format();
+    TONO_LOG(kInfo, "render_overlay_frame: allocated " << layer_w << "x" << h << " surfaces, byte ordering R="
+                                                       << fmt.r_index << " G=" << fmt.g_index << " B="
+                                                       << fmt.b_index);
+  }
+
+  const std::wstring text(reinterpret_cast<const wchar_t*>(snapshot.text.data()),
+                          snapshot.text.size() / sizeof(wchar_t));
+  const uint64_t raster_hash = tono_overlay::TextLayerRasterHash(snapshot.text, style, layer_w, h);
+  tono_overlay::LineCacheKey cache_key;
+  cache_key.text = snapshot.text;
+  cache_key.style_hash = tono_overlay::TextLayerStyleHash(snapshot.style, w, h, surfaces->pixel_format());
+  buffer->style_hash = cache_key.style_hash;
+  buffer->karaoke_segments.clear();
+  GdiSurface* output = text_layer_output(surfaces);
+
+  // Only colors or text opacity changed since this buffer's masks were drawn.
+  const bool masks_match = buffer->raster_hash == raster_hash;
+
+  // Word-timed line: swept frame by frame from its masks, so it bypasses
+  // the cache.
+  if (!snapshot.words.empty()) {
+    if (masks_match) {
+      renderer->pipeline.Recomposite(style, surfaces);
+    } else {
+      if (!renderer->pipeline.Render(utf8, style, layer_w, h, surfaces)) {
+        buffer->raster_hash = 0;
+        return false;
+      }
+      buffer->raster_hash = raster_hash;
+    }
+    build_karaoke_segments(style, layer_w, text, snapshot.words, snapshot.line_end_ms, renderer->rasterizer.MeasureDc(),
+                           renderer->rasterizer.FontFor(style), &buffer->karaoke_segments);
+    return true;
+  }
+
+  if (masks_match) {
+    renderer->pipeline.Recomposite(style, surfaces);
+    overlay_line_cache.Insert(cache_key, layer_w, h, output->data());
+    return true;
   }
+
+  // Cache hit (pre-rendered or shown before): skip rasterization and
+  // compositing entirely. The masks no longer match the output.
+  if (overlay_line_cache.Lookup(cache_key, output->data(), output->size_bytes())) {
+    buffer->raster_hash = 0;
+    return true;
+  }
+
+  if (!renderer->pipeline.Render(utf8, style, layer_w, h, surfaces)) {
+    buffer->raster_hash = 0;
+    return false;
+  }
+  buffer->raster_hash = raster_hash;
+  overlay_line_cache.Insert(cache_key, layer_w, h, output->data());
+  return true;
+}
+
+
+// Text pipeline of the render worker. Every overlay's RenderThread draws on
+// that one thread, so they share it, with its layout and stroke scratch.
+static std::shared_ptr<OverlayTextRenderer> overlay_render_text;
+
+// One overlay: a single per-pixel-alpha layered window showing the background
+// plate and the text composited together, with its own text, style, sheet,
+// timeline, karaoke sweep, line transition and marquee. Everything runs on the
+// window thread except the renders of its RenderThread on
+// overlay_render_worker.
+class OverlayInstance {
+ public:
+  explicit OverlayInstance(tono_overlay::OverlayId id) : id_(id) {}
+  ~OverlayInstance() { Destroy(); }
+
+  OverlayInstance(const OverlayInstance&) = delete;
+  OverlayInstance& operator=(const OverlayInstance&) = delete;
+
+  // Creates and shows the window; true if it exists afterwards.
+  bool Create();
+  void Destroy();
+  bool created() const { return hwnd_ != nullptr; }
+  void Show();
+  void Hide();
+
+  // Shows a line picked by Dart, ending any karaoke sweep.
+  void SetLyricsText(const std::wstring& text);
+  // Applies a decoded style batch as one transaction.
+  void CommitStyleUpdate(const tono_overlay::OverlayStyleUpdate& update);
+  void SetOpacity(int alpha);
+  void SetClickThrough(bool enable);
+  // Replaces the sheet with |lines|, sorted by start time, whose texts may
+  // carry <mm:ss.xx> word tags for the karaoke sweep. Upcoming lines are
+  // pre-rendered |lookahead| ahead (< 0 keeps the current setting).
+  void SetSheet(const std::vector<tono_overlay::LrcLine>& lines, int lookahead);
+  // Re-anchors the lyric timeline at |position_ms| as of now.
+  void SetPlayback(int64_t position_ms, bool playing, double rate);
+
+  // Window messages of the overlay's window.
+  void OnMove(int x, int y);
+  void OnFrameReady();
+  void OnTimelineTimer();
+  // Runs the refresh the overlay asked for, if it did; see overlay_vsync.
+  void OnVsync();
+
+ private:
+  bool CreateOverlayWindow();
+  void UpdateFont();
+  // Shows |t|. Identical text is not redrawn unless |force| is set (the
+  // karaoke state of the line changed).
+  void SetText(const std::wstring& t, bool force = false);
+  void TimelineTick();
+  void CreateRenderer();
+  void RequestFrame();
+  void PresentTextLayer(GdiSurface* output, int w, int h, const RECT* dirty = nullptr);
+  bool AdvanceKaraokeSweep(tono_overlay::RenderBuffer* frame, RECT* dirty, bool* moving);
+  void ResetKaraokeCompositor(tono_overlay::RenderBuffer* frame);
+  void NotePrerenderStyle(const tono_overlay::RenderSnapshot& snapshot, const tono_overlay::LineCacheKey& key);
+  void UpdateTextLayer();
+  void StartLineTransition(tono_overlay::RenderBuffer* shown);
+  void UpdateMarquee(tono_overlay::RenderBuffer* frame, bool same_line);
+  void AcquireRenderedFrame();
+  void VsyncFrame();
+  int EffectiveBackgroundAlpha() const;
+  void ApplyChanges();
+  int LineHeightPixels() const;
+  void UpdateSizeAndRedraw();
+
+  const tono_overlay::OverlayId id_;
+  // Topmost layered window; its pixels only change through
+  // UpdateLayeredWindowIndirect in PresentTextLayer().
+  HWND hwnd_ = nullptr;
+  std::wstring text_;
+  // Window height, derived from the font, lines and padding.
+  int height_ = 64;
+  // Every style setting plus what changed since it was last applied.
+  // Setters only record the change; ApplyChanges() runs the stages needed.
+  tono_overlay::OverlayState state_;
+  // Font of the current style from GdiFontCache(), used on the window
+  // thread to size the window.
+  std::shared_ptr<tono_overlay::FontInstance> font_;
+  // Renders the upcoming lines of the sheet sent by setLyricsSheet into
+  // overlay_line_cache. Created with the first sheet.
+  std::unique_ptr<tono_overlay::LinePrerenderer> prerenderer_;
+  // Style hash the prerenderer was last given; 0 = none.
+  uint64_t prerender_style_hash_ = 0;
+  // Draws the shown line on overlay_render_worker. UpdateTextLayer() posts
+  // a snapshot and returns; the worker draws it into the buffer the window
+  // thread is not presenting from and posts kOverlayFrameReadyMessage to
+  // the window. Created with the window.
+  std::unique_ptr<tono_overlay::RenderThread> renderer_;
+  // Lines of the current sheet, and the timeline that picks one from the
+  // playback anchor sent by setLyricsPlayback. While the sheet is
+  // non-empty the overlay advances lines itself on a window timer.
+  std::vector<std::wstring> sheet_texts_;
+  tono_overlay::LyricTimeline timeline_{&overlay_clock};
+  // Sheet index last shown by the timeline (-1 = none yet).
+  int timeline_index_ = -1;
+  // Karaoke: word timings of each sheet line (empty for plain lines), with
+  // LrcWord::begin as a UTF-16 offset into sheet_texts_.
+  std::vector<std::vector<tono_overlay::LrcWord>> sheet_words_;
+  // Sheet line being swept, or -1 when the shown text is not word-timed.
+  int karaoke_index_ = -1;
+  // Composites the swept line in place in the render thread's front
+  // buffer, using the masks and segments drawn there; valid while
+  // karaoke_ready_.
+  tono_overlay::KaraokeCompositor karaoke_;
+  bool karaoke_ready_ = false;
+  // Asked overlay_vsync for a refresh that has not run yet.
+  bool frame_requested_ = false;
+  // The render thread finished a frame the next refresh should acquire.
+  bool frame_pending_ = false;
+  // The front buffer's output must be uploaded whole on the next refresh.
+  bool present_full_ = false;
+  // Text of the last snapshot posted and of the frame on screen, to tell a
+  // new line (which animates) from a restyle of the same one (which does
+  // not).
+  std::string posted_text_;
+  std::string shown_text_;
+  bool shown_ = false;
+  // Line change animation: blends the pixels on screen when the line
+  // changed with the new front buffer into transition_surface_, one frame
+  // per refresh. Neither line is rasterized again.
+  tono_overlay::LineTransition transition_;
+  std::unique_ptr<GdiSurface> transition_surface_;
+  // A single line too long for the window, with the marquee on: the front
+  // buffer holds it as a strip wider than the window, and each refresh copies
+  // the window's share into marquee_surface_, only when it moved.
+  tono_overlay::Marquee marquee_;
+  std::unique_ptr<GdiSurface> marquee_surface_;
+};
+
+// Looks up the font for the family, size and weight in state_. A style
+// used before (a preset switched back to, or another overlay's) is a cache
+// hit.
+void OverlayInstance::UpdateFont() {
+  const tono_overlay::OverlayStyle& style = state_.style();
+  const tono_overlay::FontKey key = OverlayFontKey(style);
+  font_ = GdiFontCache().Get(key);
+  const tono_overlay::FontCacheStats stats = GdiFontCache().stats();
+  TONO_VLOG("UpdateFont: id=" << id_ << " size=" << key.size_pt << " weight=" << key.weight << " family="
+                              << key.family << " cache hits=" << stats.hits << " misses=" << stats.misses);
+}
+
+bool OverlayInstance::Create() {
+  if (hwnd_) return true;
+  if (!CreateOverlayWindow()) return false;
+  TimelineTick();
+  return true;
+}
+
+bool OverlayInstance::CreateOverlayWindow() {
+  TONO_LOG(kInfo, "OverlayInstance::Create: id=" << id_ << " compositor isa="
+                      << tono_overlay::CompositorIsaName(tono_overlay::ActiveCompositorIsa()));
+  ensure_overlay_class();
+  if (!ensure_overlay_shared_resources()) {
+    TONO_LOG(kError, "OverlayInstance::Create: no message window for the vsync pacer");
+    return false;
+  }
+  const tono_overlay::OverlayStyle& style = state_.style();
+  TONO_VLOG("OverlayInstance::Create: params x=" << style.x << " y=" << style.y << " w=" << style.width
+                                                 << " h=" << height_);
   HMODULE hInst = GetModuleHandle(NULL);
-  std::ostringstream ss_mod;
-  ss_mod << "create_overlay: module=" << reinterpret_cast<void*>(hInst);
-  AppendOverlayLog(ss_mod.str());
+  TONO_VLOG("OverlayInstance::Create: module=" << reinterpret_cast<void*>(hInst));
 
   const std::vector<DWORD> exstyles_to_try = {
       WS_EX_LAYERED | WS_EX_TOPMOST | WS_EX_TOOLWINDOW | WS_EX_NOACTIVATE,
       WS_EX_LAYERED | WS_EX_TOPMOST | WS_EX_TOOLWINDOW,
       WS_EX_LAYERED | WS_EX_TOPMOST,
   };
+  // The window gets |this| as its GWLP_USERDATA in WM_NCCREATE, so
+  // messages sent during creation already reach the instance.
+  LPCWSTR class_name_or_atom = overlay_class_atom ? MAKEINTATOM(overlay_class_atom) : kOverlayClass;
   DWORD last_err = 0;
   for (size_t i = 0; i < exstyles_to_try.size(); ++i) {
     DWORD ex = exstyles_to_try[i];
-    std::ostringstream ss;
-    ss << "create_overlay: trying CreateWindowEx with ex=0x" << std::hex << ex;
-    AppendOverlayLog(ss.str());
+    TONO_VLOG("OverlayInstance::Create: trying CreateWindowEx with ex=0x" << std::hex << ex);
     SetLastError(0);
-    LPCWSTR class_name_or_atom = kOverlayClass;
-    if (overlay_class_atom) {
-      class_name_or_atom = MAKEINTATOM(overlay_class_atom);
-    }
-    overlay_hwnd = CreateWindowExW(
-        ex,
-        class_name_or_atom, L"TonoLyrics", WS_POPUP, overlay_x, overlay_y, overlay_w, overlay_h,
-        NULL, NULL, hInst, NULL);
-    if (overlay_hwnd) break;
+    hwnd_ = CreateWindowExW(ex, class_name_or_atom, L"TonoLyrics", WS_POPUP, style.x, style.y, style.width,
+                            height_, NULL, NULL, hInst, this);
+    if (hwnd_) break;
     last_err = GetLastError();
     char buf[512] = {0};
     FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
                    NULL, last_err, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), buf, sizeof(buf), NULL);
-    std::ostringstream serr;
-    serr << "create_overlay: CreateWindowEx failed (ex=0x" << std::hex << ex << ") GetLastError=" << std::dec << last_err << " msg=" << buf;
-    AppendOverlayLog(serr.str());
+    TONO_LOG(kWarning, "OverlayInstance::Create: CreateWindowEx failed (ex=0x" << std::hex << ex
+                           << ") GetLastError=" << std::dec << last_err << " msg=" << buf);
   }
-  if (!overlay_hwnd) {
-    std::ostringstream serr;
-    serr << "create_overlay: all CreateWindowEx attempts failed, last_err=" << last_err;
-    AppendOverlayLog(serr.str());
+  if (!hwnd_) {
+    TONO_LOG(kError, "OverlayInstance::Create: all CreateWindowEx attempts failed, last_err=" << last_err);
     return false;
   }
-  AppendOverlayLog("create_overlay: window created");
-  auto ptr = new std::wstring(overlay_text);
-  SetWindowLongPtr(overlay_hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(ptr));
-  BOOL sla = SetLayeredWindowAttributes(overlay_hwnd, 0, (BYTE)overlay_alpha, LWA_ALPHA);
-  if (!sla) {
-    std::ostringstream ss;
-    ss << "create_overlay: SetLayeredWindowAttributes failed, GetLastError=" << GetLastError();
-    AppendOverlayLog(ss.str());
-  } else {
-    AppendOverlayLog("create_overlay: SetLayeredWindowAttributes succeeded");
+  TONO_VLOG("OverlayInstance::Create: window created");
+  // No SetLayeredWindowAttributes: the window stays empty until the first
+  // frame's UpdateLayeredWindowIndirect, which carries the background plate
+  // and the text in one per-pixel-alpha bitmap.
+  ShowWindow(hwnd_, SW_SHOWNOACTIVATE);
+  // A sheet and anchor may have arrived while the overlay was closed.
+  timeline_index_ = -1;
+  CreateRenderer();
+  UpdateTextLayer();
+  return true;
+}
+
+void OverlayInstance::Destroy() {
+  // Waits for a render in flight; its frame-ready message goes nowhere.
+  karaoke_ready_ = false;
+  renderer_.reset();
+  frame_requested_ = false;
+  frame_pending_ = false;
+  present_full_ = false;
+  shown_ = false;
+  shown_text_.clear();
+  transition_.Cancel();
+  transition_surface_.reset();
+  marquee_.Stop();
+  marquee_surface_.reset();
+  // Keep the sheet for the next window, but stop rendering for this one.
+  if (prerenderer_) prerenderer_->SetStyle(0, nullptr);
+  prerender_style_hash_ = 0;
+  if (hwnd_) {
+    DestroyWindow(hwnd_);
+    hwnd_ = nullptr;
   }
-  ShowWindow(overlay_hwnd, SW_SHOWNOACTIVATE);
-  AppendOverlayLog("create_overlay: ShowWindow done");
-  UpdateWindow(overlay_hwnd);
-  AppendOverlayLog("create_overlay: UpdateWindow done");
-  // Create the text window which will receive a per-pixel alpha bitmap via UpdateLayeredWindow.
-  LPCWSTR class_name_for_text = overlay_class_atom ? MAKEINTATOM(overlay_class_atom) : kOverlayClass;
-  for (size_t i = 0; i < exstyles_to_try.size(); ++i) {
-    DWORD ex = exstyles_to_try[i];
-    SetLastError(0);
-    overlay_text_hwnd = CreateWindowExW(
-        ex,
-        class_name_for_text, L"TonoLyricsText", WS_POPUP, overlay_x, overlay_y, overlay_w, overlay_h,
-        NULL, NULL, hInst, NULL);
-    if (overlay_text_hwnd) break;
+}
+
+void OverlayInstance::Show() {
+  if (hwnd_) ShowWindow(hwnd_, SW_SHOWNOACTIVATE);
+}
+
+void OverlayInstance::Hide() {
+  if (hwnd_) ShowWindow(hwnd_, SW_HIDE);
+}
+
+void OverlayInstance::SetText(const std::wstring& t, bool force) {
+  if (t == text_ && !force) return;
+  text_ = t;
+  UpdateTextLayer();
+}
+
+// Shows the sheet line for the current playback position and arms a
+// one-shot timer for the next line change. Blank lines keep the previous
+// text on screen, matching the Dart-driven path.
+void OverlayInstance::TimelineTick() {
+  if (!hwnd_) return;
+  KillTimer(hwnd_, kOverlayTimelineTimer);
+  if (timeline_.empty()) return;
+  int index = timeline_.CurrentIndex();
+  if (index != timeline_index_) {
+    timeline_index_ = index;
+    if (index >= 0 && index < (int)sheet_texts_.size()) {
+      const std::wstring& text = sheet_texts_[index];
+      if (text.find_first_not_of(L" \t\r\n") != std::wstring::npos) {
+        const int karaoke_index = index < (int)sheet_words_.size() && !sheet_words_[index].empty() ? index : -1;
+        // A repeated line still restarts its sweep.
+        const bool force = karaoke_index != karaoke_index_ || karaoke_index >= 0;
+        karaoke_index_ = karaoke_index;
+        SetText(text, force);
+      }
+      if (prerenderer_) prerenderer_->SetCurrentIndex(index);
+    }
   }
-  if (overlay_text_hwnd) {
-    // Keep same userdata pointer for text window
-    // Avoid sharing the same heap pointer to prevent double free on WM_DESTROY.
-    SetWindowLongPtr(overlay_text_hwnd, GWLP_USERDATA, 0);
-    ShowWindow(overlay_text_hwnd, SW_SHOWNOACTIVATE);
-    AppendOverlayLog("create_overlay: text window created");
-    // Push initial text content
-    update_text_layer();
-  } else {
-    AppendOverlayLog("create_overlay: failed to create text window");
+  int64_t delay = timeline_.MsUntilNextChange();
+  if (delay < 0) return;
+  // SetTimer never fires early; a late tick just shows the right line late
+  // by the timer granularity and re-arms from the real position.
+  if (delay < USER_TIMER_MINIMUM) delay = USER_TIMER_MINIMUM;
+  if (delay > 0x7FFFFFFF) delay = 0x7FFFFFFF;
+  SetTimer(hwnd_, kOverlayTimelineTimer, (UINT)delay, NULL);
+}
+
+// Pushes a finished premultiplied surface to the window. With |dirty|
+// only that rectangle is re-uploaded, and the window keeps its position and
+// size.
+void OverlayInstance::PresentTextLayer(GdiSurface* output, int w, int h, const RECT* dirty) {
+  tono_overlay::ScopedStageTimer timer(tono_overlay::TimingStage::kPresent);
+  POINT ptSrc = {0,0};
+  SIZE sizeWnd = {w,h};
+  POINT ptDst = {state_.style().x, state_.style().y};
+
+  BLENDFUNCTION bf = {};
+  bf.BlendOp = AC_SRC_OVER;
+  bf.BlendFlags = 0;
+  bf.SourceConstantAlpha = 255;
+  bf.AlphaFormat = AC_SRC_ALPHA;
+
+  // A NULL destination DC uses the default palette, which is all a 32-bit
+  // per-pixel-alpha update needs.
+  UPDATELAYEREDWINDOWINFO info = {};
+  info.cbSize = sizeof(info);
+  info.hdcDst = NULL;
+  info.pptDst = dirty ? NULL : &ptDst;
+  info.psize = dirty ? NULL : &sizeWnd;
+  info.hdcSrc = output->dc();
+  info.pptSrc = &ptSrc;
+  info.crKey = 0;
+  info.pblend = &bf;
+  info.dwFlags = ULW_ALPHA;
+  info.prcDirty = dirty;
+  BOOL ok = UpdateLayeredWindowIndirect(hwnd_, &info);
+  if (!ok) {
+    TONO_LOG(kWarning, "PresentTextLayer: UpdateLayeredWindowIndirect failed, GetLastError=" << GetLastError());
   }
+}
+
+// Creates the render thread for the window on the shared worker.
+// Frame-ready messages go to the window, so presenting stays on the window
+// thread.
+void OverlayInstance::CreateRenderer() {
+  if (!overlay_render_text) overlay_render_text = std::make_shared<OverlayTextRenderer>();
+  std::shared_ptr<OverlayTextRenderer> renderer = overlay_render_text;
+  HWND hwnd = hwnd_;
+  renderer_ = std::make_unique<tono_overlay::RenderThread>(
+      overlay_render_worker,
+      [renderer](const tono_overlay::RenderSnapshot& snapshot, tono_overlay::RenderBuffer* buffer) {
+        return render_overlay_frame(renderer.get(), snapshot, buffer);
+      },
+      [hwnd] { PostMessage(hwnd, kOverlayFrameReadyMessage, 0, 0); });
+}
+
+// Asks for OnVsync() after the next display refresh.
+void OverlayInstance::RequestFrame() {
+  frame_requested_ = true;
+  if (overlay_vsync) overlay_vsync->RequestFrame();
+}
+
+// Moves the karaoke sweep of |frame| (the front buffer) to the playback
+// position. Returns true if columns were recomposited, with them in
+// |dirty|. Sets |*moving| while playing and the sweep has not reached the
+// end of the line.
+bool OverlayInstance::AdvanceKaraokeSweep(tono_overlay::RenderBuffer* frame, RECT* dirty, bool* moving) {
+  if (!karaoke_ready_ || frame->karaoke_segments.empty()) return false;
+  const std::vector<tono_overlay::KaraokeSegment>& segments = frame->karaoke_segments;
+  const int x = tono_overlay::KaraokeSweepX(segments, timeline_.PositionMs());
+  if (!timeline_.paused() && x < segments.back().x_end) *moving = true;
+  int dirty_begin = 0, dirty_end = 0;
+  if (!karaoke_.SetSweep(x, &dirty_begin, &dirty_end)) return false;
+  *dirty = {dirty_begin, 0, dirty_end, frame->snapshot->height};
   return true;
 }
 
-static void destroy_overlay() {
-  if (overlay_text_hwnd) {
-    DestroyWindow(overlay_text_hwnd);
-    overlay_text_hwnd = nullptr;
-  }
-  if (overlay_hwnd) {
-    DestroyWindow(overlay_hwnd);
-    overlay_hwnd = nullptr;
-  }
+// Binds the sweep compositor to the masks of |frame| (the front buffer)
+// with the colors it was drawn with and sweeps it to the playback
+// position.
+void OverlayInstance::ResetKaraokeCompositor(tono_overlay::RenderBuffer* frame) {
+  const tono_overlay::RenderSnapshot& snapshot = *frame->snapshot;
+  const tono_overlay::OverlayStyle& style = snapshot.style;
+  tono_overlay::SurfacePool* surfaces = frame->surfaces.get();
+  GdiSurface* output = text_layer_output(surfaces);
+  tono_overlay::Surface* stroke = surfaces->surface(tono_overlay::kTextLayerStroke);
+  tono_overlay::Surface* fill = surfaces->surface(tono_overlay::kTextLayerFill);
+  const uint32_t highlight = style.highlight_color;
+  // The output is wider than the window when it holds a marquee strip.
+  karaoke_.Reset(fill->data(), style.stroke_width > 0 ? stroke->data() : nullptr, output->data(),
+                 output->width(), output->height(),
+                 tono_overlay::TextLayerCompositeParams(style, surfaces->pixel_format()),
+                 {(uint8_t)(highlight >> 16), (uint8_t)(highlight >> 8), (uint8_t)highlight});
+  int dirty_begin = 0, dirty_end = 0;
+  karaoke_.SetSweep(tono_overlay::KaraokeSweepX(frame->karaoke_segments, timeline_.PositionMs()), &dirty_begin,
+                    &dirty_end);
+  karaoke_ready_ = true;
 }
 
-static void set_overlay_text(const std::wstring& t) {
-  overlay_text = t;
-  if (overlay_hwnd) {
-    auto ptr = reinterpret_cast<std::wstring*>(GetWindowLongPtr(overlay_hwnd, GWLP_USERDATA));
-    if (ptr) *ptr = overlay_text;
-    // Update layered text window content (opaque text)
-    if (overlay_text_hwnd) {
-      update_text_layer();
-    }
-    InvalidateRect(overlay_hwnd, NULL, TRUE);
+// Keeps the background worker a few lines ahead of what is shown, with the
+// style and size of the line just drawn.
+void OverlayInstance::NotePrerenderStyle(const tono_overlay::RenderSnapshot& snapshot,
+                                         const tono_overlay::LineCacheKey& key) {
+  if (!prerenderer_) return;
+  if (key.style_hash != prerender_style_hash_) {
+    prerenderer_->SetStyle(key.style_hash, make_prerender_fn(snapshot.style, snapshot.width, snapshot.height));
+    prerender_style_hash_ = key.style_hash;
   }
+  prerenderer_->NoteText(key.text);
 }
 
-// Helper: create a 32-bit ARGB DIB with the overlay_text drawn and call UpdateLayeredWindow
-static void update_text_layer() {
-  if (!overlay_text_hwnd) return;
-  // Get client size
+// Queues a render of text_ with the current style and returns at once;
+// VsyncFrame() shows the result. Snapshots posted faster than the worker
+// draws replace each other, so only the newest is drawn. The snapshot's
+// background alpha is the one shown, so a locked overlay renders without
+// its plate.
+void OverlayInstance::UpdateTextLayer() {
+  if (!hwnd_ || !renderer_) return;
   RECT r;
-  GetClientRect(overlay_text_hwnd, &r);
+  GetClientRect(hwnd_, &r);
   int w = r.right - r.left;
   int h = r.bottom - r.top;
   if (w <= 0 || h <= 0) return;
 
-  HDC screenDC = GetDC(NULL);
-  HDC memDC = CreateCompatibleDC(screenDC); // final composited output
-
-  BITMAPINFO bmi = {};
-  bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-  bmi.bmiHeader.biWidth = w;
-  // top-down DIB
-  bmi.bmiHeader.biHeight = -h;
-  bmi.bmiHeader.biPlanes = 1;
-  bmi.bmiHeader.biBitCount = 32;
-  // Use BI_RGB (default DIB ordering). We'll detect the byte ordering at runtime
-  // after CreateDIBSection and adapt reads/writes accordingly. Using BI_BITFIELDS
-  // caused platform-dependent interpretation issues, so prefer BI_RGB + detection.
-  bmi.bmiHeader.biCompression = BI_RGB;
-
-  void* pvBits = nullptr;
-  HBITMAP hBitmap = CreateDIBSection(memDC, &bmi, DIB_RGB_COLORS, &pvBits, NULL, 0); // output bitmap
-  if (!hBitmap) {
-    DeleteDC(memDC);
-    ReleaseDC(NULL, screenDC);
-    return;
+  tono_overlay::RenderSnapshot snapshot;
+  snapshot.text = wide_bytes(text_);
+  snapshot.style = state_.style();
+  snapshot.style.background_alpha = EffectiveBackgroundAlpha();
+  snapshot.width = w;
+  snapshot.height = h;
+  posted_text_ = snapshot.text;
+  const int index = karaoke_index_;
+  if (index >= 0 && index < (int)sheet_words_.size() && snapshot.style.lines <= 1) {
+    const std::vector<int64_t>& times = timeline_.times();
+    snapshot.words = sheet_words_[index];
+    snapshot.line_end_ms = index + 1 < (int)times.size() ? times[index + 1] : times[index] + 5000;
   }
+  renderer_->Post(std::move(snapshot));
+}
 
-  HGDIOBJ oldBmp = SelectObject(memDC, hBitmap);
-
-  // Detect byte ordering for the DIB pixels by drawing a known test pixel at (0,0)
-  // and inspecting pvBits. This allows us to handle differences in channel ordering
-  // (e.g., whether memory layout is BGRA or RGBA).
-  int byteIndexR = 2;
-  int byteIndexG = 1;
-  int byteIndexB = 0;
-  if (pvBits) {
-    // Set a red pixel at (0,0)
-    SetPixel(memDC, 0, 0, RGB(255, 0, 0));
-    // Read the first pixel bytes
-    uint8_t* testPix = (uint8_t*)pvBits;
-    uint8_t b0 = testPix[0];
-    uint8_t b1 = testPix[1];
-    uint8_t b2 = testPix[2];
-    // Find which byte equals 255
-  if (b0 == 255) { byteIndexR = 0; byteIndexG = 1; byteIndexB = 2; }
-  else if (b1 == 255) { byteIndexR = 1; byteIndexG = 0; byteIndexB = 2; }
-  else if (b2 == 255) { byteIndexR = 2; byteIndexG = 1; byteIndexB = 0; }
-  std::ostringstream ssmap;
-  ssmap << "update_text_layer: detected byte ordering R=" << byteIndexR << " G=" << byteIndexG << " B=" << byteIndexB;
-  AppendOverlayLog(ssmap.str());
-    // Clear test pixel by filling black background again (we'll redraw later)
-    SetPixel(memDC, 0, 0, RGB(0,0,0));
-    std::ostringstream ssinit;
-    ssinit << "update_text_layer: initial pixel bytes before draw: [0]=" << (int)b0 << " [1]=" << (int)b1 << " [2]=" << (int)b2;
-    AppendOverlayLog(ssinit.str());
-    std::ostringstream ssclr;
-    ssclr << "update_text_layer: desired color R=" << (int)GetRValue(overlay_text_color) << " G=" << (int)GetGValue(overlay_text_color) << " B=" << (int)GetBValue(overlay_text_color);
-    AppendOverlayLog(ssclr.str());
+// Starts the configured line transition from the pixels on screen: the
+// previous transition frame if one is running, else the output of |shown|
+// (the front buffer, about to go back to the render thread). The plate
+// under both lines stays still; only the text animates.
+void OverlayInstance::StartLineTransition(tono_overlay::RenderBuffer* shown) {
+  const tono_overlay::OverlayStyle& style = state_.style();
+  const tono_overlay::Surface* on_screen = nullptr;
+  if (transition_.active()) {
+    on_screen = transition_surface_.get();
+  } else if (marquee_.active()) {
+    on_screen = marquee_surface_.get();
+  } else if (shown_ && shown && shown->surfaces) {
+    on_screen = shown->surfaces->surface(tono_overlay::kTextLayerOutput);
+  }
+  if (!on_screen) {
+    transition_.Cancel();
+    return;
   }
+  // Both lines were drawn in the byte order of the front buffer's pool.
+  const tono_overlay::PixelFormat format =
+      shown && shown->surfaces ? shown->surfaces->pixel_format() : tono_overlay::PixelFormat();
+  tono_overlay::BackgroundPlate plate = tono_overlay::TextLayerCompositeParams(style, format).background;
+  plate.alpha = EffectiveBackgroundAlpha();
+  transition_.Start(style.transition, style.transition_ms, overlay_clock.NowMs(), on_screen->data(),
+                    on_screen->width(), on_screen->height(), on_screen->stride(), plate, format);
+}
 
-  // Fill background with black (transparent later)
-  HBRUSH black = CreateSolidBrush(RGB(0,0,0));
-  FillRect(memDC, &r, black);
-  DeleteObject(black);
-
-  SetBkMode(memDC, TRANSPARENT);
-  SetTextColor(memDC, overlay_text_color);
-  HFONT oldf = nullptr;
-  if (overlay_hfont) oldf = (HFONT)SelectObject(memDC, overlay_hfont);
-
-  // Prepare separate stroke and fill DIBs to build masks
-  HDC dcStroke = CreateCompatibleDC(screenDC);
-  HDC dcFill = CreateCompatibleDC(screenDC);
-  void* bitsStroke = nullptr;
-  void* bitsFill = nullptr;
-  HBITMAP bmpStroke = CreateDIBSection(dcStroke, &bmi, DIB_RGB_COLORS, &bitsStroke, NULL, 0);
-  HBITMAP bmpFill = CreateDIBSection(dcFill, &bmi, DIB_RGB_COLORS, &bitsFill, NULL, 0);
-  HGDIOBJ oldStrokeBmp = nullptr;
-  HGDIOBJ oldFillBmp = nullptr;
-  if (bmpStroke) oldStrokeBmp = SelectObject(dcStroke, bmpStroke);
-  if (bmpFill) oldFillBmp = SelectObject(dcFill, bmpFill);
-  // Clear stroke/fill surfaces
-  HBRUSH brushBlackStroke = CreateSolidBrush(RGB(0,0,0));
-  HBRUSH brushBlackFill = CreateSolidBrush(RGB(0,0,0));
-  FillRect(dcStroke, &r, brushBlackStroke); DeleteObject(brushBlackStroke);
-  FillRect(dcFill, &r, brushBlackFill); DeleteObject(brushBlackFill);
-  // Set common font
-  if (overlay_hfont) {
-    SelectObject(dcStroke, overlay_hfont);
-    SelectObject(dcFill, overlay_hfont);
+// Scrolls the output of |frame| (the new front buffer) through the window if it
+// is a strip wider than the window. A restyle of the line already scrolling
+// keeps its place; the strip is a new buffer either way.
+void OverlayInstance::UpdateMarquee(tono_overlay::RenderBuffer* frame, bool same_line) {
+  const tono_overlay::RenderSnapshot& snapshot = *frame->snapshot;
+  GdiSurface* output = text_layer_output(frame->surfaces.get());
+  if (output->width() <= snapshot.width) {
+    marquee_.Stop();
+    return;
   }
-  SetBkMode(dcStroke, TRANSPARENT);
-  SetBkMode(dcFill, TRANSPARENT);
-  SetTextColor(dcStroke, RGB(255,255,255));
-  SetTextColor(dcFill, RGB(255,255,255));
-
-  RECT tr = {overlay_padding, overlay_padding, w - overlay_padding, h - overlay_padding};
-  UINT dtFlags = DT_NOPREFIX;
-  // horizontal alignment
-  if (overlay_text_align == 1) dtFlags |= DT_CENTER; else if (overlay_text_align == 2) dtFlags |= DT_RIGHT; else dtFlags |= DT_LEFT;
-  if (overlay_lines <= 1) dtFlags |= DT_SINGLELINE | DT_VCENTER | DT_END_ELLIPSIS; else dtFlags |= DT_WORDBREAK | DT_WORD_ELLIPSIS | DT_TOP;
-
-  // Draw stroke mask (if enabled): draw text at offsets within a disk radius
-  if (overlay_stroke_width > 0) {
-    int radsq = overlay_stroke_width * overlay_stroke_width;
-    for (int dy = -overlay_stroke_width; dy <= overlay_stroke_width; ++dy) {
-      for (int dx = -overlay_stroke_width; dx <= overlay_stroke_width; ++dx) {
-        if (dx*dx + dy*dy > radsq) continue;
-        RECT trs = {tr.left + dx, tr.top + dy, tr.right + dx, tr.bottom + dy};
-        DrawTextW(dcStroke, overlay_text.c_str(), -1, &trs, dtFlags);
-      }
+  if (!marquee_surface_ || marquee_surface_->width() != snapshot.width ||
+      marquee_surface_->height() != snapshot.height) {
+    marquee_surface_ = GdiSurface::Create(snapshot.width, snapshot.height);
+    if (!marquee_surface_) {
+      TONO_LOG(kError, "UpdateMarquee: surface allocation failed for " << snapshot.width << "x" << snapshot.height);
+      marquee_.Stop();
+      return;
     }
   }
-  // Draw fill mask (center)
-  DrawTextW(dcFill, overlay_text.c_str(), -1, &tr, dtFlags);
-
-  if (oldf) SelectObject(memDC, oldf);
-
-  // Composite: stroke (bottom) then fill (top), writing premultiplied RGBA into pvBits
-  if (pvBits && bitsFill) {
-    uint8_t* out = (uint8_t*)pvBits;
-    uint8_t* pFill = (uint8_t*)bitsFill;
-    uint8_t* pStroke = (uint8_t*)bitsStroke;
-    uint8_t fill_r = (uint8_t)GetRValue(overlay_text_color);
-    uint8_t fill_g = (uint8_t)GetGValue(overlay_text_color);
-    uint8_t fill_b = (uint8_t)GetBValue(overlay_text_color);
-    uint8_t stroke_r = (uint8_t)GetRValue(overlay_stroke_color);
-    uint8_t stroke_g = (uint8_t)GetGValue(overlay_stroke_color);
-    uint8_t stroke_b = (uint8_t)GetBValue(overlay_stroke_color);
-    for (int y = 0; y < h; ++y) {
-      for (int x = 0; x < w; ++x) {
-        int idx = (y * w + x) * 4;
-        // alpha from masks (max channel)
-        uint8_t fsr = pFill[idx + byteIndexR];
-        uint8_t fsg = pFill[idx + byteIndexG];
-        uint8_t fsb = pFill[idx + byteIndexB];
-        uint8_t fA = fsr; if (fsg > fA) fA = fsg; if (fsb > fA) fA = fsb;
-        uint8_t ssr = 0, ssg = 0, ssb = 0; uint8_t sA = 0;
-        if (overlay_stroke_width > 0 && pStroke) {
-          ssr = pStroke[idx + byteIndexR];
-          ssg = pStroke[idx + byteIndexG];
-          ssb = pStroke[idx + byteIndexB];
-          sA = ssr; if (ssg > sA) sA = ssg; if (ssb > sA) sA = ssb;
-        }
-        // apply text opacity to both
-        if (overlay_text_opacity < 255) {
-          fA = (uint8_t)((fA * overlay_text_opacity + 127) / 255);
-          sA = (uint8_t)((sA * overlay_text_opacity + 127) / 255);
-        }
-        // premultiplied colors
-        uint32_t out_r = 0, out_g = 0, out_b = 0, out_a = 0;
-        if (sA) {
-          out_r = (stroke_r * sA + 127) / 255;
-          out_g = (stroke_g * sA + 127) / 255;
-          out_b = (stroke_b * sA + 127) / 255;
-          out_a = sA;
-        }
-        if (fA) {
-          // over: fill over stroke
-          uint32_t inv = 255 - fA;
-          uint32_t nr = (fill_r * fA + (out_r * inv)) / 255;
-          uint32_t ng = (fill_g * fA + (out_g * inv)) / 255;
-          uint32_t nb = (fill_b * fA + (out_b * inv)) / 255;
-          uint32_t na = fA + (out_a * inv) / 255;
-          out_r = nr; out_g = ng; out_b = nb; out_a = na;
-        }
-        out[idx + byteIndexR] = (uint8_t)out_r;
-        out[idx + byteIndexG] = (uint8_t)out_g;
-        out[idx + byteIndexB] = (uint8_t)out_b;
-        out[idx + 3] = (uint8_t)out_a; // alpha index is always 3
-      }
-    }
+  if (!same_line || !marquee_.active() || marquee_.strip_width() != output->width()) {
+    marquee_.Start(output->width(), snapshot.width, snapshot.height, overlay_clock.NowMs());
   }
+  // The snapshot carries the plate's alpha as drawn, in the strip's byte order.
+  const tono_overlay::PixelFormat format = frame->surfaces->pixel_format();
+  marquee_.SetPlate(tono_overlay::TextLayerCompositeParams(snapshot.style, format).background, format);
+  marquee_.Invalidate();
+}
 
-  POINT ptSrc = {0,0};
-  SIZE sizeWnd = {w,h};
-  POINT ptDst = {overlay_x, overlay_y};
-
-  BLENDFUNCTION bf = {};
-  bf.BlendOp = AC_SRC_OVER;
-  bf.BlendFlags = 0;
-  bf.SourceConstantAlpha = 255;
-  bf.AlphaFormat = AC_SRC_ALPHA;
-
-  HDC hdcScreen = GetDC(NULL);
-  BOOL ok = UpdateLayeredWindow(overlay_text_hwnd, hdcScreen, &ptDst, &sizeWnd, memDC, &ptSrc, 0, &bf, ULW_ALPHA);
-  ReleaseDC(NULL, hdcScreen);
+// Makes the newest finished frame the front buffer and marks it for a full
+// upload. A new line first saves what is on screen for its transition, only
+// once a frame is actually taken: with none ready the old line stays up.
+void OverlayInstance::AcquireRenderedFrame() {
+  const tono_overlay::OverlayStyle& style = state_.style();
+  const bool animate = style.transition != tono_overlay::TransitionKind::kNone && style.transition_ms > 0;
+  // The frame waiting is the newest snapshot's, or an older one on its way
+  // there; either way a different line than the one shown.
+  const bool new_line = posted_text_ != shown_text_;
+  tono_overlay::RenderBuffer* frame = renderer_->AcquireFrame([&](tono_overlay::RenderBuffer* previous) {
+    if (animate && new_line) StartLineTransition(previous);
+  });
+  if (!frame) return;
+  const tono_overlay::RenderSnapshot& snapshot = *frame->snapshot;
+  // The previous front buffer went back to the render thread.
+  karaoke_ready_ = false;
+  RECT r;
+  GetClientRect(hwnd_, &r);
+  if (r.right - r.left != snapshot.width || r.bottom - r.top != snapshot.height) {
+    // Drawn before a resize; the frame for the new size is already queued.
+    transition_.Cancel();
+    marquee_.Stop();
+    shown_ = false;
+    return;
+  }
+  const bool same_line = shown_ && snapshot.text == shown_text_;
+  // An older frame of the line on screen after all: nothing to animate. A
+  // transition already running simply continues into a restyled line.
+  if (new_line && shown_ && snapshot.text == shown_text_) transition_.Cancel();
+  shown_text_ = snapshot.text;
+  shown_ = true;
+  // VsyncFrame() uploads it right after this.
+  tono_overlay::RecordStage(tono_overlay::TimingStage::kUpdate, snapshot.posted_ns, tono_overlay::StatsNowNs());
+  tono_overlay::LineCacheKey cache_key;
+  cache_key.text = snapshot.text;
+  cache_key.style_hash = frame->style_hash;
+  NotePrerenderStyle(snapshot, cache_key);
 
-  // Cleanup temp DC/bitmaps
-  if (oldStrokeBmp) SelectObject(dcStroke, oldStrokeBmp);
-  if (oldFillBmp) SelectObject(dcFill, oldFillBmp);
-  if (bmpStroke) DeleteObject(bmpStroke);
-  if (bmpFill) DeleteObject(bmpFill);
-  DeleteDC(dcStroke);
-  DeleteDC(dcFill);
+  if (!frame->karaoke_segments.empty()) ResetKaraokeCompositor(frame);
+  UpdateMarquee(frame, same_line);
+  if (transition_.active() &&
+      (!transition_surface_ || transition_surface_->width() != snapshot.width ||
+       transition_surface_->height() != snapshot.height)) {
+    transition_surface_ = GdiSurface::Create(snapshot.width, snapshot.height);
+    if (!transition_surface_) transition_.Cancel();
+  }
+  present_full_ = true;
+}
 
-  SelectObject(memDC, oldBmp);
-  DeleteObject(hBitmap);
-  DeleteDC(memDC);
-  ReleaseDC(NULL, screenDC);
+void OverlayInstance::OnVsync() {
+  if (!frame_requested_) return;
+  frame_requested_ = false;
+  VsyncFrame();
+}
 
-  if (!ok) {
-    AppendOverlayLog("update_text_layer: UpdateLayeredWindow failed");
+// One display refresh, on the window thread: takes the newest finished frame,
+// advances the karaoke sweep, the marquee and any line transition, and uploads
+// the result once. Requests the next refresh while something still moves.
+void OverlayInstance::VsyncFrame() {
+  if (!renderer_ || !hwnd_) return;
+  if (frame_pending_) {
+    frame_pending_ = false;
+    AcquireRenderedFrame();
   }
+  tono_overlay::RenderBuffer* frame = renderer_->front();
+  if (!frame || !shown_) return;
+  GdiSurface* output = text_layer_output(frame->surfaces.get());
+  // A strip with no marquee to show it (its window surface failed to allocate)
+  // would resize the window.
+  if (output->width() != frame->snapshot->width && !marquee_.active()) return;
+  bool moving = false;
+  RECT dirty = {};
+  const bool swept = AdvanceKaraokeSweep(frame, &dirty, &moving);
+  const int64_t now_ms = overlay_clock.NowMs();
+  GdiSurface* shown = output;
+  if (marquee_.active()) {
+    // The window's share of the strip is copied again when it moved or the
+    // sweep changed the strip under it; at rest nothing is uploaded.
+    if (swept) marquee_.Invalidate();
+    marquee_.SetMotion(tono_overlay::MarqueeMotionOf(state_.style()), now_ms);
+    if (marquee_.Frame(output->data(), marquee_surface_->data(), now_ms)) present_full_ = true;
+    shown = marquee_surface_.get();
+    moving = true;
+  }
+  const int w = shown->width();
+  const int h = shown->height();
+  GdiSurface* blended = transition_surface_.get();
+  if (transition_.active() && (!blended || blended->width() != w || blended->height() != h)) {
+    // No surface of this size to blend into; the new line shows at once.
+    transition_.Cancel();
+    present_full_ = true;
+  }
+  if (transition_.active()) {
+    if (transition_.Frame(shown->data(), blended->data(), w, h, shown->stride(), now_ms)) {
+      PresentTextLayer(blended, w, h);
+      present_full_ = false;
+      RequestFrame();
+      return;
+    }
+    // Finished: the line itself goes up whole.
+    present_full_ = true;
+  }
+  if (present_full_) {
+    PresentTextLayer(shown, w, h);
+  } else if (swept) {
+    PresentTextLayer(output, w, h, &dirty);
+  }
+  present_full_ = false;
+  if (moving) RequestFrame();
+}
+
+// Background alpha actually drawn: a locked (click-through) overlay hides
+// its plate. An unlocked one keeps at least alpha 1, since a per-pixel-alpha
+// window lets clicks through its fully transparent pixels and the whole
+// overlay should stay draggable.
+int OverlayInstance::EffectiveBackgroundAlpha() const {
+  if (hwnd_ && (GetWindowLongPtr(hwnd_, GWL_EXSTYLE) & WS_EX_TRANSPARENT)) return 0;
+  return std::max(state_.style().background_alpha, 1);
 }
 
-static void set_overlay_pos(int x, int y) {
-  overlay_x = x;
-  overlay_y = y;
-  if (overlay_hwnd) {
-    SetWindowPos(overlay_hwnd, HWND_TOPMOST, overlay_x, overlay_y, 0, 0, SWP_NOSIZE | SWP_NOACTIVATE);
+// Applies pending state_ changes, running only the stages they need: a
+// color change (text or background) recomposites the existing masks, a
+// position change only moves the window, and a value equal to the current
+// one does nothing.
+void OverlayInstance::ApplyChanges() {
+  const uint32_t stages = state_.TakeDirtyStages();
+  if (stages == 0) return;
+  const tono_overlay::OverlayStyle& style = state_.style();
+  if ((stages & tono_overlay::kStageWindow) && hwnd_) {
+    SetWindowPos(hwnd_, HWND_TOPMOST, style.x, style.y, 0, 0, SWP_NOSIZE | SWP_NOACTIVATE);
   }
-  if (overlay_text_hwnd) {
-    SetWindowPos(overlay_text_hwnd, HWND_TOPMOST, overlay_x, overlay_y, 0, 0, SWP_NOSIZE | SWP_NOACTIVATE);
+  if (stages & tono_overlay::kStageFont) UpdateFont();
+  if (stages & tono_overlay::kStageLayout) {
+    UpdateSizeAndRedraw();
+  } else if (stages & (tono_overlay::kStageRaster | tono_overlay::kStageComposite)) {
+    // The render thread recolors its masks when only colors changed.
+    UpdateTextLayer();
   }
 }
 
-static void set_overlay_clickthrough(bool enable) {
-  if (!overlay_hwnd && !overlay_text_hwnd) return;
-  if (overlay_hwnd) {
-    LONG_PTR ex = GetWindowLongPtr(overlay_hwnd, GWL_EXSTYLE);
-    if (enable) SetWindowLongPtr(overlay_hwnd, GWL_EXSTYLE, ex | WS_EX_TRANSPARENT);
-    else SetWindowLongPtr(overlay_hwnd, GWL_EXSTYLE, ex & ~WS_EX_TRANSPARENT);
-    // Adjust background opacity: locked -> fully transparent, unlocked -> restore configured alpha
-    if (enable) {
-      SetLayeredWindowAttributes(overlay_hwnd, 0, (BYTE)0, LWA_ALPHA);
-    } else {
-      SetLayeredWindowAttributes(overlay_hwnd, 0, (BYTE)overlay_alpha, LWA_ALPHA);
+void OverlayInstance::SetClickThrough(bool enable) {
+  if (!hwnd_) return;
+  LONG_PTR ex = GetWindowLongPtr(hwnd_, GWL_EXSTYLE);
+  if (enable) SetWindowLongPtr(hwnd_, GWL_EXSTYLE, ex | WS_EX_TRANSPARENT);
+  else SetWindowLongPtr(hwnd_, GWL_EXSTYLE, ex & ~WS_EX_TRANSPARENT);
+  // Locked hides the plate, unlocked restores it: a recomposite of the
+  // masks already drawn.
+  UpdateTextLayer();
+}
+
+void OverlayInstance::CommitStyleUpdate(const tono_overlay::OverlayStyleUpdate& update) {
+  if (update.ApplyTo(&state_)) ApplyChanges();
+}
+
+void OverlayInstance::SetLyricsText(const std::wstring& text) {
+  // Dropping a karaoke sweep redraws even the same text.
+  const bool force = karaoke_index_ >= 0;
+  karaoke_index_ = -1;
+  SetText(text, force);
+}
+
+void OverlayInstance::SetSheet(const std::vector<tono_overlay::LrcLine>& lines, int lookahead) {
+  std::vector<tono_overlay::LyricLine> sheet;
+  std::vector<std::wstring> sheet_texts;
+  std::vector<std::vector<tono_overlay::LrcWord>> sheet_words;
+  std::vector<int64_t> sheet_times;
+  std::string plain;
+  sheet.reserve(lines.size());
+  for (const tono_overlay::LrcLine& lrc : lines) {
+    // Enhanced LRC lines carry <mm:ss.xx> word tags for the sweep.
+    std::vector<tono_overlay::LrcWord> words;
+    tono_overlay::StripWordTimings(lrc.text, &plain, &words);
+    // Sheet text uses the same encoding as the cache key built from
+    // text_ in UpdateTextLayer().
+    std::wstring wide;
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, plain.c_str(), (int)plain.size(), NULL, 0);
+    if (size_needed > 0) {
+      wide.resize(size_needed);
+      MultiByteToWideChar(CP_UTF8, 0, plain.c_str(), (int)plain.size(), &wide[0], size_needed);
     }
+    // Word offsets from UTF-8 bytes to UTF-16 units.
+    for (auto& word : words) {
+      word.begin = (size_t)MultiByteToWideChar(CP_UTF8, 0, plain.c_str(), (int)word.begin, NULL, 0);
+    }
+    tono_overlay::LyricLine line;
+    line.time_ms = lrc.time_ms;
+    // Karaoke lines bypass the cache, so there is nothing to
+    // pre-render for them; an empty text is skipped by the worker.
+    if (words.empty()) line.text = wide_bytes(wide);
+    sheet.push_back(std::move(line));
+    sheet_times.push_back(lrc.time_ms);
+    sheet_texts.push_back(std::move(wide));
+    sheet_words.push_back(std::move(words));
   }
-  if (overlay_text_hwnd) {
-    LONG_PTR ex2 = GetWindowLongPtr(overlay_text_hwnd, GWL_EXSTYLE);
-    if (enable) SetWindowLongPtr(overlay_text_hwnd, GWL_EXSTYLE, ex2 | WS_EX_TRANSPARENT);
-    else SetWindowLongPtr(overlay_text_hwnd, GWL_EXSTYLE, ex2 & ~WS_EX_TRANSPARENT);
-  }
+  if (!prerenderer_) prerenderer_ = std::make_unique<tono_overlay::LinePrerenderer>(&overlay_line_cache);
+  if (lookahead >= 0) prerenderer_->SetLookahead(lookahead);
+  prerenderer_->SetSheet(std::move(sheet));
+  // Hand the worker the current style right away instead of waiting for
+  // the next line change.
+  UpdateTextLayer();
+  sheet_texts_ = std::move(sheet_texts);
+  sheet_words_ = std::move(sheet_words);
+  timeline_.SetTimes(std::move(sheet_times));
+  timeline_index_ = -1;
+  karaoke_index_ = -1;
+  TimelineTick();
+}
+
+void OverlayInstance::SetPlayback(int64_t position_ms, bool playing, double rate) {
+  timeline_.SetAnchor(position_ms, rate, !playing);
+  TimelineTick();
+  // Resume or stop the sweep, and snap it after a seek.
+  RequestFrame();
 }
 
-// Set the overlay alpha value (0..255). If the overlay window exists the
-// layered alpha is updated immediately; otherwise the value is stored and
+// Set the background plate alpha (0..255). If the overlay window exists the
+// plate is recomposited right away; otherwise the value is stored and
 // applied when the window is created.
-static void set_overlay_opacity_impl(int alpha) {
-  if (alpha < 0) alpha = 0;
-  if (alpha > 255) alpha = 255;
-  overlay_alpha = alpha;
-  AppendOverlayLog(std::string("set_overlay_opacity_impl: alpha=") + std::to_string(overlay_alpha));
-  if (overlay_hwnd) {
-    BOOL sla = SetLayeredWindowAttributes(overlay_hwnd, 0, (BYTE)overlay_alpha, LWA_ALPHA);
-    if (!sla) {
-      std::ostringstream ss;
-      ss << "set_overlay_opacity_impl: SetLayeredWindowAttributes failed, GetLastError=" << GetLastError();
-      AppendOverlayLog(ss.str());
-    } else {
-      AppendOverlayLog("set_overlay_opacity_impl: applied alpha");
-    }
+void OverlayInstance::SetOpacity(int alpha) {
+  if (!state_.SetBackgroundAlpha(alpha)) return;
+  TONO_VLOG("SetOpacity: id=" << id_ << " alpha=" << state_.style().background_alpha);
+  ApplyChanges();
+}
+
+// Line height in pixels of the current font (includes external leading),
+// measured once when the font was opened.
+int OverlayInstance::LineHeightPixels() const {
+  const int line_h = font_ ? font_->metrics().line_height : 0;
+  return line_h > 0 ? line_h : 16;  // fallback
+}
+
+// Recompute overlay height from width and lines, resize the window, and redraw.
+void OverlayInstance::UpdateSizeAndRedraw() {
+  const tono_overlay::OverlayStyle& style = state_.style();
+  int line_h = LineHeightPixels();
+  height_ = style.padding * 2 + (style.lines <= 1 ? line_h : line_h * style.lines);
+  if (hwnd_) {
+    MoveWindow(hwnd_, style.x, style.y, style.width, height_, FALSE);
+    UpdateTextLayer();
   }
 }
 
-// External API wrapper
-void SetLyricsOverlayOpacity(int alpha) {
-  set_overlay_opacity_impl(alpha);
+// Records a drag (or any other move) of the window. The move already
+// happened, so the position is not dirty.
+void OverlayInstance::OnMove(int x, int y) {
+  if (!state_.SetPosition(x, y)) return;
+  state_.MarkClean(tono_overlay::kFieldPosition);
+  tono_overlay::OverlayTracer::Global().Instant("window", "move", tono_overlay::StatsNowNs(), "x", x, "y", y);
+}
+
+void OverlayInstance::OnFrameReady() {
+  frame_pending_ = true;
+  RequestFrame();
+}
+
+void OverlayInstance::OnTimelineTimer() { TimelineTick(); }
+
+// Every overlay by id; the channel creates them on first use. Destroyed at
+// exit before the shared resources above, which its instances use.
+static tono_overlay::OverlayRegistry<OverlayInstance>& overlay_instances() {
+  static tono_overlay::OverlayRegistry<OverlayInstance> instances(
+      [](tono_overlay::OverlayId id) { return std::make_unique<OverlayInstance>(id); });
+  return instances;
+}
+
+// The overlay of the C API and of SetLyricsOverlayOpacity.
+static OverlayInstance* default_overlay() {
+  return overlay_instances().Get(tono_overlay::kDefaultOverlayId);
+}
+
+// Per-stage latency summaries for getOverlayStats:
+// {stage: {count, meanUs, p50Us, p95Us, p99Us, maxUs}}.
+static flutter::EncodableValue overlay_stats_value(bool reset) {
+  tono_overlay::OverlayStats& stats = tono_overlay::OverlayStats::Global();
+  flutter::EncodableMap stages;
+  for (int i = 0; i < (int)tono_overlay::TimingStage::kCount; ++i) {
+    const auto stage = (tono_overlay::TimingStage)i;
+    const tono_overlay::LatencySummary s = stats.Summary(stage);
+    flutter::EncodableMap m;
+    m[flutter::EncodableValue("count")] = flutter::EncodableValue((int64_t)s.count);
+    m[flutter::EncodableValue("meanUs")] = flutter::EncodableValue(s.mean_us);
+    m[flutter::EncodableValue("p50Us")] = flutter::EncodableValue(s.p50_us);
+    m[flutter::EncodableValue("p95Us")] = flutter::EncodableValue(s.p95_us);
+    m[flutter::EncodableValue("p99Us")] = flutter::EncodableValue(s.p99_us);
+    m[flutter::EncodableValue("maxUs")] = flutter::EncodableValue(s.max_us);
+    stages[flutter::EncodableValue(tono_overlay::TimingStageName(stage))] = flutter::EncodableValue(m);
+  }
+  if (reset) stats.Reset();
+  return flutter::EncodableValue(stages);
 }
 
-// Calculates line height in pixels for current font (includes external leading).
-static int get_line_height_pixels() {
-  int line_h = 16; // fallback
-  HDC hdc = GetDC(NULL);
-  HFONT old = nullptr;
-  if (overlay_hfont) old = (HFONT)SelectObject(hdc, overlay_hfont);
-  TEXTMETRIC tm = {};
-  if (GetTextMetrics(hdc, &tm)) {
-    line_h = tm.tmHeight + tm.tmExternalLeading;
+// Ids of the overlays that exist, with or without windows:
+// [{id, created}].
+static flutter::EncodableValue overlay_list_value() {
+  flutter::EncodableList list;
+  overlay_instances().ForEach([&list](tono_overlay::OverlayId id, OverlayInstance* instance) {
+    flutter::EncodableMap m;
+    m[flutter::EncodableValue("id")] = flutter::EncodableValue((int64_t)id);
+    m[flutter::EncodableValue("created")] = flutter::EncodableValue(instance->created());
+    list.push_back(flutter::EncodableValue(m));
+  });
+  return flutter::EncodableValue(list);
+}
+
+// Target of the dart:ffi calls in tono_overlay_api.h, which address the
+// default overlay; the MethodChannel handlers below call the same
+// functions.
+class LyricsOverlayApiHost : public tono_overlay::OverlayApiHost {
+ public:
+  bool OnHostThread() const override { return GetCurrentThreadId() == thread_id_; }
+  void Wake() override {
+    if (overlay_message_hwnd) PostMessage(overlay_message_hwnd, kOverlayApiWakeMessage, 0, 0);
+  }
+  void SetText(const std::string& utf8) override {
+    if (OverlayInstance* overlay = default_overlay()) overlay->SetLyricsText(WideFromUtf8(utf8));
+  }
+  void ApplyStyle(const tono_overlay::OverlayStyleUpdate& update) override {
+    if (OverlayInstance* overlay = default_overlay()) overlay->CommitStyleUpdate(update);
+  }
+  void SetSheet(const std::vector<tono_overlay::LrcLine>& lines) override {
+    if (OverlayInstance* overlay = default_overlay()) overlay->SetSheet(lines, -1);
+  }
+  void SetPlayback(int64_t position_ms, bool playing, double rate) override {
+    if (OverlayInstance* overlay = default_overlay()) overlay->SetPlayback(position_ms, playing, rate);
   }
-  if (old) SelectObject(hdc, old);
-  ReleaseDC(NULL, hdc);
-  return line_h;
+
+ private:
+  // The window thread, which registers the channel.
+  const DWORD thread_id_ = GetCurrentThreadId();
+};
+static std::unique_ptr<LyricsOverlayApiHost> overlay_api_host;
+
+// Routes the C API to the default overlay, on the thread that owns its
+// windows.
+static void register_overlay_api() {
+  if (overlay_api_host) return;
+  if (!ensure_overlay_message_window()) {
+    TONO_LOG(kError, "register_overlay_api: no message window");
+    return;
+  }
+  overlay_api_host = std::make_unique<LyricsOverlayApiHost>();
+  tono_overlay::SetOverlayApiHost(overlay_api_host.get(), &overlay_clock);
 }
 
-// Recompute overlay height from width and lines, resize windows, and redraw.
-static void update_overlay_size_and_redraw() {
-  int line_h = get_line_height_pixels();
-  int desired_h = overlay_padding * 2 + (overlay_lines <= 1 ? line_h : line_h * overlay_lines);
-  overlay_h = desired_h;
-  if (overlay_hwnd) {
-    MoveWindow(overlay_hwnd, overlay_x, overlay_y, overlay_w, overlay_h, TRUE);
+// The overlay a call addresses: {id: int} in a map argument, else the
+// default one. False if the id is not an integer.
+static bool parse_overlay_id(const flutter::EncodableValue* arguments, tono_overlay::OverlayId* id) {
+  *id = tono_overlay::kDefaultOverlayId;
+  const flutter::EncodableValue* value = LookupArg(arguments, "id");
+  if (!value) return true;
+  if (const int32_t* i32 = std::get_if<int32_t>(value)) {
+    *id = *i32;
+    return true;
+  }
+  if (const int64_t* i64 = std::get_if<int64_t>(value)) {
+    *id = *i64;
+    return true;
   }
-  if (overlay_text_hwnd) {
-    MoveWindow(overlay_text_hwnd, overlay_x, overlay_y, overlay_w, overlay_h, TRUE);
-    update_text_layer();
+  return false;
+}
+
+// applyOverlayStyle, or a single-purpose setter when |setter| is set.
+// Nothing is applied unless every field is valid; then the font is rebuilt
+// at most once and the overlay rendered once. Replies bad_args with the
+// reason, or the setter's usage, otherwise.
+static void apply_overlay_style(OverlayInstance* overlay, const tono_overlay::StyleSetter* setter,
+                                const flutter::EncodableValue* arguments,
+                                flutter::MethodResult<flutter::EncodableValue>& result) {
+  const EncodableStyleArgs args(arguments);
+  tono_overlay::OverlayStyleUpdate update;
+  std::string error;
+  const bool ok = setter ? tono_overlay::DecodeStyleSetter(*setter, args, &update, &error)
+                         : tono_overlay::DecodeStyleMap(args, &update, &error);
+  if (!ok) {
+    result.Error("bad_args", error);
+    return;
   }
+  overlay->CommitStyleUpdate(update);
+  result.Success(flutter::EncodableValue(true));
 }
 
-// Window proc implementation
+// External API wrapper; sets the background alpha of the default overlay.
+void SetLyricsOverlayOpacity(int alpha) {
+  if (OverlayInstance* overlay = default_overlay()) overlay->SetOpacity(alpha);
+}
+
+// Window proc implementation. The message window handles the shared
+// messages; an overlay's window finds it in GWLP_USERDATA, set from the
+// creation parameter. Layered windows updated with
+// UpdateLayeredWindowIndirect are never painted, so WM_PAINT goes to
+// DefWindowProc.
 static LRESULT CALLBACK OverlayWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+  if (uMsg == WM_NCCREATE) {
+    const CREATESTRUCT* create = reinterpret_cast<const CREATESTRUCT*>(lParam);
+    SetWindowLongPtr(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(create->lpCreateParams));
+    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+  }
   switch (uMsg) {
-    case WM_PAINT: {
-      // If this is the background window, paint background only.
-      if (hwnd == overlay_hwnd) {
-        PAINTSTRUCT ps;
-        HDC hdc = BeginPaint(hwnd, &ps);
-        RECT r;
-        GetClientRect(hwnd, &r);
-        HBRUSH br = CreateSolidBrush(RGB(0, 0, 0));
-        FillRect(hdc, &r, br);
-        DeleteObject(br);
-        EndPaint(hwnd, &ps);
-        return 0;
-      }
-      // For text window we rely on UpdateLayeredWindow; nothing to do here.
+    case kOverlayVsyncMessage: {
+      // One refresh for every overlay that asked for one.
+      overlay_instances().ForEach(
+          [](tono_overlay::OverlayId, OverlayInstance* instance) { instance->OnVsync(); });
       return 0;
     }
+    case kOverlayApiWakeMessage: {
+      tono_overlay::DrainOverlayApi();
+      return 0;
+    }
+  }
+  OverlayInstance* instance = reinterpret_cast<OverlayInstance*>(GetWindowLongPtr(hwnd, GWLP_USERDATA));
+  if (!instance) return DefWindowProc(hwnd, uMsg, wParam, lParam);
+  switch (uMsg) {
     case WM_LBUTTONDOWN: {
       LONG_PTR ex = GetWindowLongPtr(hwnd, GWL_EXSTYLE);
       if (!(ex & WS_EX_TRANSPARENT)) {
@@ -640,56 +1299,48 @@ static LRESULT CALLBACK OverlayWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPAR
       return 0;
     }
     case WM_MOVE: {
-      // Sync positions between the background and text windows so dragging moves both together.
-      int new_x = (int)(short)LOWORD(lParam);
-      int new_y = (int)(short)HIWORD(lParam);
-      // If the background moved, move the text window to match, and vice versa.
-      if (hwnd == overlay_hwnd) {
-        overlay_x = new_x;
-        overlay_y = new_y;
-        if (overlay_text_hwnd) {
-          SetWindowPos(overlay_text_hwnd, HWND_TOPMOST, overlay_x, overlay_y, 0, 0, SWP_NOSIZE | SWP_NOACTIVATE);
-        }
-      } else if (hwnd == overlay_text_hwnd) {
-        overlay_x = new_x;
-        overlay_y = new_y;
-        if (overlay_hwnd) {
-          SetWindowPos(overlay_hwnd, HWND_TOPMOST, overlay_x, overlay_y, 0, 0, SWP_NOSIZE | SWP_NOACTIVATE);
-        }
-      }
+      instance->OnMove((int)(short)LOWORD(lParam), (int)(short)HIWORD(lParam));
       return 0;
     }
-    case WM_DESTROY: {
-      auto ptr = reinterpret_cast<std::wstring*>(GetWindowLongPtr(hwnd, GWLP_USERDATA));
-      if (ptr) delete ptr;
+    case kOverlayFrameReadyMessage: {
+      instance->OnFrameReady();
       return 0;
     }
+    case WM_TIMER: {
+      if (wParam == kOverlayTimelineTimer) {
+        instance->OnTimelineTimer();
+        return 0;
+      }
+      break;
+    }
+    case WM_NCDESTROY: {
+      SetWindowLongPtr(hwnd, GWLP_USERDATA, 0);
+      break;
+    }
   }
   return DefWindowProc(hwnd, uMsg, wParam, lParam);
 }
 
 void RegisterLyricsOverlayChannel(flutter::BinaryMessenger* messenger,
                                   flutter::FlutterViewController* controller) {
+  ensure_overlay_logger();
+  register_overlay_api();
   auto channel = std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
     messenger, "com.enten0103.tono_music/window",
     &flutter::StandardMethodCodec::GetInstance());
 
+  // Every method but setClickThrough and the process-wide ones addresses
+  // one overlay by the optional "id" argument (default 0), creating it on
+  // first use; settings sent before its windows exist apply once they do.
   channel->SetMethodCallHandler(
       [controller](const flutter::MethodCall<flutter::EncodableValue>& call,
                    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
         const std::string method = call.method_name();
+        tono_overlay::ScopedTraceEvent trace("channel", method);
         if (method == "setClickThrough") {
           bool enable = false;
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto it = map->find(flutter::EncodableValue("enabled"));
-            if (it != map->end()) {
-              if (const bool* b = std::get_if<bool>(&it->second)) {
-                enable = *b;
-              }
-            }
-          } else if (const bool* b = std::get_if<bool>(call.arguments())) {
-            enable = *b;
-          }
+          const flutter::EncodableValue* enabled = LookupArg(call.arguments(), "enabled");
+          if (!BoolArg(enabled ? enabled : call.arguments(), &enable)) enable = false;
           HWND hwnd = controller->view()->GetNativeWindow();
           if (hwnd) {
             LONG_PTR ex = GetWindowLongPtr(hwnd, GWL_EXSTYLE);
@@ -707,431 +1358,184 @@ void RegisterLyricsOverlayChannel(flutter::BinaryMessenger* messenger,
           return;
         }
 
-        if (method == "createLyricsWindow") {
-          bool ok = create_overlay();
-          result->Success(flutter::EncodableValue(ok));
+        // Process-wide: the line cache and stats are shared by every overlay.
+        if (method == "getOverlayCacheStats") {
+          tono_overlay::LineCacheStats st = overlay_line_cache.stats();
+          flutter::EncodableMap m;
+          m[flutter::EncodableValue("hits")] = flutter::EncodableValue((int64_t)st.hits);
+          m[flutter::EncodableValue("misses")] = flutter::EncodableValue((int64_t)st.misses);
+          m[flutter::EncodableValue("insertions")] = flutter::EncodableValue((int64_t)st.insertions);
+          m[flutter::EncodableValue("evictions")] = flutter::EncodableValue((int64_t)st.evictions);
+          m[flutter::EncodableValue("entries")] = flutter::EncodableValue((int64_t)st.entries);
+          m[flutter::EncodableValue("bytes")] = flutter::EncodableValue((int64_t)st.bytes);
+          m[flutter::EncodableValue("budgetBytes")] = flutter::EncodableValue((int64_t)st.byte_budget);
+          result->Success(flutter::EncodableValue(m));
           return;
         }
-        if (method == "destroyLyricsWindow") {
-          destroy_overlay();
-          result->Success(flutter::EncodableValue(true));
+
+        if (method == "getOverlayStats") {
+          // {reset?: bool}: clears the histograms after reading them.
+          bool reset = false;
+          if (!BoolArg(LookupArg(call.arguments(), "reset"), &reset)) reset = false;
+          result->Success(overlay_stats_value(reset));
           return;
         }
-        if (method == "showLyricsWindow") {
-          if (!create_overlay()) {
-            result->Error("create_failed", "Failed to create overlay");
+
+        if (method == "setOverlayCacheBudget") {
+          int bytes = -1;
+          if (!IntArg(LookupArg(call.arguments(), "bytes"), &bytes) || bytes < 0) {
+            result->Error("bad_args", "Expected {bytes: int>=0}");
             return;
           }
-          if (overlay_hwnd) ShowWindow(overlay_hwnd, SW_SHOWNOACTIVATE);
-          if (overlay_text_hwnd) ShowWindow(overlay_text_hwnd, SW_SHOWNOACTIVATE);
+          overlay_line_cache.SetByteBudget((size_t)bytes);
           result->Success(flutter::EncodableValue(true));
           return;
         }
-        if (method == "hideLyricsWindow") {
-          if (overlay_hwnd) ShowWindow(overlay_hwnd, SW_HIDE);
-          if (overlay_text_hwnd) ShowWindow(overlay_text_hwnd, SW_HIDE);
-          result->Success(flutter::EncodableValue(true));
+
+        if (method == "listLyricsWindows") {
+          result->Success(overlay_list_value());
           return;
         }
-        if (method == "setOverlayWidth") {
-          int parsed = -1;
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto it = map->find(flutter::EncodableValue("width"));
-            if (it != map->end()) {
-              if (const std::string* ss = std::get_if<std::string>(&it->second)) {
-                try { parsed = std::stoi(*ss); } catch (...) { parsed = -1; }
-              } else if (const int64_t* pi = std::get_if<int64_t>(&it->second)) {
-                parsed = (int)*pi;
-              } else if (const double* pd = std::get_if<double>(&it->second)) {
-                parsed = (int)std::round(*pd);
-              }
-            }
-          }
-          if (parsed > 0) {
-            overlay_w = parsed;
-            update_overlay_size_and_redraw();
-            result->Success(flutter::EncodableValue(true));
-            return;
-          }
-          result->Error("bad_args", "Expected {width: int}");
+
+        tono_overlay::OverlayId id = tono_overlay::kDefaultOverlayId;
+        if (!parse_overlay_id(call.arguments(), &id)) {
+          result->Error("bad_args", "Expected {id: int}");
           return;
         }
-        if (method == "setOverlayLines") {
-          int parsed = -1;
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto it = map->find(flutter::EncodableValue("lines"));
-            if (it != map->end()) {
-              if (const std::string* ss = std::get_if<std::string>(&it->second)) {
-                try { parsed = std::stoi(*ss); } catch (...) { parsed = -1; }
-              } else if (const int64_t* pi = std::get_if<int64_t>(&it->second)) {
-                parsed = (int)*pi;
-              } else if (const double* pd = std::get_if<double>(&it->second)) {
-                parsed = (int)std::round(*pd);
-              }
-            }
-          }
-          if (parsed > 0) {
-            overlay_lines = parsed;
-            update_overlay_size_and_redraw();
-            result->Success(flutter::EncodableValue(true));
-            return;
+        if (method == "destroyLyricsWindow") {
+          // The default overlay keeps its text and style for the next
+          // window; any other is gone with its windows.
+          if (id == tono_overlay::kDefaultOverlayId) {
+            if (OverlayInstance* overlay = overlay_instances().Find(id)) overlay->Destroy();
+          } else {
+            overlay_instances().Remove(id);
           }
-          result->Error("bad_args", "Expected {lines: int>0}");
+          result->Success(flutter::EncodableValue(true));
           return;
         }
-        if (method == "setLyricsText") {
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto it = map->find(flutter::EncodableValue("text"));
-            if (it != map->end()) {
-              if (const std::string* s = std::get_if<std::string>(&it->second)) {
-                int size_needed = MultiByteToWideChar(CP_UTF8, 0, s->c_str(), (int)s->size(), NULL, 0);
-                std::wstring wstrTo(size_needed, 0);
-                MultiByteToWideChar(CP_UTF8, 0, s->c_str(), (int)s->size(), &wstrTo[0], size_needed);
-                set_overlay_text(wstrTo);
-                result->Success(flutter::EncodableValue(true));
-                return;
-              }
-            }
-          }
-          result->Error("bad_args", "Expected {text: string}");
+        if (method == "hideLyricsWindow") {
+          if (OverlayInstance* overlay = overlay_instances().Find(id)) overlay->Hide();
+          result->Success(flutter::EncodableValue(true));
           return;
         }
-
-        if(method == "setLyricsFontFamily") {
-          if (const std::string* s = std::get_if<std::string>(call.arguments())) {
-            int size_needed = MultiByteToWideChar(CP_UTF8, 0, s->c_str(), (int)s->size(), NULL, 0);
-            std::wstring wstrTo(size_needed, 0);
-            MultiByteToWideChar(CP_UTF8, 0, s->c_str(), (int)s->size(), &wstrTo[0], size_needed);
-            overlay_font_family = wstrTo;
-            update_overlay_font();
-            if (overlay_hwnd) InvalidateRect(overlay_hwnd, NULL, TRUE);
-            update_overlay_size_and_redraw();
-            result->Success(flutter::EncodableValue(true));
-            return;
-          }
-          result->Error("bad_args", "Expected string font family");
+        OverlayInstance* overlay = overlay_instances().Get(id);
+        if (!overlay) {
+          result->Error("too_many_overlays", "No more overlay windows can be opened");
           return;
         }
 
-        // Individual style setters (replaces legacy setLyricsStyle map).
-        if (method == "setLyricsFontSize") {
-          // Accept either a map {fontSize: value} or a direct string/int
-          int parsed = -1;
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto it = map->find(flutter::EncodableValue("fontSize"));
-            if (it != map->end()) {
-              if (const std::string* ss = std::get_if<std::string>(&it->second)) {
-                try { parsed = std::stoi(*ss); } catch (...) { parsed = -1; }
-              } else {
-                if (ParseIntFromEncodable(&it->second, parsed) == false) parsed = -1;
-              }
-            }
-          } else {
-            if (const std::string* ss = std::get_if<std::string>(call.arguments())) {
-              try { parsed = std::stoi(*ss); } catch (...) { parsed = -1; }
-            } else {
-              if (!ParseIntFromEncodable(call.arguments(), parsed)) parsed = -1;
-            }
-          }
-          if (parsed >= 0) {
-            overlay_font_size = parsed;
-            update_overlay_font();
-            if (overlay_hwnd) InvalidateRect(overlay_hwnd, NULL, TRUE);
-            update_overlay_size_and_redraw();
-            result->Success(flutter::EncodableValue(true));
-            return;
-          }
-          result->Error("bad_args", "Expected fontSize (int|string)");
+        if (method == "createLyricsWindow") {
+          bool ok = overlay->Create();
+          result->Success(flutter::EncodableValue(ok));
           return;
         }
-
-        if (method == "setLyricsFontWeight") {
-          int weight = -1;
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto it = map->find(flutter::EncodableValue("weight"));
-            if (it != map->end()) {
-              if (const std::string* ss = std::get_if<std::string>(&it->second)) {
-                try { weight = std::stoi(*ss); } catch (...) { weight = -1; }
-                if (weight < 1) {
-                  std::string v = *ss; for (auto &c : v) c = (char)tolower(c);
-                  // English names
-                  if (v == "thin" || v == "hairline") weight = 100;
-                  else if (v == "extralight" || v == "ultralight") weight = 200;
-                  else if (v == "light") weight = 300;
-                  else if (v == "regular" || v == "normal") weight = 400;
-                  else if (v == "medium") weight = 500;
-                  else if (v == "semibold" || v == "demibold") weight = 600;
-                  else if (v == "bold") weight = 700;
-                  else if (v == "extrabold" || v == "ultrabold") weight = 800;
-                  else if (v == "black" || v == "heavy") weight = 900;
-                  // Chinese aliases (best-effort mapping)
-                  else if (v == "极细" || v == "超细") weight = 100;
-                  else if (v == "纤细") weight = 200;
-                  else if (v == "细") weight = 300;
-                  else if (v == "常规" || v == "正常") weight = 400;
-                  else if (v == "中" || v == "中等") weight = 500;
-                  else if (v == "半粗" || v == "中粗") weight = 600;
-                  else if (v == "粗" || v == "加粗") weight = 700;
-                  else if (v == "特粗" || v == "超粗") weight = 800;
-                  else if (v == "黑" || v == "重" || v == "黑体") weight = 900;
-                }
-              } else if (const int64_t* pi = std::get_if<int64_t>(&it->second)) {
-                weight = (int)*pi;
-              } else if (const double* pd = std::get_if<double>(&it->second)) {
-                weight = (int)std::round(*pd);
-              }
-            }
-          }
-          if (weight > 0) {
-            if (weight < 100) weight = 100; if (weight > 900) weight = 900;
-            overlay_font_weight = weight;
-            overlay_font_bold = (weight >= 700);
-            update_overlay_font();
-            if (overlay_hwnd) InvalidateRect(overlay_hwnd, NULL, TRUE);
-            update_overlay_size_and_redraw();
-            result->Success(flutter::EncodableValue(true));
+        if (method == "showLyricsWindow") {
+          if (!overlay->Create()) {
+            result->Error("create_failed", "Failed to create overlay");
             return;
           }
-          result->Error("bad_args", "Expected {weight: 100..900 | named}");
+          overlay->Show();
+          result->Success(flutter::EncodableValue(true));
           return;
         }
-
-        if (method == "setLyricsTextColor") {
-          int rgb = -1;
-          std::ostringstream ssdet;
-          // Detect top-level argument type for debugging
+        if (method == "setLyricsText") {
           if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            ssdet << "setLyricsTextColor: arg is EncodableMap";
-            AppendOverlayLog(ssdet.str());
-            auto it = map->find(flutter::EncodableValue("textColor"));
+            auto it = map->find(flutter::EncodableValue("text"));
             if (it != map->end()) {
-              if (const std::string* cs = std::get_if<std::string>(&it->second)) {
-                try {
-                  std::string s = *cs;
-                  AppendOverlayLog(s);
-                  if (!s.empty() && s[0] == '#') s = s.substr(1);
-                  if (s.rfind("0x", 0) == 0 || s.rfind("0X", 0) == 0) s = s.substr(2);
-                  rgb = (int)std::stoul(s, nullptr, 16) & 0xFFFFFF;
-                } catch (...) {
-                  rgb = -1;
-                }
-                std::ostringstream ss; ss << "setLyricsTextColor: parsed from map string=" << (cs?*cs:"(null)") << " -> rgb=" << rgb; AppendOverlayLog(ss.str());
-              } else if (const int64_t* pi = std::get_if<int64_t>(&it->second)) {
-                rgb = (int)(*pi & 0xFFFFFF);
-                std::ostringstream ss; ss << "setLyricsTextColor: parsed from map int=" << *pi << " -> rgb=" << rgb; AppendOverlayLog(ss.str());
-              } else {
-                bool ok = ParseColorFromEncodable(&it->second, rgb);
-                std::ostringstream ss; ss << "setLyricsTextColor: parsed from map via ParseColorFromEncodable -> ok=" << ok << " rgb=" << rgb; AppendOverlayLog(ss.str());
+              if (const std::string* s = std::get_if<std::string>(&it->second)) {
+                overlay->SetLyricsText(WideFromUtf8(*s));
+                result->Success(flutter::EncodableValue(true));
+                return;
               }
-            } else {
-              AppendOverlayLog("setLyricsTextColor: map provided but no 'textColor' key");
             }
-          } else if (const std::string* cs = std::get_if<std::string>(call.arguments())) {
-            std::ostringstream ss; ss << "setLyricsTextColor: arg is string='" << *cs << "'"; AppendOverlayLog(ss.str());
-            try {
-              std::string s = *cs;
-              if (!s.empty() && s[0] == '#') s = s.substr(1);
-              if (s.rfind("0x", 0) == 0 || s.rfind("0X", 0) == 0) s = s.substr(2);
-              rgb = (int)std::stoul(s, nullptr, 16) & 0xFFFFFF;
-            } catch (...) { rgb = -1; }
-            std::ostringstream ss2; ss2 << "setLyricsTextColor: parsed from string -> rgb=" << rgb; AppendOverlayLog(ss2.str());
-          } else if (const int64_t* pi = std::get_if<int64_t>(call.arguments())) {
-            rgb = (int)(*pi & 0xFFFFFF);
-            std::ostringstream ss; ss << "setLyricsTextColor: arg is int64=" << *pi << " -> rgb=" << rgb; AppendOverlayLog(ss.str());
-          } else if (const double* pd = std::get_if<double>(call.arguments())) {
-            rgb = (int)std::round(*pd) & 0xFFFFFF;
-            std::ostringstream ss; ss << "setLyricsTextColor: arg is double=" << *pd << " -> rgb=" << rgb; AppendOverlayLog(ss.str());
-          } else if (const std::vector<uint8_t>* pb = std::get_if<std::vector<uint8_t>>(call.arguments())) {
-            try {
-              std::string s(pb->begin(), pb->end());
-              std::ostringstream ss; ss << "setLyricsTextColor: arg is bytevector->'" << s << "'"; AppendOverlayLog(ss.str());
-              if (!s.empty() && s[0] == '#') s = s.substr(1);
-              rgb = (int)std::stoul(s, nullptr, 16) & 0xFFFFFF;
-              std::ostringstream ss2; ss2 << "setLyricsTextColor: parsed from bytevector -> rgb=" << rgb; AppendOverlayLog(ss2.str());
-            } catch (...) { rgb = -1; }
-          } else {
-            AppendOverlayLog("setLyricsTextColor: arg type not recognized");
-            // Fallback: try general parser
-            ParseColorFromEncodable(call.arguments(), rgb);
-            std::ostringstream ss; ss << "setLyricsTextColor: fallback parse rgb=" << rgb; AppendOverlayLog(ss.str());
-          }
-
-          // If parsing succeeded (rgb may be 0 for black which is valid), we accept >=0
-          if (rgb >= 0) {
-            std::ostringstream ss; ss << "setLyricsTextColor: final rgb=0x" << std::hex << (rgb & 0xFFFFFF) << std::dec;
-            AppendOverlayLog(ss.str());
-            overlay_text_color = RGB((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
-            // If using separate text layer, update it; otherwise repaint.
-            update_text_layer();
-            if (overlay_hwnd) InvalidateRect(overlay_hwnd, NULL, TRUE);
-            result->Success(flutter::EncodableValue(true));
-            return;
           }
-          result->Error("bad_args", "Expected textColor (int|string)");
+          result->Error("bad_args", "Expected {text: string}");
           return;
         }
 
-        if (method == "setLyricsBold") {
-          bool bval = false;
-          bool parsed = false;
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto it = map->find(flutter::EncodableValue("bold"));
-            if (it != map->end()) {
-              if (const std::string* bs = std::get_if<std::string>(&it->second)) {
-                std::string s = *bs;
-                for (auto &c : s) c = (char)tolower(c);
-                if (s == "true" || s == "1") { bval = true; parsed = true; }
-                else if (s == "false" || s == "0") { bval = false; parsed = true; }
-                else { try { bval = (std::stoi(s) != 0); parsed = true; } catch (...) { parsed = false; } }
-              } else {
-                if (ParseBoolFromEncodable(&it->second, bval)) parsed = true;
-              }
-            }
-          } else {
-            if (const std::string* bs = std::get_if<std::string>(call.arguments())) {
-              std::string s = *bs;
-              for (auto &c : s) c = (char)tolower(c);
-              if (s == "true" || s == "1") { bval = true; parsed = true; }
-              else if (s == "false" || s == "0") { bval = false; parsed = true; }
-              else { try { bval = (std::stoi(s) != 0); parsed = true; } catch (...) { parsed = false; } }
-            } else {
-              if (ParseBoolFromEncodable(call.arguments(), bval)) parsed = true;
-            }
-          }
-          if (parsed) {
-            overlay_font_bold = bval;
-            overlay_font_weight = bval ? FW_BOLD : FW_NORMAL;
-            update_overlay_font();
-            if (overlay_hwnd) InvalidateRect(overlay_hwnd, NULL, TRUE);
-            update_overlay_size_and_redraw();
-            result->Success(flutter::EncodableValue(true));
-            return;
-          }
-          result->Error("bad_args", "Expected bold (bool|int|string)");
+        if (method == "applyOverlayStyle") {
+          // Any subset of the OverlayStyleUpdate fields, plus the "id" of
+          // the overlay.
+          apply_overlay_style(overlay, nullptr, call.arguments(), *result);
           return;
         }
-        if (method == "setLyricsPosition") {
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto itx = map->find(flutter::EncodableValue("x"));
-            auto ity = map->find(flutter::EncodableValue("y"));
-            if (itx != map->end() && ity != map->end()) {
-              if (const int64_t* xi = std::get_if<int64_t>(&itx->second)) {
-                if (const int64_t* yi = std::get_if<int64_t>(&ity->second)) {
-                  set_overlay_pos((int)*xi, (int)*yi);
-                  result->Success(flutter::EncodableValue(true));
-                  return;
-                }
-              }
-            }
-          }
-          result->Error("bad_args", "Expected {x: int, y: int}");
+
+        if (const tono_overlay::StyleSetter* setter = tono_overlay::FindStyleSetter(method)) {
+          apply_overlay_style(overlay, setter, call.arguments(), *result);
           return;
         }
+
         if (method == "setOverlayClickThrough") {
           bool enable = false;
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto it = map->find(flutter::EncodableValue("enabled"));
-            if (it != map->end()) {
-              if (const bool* b = std::get_if<bool>(&it->second)) {
-                enable = *b;
-              }
-            }
-          }
-          set_overlay_clickthrough(enable);
+          if (!BoolArg(LookupArg(call.arguments(), "enabled"), &enable)) enable = false;
+          overlay->SetClickThrough(enable);
           result->Success(flutter::EncodableValue(enable));
           return;
         }
 
-        if (method == "setOverlayOpacity") {
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto it = map->find(flutter::EncodableValue("alpha"));
-            if (it != map->end()) {
-              if (const std::string* alpha = std::get_if<std::string>(&it->second)) {
-                set_overlay_opacity_impl(std::stoi(*alpha));
-                result->Success(flutter::EncodableValue(true));
-                return;
-              }
+        if (method == "setLyricsSheet") {
+          // {lrc: String, lookahead?: int}, parsed here, or the parsed lines
+          // as {times: List<int> (ms), texts: List<String>, lookahead?: int}.
+          const char* usage = "Expected {lrc: String} or {times: List<int>, texts: List<String>} of equal length";
+          int lookahead = -1;
+          if (!IntArg(LookupArg(call.arguments(), "lookahead"), &lookahead)) lookahead = -1;
+          if (const flutter::EncodableValue* lrc = LookupArg(call.arguments(), "lrc")) {
+            const std::string* s = std::get_if<std::string>(lrc);
+            if (!s) {
+              result->Error("bad_args", usage);
+              return;
             }
-          }
-          result->Error("bad_args", "Expected {alpha: int}");
-          return;
-        }
-
-        if (method == "setLyricsStroke") {
-          int wpx = -1; int rgb = -1;
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto itw = map->find(flutter::EncodableValue("width"));
-            auto itc = map->find(flutter::EncodableValue("color"));
-            if (itw != map->end()) {
-              if (const int64_t* pi = std::get_if<int64_t>(&itw->second)) wpx = (int)*pi;
-              else if (const std::string* ss = std::get_if<std::string>(&itw->second)) { try { wpx = std::stoi(*ss);} catch(...) { wpx = -1; } }
-              else if (const double* pd = std::get_if<double>(&itw->second)) wpx = (int)std::round(*pd);
-            }
-            if (itc != map->end()) {
-              if (const std::string* cs = std::get_if<std::string>(&itc->second)) {
-                try { std::string s=*cs; if(!s.empty()&&s[0]=='#') s=s.substr(1); if (s.rfind("0x",0)==0||s.rfind("0X",0)==0) s=s.substr(2); rgb=(int)std::stoul(s,nullptr,16)&0xFFFFFF; } catch(...) { rgb=-1; }
-              } else if (const int64_t* pi = std::get_if<int64_t>(&itc->second)) rgb = (int)(*pi & 0xFFFFFF);
-              else { ParseColorFromEncodable(&itc->second, rgb); }
-            }
-          }
-          if (wpx >= 0 && rgb >= 0) {
-            if (wpx > 20) wpx = 20;
-            overlay_stroke_width = wpx;
-            overlay_stroke_color = RGB((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
-            update_text_layer();
+            const std::vector<tono_overlay::LrcLine>& lines = overlay_lrc_parser.Parse(*s);
+            overlay->SetSheet(lines, lookahead);
+            TONO_LOG(kInfo, "setLyricsSheet: id=" << id << " " << lines.size() << " lines");
             result->Success(flutter::EncodableValue(true));
             return;
           }
-          result->Error("bad_args", "Expected {width:int>=0,color:int|string}");
-          return;
-        }
-
-        if (method == "setLyricsTextAlign") {
-          int align = -1;
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto it = map->find(flutter::EncodableValue("align"));
-            if (it != map->end()) {
-              if (const std::string* s = std::get_if<std::string>(&it->second)) {
-                std::string v = *s; for (auto &c : v) c = (char)tolower(c);
-                if (v == "left") align = 0; else if (v == "center" || v == "centre") align = 1; else if (v == "right") align = 2;
-              } else if (const int64_t* pi = std::get_if<int64_t>(&it->second)) {
-                align = (int)*pi; if (align < 0 || align > 2) align = -1;
-              }
-            }
+          const flutter::EncodableList* times = nullptr;
+          const flutter::EncodableList* texts = nullptr;
+          if (const flutter::EncodableValue* arg = LookupArg(call.arguments(), "times")) {
+            times = std::get_if<flutter::EncodableList>(arg);
           }
-          if (align >= 0) {
-            overlay_text_align = align;
-            update_text_layer();
-            if (overlay_hwnd) InvalidateRect(overlay_hwnd, NULL, TRUE);
-            result->Success(flutter::EncodableValue(true));
+          if (const flutter::EncodableValue* arg = LookupArg(call.arguments(), "texts")) {
+            texts = std::get_if<flutter::EncodableList>(arg);
+          }
+          if (!times || !texts || times->size() != texts->size()) {
+            result->Error("bad_args", usage);
             return;
           }
-          result->Error("bad_args", "Expected {align: 'left'|'center'|'right'|0|1|2}");
+          // The texts stay in the call's arguments meanwhile.
+          std::vector<tono_overlay::LrcLine> lines(texts->size());
+          for (size_t i = 0; i < texts->size(); ++i) {
+            const std::string* s = std::get_if<std::string>(&(*texts)[i]);
+            int time_ms = 0;
+            if (!s || !IntArg(&(*times)[i], &time_ms)) {
+              result->Error("bad_args", usage);
+              return;
+            }
+            lines[i].time_ms = time_ms;
+            lines[i].text = *s;
+          }
+          overlay->SetSheet(lines, lookahead);
+          TONO_LOG(kInfo, "setLyricsSheet: id=" << id << " " << lines.size() << " lines");
+          result->Success(flutter::EncodableValue(true));
           return;
         }
 
-        if (method == "setLyricsTextOpacity") {
-          int parsed = -1;
-          if (const auto* map = std::get_if<flutter::EncodableMap>(call.arguments())) {
-            auto it = map->find(flutter::EncodableValue("alpha"));
-            if (it != map->end()) {
-              if (const std::string* ss = std::get_if<std::string>(&it->second)) {
-                try { parsed = std::stoi(*ss); } catch (...) { parsed = -1; }
-              } else if (const int64_t* pi = std::get_if<int64_t>(&it->second)) {
-                parsed = (int)*pi;
-              } else if (const double* pd = std::get_if<double>(&it->second)) {
-                parsed = (int)std::round(*pd);
-              }
-            }
-          }
-          if (parsed >= 0) {
-            if (parsed < 0) parsed = 0; if (parsed > 255) parsed = 255;
-            overlay_text_opacity = parsed;
-            update_text_layer();
-            result->Success(flutter::EncodableValue(true));
+        if (method == "setLyricsPlayback") {
+          // {positionMs: int, playing: bool, rate?: double}
+          int position_ms = -1;
+          bool playing = false;
+          double rate = 1.0;
+          bool ok = IntArg(LookupArg(call.arguments(), "positionMs"), &position_ms) && position_ms >= 0 &&
+                    BoolArg(LookupArg(call.arguments(), "playing"), &playing);
+          const flutter::EncodableValue* rate_arg = LookupArg(call.arguments(), "rate");
+          if (ok && rate_arg) ok = NumberArg(rate_arg, &rate) && rate > 0.0;
+          if (!ok) {
+            result->Error("bad_args", "Expected {positionMs: int>=0, playing: bool, rate?: double>0}");
             return;
           }
-          result->Error("bad_args", "Expected {alpha: int}");
+          overlay->SetPlayback(position_ms, playing, rate);
+          result->Success(flutter::EncodableValue(true));
           return;
         }
 
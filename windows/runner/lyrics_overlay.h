@@ -16,10 +16,10 @@ class FlutterViewController;
 void RegisterLyricsOverlayChannel(flutter::BinaryMessenger* messenger,
                                   flutter::FlutterViewController* controller);
 
-// Programmatic API: set the overlay opacity (alpha 0..255). If the overlay
-// window exists this will apply immediately; otherwise the value is stored
-// and applied when the window is created. Only integer values in the range
-// 0..255 are accepted.
+// Programmatic API: set the opacity (alpha 0..255) of the default overlay
+// (id 0 on the channel). If its window exists this will apply immediately;
+// otherwise the value is stored and applied when the window is created. Only
+// integer values in the range 0..255 are accepted.
 void SetLyricsOverlayOpacity(int alpha);
 
 // Set overlay font style. font_family: UTF-8 string converted to wide string.
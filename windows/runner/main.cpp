@@ -2,7 +2,10 @@
 #include <flutter/flutter_view_controller.h>
 #include <windows.h>
 
+#include <cstdlib>
+
 #include "flutter_window.h"
+#include "overlay_core/overlay_trace.h"
 #include "utils.h"
 
 int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev,
@@ -22,6 +25,30 @@ int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev,
   std::vector<std::string> command_line_arguments =
       GetCommandLineArguments();
 
+  // --overlay-trace=<path> (or %TONO_OVERLAY_TRACE%=<path>) records a Chrome
+  // trace of the overlay and the window channel, written at exit. The flag
+  // is removed so Dart never sees it.
+  std::string trace_path;
+  char* trace_env = nullptr;
+  size_t trace_env_size = 0;
+  if (_dupenv_s(&trace_env, &trace_env_size, tono_overlay::kTraceEnvVar) == 0 &&
+      trace_env != nullptr) {
+    trace_path = trace_env;
+    free(trace_env);
+  }
+  std::vector<std::string> dart_arguments;
+  for (const std::string& argument : command_line_arguments) {
+    if (!tono_overlay::ParseTraceFlag(argument, &trace_path)) {
+      dart_arguments.push_back(argument);
+    }
+  }
+  command_line_arguments = std::move(dart_arguments);
+  tono_overlay::OverlayTracer& tracer = tono_overlay::OverlayTracer::Global();
+  if (!trace_path.empty()) {
+    tracer.Start(trace_path);
+    tracer.SetThreadName("platform");
+  }
+
   project.set_dart_entrypoint_arguments(std::move(command_line_arguments));
 
   FlutterWindow window(project);
@@ -38,6 +65,10 @@ int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev,
     ::DispatchMessage(&msg);
   }
 
+  if (tracer.enabled() && !tracer.Stop()) {
+    ::OutputDebugStringA("Failed to write the overlay trace\n");
+  }
+
   ::CoUninitialize();
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,69 @@
+#include "vsync_pacer.h"
+
+#include <dwmapi.h>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+VsyncPacer::VsyncPacer(HWND hwnd, UINT message) : hwnd_(hwnd), message_(message) {
+  // High-resolution timers need Windows 10 1803; older systems get the
+  // default one, which is as coarse as the system timer.
+  timer_ = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+  if (!timer_) timer_ = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+  HDC hdc = GetDC(hwnd);
+  const int hz = hdc ? GetDeviceCaps(hdc, VREFRESH) : 0;
+  if (hdc) ReleaseDC(hwnd, hdc);
+  // 0 and 1 mean "hardware default".
+  if (hz > 1) period_100ns_ = 10000000 / hz;
+  worker_ = std::thread([this] { Run(); });
+}
+
+VsyncPacer::~VsyncPacer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  worker_.join();
+  if (timer_) CloseHandle(timer_);
+}
+
+void VsyncPacer::RequestFrame() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (requested_) return;
+    requested_ = true;
+  }
+  wake_.notify_one();
+}
+
+void VsyncPacer::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait(lock, [this] { return requested_ || stop_; });
+    if (stop_) return;
+    lock.unlock();
+    WaitForRefresh();
+    lock.lock();
+    if (stop_) return;
+    // Cleared after the wait, so everything requested until now lands in
+    // this one message.
+    requested_ = false;
+    PostMessage(hwnd_, message_, 0, 0);
+  }
+}
+
+void VsyncPacer::WaitForRefresh() {
+  BOOL composition = FALSE;
+  if (SUCCEEDED(DwmIsCompositionEnabled(&composition)) && composition && SUCCEEDED(DwmFlush())) return;
+  if (timer_) {
+    LARGE_INTEGER due;
+    due.QuadPart = -period_100ns_;
+    if (SetWaitableTimer(timer_, &due, 0, NULL, NULL, FALSE)) {
+      WaitForSingleObject(timer_, INFINITE);
+      return;
+    }
+  }
+  Sleep((DWORD)(period_100ns_ / 10000));
+}
@@ -0,0 +1,45 @@
+#ifndef RUNNER_VSYNC_PACER_H_
+#define RUNNER_VSYNC_PACER_H_
+
+#include <windows.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Posts |message| to a window once per display refresh, on demand. A
+// worker thread waits for the next DWM composition pass (DwmFlush) and,
+// where composition is off or DwmFlush fails, for a high-resolution
+// waitable timer at the monitor's refresh period. It only runs while
+// frames are requested, so an idle overlay costs no wakeups.
+class VsyncPacer {
+ public:
+  VsyncPacer(HWND hwnd, UINT message);
+  // Stops the worker. A message it already posted may still arrive.
+  ~VsyncPacer();
+
+  VsyncPacer(const VsyncPacer&) = delete;
+  VsyncPacer& operator=(const VsyncPacer&) = delete;
+
+  // Asks for one message after the next refresh. Any thread; requests made
+  // before that message is posted merge into it.
+  void RequestFrame();
+
+ private:
+  void Run();
+  // Blocks until the next refresh, roughly.
+  void WaitForRefresh();
+
+  const HWND hwnd_;
+  const UINT message_;
+  HANDLE timer_ = nullptr;
+  LONGLONG period_100ns_ = 166667;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool requested_ = false;
+  bool stop_ = false;
+  std::thread worker_;
+};
+
+#endif  // RUNNER_VSYNC_PACER_H_